@@ -0,0 +1,154 @@
+#include "../include/sampler.h"
+#include "../lab1/include/metrics.h"
+
+#include <time.h>
+
+/**
+ * @brief Iterations of each collector when none is given
+ */
+#define BENCH_DEFAULT_ITERATIONS 2000
+
+/** @brief Calls to malloc, calloc and realloc of the binary, the C library's own excepted */
+static uint64_t allocations = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+/*
+ * The bench is linked with --wrap for the three functions, so only its
+ * calls and those of the shell library go through here.
+ */
+void* __wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+
+static double collect_cpu(void)
+{
+    return get_cpu_usage();
+}
+
+static double collect_memory(void)
+{
+    return get_memory_usage();
+}
+
+static double collect_disk(void)
+{
+    return get_IOdisk();
+}
+
+static double collect_network(void)
+{
+    return get_network_transfer_rate();
+}
+
+static double collect_processes(void)
+{
+    return get_processcounter();
+}
+
+static double collect_context_switches(void)
+{
+    return get_context_switchs();
+}
+
+static double collect_sample(void)
+{
+    MetricSample sample;
+    sampler_collect(&sample);
+    return sample.cpu_usage;
+}
+
+static const struct
+{
+    const char* name;
+    double (*collect)(void);
+} collectors[] = {
+    {"get_cpu_usage", collect_cpu},
+    {"get_memory_usage", collect_memory},
+    {"get_IOdisk", collect_disk},
+    {"get_network_transfer_rate", collect_network},
+    {"get_processcounter", collect_processes},
+    {"get_context_switchs", collect_context_switches},
+    {"sampler_collect", collect_sample},
+};
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Runs every collector of lab1 in a tight loop and reports its cost per sample.
+ *
+ * Usage: bench_collectors [ITERATIONS] [--budget NS]. With a budget, the
+ * exit status is 1 when a whole sample, sampler_collect, costs more, so a
+ * regression fails the bench target.
+ */
+int main(int argc, char* argv[])
+{
+    long iterations = BENCH_DEFAULT_ITERATIONS;
+    double budget_ns = 0;
+    for (int index = 1; index < argc; index++)
+    {
+        if (strcmp(argv[index], "--budget") == 0 && index + 1 < argc)
+        {
+            budget_ns = atof(argv[++index]);
+        }
+        else if ((iterations = atol(argv[index])) <= 0)
+        {
+            fprintf(stderr, "Usage: %s [ITERATIONS] [--budget NS]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("%-26s %12s %12s %12s\n", "COLLECTOR", "ns/sample", "min ns", "allocs");
+    int over_budget = 0;
+    for (size_t collector = 0; collector < sizeof(collectors) / sizeof(collectors[0]); collector++)
+    {
+        volatile double sink = 0;
+        // The first calls open files and fill caches
+        for (int warmup = 0; warmup < 10; warmup++)
+        {
+            sink += collectors[collector].collect();
+        }
+        uint64_t fastest = UINT64_MAX;
+        uint64_t allocated = allocations;
+        uint64_t start = monotonic_ns();
+        for (long iteration = 0; iteration < iterations; iteration++)
+        {
+            uint64_t before = monotonic_ns();
+            sink += collectors[collector].collect();
+            uint64_t elapsed = monotonic_ns() - before;
+            fastest = elapsed < fastest ? elapsed : fastest;
+        }
+        double per_sample = (double)(monotonic_ns() - start) / (double)iterations;
+        printf("%-26s %12.0f %12llu %12.2f\n", collectors[collector].name, per_sample, (unsigned long long)fastest,
+               (double)(allocations - allocated) / (double)iterations);
+        (void)sink;
+        if (budget_ns > 0 && collectors[collector].collect == collect_sample && per_sample > budget_ns)
+        {
+            fprintf(stderr, "sampler_collect takes %.0f ns per sample, over the budget of %.0f ns\n", per_sample,
+                    budget_ns);
+            over_budget = 1;
+        }
+    }
+    return over_budget;
+}
@@ -0,0 +1,43 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include "config.h"
+#include "sampler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Most hook commands running at the same time, more alerts skip their hook
+ */
+#define ALERTS_MAX_HOOKS 16
+
+/**
+ * @brief Evaluates the alert rules of a configuration on a sample
+ * A rule fires once its condition held for its duration and clears once
+ * the metric is back past its clear value. Every change is appended to the
+ * alert log and passed to the hook command, as $1 the rule, $2 firing or
+ * cleared, $3 the metric and $4 its value. It costs one pass over the rules
+ * and allocates nothing
+ */
+void alerts_evaluate(const MonitorConfig* config, const MetricSample* sample);
+
+/**
+ * @brief Returns a bit per rule of the evaluated configuration that is firing
+ */
+uint64_t alerts_firing(void);
+
+/**
+ * @brief Formats the firing alerts for the prompt
+ * @return length of the text, 0 when no alert is firing or prompt alerts are off
+ */
+int alerts_prompt_text(const MonitorConfig* config, char* buffer, size_t size);
+
+/**
+ * @brief Clears the state of every rule and closes the alert log
+ */
+void alerts_reset(void);
+
+#endif // ALERTS_H
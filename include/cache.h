@@ -0,0 +1,94 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Size of the store holding the cached results, in bytes
+ */
+#define CACHE_ARENA_SIZE (4 * 1024 * 1024)
+
+/**
+ * @brief Time a cached result stays valid when no ttl is given, in seconds
+ */
+#define CACHE_DEFAULT_TTL 60
+
+/**
+ * @brief Environment variables that are always part of the key of a result
+ */
+#define CACHE_KEY_VARIABLES "PATH,HOME,USER,LANG,LC_ALL,TZ"
+
+/**
+ * @brief Result of a command found in the cache, owned by the caller
+ */
+typedef struct
+{
+    char* output;
+    size_t output_length;
+    char* errors;
+    size_t errors_length;
+    int status;
+} CacheEntry;
+
+/**
+ * @brief Opens the result store
+ * The store is a ring of records in one mapping. New results are appended
+ * at the head and the oldest ones are dropped when it is full; a hit on one
+ * of the oldest results copies it back to the head, so the results that are
+ * used stay and the store behaves as a size-bounded LRU. With a path, the
+ * mapping is a shared file locked with flock, so every shell using it sees
+ * the results of the others
+ * @param path file of the store, NULL to keep it in memory
+ * @return 0 on success, -1 on error
+ */
+int cache_open(const char* path);
+
+/**
+ * @brief Unmaps the store
+ */
+void cache_close(void);
+
+/**
+ * @brief Looks a result up
+ * @param key bytes identifying the command
+ * @param key_length number of bytes of the key
+ * @param ttl_ms maximum age of the result in milliseconds
+ * @param entry where a copy of the result is stored, free it with cache_entry_free
+ * @return 1 on a hit, 0 on a miss, -1 on error
+ */
+int cache_lookup(const char* key, size_t key_length, int64_t ttl_ms, CacheEntry* entry);
+
+/**
+ * @brief Stores a result, replacing the previous one with the same key
+ * Results larger than a quarter of the store are not kept
+ * @param key bytes identifying the command
+ * @param key_length number of bytes of the key
+ * @param entry result to store
+ * @return 0 on success, -1 if it was not stored
+ */
+int cache_store(const char* key, size_t key_length, const CacheEntry* entry);
+
+/**
+ * @brief Frees the buffers of a result returned by cache_lookup
+ */
+void cache_entry_free(CacheEntry* entry);
+
+/**
+ * @brief Prefix command that replays the result of its command line while it is fresh
+ * Usage: cached [TTL] [ttl=SECONDS] [env=VAR,...] [--] command. The key is
+ * the words of the line, the working directory and the variables of
+ * CACHE_KEY_VARIABLES and env. On a miss the line runs with its standard
+ * output and error captured in memory files, which are written out and
+ * stored when it ends. Lines that redirect their output to a file always
+ * run, since a hit would not write the file. The store is $SURVSHELL_CACHE
+ * when set, otherwise it only lives as long as the shell
+ * @param arg options followed by the command line
+ */
+void command_cached(char* arg);
+
+#endif // CACHE_H
@@ -15,8 +15,8 @@ void set_foreground_pid(pid_t pid);
  * @brief executes an external command
  * if the command is not found in the list of internal commands
  * it is interpreted as a program invocation. This will be
- * executed in a child process
- * @param program to execute
+ * launched in a child process through posix_spawnp
+ * @param command line with the program and its arguments
  */
 void external_command(char* command);
 
@@ -66,4 +66,33 @@ typedef struct
  */
 extern Command internals_commands[];
 
+/**
+ * @brief Number of entries in internals_commands
+ */
+extern const int internals_commands_count;
+
+/**
+ * @brief Looks up an internal command by name
+ * @param name of the command
+ * @return the command entry or NULL if it is not internal
+ */
+Command* find_internal_command(const char* name);
+
+/**
+ * @brief Checks whether a command line starts with a prefix command such as limit
+ * Prefix commands receive the rest of the line, pipes and redirections included
+ * @param command_line line to check
+ * @return 1 if it starts with a prefix command, 0 otherwise
+ */
+int is_prefix_command(const char* command_line);
+
+/**
+ * @brief Separates the name=value options of a prefix command from the command line it runs
+ * The options end at "--" or at the first word without '='
+ * @param arg argument of the prefix command, modified in place
+ * @param options where the options are stored, an empty string if there are none
+ * @return the command line, or NULL if it is empty
+ */
+char* split_prefix_options(char* arg, char** options);
+
 #endif // COMMANDS_H
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximum number of PATH directories whose programs are completed
+ */
+#define COMPLETION_MAX_DIRECTORIES 63
+
+/**
+ * @brief Function called for every name that matches a completion prefix
+ * @param name the complete name
+ * @param data pointer given to completion_each
+ */
+typedef void (*CompletionVisitor)(const char* name, void* data);
+
+/**
+ * @brief Builds the completion trie from the executables of PATH and the internal commands
+ * Every PATH directory is watched with inotify. Programs that are added,
+ * removed or made executable are patched into the trie on the next lookup,
+ * so directories are never scanned again
+ * @return 0 on success, -1 on error
+ */
+int completion_init(void);
+
+/**
+ * @brief Frees the trie and stops watching the PATH directories
+ */
+void completion_close(void);
+
+/**
+ * @brief Finds the command names that start with a prefix
+ * @param prefix text typed so far
+ * @param common where the longest text shared by every match is stored,
+ * it always starts with the prefix
+ * @param size size of common
+ * @return number of matching names
+ */
+int completion_find(const char* prefix, char* common, size_t size);
+
+/**
+ * @brief Calls a function for the command names that start with a prefix, in alphabetical order
+ * @param prefix text typed so far
+ * @param max maximum number of names to visit
+ * @param visitor function to call
+ * @param data pointer passed to the visitor
+ * @return number of names visited
+ */
+int completion_each(const char* prefix, int max, CompletionVisitor visitor, void* data);
+
+#endif // COMPLETION_H
@@ -0,0 +1,167 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "sampler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Monitor configuration read when $SURVSHELL_CONFIG is not set
+ */
+#define CONFIG_DEFAULT_PATH "config.json"
+
+/**
+ * @brief Most alert rules a configuration may hold
+ */
+#define CONFIG_MAX_RULES 64
+
+/**
+ * @brief Most threads that may hold a configuration at the same time
+ */
+#define CONFIG_READERS 8
+
+/**
+ * @brief Comparison of an alert rule
+ */
+typedef enum
+{
+    RULE_ABOVE,
+    RULE_AT_LEAST,
+    RULE_BELOW,
+    RULE_AT_MOST
+} RuleComparison;
+
+/**
+ * @brief Alert rule compiled from a text such as "cpu > 90% for 30s clear 80%"
+ */
+typedef struct
+{
+    /** @brief Index of the metric in sampler_metric_names */
+    uint8_t metric;
+    /** @brief RuleComparison */
+    uint8_t comparison;
+    /** @brief Time the condition has to hold before the alert fires, in milliseconds */
+    uint32_t hold_ms;
+    float threshold;
+    /** @brief Value the metric has to get back past for the alert to clear */
+    float clear;
+} AlertRule;
+
+/**
+ * @brief Glob patterns selecting devices by name
+ * A device is kept if it matches an include pattern, or there is none, and
+ * no exclude pattern
+ */
+typedef struct
+{
+    char** include;
+    int include_count;
+    char** exclude;
+    int exclude_count;
+} DeviceFilter;
+
+/**
+ * @brief Monitor configuration, never changed once loaded
+ * A new configuration replaces it as a whole when config.json changes
+ */
+typedef struct
+{
+    /** @brief Number of the load, different for every configuration */
+    uint64_t generation;
+    /** @brief 1 for each metric of sampler_metric_names that is enabled */
+    int metrics[SAMPLER_METRICS];
+    /** @brief Time between samples, in milliseconds, 0 to keep the one of start_monitor */
+    int interval_ms;
+    /** @brief Block devices of /proc/diskstats to track */
+    DeviceFilter disks;
+    /** @brief Network interfaces of /proc/net/dev to track */
+    DeviceFilter interfaces;
+    /** @brief Alert rules, evaluated in order on every sample */
+    AlertRule rules[CONFIG_MAX_RULES];
+    /** @brief Text of each rule, for the alerts */
+    char* rule_texts[CONFIG_MAX_RULES];
+    int rule_count;
+    /** @brief 1 to show the firing alerts in the prompt */
+    int alert_prompt;
+    /** @brief File the alerts are appended to, NULL for none */
+    char* alert_log;
+    /** @brief Command run by sh on every alert, NULL for none */
+    char* alert_hook;
+} MonitorConfig;
+
+/**
+ * @brief Returns the path of the monitor configuration
+ */
+const char* config_path(void);
+
+/**
+ * @brief Loads a monitor configuration
+ * Missing sections keep their defaults: every metric enabled and every
+ * device tracked
+ * @param path JSON configuration file
+ * @return the configuration, or NULL if the file cannot be read or is invalid
+ */
+MonitorConfig* config_load(const char* path);
+
+/**
+ * @brief Loads config.json again and makes it the configuration in use
+ * An invalid file keeps the configuration in use; the previous one is
+ * freed once no thread holds it
+ * @return 0 if the file was loaded, -1 otherwise
+ */
+int config_reload(void);
+
+/**
+ * @brief Returns the configuration in use and keeps it valid until config_release
+ * It is loaded on first use, with the defaults when the file cannot be
+ * loaded. A thread holds at most one configuration: nested holds return the
+ * same one. Each thread owns a reader slot until it exits; more than
+ * CONFIG_READERS concurrent readers abort
+ * @return the configuration, NULL on error
+ */
+const MonitorConfig* config_hold(void);
+
+/**
+ * @brief Releases a configuration returned by config_hold
+ */
+void config_release(const MonitorConfig* config);
+
+/**
+ * @brief Frees the replaced configurations that no thread holds any more
+ */
+void config_collect(void);
+
+/**
+ * @brief Watches the directory of config.json for saved files
+ * @return an inotify descriptor to poll, -1 on error
+ */
+int config_watch_open(void);
+
+/**
+ * @brief Reads the events of a watch
+ * @return 1 if config.json was saved, 0 otherwise, -1 on error
+ */
+int config_watch_changed(int fd);
+
+/**
+ * @brief Compiles an alert rule: METRIC OP VALUE[%] [for DURATION] [clear VALUE[%]]
+ * OP is >, >=, < or <=; without clear, the alert clears 10% of the
+ * threshold past it
+ * @return 0 on success, -1 if the text is invalid
+ */
+int config_compile_rule(const char* text, AlertRule* rule);
+
+/**
+ * @brief Returns 1 if a device name passes a filter
+ */
+int config_device_selected(const DeviceFilter* filter, const char* name);
+
+/**
+ * @brief Frees a configuration returned by config_load
+ */
+void config_free(MonitorConfig* config);
+
+#endif // CONFIG_H
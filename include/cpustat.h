@@ -0,0 +1,119 @@
+#ifndef CPUSTAT_H
+#define CPUSTAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Time between the two readings of a first per-core view, in milliseconds
+ */
+#define CPUSTAT_FIRST_INTERVAL_MS 250
+
+/**
+ * @brief Columns of a cpu line of /proc/stat, in clock ticks
+ * guest and guest_nice are left out, the kernel already counts them in user and nice
+ */
+typedef enum
+{
+    CPUSTAT_USER,
+    CPUSTAT_NICE,
+    CPUSTAT_SYSTEM,
+    CPUSTAT_IDLE,
+    CPUSTAT_IOWAIT,
+    CPUSTAT_IRQ,
+    CPUSTAT_SOFTIRQ,
+    CPUSTAT_STEAL,
+    CPUSTAT_FIELDS
+} CpuField;
+
+/**
+ * @brief Shares of the time of a CPU between two readings, in percent
+ */
+typedef enum
+{
+    CPUSTAT_BUSY,
+    CPUSTAT_USER_SHARE,
+    CPUSTAT_SYSTEM_SHARE,
+    CPUSTAT_IOWAIT_SHARE,
+    CPUSTAT_IRQ_SHARE,
+    CPUSTAT_STEAL_SHARE,
+    CPUSTAT_SHARES
+} CpuShare;
+
+/**
+ * @brief Tick counters of every online CPU, one array per column
+ */
+typedef struct
+{
+    int count;
+    int capacity;
+    /** @brief Number of each CPU, offline CPUs have no line */
+    int* id;
+    uint64_t* ticks[CPUSTAT_FIELDS];
+    /** @brief Counters of the aggregate cpu line */
+    uint64_t total[CPUSTAT_FIELDS];
+} CpuTimes;
+
+/**
+ * @brief Shares of every CPU between two readings, one array per share
+ */
+typedef struct
+{
+    int count;
+    int capacity;
+    int* id;
+    float* share[CPUSTAT_SHARES];
+    /** @brief Shares of the aggregate cpu line */
+    float total[CPUSTAT_SHARES];
+} CpuUsage;
+
+/**
+ * @brief Spread of the busy share across CPUs
+ */
+typedef struct
+{
+    float minimum;
+    float maximum;
+    float average;
+    float deviation;
+    /** @brief Numbers of the least and the most busy CPU */
+    int coolest;
+    int hottest;
+} CpuSpread;
+
+/**
+ * @brief Parses the cpu lines of a /proc/stat text
+ * @return number of CPUs, -1 on error
+ */
+int cpustat_parse(const char* text, CpuTimes* times);
+
+/**
+ * @brief Reads /proc/stat into times
+ * @return number of CPUs, -1 on error
+ */
+int cpustat_read(CpuTimes* times);
+
+/**
+ * @brief Computes the shares of every CPU between two readings
+ * @return number of CPUs, -1 if the set of CPUs changed or on error
+ */
+int cpustat_usage(const CpuTimes* previous, const CpuTimes* current, CpuUsage* usage);
+
+/**
+ * @brief Computes the spread of the busy share across CPUs
+ */
+void cpustat_spread(const CpuUsage* usage, CpuSpread* spread);
+
+/**
+ * @brief Frees the arrays of a reading
+ */
+void cpustat_free_times(CpuTimes* times);
+
+/**
+ * @brief Frees the arrays of a usage
+ */
+void cpustat_free_usage(CpuUsage* usage);
+
+#endif // CPUSTAT_H
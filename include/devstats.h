@@ -0,0 +1,86 @@
+#ifndef DEVSTATS_H
+#define DEVSTATS_H
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Time between the two readings of a first per-device view, in milliseconds
+ */
+#define DEVSTATS_FIRST_INTERVAL_MS 250
+
+/**
+ * @brief Longest device or interface name kept, longer ones are cut
+ */
+#define DEVSTATS_NAME_SIZE 32
+
+/**
+ * @brief Activity of a block device between the last two readings
+ */
+typedef struct
+{
+    char name[DEVSTATS_NAME_SIZE];
+    double reads_per_second;
+    double writes_per_second;
+    double read_bytes_per_second;
+    double write_bytes_per_second;
+    /** @brief Average time of the completed requests, in milliseconds */
+    double latency_ms;
+    /** @brief Share of the time the device had requests in flight, in percent */
+    double utilization;
+} DiskRates;
+
+/**
+ * @brief Traffic of a network interface between the last two readings
+ */
+typedef struct
+{
+    char name[DEVSTATS_NAME_SIZE];
+    double receive_bytes_per_second;
+    double transmit_bytes_per_second;
+    double receive_packets_per_second;
+    double transmit_packets_per_second;
+    double receive_drops_per_second;
+    double transmit_drops_per_second;
+    double errors_per_second;
+} InterfaceRates;
+
+/**
+ * @brief Reads /proc/diskstats and /proc/net/dev and updates the rates
+ * Only the devices selected by the filters of the configuration are
+ * parsed; the decision is taken once per device and configuration
+ * @return 0 on success, -1 if neither file can be read
+ */
+int devstats_update(const MonitorConfig* config);
+
+/**
+ * @brief Updates the rates from the texts of /proc/diskstats and /proc/net/dev
+ * @param diskstats text of /proc/diskstats, NULL to leave the disks as they are
+ * @param net_dev text of /proc/net/dev, NULL to leave the interfaces as they are
+ * @param now_ms time of the reading on a monotonic clock
+ * @return number of tracked devices and interfaces
+ */
+int devstats_parse(const char* diskstats, const char* net_dev, int64_t now_ms, const MonitorConfig* config);
+
+/**
+ * @brief Copies the rates of the disks present in the last two readings
+ * @return number of disks copied
+ */
+int devstats_disks(DiskRates* rates, int capacity);
+
+/**
+ * @brief Copies the rates of the interfaces present in the last two readings
+ * @return number of interfaces copied
+ */
+int devstats_interfaces(InterfaceRates* rates, int capacity);
+
+/**
+ * @brief Forgets every device and its counters
+ */
+void devstats_reset(void);
+
+#endif // DEVSTATS_H
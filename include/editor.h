@@ -0,0 +1,56 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Functions the editor uses for history and completion
+ * Any of them may be NULL. Their signatures match history_count, history_get,
+ * history_search, completion_find and completion_each
+ */
+typedef struct
+{
+    /** @brief Returns the number of commands in the history */
+    int (*history_count)(void);
+
+    /** @brief Copies the command with the given number, starting at 1 */
+    int (*history_get)(int number, char* buffer, size_t size);
+
+    /** @brief Returns the most recent command below before that contains text, 0 if none */
+    int (*history_search)(const char* text, int before);
+
+    /** @brief Returns the number of command names that start with word and their common prefix */
+    int (*complete)(const char* word, char* common, size_t size);
+
+    /** @brief Calls visitor for at most max command names that start with word */
+    int (*list_completions)(const char* word, int max, void (*visitor)(const char* name, void* data), void* data);
+} EditorHooks;
+
+/**
+ * @brief Sets the history and completion functions of the editor
+ * @param hooks functions to use, copied
+ */
+void editor_set_hooks(const EditorHooks* hooks);
+
+/**
+ * @brief Reads a command line from the standard input
+ * On a terminal the line is edited in raw mode in a gap buffer. Every key
+ * redraws only the part of the line that changed, with the escape sequences
+ * sent in one write. Keys: arrows, Home, End, Delete, Backspace, Ctrl-A/E/B/F,
+ * Alt-B/F, Ctrl-K/U/W, Ctrl-L, Up/Down and Ctrl-R for the history, Tab to
+ * complete (twice to list), Ctrl-C to discard the line and Ctrl-D to end the
+ * input on an empty line. A line ending in a backslash continues on the next
+ * one. Other input is read with getline. Children are supervised while the
+ * user types and the line is shown again after a job reports its end
+ * @param prompt prompt shown before the line, may contain color sequences
+ * @param line where the line is stored, without the newline
+ * @param size size of the line buffer, longer lines are cut
+ * @return length of the line, or -1 at the end of the input
+ */
+int editor_read_line(const char* prompt, char* line, size_t size);
+
+#endif // EDITOR_H
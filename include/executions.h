@@ -20,9 +20,11 @@ void execute_command(char* command);
 
 /**
  * @brief Function that executes a command in the background
- * When an & is detected, the command is executed in the background in a child process.
+ * When an & is detected, the command is executed in the background in a child process
+ * with its own process group, so kill %job reaches everything it started.
  * Its output is redirected to a temporary file, and the parent prints the job ID and
- * process ID while it is running. Once the execution is finished, the file is printed.
+ * process ID and returns to the prompt. Once the execution is finished, the
+ * supervision loop prints the file.
  */
 void execute_command_secondplane(char* command);
 
@@ -49,9 +51,22 @@ void execute_command_redirection(char* command);
 
 void restore_io(int original_stdin, int original_stdout, int original_stderr);
 
+/**
+ * @brief Set by the signal handler when SIGINT arrives
+ * Long running internal commands check it to stop early
+ */
+extern volatile sig_atomic_t interrupt_received;
+
+/**
+ * @brief Exit code of the last command line, 128 plus the signal number when
+ * it was killed or stopped, and 127 when the program could not be launched
+ */
+extern int last_exit_status;
+
 /**
  * @brief Function that handles signals
- * If an interrupt signal is received, the signal is sent to the foreground process
+ * If an interrupt signal is received, the signal is sent to the process group
+ * of the foreground job
  * @param signo The number of the signal being handled.
  */
 void signal_handler(int signo);
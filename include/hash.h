@@ -0,0 +1,27 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Hashes a block of memory with XXH64
+ * Four independent lanes consume 32 bytes per step, so large inputs are
+ * hashed at memory speed. The result matches the reference xxHash
+ * @param data bytes to hash
+ * @param length number of bytes
+ * @param seed seed of the hash, 0 for the reference value
+ * @return the 64-bit hash
+ */
+uint64_t hash64(const void* data, size_t length, uint64_t seed);
+
+/**
+ * @brief Hashes the content of a file with XXH64
+ * The file is mapped instead of read, empty files hash like an empty block
+ * @param path file to hash
+ * @param hash where the hash is stored
+ * @return 0 on success, -1 if the file cannot be read
+ */
+int hash_file(const char* path, uint64_t* hash);
+
+#endif // HASH_H
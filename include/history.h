@@ -0,0 +1,83 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximum length of a command stored in the history
+ */
+#define HISTORY_MAX_LINE 4096
+
+/**
+ * @brief Opens the history file and indexes the commands it already holds
+ * The file is $SURVSHELL_HISTFILE or ~/.survshell_history. It is an append
+ * only log with one command per line, shared by every running shell: each
+ * command is appended with a single O_APPEND write under an exclusive flock,
+ * and readers map the file and only use complete lines. Commands appended by
+ * other shells are picked up on the next lookup
+ * @return 0 on success, -1 if the history is not available
+ */
+int history_init(void);
+
+/**
+ * @brief Closes the history file and frees the index
+ */
+void history_close(void);
+
+/**
+ * @brief Appends a command to the history
+ * Empty commands are ignored
+ * @param command command line, a trailing newline is ignored
+ * @return 0 on success, -1 on error
+ */
+int history_add(const char* command);
+
+/**
+ * @brief Returns the number of commands in the history, including the ones
+ * appended by other shells
+ */
+int history_count(void);
+
+/**
+ * @brief Copies a command of the history
+ * @param number position of the command, starting at 1
+ * @param buffer where the command is stored as a NUL terminated string
+ * @param size size of the buffer
+ * @return length of the command, or -1 if there is no such command
+ */
+int history_get(int number, char* buffer, size_t size);
+
+/**
+ * @brief Finds the most recent command that contains a text
+ * Queries of three or more bytes are answered from a trigram index, so the
+ * cost depends on the number of candidates and not on the size of the history
+ * @param text text to look for
+ * @param before only commands numbered below it are considered, 0 for all
+ * @return number of the command, or 0 if none matches
+ */
+int history_search(const char* text, int before);
+
+/**
+ * @brief Expands a history reference at the start of a command line
+ * !! is the previous command, !n the command number n and !-n the n-th
+ * previous command. The rest of the line is kept after the expansion
+ * @param line command line, replaced by the expanded one
+ * @param size size of the line buffer
+ * @return 1 if the line was expanded, 0 if there was nothing to expand,
+ * -1 after printing an error
+ */
+int history_expand(char* line, size_t size);
+
+/**
+ * @brief Implementation of the history command
+ * history [n] lists the last n commands (all of them by default)
+ * history -s text lists the commands that contain text
+ * @param arg count or search
+ */
+void command_history(char* arg);
+
+#endif // HISTORY_H
@@ -0,0 +1,55 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief State file of incremental batch runs when $SURVSHELL_STATE is not set
+ */
+#define INCREMENTAL_STATE_FILE ".survshell-state"
+
+/**
+ * @brief Prefix of the comment line annotating the inputs and outputs of the next command
+ * Example: #@ in=main.c,util.h out=main.o
+ */
+#define INCREMENTAL_ANNOTATION "#@"
+
+/**
+ * @brief Loads the state of the previous runs
+ * A missing file is an empty state
+ * @param path state file
+ * @return 0 on success, -1 if the file exists but cannot be read
+ */
+int incremental_open(const char* path);
+
+/**
+ * @brief Releases the state, every change was already saved
+ */
+void incremental_close(void);
+
+/**
+ * @brief Returns 1 if an annotated command can be skipped
+ * It can when its last run succeeded and its inputs and outputs still have
+ * the content hashes seen then. Files whose size, times and inode did not
+ * change since they were hashed are not read again
+ * @param annotation text of the annotation, in= and out= lists of files
+ * @param command command line
+ * @return 1 if the command is up to date, 0 if it has to run
+ */
+int incremental_is_current(const char* annotation, const char* command);
+
+/**
+ * @brief Records the end of an annotated command and saves the state
+ * A success stores the hashes of its inputs and outputs, a failure forgets
+ * them so the command runs again next time
+ * @param annotation text of the annotation
+ * @param command command line
+ * @param status exit status of the command
+ * @return 0 on success, -1 if the state could not be saved
+ */
+int incremental_record(const char* annotation, const char* command, int status);
+
+#endif // INCREMENTAL_H
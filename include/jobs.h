@@ -0,0 +1,172 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <termios.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximum number of jobs tracked at the same time
+ */
+#define JOBS_MAX 64
+
+/**
+ * @brief Maximum number of processes in one job (pipeline stages)
+ */
+#define JOB_MAX_PROCESSES 20
+
+/**
+ * @brief State of a job
+ */
+typedef enum
+{
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE
+} JobState;
+
+/**
+ * @brief A command line running in its own process group
+ */
+typedef struct
+{
+    /** @brief Job number shown to the user, 0 for a free entry */
+    int id;
+
+    /** @brief Process group of the job, 0 until the first process is added */
+    pid_t pgid;
+
+    /** @brief Processes of the job and their states */
+    pid_t pids[JOB_MAX_PROCESSES];
+    JobState process_states[JOB_MAX_PROCESSES];
+    int process_count;
+
+    /** @brief Wait status of the last process of the pipeline */
+    int status;
+
+    /** @brief 1 while the job runs without the terminal */
+    int background;
+
+    JobState state;
+
+    /** @brief File collecting the output of a background job, empty if none */
+    char output_path[32];
+
+    /** @brief Terminal modes of the job when it was stopped */
+    struct termios modes;
+    int has_modes;
+
+    char command[256];
+} Job;
+
+/**
+ * @brief Puts the shell in its own process group and takes the terminal
+ * Only done when the standard input is a terminal. Jobs are always placed in
+ * their own process group so signals can reach every stage of a pipeline
+ */
+void job_control_init(void);
+
+/**
+ * @brief Creates a job
+ * @param command text shown by the jobs command
+ * @param background 1 if the job runs without the terminal
+ * @return the job or NULL if the table is full
+ */
+Job* job_create(const char* command, int background);
+
+/**
+ * @brief Returns the process group to use in LaunchOptions for the next process of a job
+ * @param job the job, may be NULL
+ * @return -1 to keep the shell's group, 0 to lead a new group, or the job's group
+ */
+pid_t job_process_group(const Job* job);
+
+/**
+ * @brief Returns the terminal a foreground job should take, -1 for none
+ * @param job the job, may be NULL
+ */
+int job_terminal(const Job* job);
+
+/**
+ * @brief Tells whether count more processes fit in a job, checked before forking them
+ * @param job the job, may be NULL
+ * @return 1 if they fit, 0 otherwise
+ */
+int job_has_room(const Job* job, int count);
+
+/**
+ * @brief Registers a process of the job in its group and in the supervision loop
+ * @param job the job
+ * @param pid the process
+ */
+void job_add_process(Job* job, pid_t pid);
+
+/**
+ * @brief Prepares a forked child of a job before it runs its command
+ * Joins the job's process group, takes the terminal for foreground jobs
+ * and restores the default job control signals
+ * @param job the job, may be NULL
+ */
+void job_setup_child(const Job* job);
+
+/**
+ * @brief Waits for a foreground job while it owns the terminal
+ * The job is released when it ends; a stopped job stays in the table as a
+ * background job that fg or bg can resume
+ * @param job the job
+ * @return wait status of the last process, or -1 if the job was stopped
+ */
+int job_wait(Job* job);
+
+/**
+ * @brief Sends a signal to the foreground job, called from the signal handler
+ * @param signo signal to forward
+ * @return 1 if a foreground job received it, 0 otherwise
+ */
+int job_forward_signal(int signo);
+
+/**
+ * @brief Implementation of the jobs command
+ * Lists the background and stopped jobs
+ */
+void command_jobs(char* arg);
+
+/**
+ * @brief Parses a signal given as a number, a name or a SIG-prefixed name
+ * @return the signal number, -1 if it is unknown
+ */
+int job_parse_signal(const char* text);
+
+/**
+ * @brief Parses a pid target of kill, negative for a process group
+ * @return 0 on success, -1 unless the whole text is a number other than 0 and -1
+ */
+int job_parse_pid(const char* text, pid_t* pid);
+
+/**
+ * @brief Implementation of the kill command
+ * kill [-SIGNAL | -s SIGNAL | -N] [--] %job|pid|-pgid ...
+ * A %job target signals the whole process group of the job
+ * @param arg signal and targets
+ */
+void command_kill(char* arg);
+
+/**
+ * @brief Implementation of the fg command
+ * Resumes a job in the foreground, the most recent one by default
+ * @param arg %job
+ */
+void command_fg(char* arg);
+
+/**
+ * @brief Implementation of the bg command
+ * Resumes a stopped job in the background, the most recent one by default
+ * @param arg %job
+ */
+void command_bg(char* arg);
+
+#endif // JOBS_H
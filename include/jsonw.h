@@ -0,0 +1,83 @@
+#ifndef JSONW_H
+#define JSONW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Deepest nesting of objects and arrays a writer accepts
+ */
+#define JSONW_MAX_DEPTH 64
+
+/**
+ * @brief Streaming JSON writer appending straight into a reusable buffer
+ * Values are formatted in place, with commas and colons added from the
+ * nesting state, so no tree is built. The buffer only grows, once it fits a
+ * document, writing the next one does not allocate
+ */
+typedef struct
+{
+    char* buffer;
+    size_t length;
+    size_t capacity;
+    /** @brief Bit set for each depth whose next value is its first one */
+    uint64_t first;
+    int depth;
+    int after_key;
+    /** @brief Set when memory ran out or the nesting was too deep, the document is then incomplete */
+    int failed;
+} JsonWriter;
+
+/**
+ * @brief Prepares a writer with a buffer of the given size
+ * @return 0 on success, -1 if the buffer cannot be allocated
+ */
+int jsonw_init(JsonWriter* writer, size_t capacity);
+
+/**
+ * @brief Empties the writer for the next document, keeping its buffer
+ */
+void jsonw_reset(JsonWriter* writer);
+
+/**
+ * @brief Frees the buffer of the writer
+ */
+void jsonw_free(JsonWriter* writer);
+
+void jsonw_begin_object(JsonWriter* writer);
+void jsonw_end_object(JsonWriter* writer);
+void jsonw_begin_array(JsonWriter* writer);
+void jsonw_end_array(JsonWriter* writer);
+
+/**
+ * @brief Writes the key of the next member of an object
+ */
+void jsonw_key(JsonWriter* writer, const char* key);
+
+/**
+ * @brief Writes a string, escaped
+ */
+void jsonw_string(JsonWriter* writer, const char* value);
+
+/**
+ * @brief Writes an integer
+ */
+void jsonw_int(JsonWriter* writer, int64_t value);
+
+/**
+ * @brief Writes a double in fixed point like printf("%.*f")
+ * Values that are not finite are written as null, values too large for
+ * fixed point in exponent form
+ * @param decimals digits after the point, from 0 to 9
+ */
+void jsonw_double(JsonWriter* writer, double value, int decimals);
+
+void jsonw_bool(JsonWriter* writer, int value);
+void jsonw_null(JsonWriter* writer);
+
+/**
+ * @brief Ends a top-level value with a newline, as JSON Lines separates records
+ */
+void jsonw_newline(JsonWriter* writer);
+
+#endif // JSONW_H
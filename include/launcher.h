@@ -0,0 +1,109 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximum number of arguments accepted for a launched program
+ */
+#define LAUNCH_MAX_ARGS 256
+
+struct CpuPlacement;
+struct JobLimits;
+
+/**
+ * @brief Settings of the command line being executed that apply to every
+ * child it launches. Prefix commands such as limit fill it while they run the
+ * rest of their line
+ */
+typedef struct
+{
+    /** @brief Limits applied before exec, NULL for none */
+    const struct JobLimits* limits;
+
+    /** @brief CPU and NUMA placement applied before exec, NULL for none */
+    const struct CpuPlacement* placement;
+} LaunchContext;
+
+/**
+ * @brief Launch context of the current command line
+ */
+extern LaunchContext launch_context;
+
+/**
+ * @brief Options that describe how a child process is launched
+ *
+ * A file descriptor of -1 means the child inherits the one from the shell.
+ */
+typedef struct
+{
+    /** @brief Descriptor used as the child's standard input */
+    int stdin_fd;
+
+    /** @brief Descriptor used as the child's standard output */
+    int stdout_fd;
+
+    /** @brief Descriptor used as the child's standard error */
+    int stderr_fd;
+
+    /** @brief Process group to join, 0 to lead a new one, -1 to keep the shell's */
+    pid_t process_group;
+
+    /** @brief Terminal handed to the child's process group, -1 for none */
+    int terminal_fd;
+
+    /** @brief Limits applied in the child before exec, NULL for none */
+    const struct JobLimits* limits;
+
+    /** @brief CPU and NUMA placement applied in the child before exec, NULL for none */
+    const struct CpuPlacement* placement;
+
+    /** @brief Position of the child in its pipeline or worker pool, used by the placement */
+    int stage;
+} LaunchOptions;
+
+/**
+ * @brief Initializes the launch options so the child inherits every descriptor
+ * and stays in the process group of the shell. Settings of the launch context
+ * are copied
+ * @param options options to initialize
+ */
+void launch_options_init(LaunchOptions* options);
+
+/**
+ * @brief Splits a command line in place into a NULL terminated argument vector
+ * @param line command line, modified in place
+ * @param args output vector, must hold max_args + 1 pointers
+ * @param max_args maximum number of arguments to store
+ * @return number of arguments stored
+ */
+int split_arguments(char* line, char* args[], int max_args);
+
+/**
+ * @brief Applies the options in a forked child that is about to exec
+ * Joins the process group, takes the terminal, moves the descriptors, restores
+ * the default signals and applies the limits and the placement. Only
+ * async-signal-safe calls are used
+ * @param options options of the child
+ * @return 0 on success, -1 with errno set on error
+ */
+int launch_setup_child(const LaunchOptions* options);
+
+/**
+ * @brief Launches a program through posix_spawnp
+ * The program is searched in PATH. The function returns as soon as the child
+ * has been created; it is up to the caller to wait for it. When the zygote
+ * runs, it launches the program instead. Options that posix_spawnp cannot
+ * express, such as limits and placement, make it fork instead.
+ * @param argv NULL terminated argument vector, argv[0] is the program
+ * @param options descriptors for the child, NULL to inherit all of them
+ * @return pid of the child or -1 with errno set on failure
+ */
+pid_t launch_process(char* const argv[], const LaunchOptions* options);
+
+#endif // LAUNCHER_H
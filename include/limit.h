@@ -0,0 +1,69 @@
+#ifndef LIMIT_H
+#define LIMIT_H
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximum number of resource limits given to one command line
+ */
+#define LIMIT_MAX_RLIMITS 8
+
+/**
+ * @brief Limits applied to every process launched by a command line
+ */
+typedef struct JobLimits
+{
+    /** @brief setrlimit calls done in the child before exec */
+    int resources[LIMIT_MAX_RLIMITS];
+    struct rlimit values[LIMIT_MAX_RLIMITS];
+    int rlimit_count;
+
+    /** @brief cgroup v2 settings, empty strings are left untouched */
+    char cpu_max[32];
+    char memory_max[32];
+    char io_max[128];
+
+    /** @brief cgroup the children join before exec, empty if none */
+    char cgroup_path[PATH_MAX];
+
+    /** @brief Directory descriptor of the cgroup, -1 if none */
+    int cgroup_fd;
+} JobLimits;
+
+/**
+ * @brief Parses the name=value options of a limit prefix into the limits
+ * A later value for a resource replaces an earlier one
+ * @param options options separated by blanks, tokenized in place
+ * @param limits limits to update
+ * @return 1 if cpu, mem or io need a cgroup, 0 otherwise, -1 after printing an error
+ */
+int limits_parse(char* options, JobLimits* limits);
+
+/**
+ * @brief Applies the limits in a forked child right before exec
+ * Only async-signal-safe calls are used
+ * @param limits limits to apply, may be NULL
+ * @return 0 on success, -1 with errno set on error
+ */
+int limits_apply_in_child(const JobLimits* limits);
+
+/**
+ * @brief Implementation of the limit prefix command
+ * limit [cpu=P%] [mem=SIZE] [io=DEVICE,KEY=VALUE,...] [cputime=S] [as=SIZE]
+ *       [data=SIZE] [fsize=SIZE] [nofile=N] [nproc=N] [stack=SIZE] [--] command line
+ * The rlimits are set in every child before exec. cpu, mem and io create a
+ * cgroup v2 child with cpu.max, memory.max and io.max that the children join
+ * before exec; its usage is reported from cpu.stat, memory.peak and io.stat
+ * once the command line ends, and the cgroup is removed when it is empty.
+ * SURVSHELL_CGROUP selects the delegated cgroup to create them in
+ * @param arg options followed by the command line
+ */
+void command_limit(char* arg);
+
+#endif // LIMIT_H
@@ -22,24 +22,37 @@
  *
  * This function creates a background process to run the metrics monitor.
  * It redirects stdout and stderr to `/dev/null` in the child process.
+ * With `--jsonl PATH` or `--binary PATH`, a sampler thread of the shell
+ * appends every sample to PATH as a JSON line or to a compressed binary
+ * record instead; interval=MS, rotate=BYTES and keep=N tune it.
+ *
+ * @param arg Options of the command, may be NULL.
  */
-void start_monitor();
+void start_monitor(char* arg);
 
 /**
  * @brief Stops the monitoring process.
  *
  * This function sends a `SIGTERM` signal to the background monitoring process,
  * stops the process, and resets the state of the `monitor_pid` and `monitoring` variables.
+ * It also stops the sampler thread started with `--jsonl`.
+ *
+ * @param arg Unused.
  */
-void stop_monitor();
+void stop_monitor(char* arg);
 
 /**
  * @brief Displays the status of metrics monitoring.
  *
  * This function provides an interactive menu to select specific metrics or all
  * available metrics. It reads data from a FIFO in JSON format and presents the
- * metrics based on the selected option.
+ * metrics based on the selected option, or the usage of every CPU core
+ * with its user, system, irq, iowait and steal shares. With arguments,
+ * "METRIC,... [--format json|csv|plain] [--watch INTERVAL] [--count N]", it
+ * prints the latest sample without a menu instead.
+ *
+ * @param arg Metrics and options of the non-interactive form, NULL or empty for the menu.
  */
-void status_monitor();
+void status_monitor(char* arg);
 
 #endif // MONITOR_H
\ No newline at end of file
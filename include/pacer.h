@@ -0,0 +1,72 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include "config.h"
+#include "sampler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Shortest interval of the adaptive sampler by default, 10 samples per second
+ */
+#define PACER_FASTEST_MS 100
+
+/**
+ * @brief Longest interval of the adaptive sampler by default, one sample every 30 seconds
+ */
+#define PACER_SLOWEST_MS 30000
+
+/**
+ * @brief How interesting a sample is compared to the previous one
+ */
+typedef enum
+{
+    /** @brief Nothing moved: the interval grows */
+    PACE_CALM,
+    /** @brief Metrics drift: the interval shrinks */
+    PACE_BUSY,
+    /** @brief A metric jumped or is close to an alert: the interval drops to the shortest */
+    PACE_HOT
+} PaceLevel;
+
+/**
+ * @brief Interval of an adaptive sampler, chosen from the samples
+ */
+typedef struct
+{
+    int fastest_ms;
+    int slowest_ms;
+    int interval_ms;
+    MetricSample previous;
+    int has_previous;
+} Pacer;
+
+/**
+ * @brief Starts a pacer at its shortest interval
+ */
+void pacer_init(Pacer* pacer, int fastest_ms, int slowest_ms);
+
+/**
+ * @brief Rates a sample against the previous one and the alert rules
+ * @param config rules whose threshold, or clear value while firing, makes a close metric hot; NULL for none
+ * @param firing bit per firing rule of the configuration
+ */
+PaceLevel pacer_level(const Pacer* pacer, const MetricSample* sample, const MonitorConfig* config,
+                      uint64_t firing);
+
+/**
+ * @brief Takes a sample into account and returns the interval until the next one
+ * A hot sample drops the interval to the shortest, a busy one halves it and
+ * a calm one makes it half again as long, up to the longest
+ */
+int pacer_update(Pacer* pacer, const MetricSample* sample, const MonitorConfig* config, uint64_t firing);
+
+/**
+ * @brief Makes the next interval the shortest, for an event seen between samples
+ */
+void pacer_wake(Pacer* pacer);
+
+#endif // PACER_H
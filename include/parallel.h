@@ -0,0 +1,36 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Upper bound for the number of jobs running at the same time
+ */
+#define PARALLEL_MAX_JOBS 256
+
+/**
+ * @brief Implementation of the parallel command
+ * Runs a command template once per argument over a bounded pool of workers.
+ * parallel [-j N] command {} ::: arg1 arg2 ...
+ * parallel [-j N] command {} :::: file
+ * {} is replaced by the argument, without {} the argument is appended.
+ * The pool defaults to the number of online CPUs and the output of each
+ * job is printed as one block when the job finishes
+ * @param arg options, command template and arguments
+ */
+void command_parallel(char* arg);
+
+/**
+ * @brief Implementation of the xargs command
+ * Reads one argument per line from stdin and runs the command over a bounded pool.
+ * xargs [-P N] [-n M] [-I replstr] command [initial-arguments]
+ * -P 0 uses one worker per online CPU, the default is a single worker
+ * @param arg options and command template
+ */
+void command_xargs(char* arg);
+
+#endif // PARALLEL_H
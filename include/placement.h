@@ -0,0 +1,77 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Highest CPU number accepted plus one
+ */
+#define PLACEMENT_MAX_CPUS 1024
+
+/**
+ * @brief Highest NUMA node number accepted plus one
+ */
+#define PLACEMENT_MAX_NODES 1024
+
+/**
+ * @brief CPU and NUMA placement applied to every process launched by a command line
+ */
+typedef struct CpuPlacement
+{
+    /** @brief CPUs the children may run on, ordered so neighbours share a cache */
+    int cpus[PLACEMENT_MAX_CPUS];
+    int cpu_count;
+
+    /** @brief 1 to give each process of a pipeline its own CPU from the ordered list */
+    int per_stage;
+
+    /** @brief Memory policy (MPOL_BIND, MPOL_INTERLEAVE, MPOL_PREFERRED), -1 to keep the shell's */
+    int memory_mode;
+
+    /** @brief Nodes of the memory policy */
+    unsigned long nodes[PLACEMENT_MAX_NODES / (8 * sizeof(unsigned long))];
+} CpuPlacement;
+
+/**
+ * @brief Parses a placement specification
+ * Space separated options: cpus=LIST, node=LIST, mem=bind|interleave|preferred
+ * and layout=set|siblings. Lists look like 0-3,8,10-11
+ * @param spec specification to parse, modified in place
+ * @param placement placement to update
+ * @return 0 on success, -1 after printing an error
+ */
+int placement_parse(char* spec, CpuPlacement* placement);
+
+/**
+ * @brief Sets the placement used by every command line of the session
+ * Used by the --pin and --numa options of the shell
+ * @param spec placement specification, see placement_parse
+ * @return 0 on success, -1 on error
+ */
+int placement_set_default(char* spec);
+
+/**
+ * @brief Applies the placement in a forked child right before exec
+ * Only async-signal-safe calls are used
+ * @param placement placement to apply, may be NULL
+ * @param stage position of the process in its pipeline, 0 for single commands
+ * @return 0 on success, -1 with errno set on error
+ */
+int placement_apply_in_child(const CpuPlacement* placement, int stage);
+
+/**
+ * @brief Implementation of the pin prefix command
+ * pin [cpus=LIST] [node=LIST] [mem=bind|interleave|preferred] [layout=set|siblings] [--] command line
+ * Every child of the line runs on the given CPUs, or on the CPUs of the given
+ * NUMA nodes, and allocates its memory with the given policy on those nodes.
+ * With layout=siblings each pipeline stage gets its own CPU, consecutive stages
+ * on cores that share a cache
+ * @param arg options followed by the command line
+ */
+void command_pin(char* arg);
+
+#endif // PLACEMENT_H
@@ -0,0 +1,78 @@
+#ifndef PROCEVENTS_H
+#define PROCEVENTS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/**
+ * @brief Forks in one second from which the second counts as a fork storm
+ */
+#define PROCEVENTS_STORM_FORKS 1000
+
+/**
+ * @brief State of the process event listener
+ */
+typedef struct
+{
+    /** @brief 1 while the count follows netlink events, 0 when it comes from scanning /proc */
+    int listening;
+    /** @brief Error that kept netlink from being used, 0 if none */
+    int error;
+    int processes;
+    /** @brief Events of the last complete second */
+    int forks_per_second;
+    int execs_per_second;
+    int exits_per_second;
+    /** @brief Number of seconds with at least PROCEVENTS_STORM_FORKS forks */
+    uint64_t storms;
+    /** @brief Number of rescans of /proc after the kernel dropped events */
+    uint64_t resyncs;
+} ProcEventStats;
+
+/**
+ * @brief Subscribes to the process events of the kernel proc connector
+ * The live set of processes is then filled from /proc once and kept up to
+ * date from fork and exit events. It needs CAP_NET_ADMIN; without it, or
+ * on kernels without the connector, it fails and the count keeps coming
+ * from scans of /proc
+ * @return the descriptor to poll for events, or -1 on error
+ */
+int procevents_open(void);
+
+/**
+ * @brief Reads the pending events and applies them to the live set
+ * When the kernel reports lost events, the set is rebuilt from /proc
+ * @return number of events applied, -1 on error
+ */
+int procevents_drain(void);
+
+/**
+ * @brief Returns 1 if the live set follows netlink events
+ */
+int procevents_active(void);
+
+/**
+ * @brief Returns the number of live processes from the events
+ */
+int procevents_count(void);
+
+/**
+ * @brief Copies the state of the listener
+ */
+void procevents_stats(ProcEventStats* stats);
+
+/**
+ * @brief Unsubscribes and frees the live set
+ */
+void procevents_close(void);
+
+/**
+ * @brief Builtin showing the state of the process event listener
+ * @param arg Unused
+ */
+void command_proc_events(char* arg);
+
+#endif // PROCEVENTS_H
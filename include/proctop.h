@@ -0,0 +1,87 @@
+#ifndef PROCTOP_H
+#define PROCTOP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/**
+ * @brief Number of processes ps_top shows when none is given
+ */
+#define PROCTOP_DEFAULT_COUNT 10
+
+/**
+ * @brief Time between the two scans of a first ps_top, in milliseconds
+ */
+#define PROCTOP_FIRST_INTERVAL_MS 250
+
+/**
+ * @brief Order of the processes returned by proctop_top
+ */
+typedef enum
+{
+    PROCTOP_BY_CPU,
+    PROCTOP_BY_RSS,
+    PROCTOP_BY_IO
+} ProcessOrder;
+
+/**
+ * @brief Usage of one process between the last two scans
+ */
+typedef struct
+{
+    pid_t pid;
+    char command[16];
+    /** @brief Share of one CPU used since the previous scan, in percent */
+    double cpu_percent;
+    uint64_t rss_bytes;
+    /** @brief Storage bytes read and written per second since the previous scan, -1 if hidden */
+    double io_rate;
+} ProcessUsage;
+
+/**
+ * @brief Scans the processes and updates their usage
+ * The PID set is read from /proc with getdents64 and diffed against the
+ * table of the previous scan. The stat and io files of every process stay
+ * open across scans, as many as half of the descriptor limit allows, and
+ * are read with pread; the others are opened for each read
+ * @return number of processes, -1 on error
+ */
+int proctop_scan(void);
+
+/**
+ * @brief Returns the processes using the most of a resource
+ * @param top where the processes are stored, the heaviest first
+ * @param count size of top
+ * @param order resource to rank by
+ * @return number of processes stored
+ */
+int proctop_top(ProcessUsage* top, int count, ProcessOrder order);
+
+/**
+ * @brief Returns the usage of one process of the last scan
+ * @return 1 if the process was found, 0 otherwise
+ */
+int proctop_lookup(pid_t pid, ProcessUsage* usage);
+
+/**
+ * @brief Returns the number of descriptors the table keeps open
+ */
+int proctop_open_descriptors(void);
+
+/**
+ * @brief Closes every descriptor and empties the table
+ */
+void proctop_close(void);
+
+/**
+ * @brief Builtin listing the processes using the most CPU, memory or I/O
+ * Usage: ps_top [N] [sort=cpu|rss|io]. The usage is measured since the
+ * previous ps_top, or over a short interval the first time
+ * @param arg count and order
+ */
+void command_ps_top(char* arg);
+
+#endif // PROCTOP_H
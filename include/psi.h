@@ -0,0 +1,113 @@
+#ifndef PSI_H
+#define PSI_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Window of the default triggers, in microseconds
+ * Unprivileged users may only use multiples of 2 s
+ */
+#define PSI_DEFAULT_WINDOW_US 2000000
+
+/**
+ * @brief Resources with a file in /proc/pressure
+ */
+typedef enum
+{
+    PSI_CPU,
+    PSI_MEMORY,
+    PSI_IO,
+    PSI_RESOURCES
+} PsiResource;
+
+/**
+ * @brief Names of the resources, as in /proc/pressure
+ */
+extern const char* const psi_resource_names[PSI_RESOURCES];
+
+/**
+ * @brief One line of a pressure file
+ */
+typedef struct
+{
+    /** @brief Share of time stalled over the last 10, 60 and 300 seconds, in percent */
+    double avg10;
+    double avg60;
+    double avg300;
+    /** @brief Total stall time, in microseconds */
+    uint64_t total_us;
+} PsiLine;
+
+/**
+ * @brief Pressure of a resource: some task or all tasks stalled
+ */
+typedef struct
+{
+    PsiLine some;
+    PsiLine full;
+} PsiStats;
+
+/**
+ * @brief A stall threshold the kernel watches for a resource
+ */
+typedef struct
+{
+    /** @brief 1 to watch full instead of some */
+    int full;
+    /** @brief Stall time in the window that fires the trigger, in microseconds, 0 for no trigger */
+    uint32_t stall_us;
+    uint32_t window_us;
+} PsiTrigger;
+
+/**
+ * @brief Parses the text of a pressure file
+ * @return 0 on success, -1 if there is no some line
+ */
+int psi_parse(const char* text, PsiStats* stats);
+
+/**
+ * @brief Reads /proc/pressure/RESOURCE
+ * @return 0 on success, -1 without PSI support
+ */
+int psi_read(PsiResource resource, PsiStats* stats);
+
+/**
+ * @brief Fills the default triggers: 50% cpu, 10% memory and 20% io stall over 2 s
+ */
+void psi_default_triggers(PsiTrigger triggers[PSI_RESOURCES]);
+
+/**
+ * @brief Parses a trigger option such as memory:150ms/2s or io:full:500ms/2s
+ * @return the resource of the trigger, -1 if the text is invalid
+ */
+int psi_parse_trigger(const char* text, PsiTrigger* trigger);
+
+/**
+ * @brief Arms a kernel trigger on a pressure file
+ * The kernel then reports POLLPRI on the descriptor whenever the stall
+ * time of the window goes over the threshold
+ * @return the descriptor to poll, -1 on error
+ */
+int psi_trigger_open(PsiResource resource, const PsiTrigger* trigger);
+
+/**
+ * @brief Records that the trigger of a resource fired
+ * It is called by the thread polling the trigger
+ */
+void psi_trigger_fired(PsiResource resource);
+
+/**
+ * @brief Prints a warning on stderr if a trigger fired since the last warning
+ * @return 1 if a warning was printed, 0 otherwise
+ */
+int psi_warn_pending(void);
+
+/**
+ * @brief Returns how many times the trigger of a resource fired
+ */
+uint64_t psi_trigger_count(PsiResource resource);
+
+#endif // PSI_H
@@ -0,0 +1,110 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "../include/sampler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Number of metrics of a sample stored as compressed doubles
+ */
+#define RECORDER_FIELDS 6
+
+/**
+ * @brief Most samples kept in one block, the ones of the open block are lost on a crash
+ */
+#define RECORDER_BLOCK_SAMPLES 256
+
+/**
+ * @brief Size of the buffer of a block, enough for its samples in the worst case
+ */
+#define RECORDER_BLOCK_BYTES (32 * 1024)
+
+/**
+ * @brief Size a file reaches before it is rotated when none is given
+ */
+#define RECORDER_DEFAULT_ROTATE (1024 * 1024)
+
+/**
+ * @brief Number of rotated files kept besides the current one when none is given
+ */
+#define RECORDER_DEFAULT_KEEP 8
+
+/**
+ * @brief Writer of the compressed binary record of the samples
+ * A file starts with a header and holds self-contained blocks. A block
+ * stores its first sample in full, then timestamps as delta-of-delta with
+ * variable-length prefixes and metrics as the XOR of their bits with the
+ * previous value, keeping only the meaningful bits, as Gorilla does
+ */
+typedef struct
+{
+    int fd;
+    char* path;
+    size_t rotate_bytes;
+    int keep_files;
+    size_t file_bytes;
+
+    unsigned char block[RECORDER_BLOCK_BYTES];
+    size_t bit_length;
+    int count;
+    int64_t previous_timestamp;
+    int64_t previous_delta;
+    uint64_t previous_values[RECORDER_FIELDS];
+    uint8_t previous_leading[RECORDER_FIELDS];
+    uint8_t previous_trailing[RECORDER_FIELDS];
+} MetricRecorder;
+
+/**
+ * @brief Function receiving every sample read back from a record
+ */
+typedef void (*RecordHandler)(const MetricSample* sample, void* data);
+
+/**
+ * @brief Opens a record, appending to it if it already exists
+ * @param recorder writer to prepare
+ * @param path file of the record
+ * @param rotate_bytes size from which the file is rotated to path.1, path.2...
+ * @param keep_files number of rotated files kept
+ * @return 0 on success, -1 on error, EINVAL if the file is not a record
+ */
+int recorder_open(MetricRecorder* recorder, const char* path, size_t rotate_bytes, int keep_files);
+
+/**
+ * @brief Appends a sample to the open block, which is written when it is full
+ * @return 0 on success, -1 if a block could not be written
+ */
+int recorder_append(MetricRecorder* recorder, const MetricSample* sample);
+
+/**
+ * @brief Writes the open block
+ * @return 0 on success, -1 on error
+ */
+int recorder_flush(MetricRecorder* recorder);
+
+/**
+ * @brief Writes the open block and closes the record
+ */
+void recorder_close(MetricRecorder* recorder);
+
+/**
+ * @brief Reads the samples of a record file
+ * @param path file of the record
+ * @param handler function called for every sample, in order
+ * @param data pointer passed to the handler
+ * @return number of samples read, -1 on error
+ */
+long recorder_read(const char* path, RecordHandler handler, void* data);
+
+/**
+ * @brief Builtin converting records back to text
+ * Usage: monitor_dump [--csv|--json] FILE. The rotated files of FILE are
+ * read first, oldest first, so the output covers the whole record
+ * @param arg options and file
+ */
+void command_monitor_dump(char* arg);
+
+#endif // RECORDER_H
@@ -0,0 +1,155 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "../include/jsonw.h"
+#include "../include/psi.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Interval between samples when none is given, in milliseconds
+ */
+#define SAMPLER_DEFAULT_INTERVAL_MS 1000
+
+/**
+ * @brief Shortest interval between samples, in milliseconds
+ */
+#define SAMPLER_MIN_INTERVAL_MS 10
+
+/**
+ * @brief One reading of every metric of the monitor
+ * Metrics that could not be read are negative
+ */
+typedef struct
+{
+    /** @brief Wall clock time of the reading, in milliseconds since the epoch */
+    int64_t timestamp_ms;
+    double cpu_usage;
+    double memory_usage;
+    double disk_usage;
+    double network_rate;
+    int process_count;
+    int context_switches;
+    /** @brief Share of time some task stalled over the last 10 s, per PsiResource, negative without PSI */
+    double pressure[PSI_RESOURCES];
+} MetricSample;
+
+/**
+ * @brief Number of metrics of a sample
+ */
+#define SAMPLER_METRICS 6
+
+/**
+ * @brief Names of the metrics of a sample, in the order of sampler_metric and of the JSON keys
+ */
+extern const char* const sampler_metric_names[SAMPLER_METRICS];
+
+/**
+ * @brief Returns one metric of a sample as a double, negative if it could not be read
+ * @param sample the sample
+ * @param metric index of the metric in sampler_metric_names
+ */
+double sampler_metric(const MetricSample* sample, int metric);
+
+/**
+ * @brief Returns 1 if a metric is a count, printed as an integer, 0 if it is a percentage or a rate
+ * @param metric index of the metric in sampler_metric_names
+ */
+int sampler_metric_is_count(int metric);
+
+/**
+ * @brief Returns the index of a metric from its name, -1 if there is none
+ */
+int sampler_metric_index(const char* name);
+
+/**
+ * @brief Reads every metric into a sample
+ */
+void sampler_collect(MetricSample* sample);
+
+/**
+ * @brief Serializes a sample as one JSON object, unreadable metrics are null
+ */
+void sampler_write_json(JsonWriter* writer, const MetricSample* sample);
+
+/**
+ * @brief Outputs and pace of the sampler thread
+ */
+typedef struct
+{
+    /** @brief File or FIFO receiving the samples as JSON lines, NULL for none */
+    const char* jsonl_path;
+    /** @brief Compressed binary record of the samples, NULL for none */
+    const char* binary_path;
+    /** @brief Time between samples, in milliseconds, 0 for the one of config.json */
+    int interval_ms;
+    /** @brief Shortest time between samples of an adaptive interval, in milliseconds */
+    int fastest_ms;
+    /** @brief Longest time between samples of an adaptive interval, 0 for a fixed interval */
+    int slowest_ms;
+    /** @brief Size from which the binary record is rotated */
+    size_t rotate_bytes;
+    /** @brief Number of rotated binary records kept */
+    int keep_files;
+    /** @brief 1 to add the cost of the previous sample to every JSON line, as a "monitor" object */
+    int export_overhead;
+    /** @brief 1 to count processes from the kernel process events when permitted */
+    int process_events;
+    /** @brief Pressure stall thresholds the sampler is woken by, per PsiResource */
+    PsiTrigger pressure_triggers[PSI_RESOURCES];
+} SamplerOptions;
+
+/**
+ * @brief Fills sampler options with the defaults, no output and the interval of config.json
+ */
+void sampler_options_init(SamplerOptions* options);
+
+/**
+ * @brief Starts the sampler thread of the shell
+ * Every interval it collects a sample, keeps it as the latest one, adds it
+ * to the time-series store and appends it as a JSON line and to the binary
+ * record when they are set. A FIFO is
+ * opened without blocking and a sample is dropped when no reader keeps up,
+ * so the sampler never stalls. config.json is watched and reloaded when it
+ * is saved, without pausing the samples. An adaptive interval follows how much the
+ * metrics move and how close they are to an alert
+ * @param options outputs and interval of the sampler
+ * @return 0 on success, -1 on error
+ */
+int sampler_start(const SamplerOptions* options);
+
+/**
+ * @brief Stops the sampler thread and closes its output
+ */
+void sampler_stop(void);
+
+/**
+ * @brief Returns a bit per PsiResource whose pressure trigger is armed
+ */
+unsigned sampler_pressure_triggers(void);
+
+/**
+ * @brief Returns the time between samples, in milliseconds, the current one when it is adaptive
+ */
+int sampler_interval(void);
+
+/**
+ * @brief Returns 1 if the sampler thread is running
+ */
+int sampler_running(void);
+
+/**
+ * @brief Copies the latest sample
+ * @return 1 if there is one, 0 before the first sample
+ */
+int sampler_latest(MetricSample* sample);
+
+/**
+ * @brief Returns the number of samples that could not be written to an output
+ */
+uint64_t sampler_dropped(void);
+
+#endif // SAMPLER_H
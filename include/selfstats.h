@@ -0,0 +1,100 @@
+#ifndef SELFSTATS_H
+#define SELFSTATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Parts of a sample whose cost is measured
+ */
+typedef enum
+{
+    /** @brief CPU usage and context switches */
+    SELF_STAT,
+    SELF_MEMINFO,
+    SELF_DISKSTATS,
+    SELF_NET_DEV,
+    /** @brief Process count, from /proc or the process events */
+    SELF_PROCESSES,
+    SELF_PRESSURE,
+    /** @brief Time-series store, alerts, JSON lines and binary record */
+    SELF_OUTPUTS,
+    SELF_SOURCES
+} SelfSource;
+
+/**
+ * @brief Names of the sources, as shown by status_monitor and written in JSON lines
+ */
+extern const char* const selfstats_source_names[SELF_SOURCES];
+
+/**
+ * @brief Resources a source used
+ */
+typedef struct
+{
+    uint64_t time_ns;
+    /** @brief read and write system calls, other calls such as open are not counted by the kernel */
+    uint64_t syscalls;
+    uint64_t bytes_read;
+    /** @brief Growth of the bytes in use in the allocator, negative when more was freed */
+    int64_t heap_bytes;
+} SelfCost;
+
+/**
+ * @brief Cost of the samples of the sampler thread
+ */
+typedef struct
+{
+    uint64_t samples;
+    /** @brief Cost of each source in the latest sample */
+    SelfCost last[SELF_SOURCES];
+    /** @brief Cost of each source since the sampler started */
+    SelfCost total[SELF_SOURCES];
+    /** @brief CPU time of the sampler thread in the latest sample and since it started, in nanoseconds */
+    uint64_t last_cpu_ns;
+    uint64_t total_cpu_ns;
+    /** @brief 0 when /proc/thread-self/io cannot be read and system calls and bytes are not counted */
+    int counts_io;
+} SelfStats;
+
+/**
+ * @brief Starts measuring the calling thread, clearing the statistics
+ * @return 0 on success, -1 if only time and heap growth can be measured
+ */
+int selfstats_open(void);
+
+/**
+ * @brief Starts a sample
+ */
+void selfstats_begin(void);
+
+/**
+ * @brief Charges what the thread used since the start of the sample or the previous mark to a source
+ * Does nothing on a thread that is not measured
+ */
+void selfstats_mark(SelfSource source);
+
+/**
+ * @brief Ends a sample and publishes its cost
+ */
+void selfstats_end(void);
+
+/**
+ * @brief Stops measuring, the statistics stay readable
+ */
+void selfstats_close(void);
+
+/**
+ * @brief Copies the statistics
+ * @return the number of samples measured
+ */
+uint64_t selfstats_read(SelfStats* stats);
+
+/**
+ * @brief Sums the cost of every source
+ */
+SelfCost selfstats_sum(const SelfCost costs[SELF_SOURCES]);
+
+#endif // SELFSTATS_H
@@ -0,0 +1,47 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximum number of clients connected at the same time
+ */
+#define SERVER_MAX_CLIENTS 256
+
+/**
+ * @brief Output kept for a slow client before its command is paused
+ */
+#define SERVER_MAX_PENDING (1 << 20)
+
+/**
+ * @brief Types of the frames sent back to clients
+ * Every frame is the type byte, a 32-bit payload length in network byte
+ * order and the payload. A request is answered with any number of output
+ * frames followed by one exit frame, whose payload is the 32-bit exit status
+ * in network byte order
+ */
+#define SERVER_FRAME_STDOUT '1'
+#define SERVER_FRAME_STDERR '2'
+#define SERVER_FRAME_EXIT 'X'
+
+/**
+ * @brief Runs the shell as a server on a Unix domain socket
+ * Clients send requests framed as a 32-bit length in network byte order
+ * followed by the command line, and may send several without waiting. The
+ * requests of one client run one after the other, the clients run in
+ * parallel. Every request runs in a forked copy of the shell with the
+ * standard input on /dev/null, so cd and other internal commands of one
+ * request do not change the next ones. The sockets, the output of the
+ * commands and the children are multiplexed in one epoll loop. A stale
+ * socket file left by a previous server is replaced
+ * @param path of the socket
+ * @return 0 when stopped with SIGINT or SIGTERM, -1 on error
+ */
+int server_run(const char* path);
+
+#endif // SERVER_H
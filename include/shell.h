@@ -12,6 +12,16 @@
 #include <string.h>
 #include <unistd.h>
 
+/**
+ * @brief Maximum length of a command line, in batch files and at the prompt.
+ */
+#define SHELL_MAX_LINE 4096
+
+/**
+ * @brief Maximum length of the formatted prompt.
+ */
+#define PROMPT_MAX_LENGTH 2304
+
 /**
  * @brief Initializes the shell and handles input.
  *
@@ -26,6 +36,14 @@ int init_shell(int argc, char* argv[]);
  */
 void prompt(void);
 
+/**
+ * @brief Formats the prompt for each new command line.
+ *
+ * @param buffer Where the prompt is stored.
+ * @param size The size of the buffer.
+ */
+void prompt_text(char* buffer, size_t size);
+
 /**
  * @brief Chooses the type of execution based on the command syntax.
  *
@@ -0,0 +1,60 @@
+#ifndef STATUSQUERY_H
+#define STATUSQUERY_H
+
+#include "sampler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Output formats of a query
+ */
+typedef enum
+{
+    /** @brief Values separated by spaces, one line per sample */
+    QUERY_PLAIN,
+    /** @brief A header line, then one line per sample */
+    QUERY_CSV,
+    /** @brief One JSON object per line */
+    QUERY_JSON
+} QueryFormat;
+
+/**
+ * @brief Non-interactive form of status_monitor
+ */
+typedef struct
+{
+    /** @brief Indexes in sampler_metric_names of the metrics to print, in order */
+    int metrics[SAMPLER_METRICS];
+    int metric_count;
+    QueryFormat format;
+    /** @brief Time between two outputs, in milliseconds, 0 to print once */
+    int watch_ms;
+    /** @brief Number of outputs, 0 for no limit */
+    long count;
+} StatusQuery;
+
+/**
+ * @brief Parses the arguments of status_monitor: [METRIC,...] [--format json|csv|plain] [--watch INTERVAL] [--count N]
+ * Without metrics, every metric is printed
+ * @return 0 on success, -1 with a message on stderr if the arguments are invalid
+ */
+int statusquery_parse(char* arg, StatusQuery* query);
+
+/**
+ * @brief Formats one sample of a query, preceded by the CSV header when header is 1
+ * @return the length of the text, which is cut at size - 1 bytes
+ */
+size_t statusquery_render(const StatusQuery* query, const MetricSample* sample, int header, char* buffer,
+                          size_t size);
+
+/**
+ * @brief Prints a query, from the latest sample of the sampler thread when it runs
+ * A watch ends after its count or on Ctrl-C
+ * @return 0 on success, -1 if the output failed
+ */
+int statusquery_run(const StatusQuery* query);
+
+#endif // STATUSQUERY_H
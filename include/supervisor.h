@@ -0,0 +1,88 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximum number of children watched at the same time
+ */
+#define SUPERVISOR_MAX_CHILDREN 1024
+
+/**
+ * @brief Function called from the event loop when a watched child ends, or
+ * for supervisor_watch_stops also stops or continues (check the status with
+ * WIFSTOPPED and WIFCONTINUED)
+ * @param pid of the child
+ * @param status wait status of the child
+ * @param data pointer given to supervisor_watch
+ */
+typedef void (*ChildEventHandler)(pid_t pid, int status, void* data);
+
+/**
+ * @brief Initializes the child supervision loop
+ * Every child is watched through a pidfd registered in one epoll instance.
+ * SIGCHLD is blocked and read from a signalfd in the same instance, which
+ * reports stopped and continued children and replaces the pidfds when the
+ * kernel has no pidfd support. Calling it again in the same process does
+ * nothing, and forked children that keep running shell code get a fresh
+ * loop on first use
+ * @return 0 on success, -1 on error
+ */
+int supervisor_init(void);
+
+/**
+ * @brief Starts watching a child of the shell until it ends
+ * Stops and continues are left to the job control of the shell
+ * @param pid of the child
+ * @param handler function called when the child ends, NULL to collect the
+ * status later with supervisor_wait
+ * @param data pointer passed to the handler
+ * @return 0 on success, -1 on error
+ */
+int supervisor_watch(pid_t pid, ChildEventHandler handler, void* data);
+
+/**
+ * @brief Starts watching a child of the shell, its stops and continues included
+ * The handler also runs when the child stops or continues, with the status
+ * of waitpid; the child stays watched until it ends
+ * @param pid of the child
+ * @param handler function called when the child changes state
+ * @param data pointer passed to the handler
+ * @return 0 on success, -1 on error
+ */
+int supervisor_watch_stops(pid_t pid, ChildEventHandler handler, void* data);
+
+/**
+ * @brief Waits for a child while the events of the other children are dispatched
+ * The child is watched first if it was not already
+ * @param pid of the child
+ * @param status where the wait status is stored, may be NULL
+ * @return 0 on success, -1 on error
+ */
+int supervisor_wait(pid_t pid, int* status);
+
+/**
+ * @brief Waits until a descriptor is readable while dispatching child events
+ * @param fd descriptor to wait for, usually the standard input
+ * @return 1 if the descriptor is readable, 0 if a child handler ran first, -1 on error
+ */
+int supervisor_wait_readable(int fd);
+
+/**
+ * @brief Runs one round of the event loop
+ * @param timeout_ms maximum time to block, -1 blocks until an event arrives
+ * @return number of child events dispatched, -1 on error
+ */
+int supervisor_dispatch(int timeout_ms);
+
+/**
+ * @brief Returns the number of children currently watched
+ */
+int supervisor_pending(void);
+
+#endif // SUPERVISOR_H
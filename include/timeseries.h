@@ -0,0 +1,69 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include "../include/sampler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Number of resolutions kept for every metric
+ */
+#define TIMESERIES_RESOLUTIONS 3
+
+/**
+ * @brief Summary of a metric over a window
+ */
+typedef struct
+{
+    double min;
+    double max;
+    double average;
+    /** @brief 95th percentile of the averages of the buckets of the window */
+    double p95;
+    /** @brief Number of samples of the window */
+    long count;
+    /** @brief Number of buckets of the window holding samples */
+    int points;
+    /** @brief Width of the buckets the window was read from, in seconds */
+    int resolution_s;
+} SeriesSummary;
+
+/**
+ * @brief Empties the store
+ */
+void timeseries_reset(void);
+
+/**
+ * @brief Adds a sample to every resolution of the store
+ * The store keeps fixed rings of buckets of 1 s, 10 s and 1 min for every
+ * metric. A sample updates the minimum, maximum, sum and count of its three
+ * buckets, and the P² estimator of their 95th percentile, in constant time
+ * and without allocation. Metrics that could not be read are skipped
+ * @param sample the sample
+ */
+void timeseries_add(const MetricSample* sample);
+
+/**
+ * @brief Summarizes a metric over the window ending at a time
+ * The window is read from the finest resolution whose ring covers it, one
+ * bucket at a time
+ * @param metric index of the metric in sampler_metric_names
+ * @param end_s last second of the window, in seconds since the epoch
+ * @param window_s length of the window, in seconds
+ * @param summary where the summary is stored
+ * @return 0 on success, -1 if the window holds no sample or is longer than the store
+ */
+int timeseries_query(int metric, int64_t end_s, int window_s, SeriesSummary* summary);
+
+/**
+ * @brief Builtin showing a metric over a past window
+ * Usage: monitor_history METRIC WINDOW [--series], with a window such as
+ * 90s, 15m or 2h. --series prints every bucket with its own rollups
+ * @param arg metric, window and option
+ */
+void command_monitor_history(char* arg);
+
+#endif // TIMESERIES_H
@@ -0,0 +1,57 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include "../include/launcher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximum size of a launch request, argument and environment strings included
+ * Larger requests are launched by the shell itself
+ */
+#define ZYGOTE_MAX_REQUEST (128 * 1024)
+
+/**
+ * @brief Maximum number of argument and environment strings of a launch request
+ */
+#define ZYGOTE_MAX_STRINGS 4096
+
+/**
+ * @brief Starts the zygote, a helper forked while the shell is still small
+ * It receives launch requests over a SOCK_SEQPACKET socket, with the working
+ * directory, the standard descriptors and the terminal passed as SCM_RIGHTS,
+ * and starts each program with clone(CLONE_VM | CLONE_VFORK | CLONE_PARENT).
+ * The program shares the small image of the zygote until it execs, and its
+ * parent is the shell, which waits for it like any other child
+ * @return 0 on success, -1 on error
+ */
+int zygote_start(void);
+
+/**
+ * @brief Stops the zygote
+ */
+void zygote_stop(void);
+
+/**
+ * @brief Returns 1 if launches of this process can go through the zygote
+ * Forked copies of the shell launch by themselves, the children of the
+ * zygote could not be waited for by them
+ */
+int zygote_available(void);
+
+/**
+ * @brief Launches a program through the zygote
+ * Limits and placement of the options are not applied, the caller handles them
+ * @param argv NULL terminated argument vector, argv[0] is searched in PATH
+ * @param options options of the child
+ * @return pid of the child, or -1 with errno set. errno is ENOTCONN when the
+ * zygote is not running or cannot take the request, and the caller should
+ * launch the program itself
+ */
+pid_t zygote_launch(char* const argv[], const LaunchOptions* options);
+
+#endif // ZYGOTE_H
@@ -0,0 +1,285 @@
+#define _GNU_SOURCE
+#include "../include/alerts.h"
+#include "../include/colors.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static struct
+{
+    /** @brief Configuration the state belongs to */
+    uint64_t generation;
+    /** @brief Time the condition of each rule started to hold, 0 while it does not */
+    int64_t holding_since_ms[CONFIG_MAX_RULES];
+    /** @brief Rules the state belongs to, matched against the rules of a reloaded configuration */
+    AlertRule rules[CONFIG_MAX_RULES];
+    int rule_count;
+    /** @brief Bit per firing rule, read by the main thread for the prompt */
+    uint64_t firing;
+    int log_fd;
+    pid_t hooks[ALERTS_MAX_HOOKS];
+    int hook_count;
+} alerts = {.generation = 0, .rule_count = 0, .firing = 0, .log_fd = -1, .hook_count = 0};
+
+/**
+ * @brief Reaps the hook commands that ended.
+ */
+static void reap_hooks(void)
+{
+    for (int index = 0; index < alerts.hook_count;)
+    {
+        if (waitpid(alerts.hooks[index], NULL, WNOHANG) != 0)
+        {
+            alerts.hooks[index] = alerts.hooks[--alerts.hook_count];
+        }
+        else
+        {
+            index++;
+        }
+    }
+}
+
+/**
+ * @brief Starts the hook command of an alert.
+ *
+ * The command runs under sh with the alert as positional parameters, so no
+ * environment has to be built. The caller may be the sampler thread, which
+ * blocks every signal, so the mask of the hook is cleared.
+ */
+static void run_hook(const char* hook, const char* rule, const char* state, const char* metric, const char* value)
+{
+    if (alerts.hook_count == ALERTS_MAX_HOOKS)
+    {
+        return;
+    }
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t none;
+    sigset_t all;
+    sigemptyset(&none);
+    sigfillset(&all);
+    posix_spawnattr_setsigmask(&attributes, &none);
+    posix_spawnattr_setsigdefault(&attributes, &all);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    char* const argv[] = {"sh", "-c", (char*)hook, "alert", (char*)rule, (char*)state, (char*)metric, (char*)value,
+                          NULL};
+    extern char** environ;
+    pid_t pid;
+    if (posix_spawn(&pid, "/bin/sh", NULL, &attributes, argv, environ) == 0)
+    {
+        alerts.hooks[alerts.hook_count++] = pid;
+    }
+    posix_spawnattr_destroy(&attributes);
+}
+
+/**
+ * @brief Reports a rule that fired or cleared to the log and the hook.
+ */
+static void notify(const MonitorConfig* config, int rule, int firing, double value, int64_t timestamp_ms)
+{
+    const char* state = firing ? "firing" : "cleared";
+    const char* metric = sampler_metric_names[config->rules[rule].metric];
+    char number[32];
+    snprintf(number, sizeof(number), "%.2f", value);
+
+    if (alerts.log_fd != -1)
+    {
+        time_t seconds = (time_t)(timestamp_ms / 1000);
+        struct tm local;
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S%z", localtime_r(&seconds, &local));
+        char line[512];
+        int length = snprintf(line, sizeof(line), "%s %s %s: %s is %s\n", when, state, config->rule_texts[rule],
+                              metric, number);
+        length = length < (int)sizeof(line) ? length : (int)sizeof(line) - 1;
+        if (write(alerts.log_fd, line, (size_t)length) == -1)
+        {
+            perror("alert log");
+        }
+    }
+    if (config->alert_hook != NULL)
+    {
+        run_hook(config->alert_hook, config->rule_texts[rule], state, metric, number);
+    }
+}
+
+static int same_rule(const AlertRule* rule, const AlertRule* other)
+{
+    return rule->metric == other->metric && rule->comparison == other->comparison &&
+           rule->hold_ms == other->hold_ms && rule->threshold == other->threshold && rule->clear == other->clear;
+}
+
+/**
+ * @brief Moves to the rules of a new configuration.
+ *
+ * A rule the previous configuration also had, compiled to the same
+ * thresholds and duration, keeps its state, so reloading config.json
+ * neither fires the alerts again nor restarts their durations. The other
+ * rules start over.
+ */
+static void adopt(const MonitorConfig* config)
+{
+    int64_t holding_since_ms[CONFIG_MAX_RULES] = {0};
+    uint64_t firing = 0;
+    uint64_t matched = 0;
+    for (int index = 0; index < config->rule_count; index++)
+    {
+        for (int previous = 0; previous < alerts.rule_count; previous++)
+        {
+            if (!(matched & (1ull << previous)) &&
+                same_rule(&config->rules[index], &alerts.rules[previous]))
+            {
+                matched |= 1ull << previous;
+                holding_since_ms[index] = alerts.holding_since_ms[previous];
+                firing |= ((alerts.firing >> previous) & 1) << index;
+                break;
+            }
+        }
+    }
+    memcpy(alerts.holding_since_ms, holding_since_ms, sizeof(holding_since_ms));
+    memcpy(alerts.rules, config->rules, sizeof(alerts.rules));
+    alerts.rule_count = config->rule_count;
+    __atomic_store_n(&alerts.firing, firing, __ATOMIC_RELAXED);
+    if (alerts.log_fd != -1)
+    {
+        close(alerts.log_fd);
+    }
+    alerts.log_fd = config->alert_log != NULL
+                        ? open(config->alert_log, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)
+                        : -1;
+    __atomic_store_n(&alerts.generation, config->generation, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Evaluates the alert rules of a configuration on a sample.
+ *
+ * The rules were compiled when the configuration was loaded, so a pass is
+ * a comparison per rule. Between the threshold and the clear value a rule
+ * keeps its state: that is the hysteresis keeping a metric that hovers
+ * around the threshold from firing on every sample. A metric that could
+ * not be read leaves its rules as they are.
+ *
+ * @param config The configuration holding the rules.
+ * @param sample The sample.
+ */
+void alerts_evaluate(const MonitorConfig* config, const MetricSample* sample)
+{
+    if (alerts.generation != config->generation)
+    {
+        adopt(config);
+    }
+    reap_hooks();
+
+    uint64_t firing = alerts.firing;
+    for (int index = 0; index < config->rule_count; index++)
+    {
+        const AlertRule* rule = &config->rules[index];
+        double value = sampler_metric(sample, rule->metric);
+        if (value < 0)
+        {
+            continue;
+        }
+        uint64_t bit = 1ull << index;
+        if (firing & bit)
+        {
+            int cleared = rule->comparison <= RULE_AT_LEAST ? value < rule->clear : value > rule->clear;
+            if (cleared)
+            {
+                firing &= ~bit;
+                alerts.holding_since_ms[index] = 0;
+                notify(config, index, 0, value, sample->timestamp_ms);
+            }
+            continue;
+        }
+
+        int holds;
+        switch (rule->comparison)
+        {
+        case RULE_ABOVE:
+            holds = value > rule->threshold;
+            break;
+        case RULE_AT_LEAST:
+            holds = value >= rule->threshold;
+            break;
+        case RULE_BELOW:
+            holds = value < rule->threshold;
+            break;
+        default:
+            holds = value <= rule->threshold;
+            break;
+        }
+        if (!holds)
+        {
+            alerts.holding_since_ms[index] = 0;
+            continue;
+        }
+        if (alerts.holding_since_ms[index] == 0)
+        {
+            alerts.holding_since_ms[index] = sample->timestamp_ms;
+        }
+        if (sample->timestamp_ms - alerts.holding_since_ms[index] >= rule->hold_ms)
+        {
+            firing |= bit;
+            notify(config, index, 1, value, sample->timestamp_ms);
+        }
+    }
+    __atomic_store_n(&alerts.firing, firing, __ATOMIC_RELEASE);
+}
+
+uint64_t alerts_firing(void)
+{
+    return __atomic_load_n(&alerts.firing, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Formats the firing alerts for the prompt.
+ *
+ * The first firing rule is shown, followed by the number of the others.
+ *
+ * @param config The configuration in use.
+ * @param buffer Where the text is stored.
+ * @param size The size of the buffer.
+ * @return The length of the text, 0 when no alert is firing or prompt alerts are off.
+ */
+int alerts_prompt_text(const MonitorConfig* config, char* buffer, size_t size)
+{
+    uint64_t firing = alerts_firing();
+    if (config == NULL || !config->alert_prompt || firing == 0 ||
+        __atomic_load_n(&alerts.generation, __ATOMIC_ACQUIRE) != config->generation)
+    {
+        return 0;
+    }
+    int first = __builtin_ctzll(firing);
+    int others = __builtin_popcountll(firing) - 1;
+    char more[16] = "";
+    if (others > 0)
+    {
+        snprintf(more, sizeof(more), " +%d", others);
+    }
+    int length = snprintf(buffer, size, COLOR_RED "[alert: %s%s]" COLOR_RESET " ", config->rule_texts[first], more);
+    return length < 0 ? 0 : length;
+}
+
+/**
+ * @brief Clears the state of every rule and closes the alert log.
+ *
+ * Hooks still running are reaped by the next evaluation.
+ */
+void alerts_reset(void)
+{
+    memset(alerts.holding_since_ms, 0, sizeof(alerts.holding_since_ms));
+    alerts.rule_count = 0;
+    __atomic_store_n(&alerts.firing, 0, __ATOMIC_RELEASE);
+    if (alerts.log_fd != -1)
+    {
+        close(alerts.log_fd);
+        alerts.log_fd = -1;
+    }
+    __atomic_store_n(&alerts.generation, 0, __ATOMIC_RELEASE);
+}
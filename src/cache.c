@@ -0,0 +1,663 @@
+#define _GNU_SOURCE
+#include "../include/cache.h"
+#include "../include/commands.h"
+#include "../include/executions.h"
+#include "../include/shell.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define CACHE_MAGIC 0x3148434143535553ULL
+
+/**
+ * @brief Start of the store, followed by the arena of records.
+ *
+ * Records are laid out as a ring: from tail to head, or from tail to end and
+ * then from the start of the arena to head once the ring has wrapped.
+ */
+typedef struct
+{
+    uint64_t magic;
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t end;
+    uint32_t wrapped;
+    uint32_t count;
+} CacheHeader;
+
+/**
+ * @brief A stored result, followed by its key, its output and its errors.
+ */
+typedef struct
+{
+    /** @brief Size of the whole record, a multiple of 8 */
+    uint32_t size;
+    /** @brief 0 once the result was replaced or moved to the head */
+    uint32_t live;
+    uint64_t hash;
+    int64_t created_ms;
+    int32_t status;
+    uint32_t key_length;
+    uint32_t output_length;
+    uint32_t errors_length;
+} CacheRecord;
+
+static struct
+{
+    int fd;
+    CacheHeader* header;
+    char* arena;
+    size_t map_size;
+} cache = {.fd = -1, .header = NULL};
+
+/**
+ * @brief Hashes a key with 64-bit FNV-1a.
+ */
+static uint64_t hash_key(const char* key, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (unsigned char)key[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void reset_store(void)
+{
+    CacheHeader* header = cache.header;
+    header->head = 0;
+    header->tail = 0;
+    header->end = 0;
+    header->wrapped = 0;
+    header->count = 0;
+}
+
+/**
+ * @brief Takes the lock of a shared store, other shells may be writing it.
+ */
+static void lock_store(int operation)
+{
+    if (cache.fd != -1)
+    {
+        flock(cache.fd, operation);
+    }
+}
+
+static CacheRecord* record_at(uint64_t offset)
+{
+    return (CacheRecord*)(cache.arena + offset);
+}
+
+/**
+ * @brief Returns the offset of the next record of the ring, or -1 if the store is damaged.
+ */
+static int64_t next_record(uint64_t offset, uint32_t index)
+{
+    CacheHeader* header = cache.header;
+    if (index == 0)
+    {
+        offset = header->tail;
+    }
+    if (header->wrapped && offset >= header->end)
+    {
+        offset = 0;
+    }
+    CacheRecord* record = record_at(offset);
+    if (offset + sizeof(CacheRecord) > header->capacity || record->size < sizeof(CacheRecord) ||
+        offset + record->size > header->capacity)
+    {
+        return -1;
+    }
+    return (int64_t)offset;
+}
+
+/**
+ * @brief Finds the newest live record with a key.
+ *
+ * @param index Where the position of the record from the oldest one is stored.
+ * @return The offset of the record, -1 if there is none.
+ */
+static int64_t find_record(const char* key, size_t key_length, uint64_t hash, uint32_t* index)
+{
+    int64_t found = -1;
+    int64_t offset = 0;
+    for (uint32_t i = 0; i < cache.header->count; i++)
+    {
+        offset = next_record((uint64_t)offset, i);
+        if (offset == -1)
+        {
+            reset_store();
+            return -1;
+        }
+        CacheRecord* record = record_at(offset);
+        if (record->live && record->hash == hash && record->key_length == key_length &&
+            memcmp(record + 1, key, key_length) == 0)
+        {
+            found = offset;
+            *index = i;
+        }
+        offset += record->size;
+    }
+    return found;
+}
+
+/**
+ * @brief Drops the oldest record of the ring.
+ */
+static void drop_oldest(void)
+{
+    CacheHeader* header = cache.header;
+    header->tail += record_at(header->tail)->size;
+    header->count--;
+    if (header->wrapped && header->tail >= header->end)
+    {
+        header->tail = 0;
+        header->wrapped = 0;
+    }
+}
+
+/**
+ * @brief Makes room for a record at the head, dropping the oldest records.
+ *
+ * @return The offset of the room, -1 if the record is larger than the store.
+ */
+static int64_t reserve_record(uint64_t size)
+{
+    CacheHeader* header = cache.header;
+    while (1)
+    {
+        if (header->count == 0)
+        {
+            reset_store();
+        }
+        if (!header->wrapped)
+        {
+            if (header->capacity - header->head >= size)
+            {
+                return (int64_t)header->head;
+            }
+            if (header->count == 0)
+            {
+                return -1;
+            }
+            // The rest of the arena stays unused until the tail passes it
+            header->end = header->head;
+            header->head = 0;
+            header->wrapped = 1;
+        }
+        if (header->tail - header->head >= size)
+        {
+            return (int64_t)header->head;
+        }
+        drop_oldest();
+    }
+}
+
+/**
+ * @brief Appends a record made of a header and three parts.
+ *
+ * @return 0 on success, -1 if it does not fit.
+ */
+static int append_record(const CacheRecord* fields, const char* key, const char* output, const char* errors)
+{
+    uint64_t size = (sizeof(CacheRecord) + fields->key_length + fields->output_length + fields->errors_length + 7) &
+                    ~(uint64_t)7;
+    if (size > cache.header->capacity / 4)
+    {
+        return -1;
+    }
+    int64_t offset = reserve_record(size);
+    if (offset == -1)
+    {
+        return -1;
+    }
+
+    CacheRecord* record = record_at(offset);
+    *record = *fields;
+    record->size = (uint32_t)size;
+    record->live = 1;
+    char* data = (char*)(record + 1);
+    memcpy(data, key, fields->key_length);
+    memcpy(data + fields->key_length, output, fields->output_length);
+    memcpy(data + fields->key_length + fields->output_length, errors, fields->errors_length);
+    cache.header->head = offset + size;
+    cache.header->count++;
+    return 0;
+}
+
+/**
+ * @brief Maps the store, creating or resetting the file when it is not a store.
+ *
+ * @param path The file of the store, NULL for memory only.
+ * @return 0 on success, -1 on error.
+ */
+int cache_open(const char* path)
+{
+    if (cache.header != NULL)
+    {
+        return 0;
+    }
+
+    size_t size = sizeof(CacheHeader) + CACHE_ARENA_SIZE;
+    void* map;
+    int fd = -1;
+    if (path == NULL)
+    {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    else
+    {
+        fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd == -1)
+        {
+            return -1;
+        }
+        struct stat status;
+        flock(fd, LOCK_EX);
+        if (fstat(fd, &status) == -1 || ((size_t)status.st_size != size && ftruncate(fd, size) == -1))
+        {
+            int error = errno;
+            close(fd);
+            errno = error;
+            return -1;
+        }
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED)
+    {
+        int error = errno;
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        errno = error;
+        return -1;
+    }
+
+    cache.fd = fd;
+    cache.header = map;
+    cache.arena = (char*)map + sizeof(CacheHeader);
+    cache.map_size = size;
+    if (cache.header->magic != CACHE_MAGIC || cache.header->capacity != CACHE_ARENA_SIZE)
+    {
+        cache.header->magic = CACHE_MAGIC;
+        cache.header->capacity = CACHE_ARENA_SIZE;
+        reset_store();
+    }
+    lock_store(LOCK_UN);
+    return 0;
+}
+
+/**
+ * @brief Unmaps the store and closes its file.
+ */
+void cache_close(void)
+{
+    if (cache.header == NULL)
+    {
+        return;
+    }
+    munmap(cache.header, cache.map_size);
+    if (cache.fd != -1)
+    {
+        close(cache.fd);
+    }
+    cache.header = NULL;
+    cache.fd = -1;
+}
+
+/**
+ * @brief Copies a fresh result out of the store.
+ *
+ * A hit on a record in the oldest quarter of the ring moves it to the head,
+ * so results in use are not the next ones dropped.
+ *
+ * @return 1 on a hit, 0 on a miss, -1 on error.
+ */
+int cache_lookup(const char* key, size_t key_length, int64_t ttl_ms, CacheEntry* entry)
+{
+    memset(entry, 0, sizeof(*entry));
+    if (cache.header == NULL)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    lock_store(LOCK_EX);
+    uint32_t index = 0;
+    int64_t offset = find_record(key, key_length, hash_key(key, key_length), &index);
+    CacheRecord* record = offset == -1 ? NULL : record_at(offset);
+    if (record == NULL || now_ms() - record->created_ms >= ttl_ms)
+    {
+        lock_store(LOCK_UN);
+        return 0;
+    }
+
+    CacheRecord fields = *record;
+    const char* output = (const char*)(record + 1) + key_length;
+    const char* errors = output + fields.output_length;
+    entry->output = malloc(fields.output_length + 1);
+    entry->errors = malloc(fields.errors_length + 1);
+    if (entry->output == NULL || entry->errors == NULL)
+    {
+        lock_store(LOCK_UN);
+        cache_entry_free(entry);
+        return -1;
+    }
+    memcpy(entry->output, output, fields.output_length);
+    memcpy(entry->errors, errors, fields.errors_length);
+    entry->output[fields.output_length] = '\0';
+    entry->errors[fields.errors_length] = '\0';
+    entry->output_length = fields.output_length;
+    entry->errors_length = fields.errors_length;
+    entry->status = fields.status;
+
+    if (index < cache.header->count / 4)
+    {
+        // The copies in the entry survive the record being dropped to make room
+        record->live = 0;
+        append_record(&fields, key, entry->output, entry->errors);
+    }
+    lock_store(LOCK_UN);
+    return 1;
+}
+
+/**
+ * @brief Appends a result and retires the previous one with the same key.
+ *
+ * @return 0 on success, -1 if it was not stored.
+ */
+int cache_store(const char* key, size_t key_length, const CacheEntry* entry)
+{
+    if (cache.header == NULL)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    CacheRecord fields = {
+        .hash = hash_key(key, key_length),
+        .created_ms = now_ms(),
+        .status = entry->status,
+        .key_length = (uint32_t)key_length,
+        .output_length = (uint32_t)entry->output_length,
+        .errors_length = (uint32_t)entry->errors_length,
+    };
+    if (key_length + entry->output_length + entry->errors_length > CACHE_ARENA_SIZE)
+    {
+        errno = EFBIG;
+        return -1;
+    }
+
+    lock_store(LOCK_EX);
+    uint32_t index;
+    int64_t offset;
+    while ((offset = find_record(key, key_length, fields.hash, &index)) != -1)
+    {
+        record_at(offset)->live = 0;
+    }
+    int result = append_record(&fields, key, entry->output, entry->errors);
+    lock_store(LOCK_UN);
+    if (result == -1)
+    {
+        errno = EFBIG;
+    }
+    return result;
+}
+
+void cache_entry_free(CacheEntry* entry)
+{
+    free(entry->output);
+    free(entry->errors);
+    entry->output = NULL;
+    entry->errors = NULL;
+}
+
+/**
+ * @brief Writes the key of a command line: its words, the working directory and the selected variables.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int build_key(const char* command_line, const char* variables, char** key, size_t* key_length)
+{
+    FILE* stream = open_memstream(key, key_length);
+    if (stream == NULL)
+    {
+        return -1;
+    }
+
+    // Words are separated by one space whatever the spacing of the line
+    const char* cursor = command_line;
+    while (*(cursor += strspn(cursor, " \t")) != '\0')
+    {
+        size_t length = strcspn(cursor, " \t");
+        fwrite(cursor, 1, length, stream);
+        fputc(' ', stream);
+        cursor += length;
+    }
+    fputc('\0', stream);
+
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) != NULL)
+    {
+        fputs(cwd, stream);
+    }
+    fputc('\0', stream);
+
+    char names[1024];
+    snprintf(names, sizeof(names), "%s,%s", CACHE_KEY_VARIABLES, variables);
+    char* saveptr = NULL;
+    for (char* name = strtok_r(names, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr))
+    {
+        const char* value = getenv(name);
+        fprintf(stream, "%s=%s", name, value != NULL ? value : "");
+        fputc('\0', stream);
+    }
+    return fclose(stream) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Reads a whole memory file.
+ *
+ * @return A NUL terminated copy of its content, NULL on error.
+ */
+static char* read_capture(int fd, size_t* length)
+{
+    struct stat status;
+    if (fstat(fd, &status) == -1)
+    {
+        return NULL;
+    }
+    char* content = malloc(status.st_size + 1);
+    if (content == NULL)
+    {
+        return NULL;
+    }
+    ssize_t count = pread(fd, content, status.st_size, 0);
+    *length = count > 0 ? (size_t)count : 0;
+    content[*length] = '\0';
+    return content;
+}
+
+/**
+ * @brief Runs a command line with its standard output and error in memory files.
+ *
+ * @param entry Where the output, the errors and the exit status are stored.
+ * @return 0 on success, 1 if the line ran but its output was lost, -1 if it
+ * did not run because the memory files could not be created.
+ */
+static int run_captured(char* command_line, CacheEntry* entry)
+{
+    memset(entry, 0, sizeof(*entry));
+    int output_fd = memfd_create("cached-stdout", MFD_CLOEXEC);
+    int errors_fd = memfd_create("cached-stderr", MFD_CLOEXEC);
+    if (output_fd == -1 || errors_fd == -1)
+    {
+        if (output_fd != -1)
+        {
+            close(output_fd);
+        }
+        return -1;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    int original_stdin = dup(STDIN_FILENO);
+    int original_stdout = dup(STDOUT_FILENO);
+    int original_stderr = dup(STDERR_FILENO);
+    dup2(output_fd, STDOUT_FILENO);
+    dup2(errors_fd, STDERR_FILENO);
+
+    choose_execution(command_line);
+
+    fflush(stdout);
+    fflush(stderr);
+    restore_io(original_stdin, original_stdout, original_stderr);
+    close(original_stdin);
+    close(original_stdout);
+    close(original_stderr);
+
+    entry->status = last_exit_status;
+    entry->output = read_capture(output_fd, &entry->output_length);
+    entry->errors = read_capture(errors_fd, &entry->errors_length);
+    close(output_fd);
+    close(errors_fd);
+    if (entry->output == NULL || entry->errors == NULL)
+    {
+        cache_entry_free(entry);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes a result as if its command had just run.
+ */
+static void replay(const CacheEntry* entry)
+{
+    fwrite(entry->output, 1, entry->output_length, stdout);
+    fflush(stdout);
+    fwrite(entry->errors, 1, entry->errors_length, stderr);
+    fflush(stderr);
+    last_exit_status = entry->status;
+}
+
+/**
+ * @brief Replays the result of the rest of the line while it is fresh, or runs and stores it.
+ *
+ * @param arg The options followed by the command line.
+ */
+void command_cached(char* arg)
+{
+    double ttl = CACHE_DEFAULT_TTL;
+
+    // A leading number is the ttl in seconds
+    if (arg != NULL)
+    {
+        char* end;
+        double value = strtod(arg, &end);
+        if (end != arg && (*end == ' ' || *end == '\t') && value >= 0)
+        {
+            ttl = value;
+            arg = end;
+        }
+    }
+
+    char* options;
+    char* command_line = split_prefix_options(arg, &options);
+    if (command_line == NULL)
+    {
+        fprintf(stderr, "Usage: cached [TTL] [ttl=SECONDS] [env=VAR,...] [--] command\n");
+        return;
+    }
+
+    char variables[512] = "";
+    char* saveptr = NULL;
+    for (char* option = strtok_r(options, " \t", &saveptr); option != NULL; option = strtok_r(NULL, " \t", &saveptr))
+    {
+        char* value = strchr(option, '=');
+        *value++ = '\0';
+        char* end;
+        if (strcmp(option, "ttl") == 0 && (ttl = strtod(value, &end)) >= 0 && end != value && *end == '\0')
+        {
+            continue;
+        }
+        if (strcmp(option, "env") == 0 && strlen(value) < sizeof(variables))
+        {
+            snprintf(variables, sizeof(variables), "%s", value);
+            continue;
+        }
+        fprintf(stderr, "cached: invalid option %s=%s\n", option, value);
+        return;
+    }
+
+    // Only the standard output and error are stored, so a hit would not write the files of the line again
+    if (strchr(command_line, '>') != NULL)
+    {
+        choose_execution(command_line);
+        return;
+    }
+
+    const char* path = getenv("SURVSHELL_CACHE");
+    if (cache_open(path) == -1)
+    {
+        // Results are still reused within this shell
+        perror(path != NULL ? path : "cached");
+        if (path == NULL || cache_open(NULL) == -1)
+        {
+            choose_execution(command_line);
+            return;
+        }
+    }
+
+    char* key = NULL;
+    size_t key_length = 0;
+    if (build_key(command_line, variables, &key, &key_length) == -1)
+    {
+        perror("cached");
+        choose_execution(command_line);
+        return;
+    }
+
+    CacheEntry entry;
+    if (cache_lookup(key, key_length, (int64_t)(ttl * 1000), &entry) == 1)
+    {
+        replay(&entry);
+        cache_entry_free(&entry);
+        free(key);
+        return;
+    }
+
+    int captured = run_captured(command_line, &entry);
+    if (captured != 0)
+    {
+        perror("cached");
+        if (captured == -1)
+        {
+            choose_execution(command_line);
+        }
+        free(key);
+        return;
+    }
+    replay(&entry);
+    // Interrupted or killed commands did not produce their whole result
+    if (entry.status < 128)
+    {
+        cache_store(key, key_length, &entry);
+    }
+    cache_entry_free(&entry);
+    free(key);
+}
@@ -1,6 +1,19 @@
 #include "../include/commands.h"
+#include "../include/cache.h"
 #include "../include/colors.h"
+#include "../include/executions.h"
+#include "../include/history.h"
+#include "../include/jobs.h"
+#include "../include/launcher.h"
+#include "../include/limit.h"
 #include "../include/monitor.h"
+#include "../include/parallel.h"
+#include "../include/placement.h"
+#include "../include/procevents.h"
+#include "../include/proctop.h"
+#include "../include/recorder.h"
+#include "../include/supervisor.h"
+#include "../include/timeseries.h"
 
 // Forward declarations for monitor functions (if not available during testing)
 void start_monitor_impl() __attribute__((weak));
@@ -9,17 +22,17 @@ void status_monitor_impl() __attribute__((weak));
 
 void start_monitor_impl()
 {
-    start_monitor();
+    start_monitor(NULL);
 }
 
 void stop_monitor_impl()
 {
-    stop_monitor();
+    stop_monitor(NULL);
 }
 
 void status_monitor_impl()
 {
-    status_monitor();
+    status_monitor(NULL);
 }
 
 // Definition of the internal commands array
@@ -31,53 +44,177 @@ Command internals_commands[] = {
     {"start_monitor", start_monitor},
     {"stop_monitor", stop_monitor},
     {"status_monitor", status_monitor},
+    {"monitor_dump", command_monitor_dump},
+    {"monitor_history", command_monitor_history},
+    {"ps_top", command_ps_top},
+    {"proc_events", command_proc_events},
+    {"parallel", command_parallel},
+    {"xargs", command_xargs},
+    {"jobs", command_jobs},
+    {"kill", command_kill},
+    {"fg", command_fg},
+    {"bg", command_bg},
+    {"limit", command_limit},
+    {"pin", command_pin},
+    {"history", command_history},
+    {"cached", command_cached},
 };
 
+// Number of entries in the internal commands array
+const int internals_commands_count = sizeof(internals_commands) / sizeof(internals_commands[0]);
+
 /**
- * @brief Executes an external command by creating a child process and using execvp.
+ * @brief Looks up an internal command by name.
+ *
+ * @param name The command name.
+ * @return The matching entry, or NULL if the command is not internal.
  */
-void external_command(char* command)
+Command* find_internal_command(const char* name)
 {
+    if (name == NULL)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < internals_commands_count; i++)
+    {
+        if (strcmp(name, internals_commands[i].name) == 0)
+        {
+            return &internals_commands[i];
+        }
+    }
+    return NULL;
+}
 
-    // Create a child process
-    pid_t pid = fork();
-
-    switch (pid)
-    {
-    // There was an error creating the child process
-    case -1:
-        perror("fork");
-        exit(EXIT_FAILURE);
-        break;
-    // The child process was created correctly
-    case 0: {
-        // Separate the command and its arguments
-        char* args[256];
-        int i = 0;
-        args[i] = strtok(command, " ");
-        while (args[i] != NULL && i < 255)
+// Internal commands that run the rest of their line, pipes and redirections included
+static const char* prefix_commands[] = {"limit", "pin", "cached"};
+
+/**
+ * @brief Checks whether a command line starts with a prefix command.
+ *
+ * @param command_line The command line.
+ * @return 1 if the first word is a prefix command, 0 otherwise.
+ */
+int is_prefix_command(const char* command_line)
+{
+    command_line += strspn(command_line, " \t");
+    size_t length = strcspn(command_line, " \t");
+    for (size_t i = 0; i < sizeof(prefix_commands) / sizeof(prefix_commands[0]); i++)
+    {
+        if (strlen(prefix_commands[i]) == length && strncmp(command_line, prefix_commands[i], length) == 0)
         {
-            i++;
-            args[i] = strtok(NULL, " ");
+            return 1;
         }
+    }
+    return 0;
+}
 
-        // Execute the program
-        if (execvp(args[0], args) == -1)
+/**
+ * @brief Separates the options of a prefix command from the command line it runs.
+ *
+ * Options are the leading words that contain '=', optionally ended by "--".
+ *
+ * @param arg The argument of the prefix command, the options are NUL terminated in place.
+ * @param options Where the options are stored, an empty string if there are none.
+ * @return The command line, or NULL if it is empty.
+ */
+char* split_prefix_options(char* arg, char** options)
+{
+    static char no_options[] = "";
+    *options = no_options;
+    if (arg == NULL)
+    {
+        return NULL;
+    }
+
+    char* cursor = arg;
+    char* options_end = arg;
+    while (1)
+    {
+        cursor += strspn(cursor, " \t");
+        size_t length = strcspn(cursor, " \t");
+        if (length == 2 && strncmp(cursor, "--", 2) == 0)
         {
-            printf(COLOR_RED "Comando no encontrado: %s" COLOR_RESET "\n", args[0]);
-            perror("execvp");
-            exit(EXIT_FAILURE);
+            options_end = cursor;
+            cursor += 2;
+            break;
         }
-        break;
+        if (length == 0 || memchr(cursor, '=', length) == NULL)
+        {
+            options_end = cursor;
+            break;
+        }
+        cursor += length;
     }
 
-    // Parent process
-    default:
+    cursor += strspn(cursor, " \t");
+    if (options_end > arg)
+    {
+        // The separator before the command line or the first '-' of "--" ends the options
+        if (options_end == cursor)
+        {
+            options_end[-1] = '\0';
+        }
+        else
+        {
+            *options_end = '\0';
+        }
+        *options = arg;
+    }
+    return *cursor != '\0' ? cursor : NULL;
+}
+
+/**
+ * @brief Executes an external command through the spawn path and waits for it.
+ *
+ * The child leads its own process group, which owns the terminal until it ends or stops.
+ */
+void external_command(char* command)
+{
+    Job* job = job_create(command, 0);
+
+    // Separate the command and its arguments
+    char* args[LAUNCH_MAX_ARGS + 1];
+    if (split_arguments(command, args, LAUNCH_MAX_ARGS) == 0)
+    {
+        if (job != NULL)
+        {
+            job_wait(job);
+        }
+        return;
+    }
+
+    // Create the child process and execute the program
+    LaunchOptions options;
+    launch_options_init(&options);
+    options.process_group = job_process_group(job);
+    options.terminal_fd = job_terminal(job);
+    pid_t pid = launch_process(args, &options);
+    if (pid == -1)
+    {
+        printf(COLOR_RED "Comando no encontrado: %s" COLOR_RESET "\n", args[0]);
+        perror("posix_spawnp");
+    }
+    else if (job != NULL)
+    {
+        job_add_process(job, pid);
+    }
+
+    if (job != NULL)
+    {
+        // Wait for the job while other children stay supervised
+        job_wait(job);
+    }
+    else if (pid != -1)
+    {
+        int status = 0;
         set_foreground_pid(pid);
-        // Wait for the child process to finish
-        waitpid(pid, NULL, 0);
+        supervisor_wait(pid, &status);
         set_foreground_pid(0);
-        break;
+        last_exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    if (pid == -1)
+    {
+        last_exit_status = 127;
     }
 }
 
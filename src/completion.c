@@ -0,0 +1,475 @@
+#define _GNU_SOURCE
+#include "../include/completion.h"
+#include "../include/commands.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+// Provider bit of the internal commands, PATH directories use the bits below it
+#define BUILTIN_PROVIDER (1ULL << COMPLETION_MAX_DIRECTORIES)
+
+// Events that can add or remove a program from a directory
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF)
+
+/**
+ * @brief Node of the trie, children are kept in a sibling list sorted by character.
+ *
+ * Nodes live in one array and refer to each other by index; index 0 is the
+ * root, which is never a child, so 0 also means "none".
+ */
+typedef struct
+{
+    uint32_t child;
+    uint32_t sibling;
+    /** @brief Number of names that end in this node or below it */
+    uint32_t words;
+    /** @brief One bit per PATH directory holding the name that ends here, plus BUILTIN_PROVIDER */
+    uint64_t providers;
+    char c;
+} TrieNode;
+
+static struct
+{
+    TrieNode* nodes;
+    uint32_t count;
+    uint32_t capacity;
+
+    int inotify_fd;
+    int directory_count;
+    char* directories[COMPLETION_MAX_DIRECTORIES];
+    int watches[COMPLETION_MAX_DIRECTORIES];
+} trie = {.inotify_fd = -1};
+
+/**
+ * @brief Appends a node to the array.
+ *
+ * @return The index of the node, or 0 if memory is exhausted.
+ */
+static uint32_t new_node(char c)
+{
+    if (trie.count == trie.capacity)
+    {
+        uint32_t capacity = trie.capacity == 0 ? 4096 : trie.capacity * 2;
+        TrieNode* nodes = realloc(trie.nodes, capacity * sizeof(TrieNode));
+        if (nodes == NULL)
+        {
+            return 0;
+        }
+        trie.nodes = nodes;
+        trie.capacity = capacity;
+    }
+    TrieNode* node = &trie.nodes[trie.count];
+    memset(node, 0, sizeof(*node));
+    node->c = c;
+    return trie.count++;
+}
+
+/**
+ * @brief Finds the child of a node for a character, creating it in order if asked.
+ *
+ * @return The index of the child, or 0 if it does not exist.
+ */
+static uint32_t find_child(uint32_t parent, char c, int create)
+{
+    uint32_t previous = 0;
+    uint32_t current = trie.nodes[parent].child;
+    while (current != 0 && (unsigned char)trie.nodes[current].c < (unsigned char)c)
+    {
+        previous = current;
+        current = trie.nodes[current].sibling;
+    }
+    if (current != 0 && trie.nodes[current].c == c)
+    {
+        return current;
+    }
+    if (!create)
+    {
+        return 0;
+    }
+
+    uint32_t node = new_node(c);
+    if (node == 0)
+    {
+        return 0;
+    }
+    trie.nodes[node].sibling = current;
+    if (previous == 0)
+    {
+        trie.nodes[parent].child = node;
+    }
+    else
+    {
+        trie.nodes[previous].sibling = node;
+    }
+    return node;
+}
+
+/**
+ * @brief Returns the node reached by a prefix, or 0 if no name starts with it.
+ */
+static uint32_t find_prefix(const char* prefix)
+{
+    uint32_t node = 0;
+    for (const char* c = prefix; *c != '\0'; c++)
+    {
+        node = find_child(node, *c, 0);
+        if (node == 0)
+        {
+            return 0;
+        }
+    }
+    return node;
+}
+
+/**
+ * @brief Marks a name as present or missing for one provider.
+ *
+ * A name is completed while at least one provider has it; the word counts
+ * along its path only change when that becomes true or false.
+ */
+static void set_provider(const char* name, uint64_t provider, int present)
+{
+    uint32_t path[NAME_MAX + 2];
+    int depth = 0;
+    uint32_t node = 0;
+    path[depth++] = node;
+    for (const char* c = name; *c != '\0' && depth < NAME_MAX + 1; c++)
+    {
+        node = find_child(node, *c, present);
+        if (node == 0)
+        {
+            return;
+        }
+        path[depth++] = node;
+    }
+    if (node == 0)
+    {
+        return;
+    }
+
+    int was_present = trie.nodes[node].providers != 0;
+    if (present)
+    {
+        trie.nodes[node].providers |= provider;
+    }
+    else
+    {
+        trie.nodes[node].providers &= ~provider;
+    }
+    int is_present = trie.nodes[node].providers != 0;
+    if (was_present != is_present)
+    {
+        for (int i = 0; i < depth; i++)
+        {
+            trie.nodes[path[i]].words += is_present ? 1 : (uint32_t)-1;
+        }
+    }
+}
+
+/**
+ * @brief Checks whether a directory entry is an executable regular file.
+ */
+static int is_program(int directory_fd, const char* name)
+{
+    struct stat info;
+    return name[0] != '.' && fstatat(directory_fd, name, &info, 0) == 0 && S_ISREG(info.st_mode) &&
+           (info.st_mode & 0111) != 0;
+}
+
+/**
+ * @brief Adds every program of a PATH directory to the trie.
+ */
+static void scan_directory(int index)
+{
+    DIR* directory = opendir(trie.directories[index]);
+    if (directory == NULL)
+    {
+        return;
+    }
+    int directory_fd = dirfd(directory);
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (entry->d_type != DT_DIR && is_program(directory_fd, entry->d_name))
+        {
+            set_provider(entry->d_name, 1ULL << index, 1);
+        }
+    }
+    closedir(directory);
+}
+
+/**
+ * @brief Clears the bit of a provider in every node below a node.
+ */
+static void clear_provider(uint32_t node, uint64_t provider, char* name, int depth)
+{
+    for (uint32_t child = trie.nodes[node].child; child != 0; child = trie.nodes[child].sibling)
+    {
+        if (depth >= NAME_MAX)
+        {
+            return;
+        }
+        name[depth] = trie.nodes[child].c;
+        name[depth + 1] = '\0';
+        if (trie.nodes[child].providers & provider)
+        {
+            set_provider(name, provider, 0);
+        }
+        clear_provider(child, provider, name, depth + 1);
+    }
+}
+
+/**
+ * @brief Applies the pending inotify events to the trie.
+ *
+ * Only the names named by the events are checked. A queue overflow, which
+ * loses events, makes every directory be scanned again.
+ */
+static void completion_refresh(void)
+{
+    if (trie.inotify_fd == -1)
+    {
+        return;
+    }
+
+    char buffer[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    int rescan = 0;
+    while ((length = read(trie.inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* cursor = buffer; cursor < buffer + length;)
+        {
+            const struct inotify_event* event = (const struct inotify_event*)cursor;
+            cursor += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                rescan = 1;
+                continue;
+            }
+
+            int index = 0;
+            while (index < trie.directory_count && trie.watches[index] != event->wd)
+            {
+                index++;
+            }
+            if (index == trie.directory_count)
+            {
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+            {
+                char name[NAME_MAX + 2];
+                clear_provider(0, 1ULL << index, name, 0);
+                trie.watches[index] = -1;
+            }
+            else if (event->len > 0)
+            {
+                int directory_fd = open(trie.directories[index], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (directory_fd != -1)
+                {
+                    set_provider(event->name, 1ULL << index, is_program(directory_fd, event->name));
+                    close(directory_fd);
+                }
+            }
+        }
+    }
+
+    if (rescan)
+    {
+        for (int index = 0; index < trie.directory_count; index++)
+        {
+            char name[NAME_MAX + 2];
+            clear_provider(0, 1ULL << index, name, 0);
+            if (trie.watches[index] != -1)
+            {
+                scan_directory(index);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Builds the trie and starts watching the PATH directories.
+ *
+ * A directory listed twice in PATH, or reached twice through a symbolic link,
+ * gets the same watch and is only scanned once.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int completion_init(void)
+{
+    if (trie.nodes != NULL)
+    {
+        return 0;
+    }
+    if (new_node('\0') != 0)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < internals_commands_count; i++)
+    {
+        set_provider(internals_commands[i].name, BUILTIN_PROVIDER, 1);
+    }
+
+    trie.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    const char* path = getenv("PATH");
+    char* directories = strdup(path != NULL ? path : "/usr/bin:/bin");
+    char* saveptr = NULL;
+    for (char* directory = strtok_r(directories, ":", &saveptr);
+         directory != NULL && trie.directory_count < COMPLETION_MAX_DIRECTORIES;
+         directory = strtok_r(NULL, ":", &saveptr))
+    {
+        int watch = -1;
+        if (trie.inotify_fd != -1)
+        {
+            watch = inotify_add_watch(trie.inotify_fd, directory, WATCH_EVENTS | IN_ONLYDIR);
+            if (watch == -1)
+            {
+                continue;
+            }
+        }
+
+        int duplicate = 0;
+        for (int i = 0; i < trie.directory_count && watch != -1; i++)
+        {
+            duplicate |= trie.watches[i] == watch;
+        }
+        if (duplicate)
+        {
+            continue;
+        }
+
+        int index = trie.directory_count++;
+        trie.directories[index] = strdup(directory);
+        trie.watches[index] = watch;
+        scan_directory(index);
+    }
+    free(directories);
+    return 0;
+}
+
+/**
+ * @brief Frees the trie and closes the inotify instance.
+ */
+void completion_close(void)
+{
+    free(trie.nodes);
+    trie.nodes = NULL;
+    trie.count = 0;
+    trie.capacity = 0;
+    for (int i = 0; i < trie.directory_count; i++)
+    {
+        free(trie.directories[i]);
+    }
+    trie.directory_count = 0;
+    if (trie.inotify_fd != -1)
+    {
+        close(trie.inotify_fd);
+        trie.inotify_fd = -1;
+    }
+}
+
+/**
+ * @brief Counts the matches of a prefix and extends it while they all agree.
+ *
+ * @param prefix The text typed so far.
+ * @param common The longest text shared by every match.
+ * @param size The size of common.
+ * @return The number of matching names.
+ */
+int completion_find(const char* prefix, char* common, size_t size)
+{
+    snprintf(common, size, "%s", prefix);
+    if (trie.nodes == NULL)
+    {
+        return 0;
+    }
+    completion_refresh();
+
+    uint32_t node = find_prefix(prefix);
+    if ((node == 0 && prefix[0] != '\0') || trie.nodes[node].words == 0)
+    {
+        return 0;
+    }
+    int matches = (int)trie.nodes[node].words;
+
+    // Follow the path while it does not branch and no shorter name ends on it
+    size_t length = strlen(common);
+    while (trie.nodes[node].providers == 0 && length + 1 < size)
+    {
+        uint32_t only = 0;
+        int live = 0;
+        for (uint32_t child = trie.nodes[node].child; child != 0; child = trie.nodes[child].sibling)
+        {
+            if (trie.nodes[child].words > 0)
+            {
+                only = child;
+                live++;
+            }
+        }
+        if (live != 1)
+        {
+            break;
+        }
+        common[length++] = trie.nodes[only].c;
+        common[length] = '\0';
+        node = only;
+    }
+    return matches;
+}
+
+/**
+ * @brief Visits the names below a node in alphabetical order.
+ */
+static void visit(uint32_t node, char* name, int depth, int* remaining, CompletionVisitor visitor, void* data)
+{
+    if (trie.nodes[node].providers != 0 && *remaining > 0)
+    {
+        visitor(name, data);
+        (*remaining)--;
+    }
+    for (uint32_t child = trie.nodes[node].child; child != 0 && *remaining > 0; child = trie.nodes[child].sibling)
+    {
+        if (trie.nodes[child].words == 0 || depth >= NAME_MAX)
+        {
+            continue;
+        }
+        name[depth] = trie.nodes[child].c;
+        name[depth + 1] = '\0';
+        visit(child, name, depth + 1, remaining, visitor, data);
+    }
+    name[depth] = '\0';
+}
+
+/**
+ * @brief Calls a function for the names that start with a prefix.
+ *
+ * @return The number of names visited.
+ */
+int completion_each(const char* prefix, int max, CompletionVisitor visitor, void* data)
+{
+    if (trie.nodes == NULL)
+    {
+        return 0;
+    }
+    completion_refresh();
+
+    uint32_t node = find_prefix(prefix);
+    size_t length = strlen(prefix);
+    if ((node == 0 && length > 0) || length > NAME_MAX)
+    {
+        return 0;
+    }
+    char name[NAME_MAX + 2];
+    memcpy(name, prefix, length + 1);
+    int remaining = max;
+    visit(node, name, (int)length, &remaining, visitor, data);
+    return max - remaining;
+}
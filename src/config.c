@@ -0,0 +1,767 @@
+#define _GNU_SOURCE
+#include "../include/config.h"
+
+#include <cjson/cJSON.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <libgen.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static struct
+{
+    /** @brief Configuration in use, only ever replaced as a whole */
+    MonitorConfig* current;
+    uint64_t loads;
+    /** @brief Configuration each reader slot is using, NULL when it holds none */
+    const MonitorConfig* hazards[CONFIG_READERS];
+    /** @brief 1 for each reader slot owned by a thread */
+    int owners[CONFIG_READERS];
+    /** @brief Configurations replaced while a reader may still use them */
+    MonitorConfig* retired[CONFIG_READERS + 1];
+    int retired_count;
+    /** @brief Serializes the reloads */
+    pthread_mutex_t reloading;
+} configuration = {.current = NULL, .loads = 0, .retired_count = 0, .reloading = PTHREAD_MUTEX_INITIALIZER};
+
+/** @brief Reader slot of the thread, -1 before its first config_hold */
+static _Thread_local int reader_slot = -1;
+/** @brief Number of config_hold of the thread not released yet */
+static _Thread_local int reader_depth = 0;
+/** @brief Key whose destructor gives the reader slot of an exiting thread back */
+static pthread_key_t reader_key;
+static pthread_once_t reader_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Returns the path of the monitor configuration.
+ *
+ * @return $SURVSHELL_CONFIG if set, config.json in the working directory otherwise.
+ */
+const char* config_path(void)
+{
+    const char* configured = getenv("SURVSHELL_CONFIG");
+    return configured != NULL && configured[0] != '\0' ? configured : CONFIG_DEFAULT_PATH;
+}
+
+/**
+ * @brief Copies the strings of a JSON array of patterns.
+ *
+ * @return 0 on success, -1 if the array holds something else than strings or memory is exhausted.
+ */
+static int read_patterns(const cJSON* array, char*** patterns, int* count)
+{
+    if (array == NULL)
+    {
+        return 0;
+    }
+    if (!cJSON_IsArray(array))
+    {
+        return -1;
+    }
+    *patterns = calloc((size_t)cJSON_GetArraySize(array) + 1, sizeof(char*));
+    if (*patterns == NULL)
+    {
+        return -1;
+    }
+    const cJSON* pattern;
+    cJSON_ArrayForEach(pattern, array)
+    {
+        if (!cJSON_IsString(pattern) || ((*patterns)[*count] = strdup(pattern->valuestring)) == NULL)
+        {
+            return -1;
+        }
+        (*count)++;
+    }
+    return 0;
+}
+
+static int read_filter(const cJSON* section, DeviceFilter* filter)
+{
+    if (section == NULL)
+    {
+        return 0;
+    }
+    if (!cJSON_IsObject(section))
+    {
+        return -1;
+    }
+    if (read_patterns(cJSON_GetObjectItemCaseSensitive(section, "include"), &filter->include,
+                      &filter->include_count) == -1 ||
+        read_patterns(cJSON_GetObjectItemCaseSensitive(section, "exclude"), &filter->exclude,
+                      &filter->exclude_count) == -1)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Skips the spaces of a rule and parses the word after them.
+ *
+ * @return The character after the word.
+ */
+static const char* next_word(const char* cursor, char* word, size_t size)
+{
+    while (isspace((unsigned char)*cursor))
+    {
+        cursor++;
+    }
+    size_t length = strcspn(cursor, " \t");
+    snprintf(word, size, "%.*s", (int)length, cursor);
+    return cursor + length;
+}
+
+/**
+ * @brief Parses the value of a rule, with an optional % sign.
+ *
+ * @return 0 on success, -1 if the word is not a number.
+ */
+static int parse_value(const char* word, float* value)
+{
+    char* end;
+    double number = strtod(word, &end);
+    if (end == word || (*end != '\0' && strcmp(end, "%") != 0) || !isfinite(number))
+    {
+        return -1;
+    }
+    *value = (float)number;
+    return 0;
+}
+
+/**
+ * @brief Parses the duration of a rule: a number with a ms, s, m or h unit.
+ *
+ * @return 0 on success, -1 if the word is not a duration.
+ */
+static int parse_hold(const char* word, uint32_t* milliseconds)
+{
+    char* end;
+    double number = strtod(word, &end);
+    double factor;
+    if (strcmp(end, "ms") == 0)
+    {
+        factor = 1;
+    }
+    else if (strcmp(end, "s") == 0)
+    {
+        factor = 1000;
+    }
+    else if (strcmp(end, "m") == 0)
+    {
+        factor = 60000;
+    }
+    else if (strcmp(end, "h") == 0)
+    {
+        factor = 3600000;
+    }
+    else
+    {
+        return -1;
+    }
+    if (end == word || number < 0 || number * factor > UINT32_MAX)
+    {
+        return -1;
+    }
+    *milliseconds = (uint32_t)(number * factor);
+    return 0;
+}
+
+/**
+ * @brief Compiles an alert rule.
+ *
+ * The grammar is METRIC OP VALUE[%] [for DURATION] [clear VALUE[%]], with
+ * OP one of >, >=, < and <=, for example "cpu > 90% for 30s clear 80%".
+ * Without a clear value, the alert clears once the metric is 10% of the
+ * threshold back past it, so a value hovering around the threshold does
+ * not fire again on every sample.
+ *
+ * @param text The rule.
+ * @param rule Where the compiled rule is stored.
+ * @return 0 on success, -1 if the text is invalid.
+ */
+int config_compile_rule(const char* text, AlertRule* rule)
+{
+    static const char* const comparisons[] = {">", ">=", "<", "<="};
+    char word[64];
+    memset(rule, 0, sizeof(*rule));
+
+    text = next_word(text, word, sizeof(word));
+    int metric = sampler_metric_index(word);
+    if (metric == -1)
+    {
+        return -1;
+    }
+    rule->metric = (uint8_t)metric;
+
+    text = next_word(text, word, sizeof(word));
+    int comparison;
+    for (comparison = 0; comparison < 4 && strcmp(word, comparisons[comparison]) != 0; comparison++)
+    {
+    }
+    if (comparison == 4)
+    {
+        return -1;
+    }
+    rule->comparison = (uint8_t)comparison;
+
+    text = next_word(text, word, sizeof(word));
+    if (parse_value(word, &rule->threshold) == -1)
+    {
+        return -1;
+    }
+    int below = comparison == RULE_BELOW || comparison == RULE_AT_MOST;
+    float margin = fabsf(rule->threshold) / 10;
+    rule->clear = below ? rule->threshold + margin : rule->threshold - margin;
+
+    for (text = next_word(text, word, sizeof(word)); word[0] != '\0'; text = next_word(text, word, sizeof(word)))
+    {
+        if (strcmp(word, "for") == 0)
+        {
+            text = next_word(text, word, sizeof(word));
+            if (parse_hold(word, &rule->hold_ms) == -1)
+            {
+                return -1;
+            }
+        }
+        else if (strcmp(word, "clear") == 0)
+        {
+            text = next_word(text, word, sizeof(word));
+            if (parse_value(word, &rule->clear) == -1 || (below ? rule->clear < rule->threshold
+                                                                : rule->clear > rule->threshold))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Compiles the "alerts" section: rules and where the alerts go.
+ *
+ * @return 0 on success, -1 if a rule is invalid or memory is exhausted.
+ */
+static int read_alerts(const cJSON* section, MonitorConfig* config, const char* path)
+{
+    config->alert_prompt = 1;
+    if (section == NULL)
+    {
+        return 0;
+    }
+    const cJSON* rules = cJSON_GetObjectItemCaseSensitive(section, "rules");
+    if (!cJSON_IsObject(section) || (rules != NULL && !cJSON_IsArray(rules)))
+    {
+        fprintf(stderr, "config: %s: alerts must hold an array of rules\n", path);
+        return -1;
+    }
+    const cJSON* rule;
+    cJSON_ArrayForEach(rule, rules)
+    {
+        if (config->rule_count == CONFIG_MAX_RULES)
+        {
+            fprintf(stderr, "config: %s: more than %d alert rules\n", path, CONFIG_MAX_RULES);
+            return -1;
+        }
+        if (!cJSON_IsString(rule) || config_compile_rule(rule->valuestring, &config->rules[config->rule_count]) == -1)
+        {
+            fprintf(stderr, "config: %s: invalid alert rule %s\n", path,
+                    cJSON_IsString(rule) ? rule->valuestring : "(not a string)");
+            return -1;
+        }
+        if ((config->rule_texts[config->rule_count] = strdup(rule->valuestring)) == NULL)
+        {
+            return -1;
+        }
+        config->rule_count++;
+    }
+
+    const cJSON* prompt = cJSON_GetObjectItemCaseSensitive(section, "prompt");
+    const cJSON* log = cJSON_GetObjectItemCaseSensitive(section, "log");
+    const cJSON* hook = cJSON_GetObjectItemCaseSensitive(section, "hook");
+    if (cJSON_IsBool(prompt))
+    {
+        config->alert_prompt = cJSON_IsTrue(prompt);
+    }
+    if ((cJSON_IsString(log) && log->valuestring[0] != '\0' && (config->alert_log = strdup(log->valuestring)) == NULL) ||
+        (cJSON_IsString(hook) && hook->valuestring[0] != '\0' &&
+         (config->alert_hook = strdup(hook->valuestring)) == NULL))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads a whole file into a NUL-terminated buffer.
+ *
+ * @return The buffer to free, or NULL on error.
+ */
+static char* read_file(const char* path)
+{
+    FILE* file = fopen(path, "re");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    char* text = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    while (!feof(file))
+    {
+        if (length + 4096 + 1 > capacity)
+        {
+            char* grown = realloc(text, capacity + 4096 + 1);
+            if (grown == NULL)
+            {
+                free(text);
+                fclose(file);
+                return NULL;
+            }
+            text = grown;
+            capacity += 4096 + 1;
+        }
+        length += fread(text + length, 1, capacity - length - 1, file);
+        if (ferror(file))
+        {
+            free(text);
+            fclose(file);
+            return NULL;
+        }
+    }
+    fclose(file);
+    if (text == NULL)
+    {
+        text = calloc(1, 1);
+    }
+    else
+    {
+        text[length] = '\0';
+    }
+    return text;
+}
+
+/**
+ * @brief Loads a monitor configuration.
+ *
+ * The "metrics" object enables or disables each metric by name, the
+ * "sampler" object may set the "interval_ms" between samples, the
+ * "devices" object holds "disks" and "interfaces" filters, each with
+ * "include" and "exclude" arrays of glob patterns, and the "alerts" object
+ * holds the "rules" compiled here and the "prompt", "log" and "hook"
+ * outputs. An invalid file is reported on stderr.
+ *
+ * @param path The JSON configuration file.
+ * @return The configuration to free with config_free, or NULL on error.
+ */
+MonitorConfig* config_load(const char* path)
+{
+    char* text = read_file(path);
+    if (text == NULL)
+    {
+        return NULL;
+    }
+    cJSON* root = cJSON_Parse(text);
+    free(text);
+    MonitorConfig* config = calloc(1, sizeof(MonitorConfig));
+    if (root == NULL || !cJSON_IsObject(root) || config == NULL)
+    {
+        fprintf(stderr, "config: %s is not a valid JSON object\n", path);
+        cJSON_Delete(root);
+        free(config);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    for (int metric = 0; metric < SAMPLER_METRICS; metric++)
+    {
+        config->metrics[metric] = 1;
+    }
+    const cJSON* metrics = cJSON_GetObjectItemCaseSensitive(root, "metrics");
+    if (!cJSON_IsObject(metrics))
+    {
+        metrics = NULL;
+    }
+    const cJSON* entry;
+    cJSON_ArrayForEach(entry, metrics)
+    {
+        int metric = sampler_metric_index(entry->string);
+        if (metric != -1 && cJSON_IsBool(entry))
+        {
+            config->metrics[metric] = cJSON_IsTrue(entry);
+        }
+    }
+
+    const cJSON* sampling = cJSON_GetObjectItemCaseSensitive(root, "sampler");
+    const cJSON* interval = cJSON_GetObjectItemCaseSensitive(sampling, "interval_ms");
+    if ((sampling != NULL && !cJSON_IsObject(sampling)) ||
+        (interval != NULL && (!cJSON_IsNumber(interval) || interval->valuedouble < SAMPLER_MIN_INTERVAL_MS ||
+                              interval->valuedouble > INT32_MAX)))
+    {
+        fprintf(stderr, "config: %s: sampler interval_ms must be a number of at least %d\n", path,
+                SAMPLER_MIN_INTERVAL_MS);
+        cJSON_Delete(root);
+        config_free(config);
+        errno = EINVAL;
+        return NULL;
+    }
+    config->interval_ms = interval != NULL ? (int)interval->valuedouble : 0;
+
+    const cJSON* devices = cJSON_GetObjectItemCaseSensitive(root, "devices");
+    if ((devices != NULL && !cJSON_IsObject(devices)) ||
+        read_filter(cJSON_GetObjectItemCaseSensitive(devices, "disks"), &config->disks) == -1 ||
+        read_filter(cJSON_GetObjectItemCaseSensitive(devices, "interfaces"), &config->interfaces) == -1)
+    {
+        fprintf(stderr, "config: %s: devices filters must hold arrays of patterns\n", path);
+        cJSON_Delete(root);
+        config_free(config);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (read_alerts(cJSON_GetObjectItemCaseSensitive(root, "alerts"), config, path) == -1)
+    {
+        cJSON_Delete(root);
+        config_free(config);
+        errno = EINVAL;
+        return NULL;
+    }
+    cJSON_Delete(root);
+    config->generation = __atomic_add_fetch(&configuration.loads, 1, __ATOMIC_RELAXED);
+    return config;
+}
+
+/**
+ * @brief Allocates the configuration used when config.json cannot be loaded.
+ *
+ * @return Every metric and device enabled, no alert rule, or NULL if memory is exhausted.
+ */
+static MonitorConfig* default_config(void)
+{
+    MonitorConfig* config = calloc(1, sizeof(MonitorConfig));
+    if (config == NULL)
+    {
+        return NULL;
+    }
+    for (int metric = 0; metric < SAMPLER_METRICS; metric++)
+    {
+        config->metrics[metric] = 1;
+    }
+    config->alert_prompt = 1;
+    config->generation = __atomic_add_fetch(&configuration.loads, 1, __ATOMIC_RELAXED);
+    return config;
+}
+
+/**
+ * @brief Frees the retired configurations no reader holds any more.
+ *
+ * Called with the reload lock held.
+ */
+static void collect_retired(void)
+{
+    for (int index = 0; index < configuration.retired_count;)
+    {
+        int held = 0;
+        for (int slot = 0; slot < CONFIG_READERS && !held; slot++)
+        {
+            held = __atomic_load_n(&configuration.hazards[slot], __ATOMIC_SEQ_CST) == configuration.retired[index];
+        }
+        if (held)
+        {
+            index++;
+            continue;
+        }
+        config_free(configuration.retired[index]);
+        configuration.retired[index] = configuration.retired[--configuration.retired_count];
+    }
+}
+
+/**
+ * @brief Makes a configuration the one in use.
+ *
+ * The previous one is retired rather than freed: a reader that loaded the
+ * pointer before the exchange may still use it, so it is freed by a later
+ * reload or collection once no reader slot holds it. At most one
+ * configuration per reader can be held, so the retired list only fills up
+ * when readers are slow to release; then the reload waits for them.
+ *
+ * @param config The configuration, owned from now on.
+ */
+static void publish(MonitorConfig* config)
+{
+    pthread_mutex_lock(&configuration.reloading);
+    MonitorConfig* previous = __atomic_exchange_n(&configuration.current, config, __ATOMIC_SEQ_CST);
+    if (previous != NULL)
+    {
+        configuration.retired[configuration.retired_count++] = previous;
+    }
+    collect_retired();
+    while (configuration.retired_count == CONFIG_READERS + 1)
+    {
+        sched_yield();
+        collect_retired();
+    }
+    pthread_mutex_unlock(&configuration.reloading);
+}
+
+/**
+ * @brief Loads config.json again and makes it the configuration in use.
+ *
+ * A file that cannot be loaded or does not validate leaves the current
+ * configuration in place, so a half-edited file never stops the monitor.
+ * Before any configuration was in use, the defaults are used instead.
+ *
+ * @return 0 if the file was loaded, -1 if the configuration was kept or the defaults are used.
+ */
+int config_reload(void)
+{
+    MonitorConfig* config = config_load(config_path());
+    int loaded = config != NULL;
+    if (config == NULL && __atomic_load_n(&configuration.current, __ATOMIC_ACQUIRE) == NULL)
+    {
+        config = default_config();
+    }
+    if (config == NULL)
+    {
+        return -1;
+    }
+    publish(config);
+    return loaded ? 0 : -1;
+}
+
+/**
+ * @brief Gives the reader slot of an exiting thread back.
+ *
+ * @param slot The slot plus one, as stored by claim_reader_slot.
+ */
+static void release_reader_slot(void* slot)
+{
+    int index = (int)(intptr_t)slot - 1;
+    __atomic_store_n(&configuration.hazards[index], NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&configuration.owners[index], 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Creates the key releasing the reader slots, once per process.
+ */
+static void create_reader_key(void)
+{
+    if (pthread_key_create(&reader_key, release_reader_slot) != 0)
+    {
+        perror("config: pthread_key_create");
+        abort();
+    }
+}
+
+/**
+ * @brief Claims a free reader slot for the calling thread.
+ *
+ * The slot is given back when the thread exits. Running out of slots means
+ * more threads read the configuration than CONFIG_READERS allows, a bug
+ * rather than a runtime condition, so it aborts instead of letting the
+ * caller fall back to the defaults unnoticed.
+ */
+static void claim_reader_slot(void)
+{
+    pthread_once(&reader_key_once, create_reader_key);
+    for (int slot = 0; slot < CONFIG_READERS && reader_slot == -1; slot++)
+    {
+        int free_slot = 0;
+        if (__atomic_compare_exchange_n(&configuration.owners[slot], &free_slot, 1, 0, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED))
+        {
+            reader_slot = slot;
+        }
+    }
+    if (reader_slot == -1)
+    {
+        fprintf(stderr, "config: more than %d threads read the configuration\n", CONFIG_READERS);
+        abort();
+    }
+    pthread_setspecific(reader_key, (void*)(intptr_t)(reader_slot + 1));
+}
+
+/**
+ * @brief Returns the configuration in use and keeps it from being freed.
+ *
+ * This is the read side of the reloads: each thread owns a slot where it
+ * announces the configuration it holds, then checks the configuration is
+ * still the current one, so a reload either sees the announcement or
+ * happens before it and the loop takes the new configuration. Nested holds
+ * of a thread share the first one, so a sample is handled with a single
+ * configuration.
+ *
+ * @return The configuration, loaded on first use; NULL if memory is exhausted.
+ */
+const MonitorConfig* config_hold(void)
+{
+    if (reader_depth > 0)
+    {
+        reader_depth++;
+        return configuration.hazards[reader_slot];
+    }
+    if (reader_slot == -1)
+    {
+        claim_reader_slot();
+    }
+
+    MonitorConfig* config;
+    do
+    {
+        config = __atomic_load_n(&configuration.current, __ATOMIC_SEQ_CST);
+        if (config == NULL)
+        {
+            config_reload();
+            if ((config = __atomic_load_n(&configuration.current, __ATOMIC_SEQ_CST)) == NULL)
+            {
+                errno = ENOMEM;
+                return NULL;
+            }
+        }
+        __atomic_store_n(&configuration.hazards[reader_slot], config, __ATOMIC_SEQ_CST);
+    } while (config != __atomic_load_n(&configuration.current, __ATOMIC_SEQ_CST));
+    reader_depth = 1;
+    return config;
+}
+
+/**
+ * @brief Releases a configuration returned by config_hold.
+ *
+ * @param config The configuration; NULL, when config_hold failed, is ignored.
+ */
+void config_release(const MonitorConfig* config)
+{
+    if (config == NULL || reader_depth == 0)
+    {
+        return;
+    }
+    if (--reader_depth == 0)
+    {
+        __atomic_store_n(&configuration.hazards[reader_slot], NULL, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Frees the configurations that were replaced and that no reader holds any more.
+ */
+void config_collect(void)
+{
+    pthread_mutex_lock(&configuration.reloading);
+    collect_retired();
+    pthread_mutex_unlock(&configuration.reloading);
+}
+
+/**
+ * @brief Watches config.json for changes.
+ *
+ * The directory is watched rather than the file: editors that save by
+ * writing a new file and renaming it over the old one replace its inode,
+ * and a watch on the file would stay on the old one. Only the saves that
+ * are complete, a file closed after writing or renamed into place, are
+ * reported, so a file is never read half-written.
+ *
+ * @return A non-blocking inotify descriptor, or -1 on error.
+ */
+int config_watch_open(void)
+{
+    char directory[4096];
+    snprintf(directory, sizeof(directory), "%s", config_path());
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    if (inotify_add_watch(fd, dirname(directory), IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+    {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Reads the pending events of a watch.
+ *
+ * @param fd The descriptor returned by config_watch_open.
+ * @return 1 if config.json was saved, 0 for other files of its directory, -1 on error.
+ */
+int config_watch_changed(int fd)
+{
+    char name[4096];
+    snprintf(name, sizeof(name), "%s", config_path());
+    const char* file = basename(name);
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t length;
+    while ((length = read(fd, events, sizeof(events))) > 0)
+    {
+        for (char* cursor = events; cursor < events + length;)
+        {
+            const struct inotify_event* event = (const struct inotify_event*)cursor;
+            changed |= event->len > 0 && strcmp(event->name, file) == 0;
+            cursor += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    if (length == -1 && errno != EAGAIN)
+    {
+        return -1;
+    }
+    return changed;
+}
+
+/**
+ * @brief Returns 1 if a device name passes a filter.
+ *
+ * @param filter The include and exclude patterns.
+ * @param name The name of the device or interface.
+ * @return 1 if the device is tracked, 0 otherwise.
+ */
+int config_device_selected(const DeviceFilter* filter, const char* name)
+{
+    int selected = filter->include_count == 0;
+    for (int pattern = 0; pattern < filter->include_count && !selected; pattern++)
+    {
+        selected = fnmatch(filter->include[pattern], name, 0) == 0;
+    }
+    for (int pattern = 0; pattern < filter->exclude_count && selected; pattern++)
+    {
+        selected = fnmatch(filter->exclude[pattern], name, 0) != 0;
+    }
+    return selected;
+}
+
+static void free_patterns(char** patterns, int count)
+{
+    for (int pattern = 0; pattern < count; pattern++)
+    {
+        free(patterns[pattern]);
+    }
+    free(patterns);
+}
+
+void config_free(MonitorConfig* config)
+{
+    if (config == NULL)
+    {
+        return;
+    }
+    free_patterns(config->disks.include, config->disks.include_count);
+    free_patterns(config->disks.exclude, config->disks.exclude_count);
+    free_patterns(config->interfaces.include, config->interfaces.include_count);
+    free_patterns(config->interfaces.exclude, config->interfaces.exclude_count);
+    for (int rule = 0; rule < config->rule_count; rule++)
+    {
+        free(config->rule_texts[rule]);
+    }
+    free(config->alert_log);
+    free(config->alert_hook);
+    free(config);
+}
@@ -0,0 +1,392 @@
+#define _GNU_SOURCE
+#include "../include/cpustat.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <unistd.h>
+
+/** @brief CPUs per allocation step, so each array starts on a 64-byte line */
+#define CPUSTAT_ALIGN_CPUS 16
+
+/**
+ * @brief Makes room for count CPUs in a reading, keeping the first kept ones.
+ *
+ * The arrays share one 64-byte aligned block: the tick columns one after
+ * the other, then the CPU numbers.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+static int reserve_times(CpuTimes* times, int count, int kept)
+{
+    if (count <= times->capacity)
+    {
+        return 0;
+    }
+    int capacity = (count + CPUSTAT_ALIGN_CPUS - 1) / CPUSTAT_ALIGN_CPUS * CPUSTAT_ALIGN_CPUS;
+    uint64_t* block = aligned_alloc(64, (size_t)capacity * (CPUSTAT_FIELDS * sizeof(uint64_t) + sizeof(int)));
+    if (block == NULL)
+    {
+        return -1;
+    }
+    int* id = (int*)(block + (size_t)CPUSTAT_FIELDS * capacity);
+    if (kept > 0)
+    {
+        for (int field = 0; field < CPUSTAT_FIELDS; field++)
+        {
+            memcpy(block + (size_t)field * capacity, times->ticks[field], (size_t)kept * sizeof(uint64_t));
+        }
+        memcpy(id, times->id, (size_t)kept * sizeof(int));
+    }
+    // The old block starts with the first column
+    free(times->ticks[0]);
+    for (int field = 0; field < CPUSTAT_FIELDS; field++)
+    {
+        times->ticks[field] = block + (size_t)field * capacity;
+    }
+    times->id = id;
+    times->capacity = capacity;
+    return 0;
+}
+
+static int reserve_usage(CpuUsage* usage, int count)
+{
+    if (count <= usage->capacity)
+    {
+        return 0;
+    }
+    int capacity = (count + CPUSTAT_ALIGN_CPUS - 1) / CPUSTAT_ALIGN_CPUS * CPUSTAT_ALIGN_CPUS;
+    float* block = aligned_alloc(64, (size_t)capacity * (CPUSTAT_SHARES * sizeof(float) + sizeof(int)));
+    if (block == NULL)
+    {
+        return -1;
+    }
+    cpustat_free_usage(usage);
+    for (int share = 0; share < CPUSTAT_SHARES; share++)
+    {
+        usage->share[share] = block + (size_t)share * capacity;
+    }
+    usage->id = (int*)(block + (size_t)CPUSTAT_SHARES * capacity);
+    usage->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Parses the cpu lines of a /proc/stat text.
+ *
+ * The aggregate line goes to times->total and every cpuN line to the next
+ * row of the columns. Missing columns of older kernels are read as 0.
+ *
+ * @param text The content of /proc/stat.
+ * @param times Where the counters are stored.
+ * @return The number of CPUs, -1 on error.
+ */
+int cpustat_parse(const char* text, CpuTimes* times)
+{
+    int count = 0;
+    const char* line = text;
+    while (strncmp(line, "cpu", 3) == 0)
+    {
+        const char* cursor = line + 3;
+        uint64_t* row[CPUSTAT_FIELDS];
+        if (*cursor == ' ')
+        {
+            for (int field = 0; field < CPUSTAT_FIELDS; field++)
+            {
+                row[field] = &times->total[field];
+            }
+        }
+        else
+        {
+            if (reserve_times(times, count + 1, count) == -1)
+            {
+                return -1;
+            }
+            int id = 0;
+            while (*cursor >= '0' && *cursor <= '9')
+            {
+                id = id * 10 + (*cursor++ - '0');
+            }
+            times->id[count] = id;
+            for (int field = 0; field < CPUSTAT_FIELDS; field++)
+            {
+                row[field] = &times->ticks[field][count];
+            }
+            count++;
+        }
+
+        for (int field = 0; field < CPUSTAT_FIELDS; field++)
+        {
+            while (*cursor == ' ')
+            {
+                cursor++;
+            }
+            uint64_t value = 0;
+            while (*cursor >= '0' && *cursor <= '9')
+            {
+                value = value * 10 + (uint64_t)(*cursor++ - '0');
+            }
+            *row[field] = value;
+        }
+
+        line = strchr(cursor, '\n');
+        if (line == NULL)
+        {
+            break;
+        }
+        line++;
+    }
+    times->count = count;
+    if (count == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return count;
+}
+
+/**
+ * @brief Reads /proc/stat into times.
+ *
+ * The text buffer is kept between calls and grows with the number of CPUs;
+ * the cpu lines come first, so the read stops once they are in.
+ *
+ * @param times Where the counters are stored.
+ * @return The number of CPUs, -1 on error.
+ */
+int cpustat_read(CpuTimes* times)
+{
+    static char* text = NULL;
+    static size_t capacity = 0;
+    int fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    size_t length = 0;
+    while (1)
+    {
+        if (capacity - length < 4096)
+        {
+            char* grown = realloc(text, capacity + 16384);
+            if (grown == NULL)
+            {
+                close(fd);
+                return -1;
+            }
+            text = grown;
+            capacity += 16384;
+        }
+        ssize_t got = read(fd, text + length, capacity - length - 1);
+        if (got == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            break;
+        }
+        size_t searched = length > 5 ? length - 5 : 0;
+        length += (size_t)got;
+        text[length] = '\0';
+        // The line after the last cpu line starts with intr, and is long on large machines
+        if (strstr(text + searched, "\nintr") != NULL)
+        {
+            break;
+        }
+    }
+    close(fd);
+    text[length] = '\0';
+    return cpustat_parse(text, times);
+}
+
+/**
+ * @brief Ticks between two counters, 0 when the counter went back.
+ *
+ * The iowait counter of a CPU may decrease, see proc(5). The difference is
+ * narrowed to 32 bits, which holds months of ticks and converts to float
+ * with plain SIMD instructions.
+ */
+static inline int32_t ticks_between(uint64_t before, uint64_t now)
+{
+    int32_t ticks = (int32_t)(uint32_t)(now - before);
+    // Masks negative differences to 0, a compare would keep the loop from vectorizing
+    return ticks & ~(ticks >> 31);
+}
+
+/**
+ * @brief Computes the shares of count CPUs from two sets of columns.
+ *
+ * Every column is a separate array, so the loop reads contiguous counters
+ * and has no branch left once ticks_between becomes a max, which lets the
+ * compiler vectorize it.
+ */
+static void compute_shares(uint64_t* const before[CPUSTAT_FIELDS], uint64_t* const now[CPUSTAT_FIELDS], int count,
+                           float* const share[CPUSTAT_SHARES])
+{
+    const uint64_t* restrict user_before = before[CPUSTAT_USER];
+    const uint64_t* restrict nice_before = before[CPUSTAT_NICE];
+    const uint64_t* restrict system_before = before[CPUSTAT_SYSTEM];
+    const uint64_t* restrict idle_before = before[CPUSTAT_IDLE];
+    const uint64_t* restrict iowait_before = before[CPUSTAT_IOWAIT];
+    const uint64_t* restrict irq_before = before[CPUSTAT_IRQ];
+    const uint64_t* restrict softirq_before = before[CPUSTAT_SOFTIRQ];
+    const uint64_t* restrict steal_before = before[CPUSTAT_STEAL];
+    const uint64_t* restrict user_now = now[CPUSTAT_USER];
+    const uint64_t* restrict nice_now = now[CPUSTAT_NICE];
+    const uint64_t* restrict system_now = now[CPUSTAT_SYSTEM];
+    const uint64_t* restrict idle_now = now[CPUSTAT_IDLE];
+    const uint64_t* restrict iowait_now = now[CPUSTAT_IOWAIT];
+    const uint64_t* restrict irq_now = now[CPUSTAT_IRQ];
+    const uint64_t* restrict softirq_now = now[CPUSTAT_SOFTIRQ];
+    const uint64_t* restrict steal_now = now[CPUSTAT_STEAL];
+    float* restrict busy_share = share[CPUSTAT_BUSY];
+    float* restrict user_share = share[CPUSTAT_USER_SHARE];
+    float* restrict system_share = share[CPUSTAT_SYSTEM_SHARE];
+    float* restrict iowait_share = share[CPUSTAT_IOWAIT_SHARE];
+    float* restrict irq_share = share[CPUSTAT_IRQ_SHARE];
+    float* restrict steal_share = share[CPUSTAT_STEAL_SHARE];
+
+    // The columns never overlap; without this the run-time overlap checks are too many to vectorize
+#if defined(__clang__)
+#pragma clang loop vectorize(assume_safety)
+#elif defined(__GNUC__)
+#pragma GCC ivdep
+#endif
+    for (int cpu = 0; cpu < count; cpu++)
+    {
+        int32_t user = ticks_between(user_before[cpu], user_now[cpu]) + ticks_between(nice_before[cpu], nice_now[cpu]);
+        int32_t system = ticks_between(system_before[cpu], system_now[cpu]);
+        int32_t idle = ticks_between(idle_before[cpu], idle_now[cpu]);
+        int32_t iowait = ticks_between(iowait_before[cpu], iowait_now[cpu]);
+        int32_t irq = ticks_between(irq_before[cpu], irq_now[cpu]) +
+                      ticks_between(softirq_before[cpu], softirq_now[cpu]);
+        int32_t steal = ticks_between(steal_before[cpu], steal_now[cpu]);
+        int32_t total = user + system + idle + iowait + irq + steal;
+        // A CPU without ticks has every share at 0, with no branch around the division
+        float scale = 100.0f / (float)(total + (total == 0));
+        busy_share[cpu] = (float)(user + system + irq + steal) * scale;
+        user_share[cpu] = (float)user * scale;
+        system_share[cpu] = (float)system * scale;
+        iowait_share[cpu] = (float)iowait * scale;
+        irq_share[cpu] = (float)irq * scale;
+        steal_share[cpu] = (float)steal * scale;
+    }
+}
+
+/**
+ * @brief Ticks between two counters of the aggregate line, 0 when the counter went back.
+ *
+ * The aggregate line adds up every CPU, so on a large machine its
+ * differences outgrow the 32 bits of ticks_between within hours.
+ */
+static uint64_t total_ticks_between(uint64_t before, uint64_t now)
+{
+    return now > before ? now - before : 0;
+}
+
+/**
+ * @brief Computes the shares of the aggregate line, with 64-bit differences.
+ */
+static void compute_total_shares(const uint64_t before[CPUSTAT_FIELDS], const uint64_t now[CPUSTAT_FIELDS],
+                                 float share[CPUSTAT_SHARES])
+{
+    uint64_t ticks[CPUSTAT_FIELDS];
+    for (int field = 0; field < CPUSTAT_FIELDS; field++)
+    {
+        ticks[field] = total_ticks_between(before[field], now[field]);
+    }
+    uint64_t user = ticks[CPUSTAT_USER] + ticks[CPUSTAT_NICE];
+    uint64_t irq = ticks[CPUSTAT_IRQ] + ticks[CPUSTAT_SOFTIRQ];
+    uint64_t total = user + ticks[CPUSTAT_SYSTEM] + ticks[CPUSTAT_IDLE] + ticks[CPUSTAT_IOWAIT] + irq +
+                     ticks[CPUSTAT_STEAL];
+    double scale = total > 0 ? 100.0 / (double)total : 0;
+    share[CPUSTAT_BUSY] = (float)((double)(user + ticks[CPUSTAT_SYSTEM] + irq + ticks[CPUSTAT_STEAL]) * scale);
+    share[CPUSTAT_USER_SHARE] = (float)((double)user * scale);
+    share[CPUSTAT_SYSTEM_SHARE] = (float)((double)ticks[CPUSTAT_SYSTEM] * scale);
+    share[CPUSTAT_IOWAIT_SHARE] = (float)((double)ticks[CPUSTAT_IOWAIT] * scale);
+    share[CPUSTAT_IRQ_SHARE] = (float)((double)irq * scale);
+    share[CPUSTAT_STEAL_SHARE] = (float)((double)ticks[CPUSTAT_STEAL] * scale);
+}
+
+/**
+ * @brief Computes the shares of every CPU between two readings.
+ *
+ * Busy time is everything but idle and iowait, as in get_cpu_usage.
+ *
+ * @param previous The older reading.
+ * @param current The newer reading.
+ * @param usage Where the shares are stored.
+ * @return The number of CPUs, -1 if a CPU went offline or online in between, or on error.
+ */
+int cpustat_usage(const CpuTimes* previous, const CpuTimes* current, CpuUsage* usage)
+{
+    if (previous->count != current->count ||
+        memcmp(previous->id, current->id, (size_t)current->count * sizeof(int)) != 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (reserve_usage(usage, current->count) == -1)
+    {
+        return -1;
+    }
+    compute_shares(previous->ticks, current->ticks, current->count, usage->share);
+    memcpy(usage->id, current->id, (size_t)current->count * sizeof(int));
+    usage->count = current->count;
+    compute_total_shares(previous->total, current->total, usage->total);
+    return usage->count;
+}
+
+/**
+ * @brief Computes the spread of the busy share across CPUs.
+ *
+ * @param usage The shares of every CPU.
+ * @param spread Where the minimum, maximum, average and standard deviation are stored.
+ */
+void cpustat_spread(const CpuUsage* usage, CpuSpread* spread)
+{
+    memset(spread, 0, sizeof(*spread));
+    if (usage->count == 0)
+    {
+        return;
+    }
+    const float* busy = usage->share[CPUSTAT_BUSY];
+    int coolest = 0;
+    int hottest = 0;
+    float sum = 0;
+    for (int cpu = 0; cpu < usage->count; cpu++)
+    {
+        sum += busy[cpu];
+        coolest = busy[cpu] < busy[coolest] ? cpu : coolest;
+        hottest = busy[cpu] > busy[hottest] ? cpu : hottest;
+    }
+    float average = sum / (float)usage->count;
+    float squares = 0;
+    for (int cpu = 0; cpu < usage->count; cpu++)
+    {
+        squares += (busy[cpu] - average) * (busy[cpu] - average);
+    }
+    spread->minimum = busy[coolest];
+    spread->maximum = busy[hottest];
+    spread->average = average;
+    spread->deviation = sqrtf(squares / (float)usage->count);
+    spread->coolest = usage->id[coolest];
+    spread->hottest = usage->id[hottest];
+}
+
+void cpustat_free_times(CpuTimes* times)
+{
+    free(times->ticks[0]);
+    memset(times->ticks, 0, sizeof(times->ticks));
+    times->id = NULL;
+    times->count = times->capacity = 0;
+}
+
+void cpustat_free_usage(CpuUsage* usage)
+{
+    free(usage->share[0]);
+    memset(usage->share, 0, sizeof(usage->share));
+    usage->id = NULL;
+    usage->count = usage->capacity = 0;
+}
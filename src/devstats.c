@@ -0,0 +1,487 @@
+#define _GNU_SOURCE
+#include "../include/devstats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Counters kept per device: the largest of the disk and interface sets */
+#define DEVICE_COUNTERS 8
+
+/** @brief Bytes of a sector in /proc/diskstats, whatever the device */
+#define SECTOR_BYTES 512
+
+enum
+{
+    DISK_READS,
+    DISK_READ_SECTORS,
+    DISK_READ_MS,
+    DISK_WRITES,
+    DISK_WRITE_SECTORS,
+    DISK_WRITE_MS,
+    DISK_BUSY_MS
+};
+
+enum
+{
+    INTERFACE_RECEIVE_BYTES,
+    INTERFACE_RECEIVE_PACKETS,
+    INTERFACE_RECEIVE_ERRORS,
+    INTERFACE_RECEIVE_DROPS,
+    INTERFACE_TRANSMIT_BYTES,
+    INTERFACE_TRANSMIT_PACKETS,
+    INTERFACE_TRANSMIT_ERRORS,
+    INTERFACE_TRANSMIT_DROPS
+};
+
+/**
+ * @brief A device or interface seen in a reading.
+ */
+typedef struct
+{
+    char name[DEVSTATS_NAME_SIZE];
+    /** @brief 1 if the filters of the configuration keep it */
+    int selected;
+    /** @brief 1 if it was in the latest reading */
+    int present;
+    /** @brief 1 if counters holds a reading */
+    int counted;
+    /** @brief 1 if deltas holds the change since the reading before */
+    int measured;
+    uint64_t counters[DEVICE_COUNTERS];
+    uint64_t deltas[DEVICE_COUNTERS];
+} Device;
+
+/**
+ * @brief Devices of one file, in the order of their lines.
+ */
+typedef struct
+{
+    Device* devices;
+    int count;
+    int capacity;
+    /** @brief Index where the next line is expected, the order rarely changes */
+    int cursor;
+    /** @brief Configuration the selections were made with */
+    uint64_t generation;
+    int64_t previous_ms;
+    int64_t elapsed_ms;
+} DeviceTable;
+
+static struct
+{
+    DeviceTable disks;
+    DeviceTable interfaces;
+} stats;
+
+/**
+ * @brief Starts a reading of a table.
+ *
+ * A new configuration selects the devices again; one that was just
+ * selected has no counters yet.
+ */
+static void begin_reading(DeviceTable* table, const DeviceFilter* filter, uint64_t generation, int64_t now_ms)
+{
+    if (table->generation != generation)
+    {
+        for (int index = 0; index < table->count; index++)
+        {
+            Device* device = &table->devices[index];
+            int selected = config_device_selected(filter, device->name);
+            if (!device->selected)
+            {
+                device->counted = device->measured = 0;
+            }
+            device->selected = selected;
+        }
+        table->generation = generation;
+    }
+    for (int index = 0; index < table->count; index++)
+    {
+        table->devices[index].present = 0;
+    }
+    table->cursor = 0;
+    table->elapsed_ms = table->previous_ms != 0 ? now_ms - table->previous_ms : 0;
+    table->previous_ms = now_ms;
+}
+
+/**
+ * @brief Ends a reading: a device that went away loses its counters.
+ */
+static void end_reading(DeviceTable* table)
+{
+    for (int index = 0; index < table->count; index++)
+    {
+        if (!table->devices[index].present)
+        {
+            table->devices[index].counted = table->devices[index].measured = 0;
+        }
+    }
+}
+
+/**
+ * @brief Finds the device of a line, adding it when it is new.
+ *
+ * Lines come in the same order from one reading to the next, so the
+ * device after the previous one is tried before a search.
+ *
+ * @return The device, or NULL if memory is exhausted.
+ */
+static Device* find_device(DeviceTable* table, const DeviceFilter* filter, const char* name, size_t length)
+{
+    char key[DEVSTATS_NAME_SIZE];
+    length = length < sizeof(key) - 1 ? length : sizeof(key) - 1;
+    memcpy(key, name, length);
+    key[length] = '\0';
+
+    int index = table->cursor;
+    if (index >= table->count || strcmp(table->devices[index].name, key) != 0)
+    {
+        for (index = 0; index < table->count && strcmp(table->devices[index].name, key) != 0; index++)
+        {
+        }
+    }
+    if (index == table->count)
+    {
+        if (table->count == table->capacity)
+        {
+            int capacity = table->capacity == 0 ? 16 : table->capacity * 2;
+            Device* grown = realloc(table->devices, (size_t)capacity * sizeof(Device));
+            if (grown == NULL)
+            {
+                return NULL;
+            }
+            table->devices = grown;
+            table->capacity = capacity;
+        }
+        Device* device = &table->devices[table->count++];
+        memset(device, 0, sizeof(*device));
+        memcpy(device->name, key, length + 1);
+        device->selected = config_device_selected(filter, key);
+    }
+    table->cursor = index + 1;
+    table->devices[index].present = 1;
+    return &table->devices[index];
+}
+
+/**
+ * @brief Returns the start of the line after the given one, NULL after the last.
+ */
+static const char* next_line(const char* line)
+{
+    if (line == NULL)
+    {
+        return NULL;
+    }
+    const char* end = strchr(line, '\n');
+    return end != NULL ? end + 1 : NULL;
+}
+
+/**
+ * @brief Parses the next unsigned number of a line.
+ *
+ * @return The character after the number.
+ */
+static const char* parse_number(const char* cursor, uint64_t* value)
+{
+    while (*cursor == ' ' || *cursor == '\t')
+    {
+        cursor++;
+    }
+    uint64_t number = 0;
+    while (*cursor >= '0' && *cursor <= '9')
+    {
+        number = number * 10 + (uint64_t)(*cursor++ - '0');
+    }
+    *value = number;
+    return cursor;
+}
+
+/**
+ * @brief Stores the counters of a reading and their change since the one before.
+ *
+ * A counter that went back, like a 32-bit counter of a driver wrapping or a
+ * device that was reset, counts as no change.
+ */
+static void store_counters(Device* device, const uint64_t counters[DEVICE_COUNTERS])
+{
+    device->measured = device->counted;
+    device->counted = 1;
+    for (int counter = 0; counter < DEVICE_COUNTERS; counter++)
+    {
+        uint64_t before = device->counters[counter];
+        device->deltas[counter] = counters[counter] >= before ? counters[counter] - before : 0;
+        device->counters[counter] = counters[counter];
+    }
+}
+
+/**
+ * @brief Parses /proc/diskstats: major, minor, name, then the counters.
+ *
+ * Lines of devices left out by the filters stop after the name.
+ */
+static void parse_disks(const char* text, const DeviceFilter* filter)
+{
+    for (const char* line = text; line != NULL && *line != '\0'; line = next_line(line))
+    {
+        uint64_t number;
+        const char* cursor = parse_number(parse_number(line, &number), &number);
+        while (*cursor == ' ')
+        {
+            cursor++;
+        }
+        size_t length = strcspn(cursor, " \n");
+        if (length == 0)
+        {
+            continue;
+        }
+        Device* device = find_device(&stats.disks, filter, cursor, length);
+        if (device == NULL || !device->selected)
+        {
+            continue;
+        }
+        cursor += length;
+
+        // Fields 1 to 10 of Documentation/admin-guide/iostats.rst
+        uint64_t fields[10];
+        for (int field = 0; field < 10; field++)
+        {
+            cursor = parse_number(cursor, &fields[field]);
+        }
+        uint64_t counters[DEVICE_COUNTERS] = {0};
+        counters[DISK_READS] = fields[0];
+        counters[DISK_READ_SECTORS] = fields[2];
+        counters[DISK_READ_MS] = fields[3];
+        counters[DISK_WRITES] = fields[4];
+        counters[DISK_WRITE_SECTORS] = fields[6];
+        counters[DISK_WRITE_MS] = fields[7];
+        counters[DISK_BUSY_MS] = fields[9];
+        store_counters(device, counters);
+    }
+}
+
+/**
+ * @brief Parses /proc/net/dev: two header lines, then the name and 16 counters.
+ */
+static void parse_interfaces(const char* text, const DeviceFilter* filter)
+{
+    for (const char* line = next_line(next_line(text)); line != NULL && *line != '\0'; line = next_line(line))
+    {
+        const char* cursor = line + strspn(line, " ");
+        const char* colon = strchr(cursor, ':');
+        if (colon == NULL)
+        {
+            break;
+        }
+        Device* device = find_device(&stats.interfaces, filter, cursor, (size_t)(colon - cursor));
+        if (device == NULL || !device->selected)
+        {
+            continue;
+        }
+        cursor = colon + 1;
+
+        uint64_t fields[12];
+        for (int field = 0; field < 12; field++)
+        {
+            cursor = parse_number(cursor, &fields[field]);
+        }
+        uint64_t counters[DEVICE_COUNTERS];
+        counters[INTERFACE_RECEIVE_BYTES] = fields[0];
+        counters[INTERFACE_RECEIVE_PACKETS] = fields[1];
+        counters[INTERFACE_RECEIVE_ERRORS] = fields[2];
+        counters[INTERFACE_RECEIVE_DROPS] = fields[3];
+        counters[INTERFACE_TRANSMIT_BYTES] = fields[8];
+        counters[INTERFACE_TRANSMIT_PACKETS] = fields[9];
+        counters[INTERFACE_TRANSMIT_ERRORS] = fields[10];
+        counters[INTERFACE_TRANSMIT_DROPS] = fields[11];
+        store_counters(device, counters);
+    }
+}
+
+static int64_t monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Updates the rates from the texts of /proc/diskstats and /proc/net/dev.
+ *
+ * @param diskstats The text of /proc/diskstats, NULL to leave the disks as they are.
+ * @param net_dev The text of /proc/net/dev, NULL to leave the interfaces as they are.
+ * @param now_ms The time of the reading on a monotonic clock.
+ * @param config The configuration holding the filters.
+ * @return The number of tracked devices and interfaces.
+ */
+int devstats_parse(const char* diskstats, const char* net_dev, int64_t now_ms, const MonitorConfig* config)
+{
+    if (diskstats != NULL)
+    {
+        begin_reading(&stats.disks, &config->disks, config->generation, now_ms);
+        parse_disks(diskstats, &config->disks);
+        end_reading(&stats.disks);
+    }
+    if (net_dev != NULL)
+    {
+        begin_reading(&stats.interfaces, &config->interfaces, config->generation, now_ms);
+        parse_interfaces(net_dev, &config->interfaces);
+        end_reading(&stats.interfaces);
+    }
+    int tracked = 0;
+    for (int index = 0; index < stats.disks.count; index++)
+    {
+        tracked += stats.disks.devices[index].present && stats.disks.devices[index].selected;
+    }
+    for (int index = 0; index < stats.interfaces.count; index++)
+    {
+        tracked += stats.interfaces.devices[index].present && stats.interfaces.devices[index].selected;
+    }
+    return tracked;
+}
+
+/**
+ * @brief Reads a file of /proc into a buffer kept between calls.
+ *
+ * @return The NUL-terminated text, or NULL on error.
+ */
+static const char* read_proc(const char* path, char** text, size_t* capacity)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+    size_t length = 0;
+    while (1)
+    {
+        if (*capacity - length < 4096)
+        {
+            char* grown = realloc(*text, *capacity + 16384);
+            if (grown == NULL)
+            {
+                close(fd);
+                return NULL;
+            }
+            *text = grown;
+            *capacity += 16384;
+        }
+        ssize_t got = read(fd, *text + length, *capacity - length - 1);
+        if (got == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            break;
+        }
+        length += (size_t)got;
+    }
+    close(fd);
+    (*text)[length] = '\0';
+    return *text;
+}
+
+/**
+ * @brief Reads /proc/diskstats and /proc/net/dev and updates the rates.
+ *
+ * @param config The configuration holding the filters.
+ * @return 0 on success, -1 if neither file can be read.
+ */
+int devstats_update(const MonitorConfig* config)
+{
+    static char* disk_text = NULL;
+    static size_t disk_capacity = 0;
+    static char* interface_text = NULL;
+    static size_t interface_capacity = 0;
+    const char* diskstats = read_proc("/proc/diskstats", &disk_text, &disk_capacity);
+    const char* net_dev = read_proc("/proc/net/dev", &interface_text, &interface_capacity);
+    if (diskstats == NULL && net_dev == NULL)
+    {
+        return -1;
+    }
+    devstats_parse(diskstats, net_dev, monotonic_ms(), config);
+    return 0;
+}
+
+/**
+ * @brief Copies the rates of the disks present in the last two readings.
+ *
+ * The latency is the time spent on the requests completed in between
+ * divided by their number, and the utilization the time with requests in
+ * flight, as iostat computes r_await, w_await and %util.
+ *
+ * @param rates Where the rates are stored.
+ * @param capacity The number of entries of rates.
+ * @return The number of disks copied.
+ */
+int devstats_disks(DiskRates* rates, int capacity)
+{
+    double seconds = (double)stats.disks.elapsed_ms / 1000;
+    int count = 0;
+    for (int index = 0; index < stats.disks.count && count < capacity && seconds > 0; index++)
+    {
+        const Device* device = &stats.disks.devices[index];
+        if (!device->measured)
+        {
+            continue;
+        }
+        const uint64_t* delta = device->deltas;
+        DiskRates* rate = &rates[count++];
+        memcpy(rate->name, device->name, sizeof(rate->name));
+        rate->reads_per_second = (double)delta[DISK_READS] / seconds;
+        rate->writes_per_second = (double)delta[DISK_WRITES] / seconds;
+        rate->read_bytes_per_second = (double)delta[DISK_READ_SECTORS] * SECTOR_BYTES / seconds;
+        rate->write_bytes_per_second = (double)delta[DISK_WRITE_SECTORS] * SECTOR_BYTES / seconds;
+        uint64_t requests = delta[DISK_READS] + delta[DISK_WRITES];
+        rate->latency_ms =
+            requests != 0 ? (double)(delta[DISK_READ_MS] + delta[DISK_WRITE_MS]) / (double)requests : 0;
+        rate->utilization = (double)delta[DISK_BUSY_MS] * 100 / (double)stats.disks.elapsed_ms;
+        if (rate->utilization > 100)
+        {
+            rate->utilization = 100;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Copies the rates of the interfaces present in the last two readings.
+ *
+ * @param rates Where the rates are stored.
+ * @param capacity The number of entries of rates.
+ * @return The number of interfaces copied.
+ */
+int devstats_interfaces(InterfaceRates* rates, int capacity)
+{
+    double seconds = (double)stats.interfaces.elapsed_ms / 1000;
+    int count = 0;
+    for (int index = 0; index < stats.interfaces.count && count < capacity && seconds > 0; index++)
+    {
+        const Device* device = &stats.interfaces.devices[index];
+        if (!device->measured)
+        {
+            continue;
+        }
+        const uint64_t* delta = device->deltas;
+        InterfaceRates* rate = &rates[count++];
+        memcpy(rate->name, device->name, sizeof(rate->name));
+        rate->receive_bytes_per_second = (double)delta[INTERFACE_RECEIVE_BYTES] / seconds;
+        rate->transmit_bytes_per_second = (double)delta[INTERFACE_TRANSMIT_BYTES] / seconds;
+        rate->receive_packets_per_second = (double)delta[INTERFACE_RECEIVE_PACKETS] / seconds;
+        rate->transmit_packets_per_second = (double)delta[INTERFACE_TRANSMIT_PACKETS] / seconds;
+        rate->receive_drops_per_second = (double)delta[INTERFACE_RECEIVE_DROPS] / seconds;
+        rate->transmit_drops_per_second = (double)delta[INTERFACE_TRANSMIT_DROPS] / seconds;
+        rate->errors_per_second =
+            (double)(delta[INTERFACE_RECEIVE_ERRORS] + delta[INTERFACE_TRANSMIT_ERRORS]) / seconds;
+    }
+    return count;
+}
+
+void devstats_reset(void)
+{
+    free(stats.disks.devices);
+    free(stats.interfaces.devices);
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,1134 @@
+#include "../include/editor.h"
+#include "../include/supervisor.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+
+// Maximum number of candidates listed after a second Tab
+#define EDITOR_MAX_LISTED 100
+
+// Escape sequences of one key are collected here and sent in one write
+#define EDITOR_OUTPUT_SIZE 4096
+
+#define EDITOR_MAX_PROMPT 4096
+#define CONTINUATION_PROMPT "> "
+
+#define KEY_CTRL_A 0x01
+#define KEY_CTRL_B 0x02
+#define KEY_CTRL_C 0x03
+#define KEY_CTRL_D 0x04
+#define KEY_CTRL_E 0x05
+#define KEY_CTRL_F 0x06
+#define KEY_CTRL_G 0x07
+#define KEY_BACKSPACE_CTRL_H 0x08
+#define KEY_TAB 0x09
+#define KEY_CTRL_K 0x0b
+#define KEY_CTRL_L 0x0c
+#define KEY_ENTER 0x0d
+#define KEY_CTRL_N 0x0e
+#define KEY_CTRL_P 0x10
+#define KEY_CTRL_R 0x12
+#define KEY_CTRL_U 0x15
+#define KEY_CTRL_W 0x17
+#define KEY_ESCAPE 0x1b
+#define KEY_BACKSPACE 0x7f
+
+/**
+ * @brief Keys decoded from escape sequences, outside the byte range.
+ */
+enum
+{
+    KEY_END_OF_INPUT = -1,
+    KEY_NONE = 0x100,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_HOME,
+    KEY_END,
+    KEY_DELETE,
+    KEY_WORD_LEFT,
+    KEY_WORD_RIGHT
+};
+
+/**
+ * @brief Text with a gap at the last edit position, so typing in the middle of
+ * a line only moves the bytes between two edit positions.
+ */
+typedef struct
+{
+    char* data;
+    size_t capacity;
+    size_t gap_start;
+    size_t gap_end;
+} GapBuffer;
+
+/**
+ * @brief What the terminal currently shows, used to send only the differences.
+ */
+typedef struct
+{
+    char prompt[EDITOR_MAX_PROMPT];
+    int prompt_width;
+
+    char* shown;
+    size_t shown_length;
+    size_t shown_capacity;
+
+    /** @brief Byte of the shown text under the terminal cursor */
+    size_t cursor;
+
+    int columns;
+} Display;
+
+static EditorHooks hooks;
+
+static struct
+{
+    GapBuffer buffer;
+    Display display;
+
+    /** @brief Contiguous copy of the buffer that is rendered */
+    char* text;
+    size_t text_capacity;
+
+    size_t cursor;
+    size_t max_length;
+
+    /** @brief History entry being shown, 0 while editing a new line */
+    int history_number;
+    char* saved_line;
+} editor;
+
+static char output[EDITOR_OUTPUT_SIZE];
+static size_t output_length = 0;
+
+/**
+ * @brief Sets the history and completion functions.
+ */
+void editor_set_hooks(const EditorHooks* new_hooks)
+{
+    hooks = *new_hooks;
+}
+
+/**
+ * @brief Writes bytes to the terminal, retrying after interruptions.
+ */
+static void terminal_write(const char* text, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(STDOUT_FILENO, text, length);
+        if (written == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return;
+        }
+        text += written;
+        length -= written;
+    }
+}
+
+/**
+ * @brief Sends the collected output in one write.
+ */
+static void output_flush(void)
+{
+    terminal_write(output, output_length);
+    output_length = 0;
+}
+
+static void output_append(const char* text, size_t length)
+{
+    if (output_length + length > sizeof(output))
+    {
+        output_flush();
+        if (length > sizeof(output))
+        {
+            terminal_write(text, length);
+            return;
+        }
+    }
+    memcpy(output + output_length, text, length);
+    output_length += length;
+}
+
+static void output_string(const char* text)
+{
+    output_append(text, strlen(text));
+}
+
+static void output_format(const char* format, ...)
+{
+    char text[64];
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+    if (length > 0)
+    {
+        output_append(text, (size_t)length < sizeof(text) ? (size_t)length : sizeof(text) - 1);
+    }
+}
+
+static size_t gap_length(const GapBuffer* buffer)
+{
+    return buffer->capacity - (buffer->gap_end - buffer->gap_start);
+}
+
+static char gap_at(const GapBuffer* buffer, size_t index)
+{
+    return index < buffer->gap_start ? buffer->data[index] : buffer->data[index + buffer->gap_end - buffer->gap_start];
+}
+
+/**
+ * @brief Moves the gap so it starts at a position.
+ */
+static void gap_move(GapBuffer* buffer, size_t position)
+{
+    if (position < buffer->gap_start)
+    {
+        size_t count = buffer->gap_start - position;
+        memmove(buffer->data + buffer->gap_end - count, buffer->data + position, count);
+        buffer->gap_start -= count;
+        buffer->gap_end -= count;
+    }
+    else if (position > buffer->gap_start)
+    {
+        size_t count = position - buffer->gap_start;
+        memmove(buffer->data + buffer->gap_start, buffer->data + buffer->gap_end, count);
+        buffer->gap_start += count;
+        buffer->gap_end += count;
+    }
+}
+
+/**
+ * @brief Inserts bytes at a position, doubling the buffer when the gap is too small.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+static int gap_insert(GapBuffer* buffer, size_t position, const char* text, size_t length)
+{
+    if (buffer->gap_end - buffer->gap_start < length)
+    {
+        size_t used = gap_length(buffer);
+        size_t capacity = buffer->capacity == 0 ? 256 : buffer->capacity;
+        while (capacity - used < length)
+        {
+            capacity *= 2;
+        }
+        char* data = realloc(buffer->data, capacity);
+        if (data == NULL)
+        {
+            return -1;
+        }
+        size_t tail = buffer->capacity - buffer->gap_end;
+        memmove(data + capacity - tail, data + buffer->gap_end, tail);
+        buffer->data = data;
+        buffer->gap_end = capacity - tail;
+        buffer->capacity = capacity;
+    }
+    gap_move(buffer, position);
+    memcpy(buffer->data + buffer->gap_start, text, length);
+    buffer->gap_start += length;
+    return 0;
+}
+
+static void gap_delete(GapBuffer* buffer, size_t from, size_t to)
+{
+    gap_move(buffer, from);
+    buffer->gap_end += to - from;
+}
+
+static void gap_clear(GapBuffer* buffer)
+{
+    buffer->gap_start = 0;
+    buffer->gap_end = buffer->capacity;
+}
+
+/**
+ * @brief Returns the number of terminal cells of a UTF-8 text, one per character.
+ */
+static size_t text_width(const char* text, size_t length)
+{
+    size_t width = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        width += ((unsigned char)text[i] & 0xc0) != 0x80;
+    }
+    return width;
+}
+
+/**
+ * @brief Returns the number of cells of a prompt, color sequences take none.
+ */
+static int prompt_width(const char* prompt)
+{
+    int width = 0;
+    for (const char* c = prompt; *c != '\0'; c++)
+    {
+        if (c[0] == '\033' && c[1] == '[')
+        {
+            c += 2;
+            while (*c != '\0' && (*c < 0x40 || *c > 0x7e))
+            {
+                c++;
+            }
+            if (*c == '\0')
+            {
+                break;
+            }
+            continue;
+        }
+        width += ((unsigned char)*c & 0xc0) != 0x80;
+    }
+    return width;
+}
+
+/**
+ * @brief Returns the cell of a byte of the shown text, counted from the start of the prompt.
+ */
+static size_t cell_of(const Display* display, const char* text, size_t index)
+{
+    return display->prompt_width + text_width(text, index);
+}
+
+/**
+ * @brief Moves the terminal cursor between two cells with relative movements.
+ */
+static void move_cursor(const Display* display, size_t from, size_t to)
+{
+    int from_row = (int)(from / display->columns);
+    int to_row = (int)(to / display->columns);
+    int from_column = (int)(from % display->columns);
+    int to_column = (int)(to % display->columns);
+    if (to_row < from_row)
+    {
+        output_format("\033[%dA", from_row - to_row);
+    }
+    else if (to_row > from_row)
+    {
+        output_format("\033[%dB", to_row - from_row);
+    }
+    if (to_column == from_column - 1)
+    {
+        output_string("\b");
+    }
+    else if (to_column < from_column)
+    {
+        output_format("\033[%dD", from_column - to_column);
+    }
+    else if (to_column > from_column)
+    {
+        output_format("\033[%dC", to_column - from_column);
+    }
+}
+
+/**
+ * @brief Moves a cursor that ended on the last column to the next row.
+ *
+ * Terminals keep the cursor on the last column after filling a row, so the
+ * next relative movement would be off by one row.
+ */
+static void settle(const Display* display, size_t cell)
+{
+    if (cell > 0 && cell % display->columns == 0)
+    {
+        output_string("\r\n");
+    }
+}
+
+/**
+ * @brief Remembers the text the terminal shows.
+ */
+static void display_store(Display* display, const char* text, size_t length, size_t cursor)
+{
+    if (length + 1 > display->shown_capacity)
+    {
+        size_t capacity = length + 256;
+        char* shown = realloc(display->shown, capacity);
+        if (shown == NULL)
+        {
+            return;
+        }
+        display->shown = shown;
+        display->shown_capacity = capacity;
+    }
+    memcpy(display->shown, text, length);
+    display->shown_length = length;
+    display->cursor = cursor;
+}
+
+/**
+ * @brief Draws the prompt and the whole line.
+ *
+ * @param fresh 1 if the cursor is at the start of an empty row, 0 to
+ * overwrite the line currently shown.
+ */
+static void display_full(Display* display, const char* prompt, const char* text, size_t length, size_t cursor,
+                         int fresh)
+{
+    if (!fresh)
+    {
+        size_t current = cell_of(display, display->shown, display->cursor);
+        if (current / display->columns > 0)
+        {
+            output_format("\033[%dA", (int)(current / display->columns));
+        }
+        output_string("\r\033[J");
+    }
+    if (prompt != display->prompt)
+    {
+        snprintf(display->prompt, sizeof(display->prompt), "%s", prompt);
+        display->prompt_width = prompt_width(display->prompt);
+    }
+    output_string(display->prompt);
+    output_append(text, length);
+    size_t end = cell_of(display, text, length);
+    settle(display, end);
+    move_cursor(display, end, cell_of(display, text, cursor));
+    display_store(display, text, length, cursor);
+}
+
+/**
+ * @brief Updates the terminal from the shown text to a new one.
+ *
+ * Only the bytes after the longest common prefix are written, and the rest
+ * of the screen is only erased when the line got shorter. Moving the cursor
+ * alone sends a single movement sequence.
+ */
+static void display_update(Display* display, const char* text, size_t length, size_t cursor)
+{
+    size_t common = 0;
+    while (common < length && common < display->shown_length && text[common] == display->shown[common])
+    {
+        common++;
+    }
+    while (common > 0 && common < length && ((unsigned char)text[common] & 0xc0) == 0x80)
+    {
+        common--;
+    }
+
+    size_t current = cell_of(display, display->shown, display->cursor);
+    size_t old_end = cell_of(display, display->shown, display->shown_length);
+    size_t new_end = cell_of(display, text, length);
+    if (common == length && common == display->shown_length)
+    {
+        move_cursor(display, current, cell_of(display, text, cursor));
+        display->cursor = cursor;
+        return;
+    }
+
+    move_cursor(display, current, cell_of(display, text, common));
+    output_append(text + common, length - common);
+    settle(display, new_end);
+    if (old_end > new_end)
+    {
+        output_string("\033[J");
+    }
+    move_cursor(display, new_end, cell_of(display, text, cursor));
+    display_store(display, text, length, cursor);
+}
+
+/**
+ * @brief Copies the gap buffer into the contiguous text that is rendered.
+ *
+ * @return The length of the text.
+ */
+static size_t line_text(void)
+{
+    size_t length = gap_length(&editor.buffer);
+    if (length + 1 > editor.text_capacity)
+    {
+        size_t capacity = length + 256;
+        char* text = realloc(editor.text, capacity);
+        if (text == NULL)
+        {
+            return 0;
+        }
+        editor.text = text;
+        editor.text_capacity = capacity;
+    }
+    if (editor.buffer.gap_start > 0)
+    {
+        memcpy(editor.text, editor.buffer.data, editor.buffer.gap_start);
+    }
+    if (length > editor.buffer.gap_start)
+    {
+        memcpy(editor.text + editor.buffer.gap_start, editor.buffer.data + editor.buffer.gap_end,
+               length - editor.buffer.gap_start);
+    }
+    editor.text[length] = '\0';
+    return length;
+}
+
+/**
+ * @brief Redraws what changed since the last key.
+ */
+static void refresh(void)
+{
+    size_t length = line_text();
+    display_update(&editor.display, editor.text, length, editor.cursor);
+}
+
+/**
+ * @brief Redraws the prompt and the line, used when the prompt changes or after other output.
+ */
+static void redraw(const char* prompt, int fresh)
+{
+    size_t length = line_text();
+    display_full(&editor.display, prompt, editor.text, length, editor.cursor, fresh);
+}
+
+/**
+ * @brief Replaces the whole line, with the cursor at its end.
+ */
+static void set_line(const char* text)
+{
+    gap_clear(&editor.buffer);
+    size_t length = strlen(text);
+    if (length > editor.max_length)
+    {
+        length = editor.max_length;
+    }
+    gap_insert(&editor.buffer, 0, text, length);
+    editor.cursor = length;
+}
+
+/**
+ * @brief Reads a byte of the terminal while children are supervised.
+ *
+ * @return The byte, or KEY_END_OF_INPUT.
+ */
+static int read_byte(void)
+{
+    while (1)
+    {
+        int ready = supervisor_wait_readable(STDIN_FILENO);
+        if (ready == 0)
+        {
+            // A job reported its end over the line, show it again below
+            fflush(stdout);
+            redraw(editor.display.prompt, 1);
+            output_flush();
+            continue;
+        }
+        unsigned char byte;
+        ssize_t count = read(STDIN_FILENO, &byte, 1);
+        if (count == 1)
+        {
+            return byte;
+        }
+        if (count == -1 && (errno == EINTR || errno == EAGAIN))
+        {
+            continue;
+        }
+        return KEY_END_OF_INPUT;
+    }
+}
+
+/**
+ * @brief Reads a key, decoding the escape sequences of the cursor keys.
+ */
+static int read_key(void)
+{
+    int byte = read_byte();
+    if (byte != KEY_ESCAPE)
+    {
+        return byte;
+    }
+
+    int next = read_byte();
+    if (next == 'b')
+    {
+        return KEY_WORD_LEFT;
+    }
+    if (next == 'f')
+    {
+        return KEY_WORD_RIGHT;
+    }
+    if (next == 'O')
+    {
+        int final = read_byte();
+        return final == 'H' ? KEY_HOME : final == 'F' ? KEY_END : KEY_NONE;
+    }
+    if (next != '[')
+    {
+        return next == KEY_END_OF_INPUT ? KEY_END_OF_INPUT : KEY_NONE;
+    }
+
+    // CSI parameters final byte
+    int parameter = 0;
+    int final = read_byte();
+    while (final >= '0' && final <= ';')
+    {
+        if (final >= '0' && final <= '9')
+        {
+            parameter = parameter * 10 + (final - '0');
+        }
+        final = read_byte();
+    }
+    switch (final)
+    {
+    case 'A':
+        return KEY_UP;
+    case 'B':
+        return KEY_DOWN;
+    case 'C':
+        return KEY_RIGHT;
+    case 'D':
+        return KEY_LEFT;
+    case 'H':
+        return KEY_HOME;
+    case 'F':
+        return KEY_END;
+    case '~':
+        if (parameter == 1 || parameter == 7)
+        {
+            return KEY_HOME;
+        }
+        if (parameter == 4 || parameter == 8)
+        {
+            return KEY_END;
+        }
+        return parameter == 3 ? KEY_DELETE : KEY_NONE;
+    default:
+        return final == KEY_END_OF_INPUT ? KEY_END_OF_INPUT : KEY_NONE;
+    }
+}
+
+static size_t previous_character(size_t position)
+{
+    if (position == 0)
+    {
+        return 0;
+    }
+    position--;
+    while (position > 0 && ((unsigned char)gap_at(&editor.buffer, position) & 0xc0) == 0x80)
+    {
+        position--;
+    }
+    return position;
+}
+
+static size_t next_character(size_t position)
+{
+    size_t length = gap_length(&editor.buffer);
+    if (position >= length)
+    {
+        return length;
+    }
+    position++;
+    while (position < length && ((unsigned char)gap_at(&editor.buffer, position) & 0xc0) == 0x80)
+    {
+        position++;
+    }
+    return position;
+}
+
+static size_t previous_word(size_t position)
+{
+    while (position > 0 && gap_at(&editor.buffer, position - 1) == ' ')
+    {
+        position--;
+    }
+    while (position > 0 && gap_at(&editor.buffer, position - 1) != ' ')
+    {
+        position--;
+    }
+    return position;
+}
+
+static size_t next_word(size_t position)
+{
+    size_t length = gap_length(&editor.buffer);
+    while (position < length && gap_at(&editor.buffer, position) == ' ')
+    {
+        position++;
+    }
+    while (position < length && gap_at(&editor.buffer, position) != ' ')
+    {
+        position++;
+    }
+    return position;
+}
+
+/**
+ * @brief Shows an older (-1) or newer (+1) history entry in place of the line.
+ */
+static void browse_history(int direction)
+{
+    if (hooks.history_count == NULL || hooks.history_get == NULL)
+    {
+        output_string("\a");
+        return;
+    }
+    int count = hooks.history_count();
+    if (editor.history_number == 0)
+    {
+        if (direction > 0 || count == 0)
+        {
+            output_string("\a");
+            return;
+        }
+        // The line being typed comes back after the newest entry
+        line_text();
+        free(editor.saved_line);
+        editor.saved_line = strdup(editor.text);
+        editor.history_number = count + 1;
+    }
+
+    int number = editor.history_number + direction;
+    if (number < 1)
+    {
+        output_string("\a");
+        return;
+    }
+    editor.history_number = number;
+    if (number > count)
+    {
+        set_line(editor.saved_line != NULL ? editor.saved_line : "");
+        editor.history_number = 0;
+    }
+    else
+    {
+        char* entry = malloc(editor.max_length + 1);
+        if (entry != NULL && hooks.history_get(number, entry, editor.max_length + 1) >= 0)
+        {
+            set_line(entry);
+        }
+        free(entry);
+    }
+    refresh();
+}
+
+/**
+ * @brief Searches the history backwards as the query is typed (Ctrl-R).
+ *
+ * @param pending_key Where a key that ends the search and must still be handled is stored.
+ * @return 1 to run the match, 0 to keep editing it, -1 if the search was cancelled.
+ */
+static int reverse_search(int* pending_key)
+{
+    if (hooks.history_search == NULL || hooks.history_get == NULL)
+    {
+        output_string("\a");
+        return 0;
+    }
+
+    char original_prompt[EDITOR_MAX_PROMPT];
+    snprintf(original_prompt, sizeof(original_prompt), "%s", editor.display.prompt);
+    line_text();
+    char* original_line = strdup(editor.text);
+    char* match = calloc(1, editor.max_length + 1);
+    char query[128] = "";
+    size_t query_length = 0;
+    int number = 0;
+    int failed = 0;
+    int result = -2;
+
+    while (result == -2)
+    {
+        char prompt[EDITOR_MAX_PROMPT];
+        snprintf(prompt, sizeof(prompt), "(%sreverse-i-search)`%s': ", failed ? "failed " : "", query);
+        const char* shown = number > 0 ? match : original_line != NULL ? original_line : "";
+        size_t shown_length = strlen(shown);
+        char* found = query_length > 0 ? strstr(shown, query) : NULL;
+        display_full(&editor.display, prompt, shown, shown_length, found != NULL ? (size_t)(found - shown) : 0, 0);
+        output_flush();
+
+        int key = read_key();
+        int from = number;
+        if (key == KEY_CTRL_R)
+        {
+            from = number > 0 ? number : 0;
+        }
+        else if ((key == KEY_BACKSPACE || key == KEY_BACKSPACE_CTRL_H) && query_length > 0)
+        {
+            query[--query_length] = '\0';
+            from = 0;
+        }
+        else if (key >= ' ' && key < KEY_BACKSPACE && query_length + 1 < sizeof(query))
+        {
+            query[query_length++] = (char)key;
+            query[query_length] = '\0';
+            // The current match still counts while the query grows
+            from = number > 0 ? number + 1 : 0;
+        }
+        else if (key == KEY_CTRL_G || key == KEY_CTRL_C || key == KEY_END_OF_INPUT)
+        {
+            result = -1;
+            break;
+        }
+        else
+        {
+            result = key == KEY_ENTER || key == '\n' ? 1 : 0;
+            *pending_key = result == 0 ? key : KEY_NONE;
+            break;
+        }
+
+        int next = query_length > 0 ? hooks.history_search(query, from) : 0;
+        failed = query_length > 0 && next == 0;
+        if (next > 0)
+        {
+            number = next;
+            hooks.history_get(number, match, editor.max_length + 1);
+        }
+        else if (query_length == 0)
+        {
+            number = 0;
+        }
+    }
+
+    set_line(result == -1 || number == 0 ? (original_line != NULL ? original_line : "") : match);
+    redraw(original_prompt, 0);
+    free(original_line);
+    free(match);
+    return result;
+}
+
+/**
+ * @brief Prints one completion candidate.
+ */
+static void list_candidate(const char* name, void* data)
+{
+    (void)data;
+    printf("%s  ", name);
+}
+
+/**
+ * @brief Completes the command name before the cursor.
+ *
+ * @param list 1 to list the candidates when the name cannot be extended.
+ */
+static void complete(int list)
+{
+    size_t length = line_text();
+    size_t word_start = editor.cursor;
+    while (word_start > 0 && strchr(" |;&", editor.text[word_start - 1]) == NULL)
+    {
+        word_start--;
+    }
+    size_t before = word_start;
+    while (before > 0 && editor.text[before - 1] == ' ')
+    {
+        before--;
+    }
+    int command_position = before == 0 || strchr("|;&", editor.text[before - 1]) != NULL;
+    if (!command_position || hooks.complete == NULL)
+    {
+        output_string("\a");
+        return;
+    }
+
+    char word[256];
+    char common[256];
+    snprintf(word, sizeof(word), "%.*s", (int)(editor.cursor - word_start), editor.text + word_start);
+    int matches = hooks.complete(word, common, sizeof(common));
+    size_t extension = strlen(common) - strlen(word);
+    if (matches == 1 && strlen(common) + 1 < sizeof(common))
+    {
+        strcat(common, " ");
+        extension++;
+    }
+    if (matches == 0 || (extension == 0 && !list) || length + extension > editor.max_length)
+    {
+        output_string("\a");
+        return;
+    }
+    if (extension > 0)
+    {
+        gap_insert(&editor.buffer, editor.cursor, common + strlen(word), extension);
+        editor.cursor += extension;
+        refresh();
+        return;
+    }
+    if (hooks.list_completions == NULL)
+    {
+        return;
+    }
+
+    // The candidates go below the line, which is drawn again after them
+    size_t end = cell_of(&editor.display, editor.display.shown, editor.display.shown_length);
+    move_cursor(&editor.display, cell_of(&editor.display, editor.display.shown, editor.display.cursor), end);
+    settle(&editor.display, end);
+    output_string("\r\n");
+    output_flush();
+    hooks.list_completions(word, EDITOR_MAX_LISTED, list_candidate, NULL);
+    if (matches > EDITOR_MAX_LISTED)
+    {
+        printf("(%d more)", matches - EDITOR_MAX_LISTED);
+    }
+    printf("\r\n");
+    fflush(stdout);
+    redraw(editor.display.prompt, 1);
+}
+
+/**
+ * @brief Moves the cursor to the end of the line and starts a new row.
+ */
+static void finish_line(void)
+{
+    size_t end = cell_of(&editor.display, editor.display.shown, editor.display.shown_length);
+    move_cursor(&editor.display, cell_of(&editor.display, editor.display.shown, editor.display.cursor), end);
+    settle(&editor.display, end);
+    if (end % editor.display.columns != 0 || end == 0)
+    {
+        output_string("\r\n");
+    }
+}
+
+/**
+ * @brief Reads a line without a terminal, with getline.
+ *
+ * getline consumes the whole input line even when it is longer than the
+ * buffer, so a long line is cut instead of being run in pieces.
+ */
+static int read_plain_line(const char* prompt, char* line, size_t size)
+{
+    fputs(prompt, stdout);
+    fflush(stdout);
+    // Jobs finishing while the input is pending are reported and the prompt is shown again
+    while (supervisor_wait_readable(STDIN_FILENO) == 0)
+    {
+        fputs(prompt, stdout);
+        fflush(stdout);
+    }
+
+    char* input = NULL;
+    size_t capacity = 0;
+    ssize_t length = getline(&input, &capacity, stdin);
+    if (length == -1)
+    {
+        free(input);
+        return -1;
+    }
+    input[strcspn(input, "\n")] = '\0';
+    snprintf(line, size, "%s", input);
+    free(input);
+    return (int)strlen(line);
+}
+
+/**
+ * @brief Reads a command line, editing it in raw mode on a terminal.
+ *
+ * The terminal is only in raw mode while the line is typed, commands always
+ * run with the modes the shell found.
+ *
+ * @param prompt The prompt shown before the line.
+ * @param line Where the line is stored.
+ * @param size The size of the line buffer.
+ * @return The length of the line, or -1 at the end of the input.
+ */
+int editor_read_line(const char* prompt, char* line, size_t size)
+{
+    struct termios original;
+    fflush(stdout);
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &original) == -1)
+    {
+        return read_plain_line(prompt, line, size);
+    }
+
+    struct termios raw = original;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+
+    struct winsize window;
+    editor.display.columns =
+        ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0 && window.ws_col > 0 ? window.ws_col : 80;
+
+    // Lines continued with a backslash are collected here
+    size_t collected = 0;
+    line[0] = '\0';
+
+    gap_clear(&editor.buffer);
+    editor.cursor = 0;
+    editor.max_length = size - 1;
+    editor.history_number = 0;
+    editor.display.shown_length = 0;
+    editor.display.cursor = 0;
+    redraw(prompt, 1);
+    output_flush();
+
+    int previous_key = 0;
+    int result = -2;
+    int pending_key = KEY_NONE;
+    while (result == -2)
+    {
+        int key = pending_key != KEY_NONE ? pending_key : read_key();
+        pending_key = KEY_NONE;
+        size_t length = gap_length(&editor.buffer);
+        switch (key)
+        {
+        case KEY_END_OF_INPUT:
+            result = -1;
+            break;
+        case KEY_ENTER:
+        case '\n':
+            finish_line();
+            line_text();
+            if (length > 0 && editor.text[length - 1] == '\\' && collected + length - 1 < size - 1)
+            {
+                // Continue the command on the next row
+                memcpy(line + collected, editor.text, length - 1);
+                collected += length - 1;
+                line[collected] = '\0';
+                gap_clear(&editor.buffer);
+                editor.cursor = 0;
+                editor.max_length = size - 1 - collected;
+                editor.display.shown_length = 0;
+                editor.display.cursor = 0;
+                redraw(CONTINUATION_PROMPT, 1);
+                break;
+            }
+            memcpy(line + collected, editor.text, length);
+            collected += length;
+            line[collected] = '\0';
+            result = (int)collected;
+            break;
+        case KEY_CTRL_C:
+            output_string("^C");
+            finish_line();
+            line[0] = '\0';
+            result = 0;
+            break;
+        case KEY_CTRL_D:
+            if (length == 0 && collected == 0)
+            {
+                result = -1;
+                break;
+            }
+            // fall through
+        case KEY_DELETE:
+            if (editor.cursor < length)
+            {
+                gap_delete(&editor.buffer, editor.cursor, next_character(editor.cursor));
+                refresh();
+            }
+            break;
+        case KEY_BACKSPACE:
+        case KEY_BACKSPACE_CTRL_H:
+            if (editor.cursor > 0)
+            {
+                size_t start = previous_character(editor.cursor);
+                gap_delete(&editor.buffer, start, editor.cursor);
+                editor.cursor = start;
+                refresh();
+            }
+            break;
+        case KEY_LEFT:
+        case KEY_CTRL_B:
+            editor.cursor = previous_character(editor.cursor);
+            refresh();
+            break;
+        case KEY_RIGHT:
+        case KEY_CTRL_F:
+            editor.cursor = next_character(editor.cursor);
+            refresh();
+            break;
+        case KEY_WORD_LEFT:
+            editor.cursor = previous_word(editor.cursor);
+            refresh();
+            break;
+        case KEY_WORD_RIGHT:
+            editor.cursor = next_word(editor.cursor);
+            refresh();
+            break;
+        case KEY_HOME:
+        case KEY_CTRL_A:
+            editor.cursor = 0;
+            refresh();
+            break;
+        case KEY_END:
+        case KEY_CTRL_E:
+            editor.cursor = length;
+            refresh();
+            break;
+        case KEY_CTRL_K:
+            gap_delete(&editor.buffer, editor.cursor, length);
+            refresh();
+            break;
+        case KEY_CTRL_U:
+            gap_delete(&editor.buffer, 0, editor.cursor);
+            editor.cursor = 0;
+            refresh();
+            break;
+        case KEY_CTRL_W:
+        {
+            size_t start = previous_word(editor.cursor);
+            gap_delete(&editor.buffer, start, editor.cursor);
+            editor.cursor = start;
+            refresh();
+            break;
+        }
+        case KEY_CTRL_L:
+            editor.display.columns =
+                ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0 && window.ws_col > 0 ? window.ws_col : 80;
+            output_string("\033[H\033[2J");
+            redraw(editor.display.prompt, 1);
+            break;
+        case KEY_UP:
+        case KEY_CTRL_P:
+            browse_history(-1);
+            break;
+        case KEY_DOWN:
+        case KEY_CTRL_N:
+            browse_history(1);
+            break;
+        case KEY_CTRL_R:
+        {
+            int found = reverse_search(&pending_key);
+            if (found == 1)
+            {
+                pending_key = KEY_ENTER;
+            }
+            break;
+        }
+        case KEY_TAB:
+            complete(previous_key == KEY_TAB);
+            break;
+        default:
+            if (key >= ' ' && key < KEY_BACKSPACE)
+            {
+                if (length < editor.max_length)
+                {
+                    char byte = (char)key;
+                    gap_insert(&editor.buffer, editor.cursor, &byte, 1);
+                    editor.cursor++;
+                    refresh();
+                }
+                else
+                {
+                    output_string("\a");
+                }
+            }
+            else if (key >= 0x80 && key <= 0xff && length < editor.max_length)
+            {
+                // UTF-8 bytes are inserted as they come, the cursor skips continuation bytes
+                char byte = (char)key;
+                gap_insert(&editor.buffer, editor.cursor, &byte, 1);
+                editor.cursor++;
+                if ((key & 0xc0) != 0xc0)
+                {
+                    refresh();
+                }
+            }
+            break;
+        }
+        output_flush();
+        previous_key = key;
+    }
+
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &original);
+    free(editor.saved_line);
+    editor.saved_line = NULL;
+    return result;
+}
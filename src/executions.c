@@ -1,10 +1,12 @@
 #include "../include/executions.h"
 #include "../include/colors.h"
+#include "../include/jobs.h"
+#include "../include/launcher.h"
+#include "../include/supervisor.h"
 
-// Global variable for the job id
-static int job_id = 1;
-static int size_internal_commands = 7;
 pid_t foreground_pid = 0;
+volatile sig_atomic_t interrupt_received = 0;
+int last_exit_status = 0;
 
 // Function declarations
 void execute_command(char* command);
@@ -26,30 +28,61 @@ void execute_command(char* command)
         return; // Empty command
     }
 
-    char* arg = strtok(NULL, " ");
+    // The rest of the line is the argument of internal commands
+    char* rest = strtok(NULL, "");
+    char* arg = rest;
+    while (arg != NULL && *arg == ' ')
+    {
+        arg++;
+    }
+    if (arg != NULL && *arg == '\0')
+    {
+        arg = NULL;
+    }
 
     // Check if the command is an internal command
-    for (int i = 0; i < size_internal_commands; i++)
+    Command* internal = find_internal_command(command_name);
+    if (internal != NULL)
     {
-        if (strcmp(command_name, internals_commands[i].name) == 0)
-        {
-            internals_commands[i].func(arg);
-            return;
-        }
+        internal->func(arg);
+        return;
     }
 
-    external_command(command);
+    // Restore the separator removed by strtok so the program keeps its arguments
+    if (rest != NULL)
+    {
+        command_name[strlen(command_name)] = ' ';
+    }
+    external_command(command_name);
+}
 
-    printf("Command not found: %s\n", command_name);
-    return;
+/**
+ * @brief Checks whether a pipeline stage starts with an internal command.
+ *
+ * @param stage The stage command string.
+ * @return 1 if the first word names an internal command, 0 otherwise.
+ */
+static int stage_is_internal(const char* stage)
+{
+    char name[64];
+    stage += strspn(stage, " ");
+    size_t length = strcspn(stage, " ");
+    if (length == 0 || length >= sizeof(name))
+    {
+        return 0;
+    }
+    memcpy(name, stage, length);
+    name[length] = '\0';
+    return find_internal_command(name) != NULL;
 }
 
 /**
  * @brief Executes a command in the background.
  *
- * Detects an '&' and runs the command in a child process. Its output is
- * redirected to a temporary file, and the parent prints the job ID and PID.
- * After the child finishes, the parent prints the contents of the file.
+ * Detects an '&' and runs the command in a child process with its own process
+ * group. Its output is redirected to a temporary file, and the parent prints
+ * the job ID and PID. The job is handed to the supervision loop, which prints
+ * the contents of the file once it finishes.
  *
  * @param command The command string to be executed.
  */
@@ -57,78 +90,91 @@ void execute_command_secondplane(char* command)
 {
     command[strlen(command) - 1] = '\0';
 
+    Job* job = job_create(command, 1);
+    if (job == NULL)
+    {
+        fprintf(stderr, "Too many jobs\n");
+        return;
+    }
+    strcpy(job->output_path, "/tmp/command_output_XXXXXX");
+    int output_fd = mkstemp(job->output_path);
+    if (output_fd == -1)
+    {
+        perror("mkstemp");
+        job->output_path[0] = '\0';
+        job_wait(job);
+        return;
+    }
+
+    fflush(stdout);
     pid_t pid = fork();
 
     if (pid == 0)
     { // Child process
-        int original_stdin = dup(STDIN_FILENO);
-        int original_stdout = dup(STDOUT_FILENO);
-        int original_stderr = dup(STDERR_FILENO);
-
-        if (freopen("/tmp/command_output.txt", "w", stdout) == NULL)
-        {
-            perror("freopen failed");
-        }
-        if (freopen("/tmp/command_output.txt", "w", stderr) == NULL)
-        {
-            perror("freopen failed");
-        }
+        job_setup_child(job);
+        dup2(output_fd, STDOUT_FILENO);
+        dup2(output_fd, STDERR_FILENO);
+        close(output_fd);
 
         execute_command(command);
 
-        restore_io(original_stdin, original_stdout, original_stderr);
-
-        close(original_stdin);
-        close(original_stdout);
-        close(original_stderr);
-
-        exit(0);
+        // _exit keeps the inherited batch file offset untouched for the parent
+        fflush(stdout);
+        _exit(0);
     }
-    else if (pid > 0)
-    { // Parent process
-        set_foreground_pid(pid);
+    close(output_fd);
 
-        printf(COLOR_YELLOW "[%d] %d" COLOR_RESET "\n", job_id++, pid);
-
-        int status;
-        waitpid(pid, &status, 0);
-
-        FILE* file = fopen("/tmp/command_output.txt", "r");
-        if (file != NULL)
-        {
-            char line[256];
-            while (fgets(line, sizeof(line), file) != NULL)
-            {
-                printf("%s", line);
-            }
-            fclose(file);
-        }
+    if (pid > 0)
+    { // Parent process
+        printf(COLOR_YELLOW "[%d] %d" COLOR_RESET "\n", job->id, pid);
+        job_add_process(job, pid);
     }
     else
     { // If pid is -1
         perror("fork");
+        unlink(job->output_path);
+        job->output_path[0] = '\0';
+        job_wait(job);
     }
-    set_foreground_pid(0);
 }
 
 /**
  * @brief Executes chained commands using pipes.
  *
  * Separates commands by the '|' character, creates a pipe for each pair,
- * and redirects the output of one command to the input of the next.
+ * and redirects the output of one command to the input of the next. Every
+ * stage joins the process group of the job, which owns the terminal until
+ * the whole pipeline ends or is stopped.
  *
  * @param command The full command string with pipes.
  */
 void execute_piped_commands(char* command)
 {
-    char* commands[20];
+    // The whole pipeline is one job with its own process group
+    Job* job = job_create(command, 0);
+
+    char* commands[JOB_MAX_PROCESSES + 1];
     int num_commands = 0;
     char* command_n = strtok(command, "|");
-    while (command_n != NULL)
+    while (command_n != NULL && num_commands <= JOB_MAX_PROCESSES)
     {
         commands[num_commands++] = command_n;
         command_n = strtok(NULL, "|");
     }
+    // Refused before forking, every stage has to belong to the job
+    if (num_commands > JOB_MAX_PROCESSES || !job_has_room(job, num_commands))
+    {
+        fprintf(stderr, "Too many commands in the pipeline, at most %d\n", JOB_MAX_PROCESSES);
+        num_commands = 0;
+    }
+    if (num_commands == 0)
+    {
+        if (job != NULL)
+        {
+            job_wait(job);
+        }
+        return;
+    }
 
     int* filedes = malloc(2 * (num_commands - 1) * sizeof(int));
     for (int j = 0; j < num_commands - 1; j++)
@@ -140,12 +186,15 @@ void execute_piped_commands(char* command)
         }
     }
 
+    fflush(stdout);
+    pid_t pids[JOB_MAX_PROCESSES];
     int j = 0;
     for (int i = 0; i < num_commands; i++)
     {
-        pid_t pid = fork();
+        pid_t pid = pids[i] = fork();
         if (pid == 0)
         {
+            job_setup_child(job);
             if (i < num_commands - 1)
             {
                 if (dup2(filedes[j + 1], STDOUT_FILENO) < 0)
@@ -167,25 +216,40 @@ void execute_piped_commands(char* command)
                 close(filedes[k]);
             }
 
-            char* arguments[10];
-            char* cmd_token = strtok(commands[i], " ");
-            int arg_count = 0;
-            while (cmd_token != NULL)
+            // Internal commands run inside the stage process itself
+            if (stage_is_internal(commands[i]))
+            {
+                execute_command(commands[i]);
+                fflush(stdout);
+                _exit(0);
+            }
+
+            // Limits and placement of the command line apply to every stage
+            LaunchOptions options;
+            launch_options_init(&options);
+            options.stage = i;
+            if (launch_setup_child(&options) == -1)
             {
-                arguments[arg_count++] = cmd_token;
-                cmd_token = strtok(NULL, " ");
+                perror("launch");
+                _exit(EXIT_FAILURE);
             }
-            arguments[arg_count] = NULL;
+
+            char* arguments[LAUNCH_MAX_ARGS + 1];
+            split_arguments(commands[i], arguments, LAUNCH_MAX_ARGS);
 
             execvp(arguments[0], arguments);
             perror("execvp");
-            exit(EXIT_FAILURE);
+            _exit(EXIT_FAILURE);
         }
         else if (pid < 0)
         {
             perror("fork");
             exit(EXIT_FAILURE);
         }
+        if (job != NULL)
+        {
+            job_add_process(job, pid);
+        }
         j += 2;
     }
 
@@ -193,10 +257,20 @@ void execute_piped_commands(char* command)
     {
         close(filedes[i]);
     }
-    for (int i = 0; i < num_commands; i++)
+    if (job != NULL)
     {
-        wait(NULL);
+        job_wait(job);
     }
+    else
+    {
+        int status = 0;
+        for (int i = 0; i < num_commands; i++)
+        {
+            supervisor_wait(pids[i], &status);
+        }
+        last_exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    free(filedes);
 }
 
 /**
@@ -245,6 +319,8 @@ void execute_command_redirection(char* command)
     }
     args[arg_count] = NULL;
 
+    // Output the shell buffered so far belongs to the terminal, not to the file
+    fflush(stdout);
     int original_stdin = dup(STDIN_FILENO);
     int original_stdout = dup(STDOUT_FILENO);
     int original_stderr = dup(STDERR_FILENO);
@@ -274,7 +350,22 @@ void execute_command_redirection(char* command)
         close(output_fd);
     }
 
-    execute_command(program);
+    // Rebuild the command line without the redirections
+    char command_line[1024] = "";
+    for (int i = 0; i < arg_count; i++)
+    {
+        if (i > 0)
+        {
+            strncat(command_line, " ", sizeof(command_line) - strlen(command_line) - 1);
+        }
+        strncat(command_line, args[i], sizeof(command_line) - strlen(command_line) - 1);
+    }
+
+    if (program != NULL)
+    {
+        execute_command(command_line);
+    }
+    fflush(stdout);
     restore_io(original_stdin, original_stdout, original_stderr);
     close(original_stdin);
     close(original_stdout);
@@ -298,12 +389,21 @@ void restore_io(int original_stdin, int original_stdout, int original_stderr)
 /**
  * @brief Signal handler function.
  *
- * If an interrupt signal is received, it sends the signal to the foreground process.
+ * If an interrupt signal is received, it sends the signal to the process group
+ * of the foreground job, or to the foreground process outside of jobs.
  *
  * @param signo The signal number being handled.
  */
 void signal_handler(int signo)
 {
+    if (signo == SIGINT)
+    {
+        interrupt_received = 1;
+    }
+    if (job_forward_signal(signo))
+    {
+        return;
+    }
     if (foreground_pid > 0)
     {
         kill(foreground_pid, signo);
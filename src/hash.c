@@ -0,0 +1,177 @@
+#include "../include/hash.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotate_left(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * @brief Reads 8 bytes as a little-endian word, at any alignment.
+ */
+static inline uint64_t read64(const unsigned char* bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+/**
+ * @brief Reads 4 bytes as a little-endian word, at any alignment.
+ */
+static inline uint32_t read32(const unsigned char* bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+/**
+ * @brief Mixes one word of input into a lane.
+ */
+static inline uint64_t lane_round(uint64_t lane, uint64_t input)
+{
+    lane += input * PRIME64_2;
+    lane = rotate_left(lane, 31);
+    return lane * PRIME64_1;
+}
+
+/**
+ * @brief Folds a finished lane into the hash.
+ */
+static inline uint64_t merge_lane(uint64_t hash, uint64_t lane)
+{
+    hash ^= lane_round(0, lane);
+    return hash * PRIME64_1 + PRIME64_4;
+}
+
+/**
+ * @brief Hashes a block of memory with XXH64.
+ *
+ * Blocks of 32 bytes go through four lanes, the remaining bytes are mixed in
+ * by 8, 4 and 1 bytes and a final avalanche spreads every input bit over the
+ * whole result.
+ *
+ * @param data The bytes to hash.
+ * @param length The number of bytes.
+ * @param seed The seed of the hash.
+ * @return The 64-bit hash.
+ */
+uint64_t hash64(const void* data, size_t length, uint64_t seed)
+{
+    const unsigned char* bytes = data;
+    const unsigned char* end = bytes + length;
+    uint64_t hash;
+
+    if (length >= 32)
+    {
+        uint64_t lanes[4] = {seed + PRIME64_1 + PRIME64_2, seed + PRIME64_2, seed, seed - PRIME64_1};
+        const unsigned char* limit = end - 32;
+        do
+        {
+            lanes[0] = lane_round(lanes[0], read64(bytes));
+            lanes[1] = lane_round(lanes[1], read64(bytes + 8));
+            lanes[2] = lane_round(lanes[2], read64(bytes + 16));
+            lanes[3] = lane_round(lanes[3], read64(bytes + 24));
+            bytes += 32;
+        } while (bytes <= limit);
+
+        hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) +
+               rotate_left(lanes[3], 18);
+        for (int i = 0; i < 4; i++)
+        {
+            hash = merge_lane(hash, lanes[i]);
+        }
+    }
+    else
+    {
+        hash = seed + PRIME64_5;
+    }
+
+    hash += (uint64_t)length;
+    while (bytes + 8 <= end)
+    {
+        hash ^= lane_round(0, read64(bytes));
+        hash = rotate_left(hash, 27) * PRIME64_1 + PRIME64_4;
+        bytes += 8;
+    }
+    if (bytes + 4 <= end)
+    {
+        hash ^= (uint64_t)read32(bytes) * PRIME64_1;
+        hash = rotate_left(hash, 23) * PRIME64_2 + PRIME64_3;
+        bytes += 4;
+    }
+    while (bytes < end)
+    {
+        hash ^= (uint64_t)*bytes * PRIME64_5;
+        hash = rotate_left(hash, 11) * PRIME64_1;
+        bytes++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * @brief Hashes the content of a file with XXH64.
+ *
+ * The file is mapped read-only and hashed in one pass, so its pages go
+ * straight from the page cache to the hash without a copy.
+ *
+ * @param path The file to hash.
+ * @param hash Where the hash is stored.
+ * @return 0 on success, -1 if the file cannot be opened or mapped.
+ */
+int hash_file(const char* path, uint64_t* hash)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1 || !S_ISREG(info.st_mode))
+    {
+        close(fd);
+        return -1;
+    }
+    if (info.st_size == 0)
+    {
+        close(fd);
+        *hash = hash64("", 0, 0);
+        return 0;
+    }
+
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return -1;
+    }
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+    *hash = hash64(data, (size_t)info.st_size, 0);
+    munmap(data, (size_t)info.st_size);
+    return 0;
+}
@@ -0,0 +1,597 @@
+#define _GNU_SOURCE
+#include "../include/history.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Commands of the index that contain one trigram, in ascending order.
+ */
+typedef struct
+{
+    uint32_t* items;
+    uint32_t count;
+    uint32_t capacity;
+} PostingList;
+
+/**
+ * @brief Slot of the open addressing trigram table, key 0 marks a free slot.
+ */
+typedef struct
+{
+    uint32_t key;
+    PostingList list;
+} TrigramSlot;
+
+/**
+ * @brief Position of a command inside the mapped file.
+ */
+typedef struct
+{
+    size_t offset;
+    uint32_t length;
+} HistoryEntry;
+
+static struct
+{
+    int fd;
+
+    /** @brief Read only shared mapping of the file */
+    char* map;
+    size_t map_size;
+
+    /** @brief Bytes of the file already indexed, always the end of a complete line */
+    size_t indexed;
+
+    HistoryEntry* entries;
+    int count;
+    int capacity;
+
+    TrigramSlot* trigrams;
+    size_t trigram_capacity;
+    size_t trigram_used;
+} history = {.fd = -1};
+
+/**
+ * @brief Packs three bytes into a non zero trigram key.
+ */
+static uint32_t trigram_key(const char* text)
+{
+    const unsigned char* bytes = (const unsigned char*)text;
+    return 0x1000000u | ((uint32_t)bytes[0] << 16) | ((uint32_t)bytes[1] << 8) | bytes[2];
+}
+
+/**
+ * @brief Returns the slot of a key in a trigram table, either the one holding it or a free one.
+ */
+static TrigramSlot* trigram_slot(TrigramSlot* table, size_t capacity, uint32_t key)
+{
+    size_t index = (key * 2654435761u) & (capacity - 1);
+    while (table[index].key != 0 && table[index].key != key)
+    {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &table[index];
+}
+
+/**
+ * @brief Doubles the trigram table, which is kept at most half full.
+ */
+static int trigram_grow(void)
+{
+    size_t capacity = history.trigram_capacity == 0 ? 4096 : history.trigram_capacity * 2;
+    TrigramSlot* table = calloc(capacity, sizeof(TrigramSlot));
+    if (table == NULL)
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < history.trigram_capacity; i++)
+    {
+        if (history.trigrams[i].key != 0)
+        {
+            *trigram_slot(table, capacity, history.trigrams[i].key) = history.trigrams[i];
+        }
+    }
+    free(history.trigrams);
+    history.trigrams = table;
+    history.trigram_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Returns the posting list of a trigram, NULL if no command contains it.
+ */
+static const PostingList* trigram_find(const char* text)
+{
+    if (history.trigram_capacity == 0)
+    {
+        return NULL;
+    }
+    TrigramSlot* slot = trigram_slot(history.trigrams, history.trigram_capacity, trigram_key(text));
+    return slot->key != 0 ? &slot->list : NULL;
+}
+
+/**
+ * @brief Adds every trigram of a command to the index.
+ */
+static int index_command(uint32_t number, const char* text, size_t length)
+{
+    for (size_t i = 0; i + 3 <= length; i++)
+    {
+        if (2 * (history.trigram_used + 1) > history.trigram_capacity && trigram_grow() == -1)
+        {
+            return -1;
+        }
+        uint32_t key = trigram_key(text + i);
+        TrigramSlot* slot = trigram_slot(history.trigrams, history.trigram_capacity, key);
+        if (slot->key == 0)
+        {
+            slot->key = key;
+            history.trigram_used++;
+        }
+
+        // A trigram that repeats in the same command is stored once
+        PostingList* list = &slot->list;
+        if (list->count > 0 && list->items[list->count - 1] == number)
+        {
+            continue;
+        }
+        if (list->count == list->capacity)
+        {
+            uint32_t capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+            uint32_t* items = realloc(list->items, capacity * sizeof(uint32_t));
+            if (items == NULL)
+            {
+                return -1;
+            }
+            list->items = items;
+            list->capacity = capacity;
+        }
+        list->items[list->count++] = number;
+    }
+    return 0;
+}
+
+/**
+ * @brief Drops the index, used when the file shrinks under the shell.
+ */
+static void reset_index(void)
+{
+    for (size_t i = 0; i < history.trigram_capacity; i++)
+    {
+        free(history.trigrams[i].list.items);
+    }
+    free(history.trigrams);
+    history.trigrams = NULL;
+    history.trigram_capacity = 0;
+    history.trigram_used = 0;
+    history.count = 0;
+    history.indexed = 0;
+}
+
+/**
+ * @brief Maps the new part of the file and indexes the complete lines it holds.
+ *
+ * Other shells append to the same file, so this runs before every lookup. A
+ * line is only indexed once its newline is there, which skips a record that
+ * is still being written.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int history_sync(void)
+{
+    if (history.fd == -1)
+    {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(history.fd, &info) == -1)
+    {
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    if (size < history.indexed)
+    {
+        reset_index();
+    }
+    if (size == history.indexed)
+    {
+        return 0;
+    }
+
+    if (size > history.map_size)
+    {
+        char* map = history.map == NULL ? mmap(NULL, size, PROT_READ, MAP_SHARED, history.fd, 0)
+                                        : mremap(history.map, history.map_size, size, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED)
+        {
+            return -1;
+        }
+        history.map = map;
+        history.map_size = size;
+    }
+
+    size_t start = history.indexed;
+    while (start < size)
+    {
+        const char* newline = memchr(history.map + start, '\n', size - start);
+        if (newline == NULL)
+        {
+            break;
+        }
+        size_t length = (size_t)(newline - (history.map + start));
+        if (length > 0)
+        {
+            if (history.count == history.capacity)
+            {
+                int capacity = history.capacity == 0 ? 1024 : history.capacity * 2;
+                HistoryEntry* entries = realloc(history.entries, capacity * sizeof(HistoryEntry));
+                if (entries == NULL)
+                {
+                    return -1;
+                }
+                history.entries = entries;
+                history.capacity = capacity;
+            }
+            history.entries[history.count].offset = start;
+            history.entries[history.count].length = (uint32_t)length;
+            if (index_command((uint32_t)history.count, history.map + start, length) == -1)
+            {
+                return -1;
+            }
+            history.count++;
+        }
+        start += length + 1;
+        history.indexed = start;
+    }
+    return 0;
+}
+
+/**
+ * @brief Opens the shared history file and builds the index.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int history_init(void)
+{
+    if (history.fd != -1)
+    {
+        return 0;
+    }
+
+    char path[PATH_MAX];
+    const char* configured = getenv("SURVSHELL_HISTFILE");
+    const char* home = getenv("HOME");
+    if (configured != NULL && configured[0] != '\0')
+    {
+        snprintf(path, sizeof(path), "%s", configured);
+    }
+    else if (home != NULL)
+    {
+        snprintf(path, sizeof(path), "%s/.survshell_history", home);
+    }
+    else
+    {
+        return -1;
+    }
+
+    history.fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (history.fd == -1)
+    {
+        return -1;
+    }
+    return history_sync();
+}
+
+/**
+ * @brief Unmaps the file and frees the index.
+ */
+void history_close(void)
+{
+    if (history.fd == -1)
+    {
+        return;
+    }
+    reset_index();
+    if (history.map != NULL)
+    {
+        munmap(history.map, history.map_size);
+    }
+    free(history.entries);
+    close(history.fd);
+    history.fd = -1;
+    history.map = NULL;
+    history.map_size = 0;
+    history.entries = NULL;
+    history.capacity = 0;
+}
+
+/**
+ * @brief Appends a command as one record.
+ *
+ * The record goes out in a single O_APPEND write under an exclusive lock, so
+ * records of concurrent shells never interleave.
+ *
+ * @param command The command line.
+ * @return 0 on success, -1 on error.
+ */
+int history_add(const char* command)
+{
+    if (history.fd == -1 || command == NULL)
+    {
+        return -1;
+    }
+
+    char record[HISTORY_MAX_LINE + 1];
+    size_t length = strcspn(command, "\n");
+    if (length > HISTORY_MAX_LINE - 1)
+    {
+        length = HISTORY_MAX_LINE - 1;
+    }
+    if (strspn(command, " \t") >= length)
+    {
+        return 0;
+    }
+    memcpy(record, command, length);
+    record[length++] = '\n';
+
+    if (flock(history.fd, LOCK_EX) == -1)
+    {
+        return -1;
+    }
+    ssize_t written = write(history.fd, record, length);
+    flock(history.fd, LOCK_UN);
+    if (written != (ssize_t)length)
+    {
+        return -1;
+    }
+    return history_sync();
+}
+
+/**
+ * @brief Returns the number of commands, synchronizing with the file first.
+ */
+int history_count(void)
+{
+    history_sync();
+    return history.count;
+}
+
+/**
+ * @brief Copies the command with the given number.
+ *
+ * @return The length of the command, or -1 if it does not exist.
+ */
+int history_get(int number, char* buffer, size_t size)
+{
+    history_sync();
+    if (number < 1 || number > history.count || size == 0)
+    {
+        return -1;
+    }
+    const HistoryEntry* entry = &history.entries[number - 1];
+    size_t length = entry->length < size - 1 ? entry->length : size - 1;
+    memcpy(buffer, history.map + entry->offset, length);
+    buffer[length] = '\0';
+    return (int)length;
+}
+
+/**
+ * @brief Checks whether the command with the given index contains a text.
+ */
+static int entry_contains(int index, const char* text, size_t length)
+{
+    const HistoryEntry* entry = &history.entries[index];
+    return memmem(history.map + entry->offset, entry->length, text, length) != NULL;
+}
+
+/**
+ * @brief Finds the most recent command below a number that contains a text.
+ *
+ * The candidates come from the shortest posting list among the trigrams of
+ * the text and are confirmed with memmem, newest first.
+ *
+ * @param text The text to look for.
+ * @param before Only commands numbered below it are considered, 0 for all.
+ * @return The number of the command, or 0 if none matches.
+ */
+int history_search(const char* text, int before)
+{
+    history_sync();
+    size_t length = strlen(text);
+    int limit = before > 0 && before <= history.count ? before - 1 : history.count;
+
+    if (length < 3)
+    {
+        for (int index = limit - 1; index >= 0; index--)
+        {
+            if (entry_contains(index, text, length))
+            {
+                return index + 1;
+            }
+        }
+        return 0;
+    }
+
+    const PostingList* shortest = NULL;
+    for (size_t i = 0; i + 3 <= length; i++)
+    {
+        const PostingList* list = trigram_find(text + i);
+        if (list == NULL)
+        {
+            return 0;
+        }
+        if (shortest == NULL || list->count < shortest->count)
+        {
+            shortest = list;
+        }
+    }
+
+    // Binary search for the first candidate at or after the limit
+    uint32_t low = 0;
+    uint32_t high = shortest->count;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        if (shortest->items[middle] < (uint32_t)limit)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    while (low > 0)
+    {
+        int index = (int)shortest->items[--low];
+        if (entry_contains(index, text, length))
+        {
+            return index + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Replaces a !!, !n, !-n or !prefix reference at the start of a line.
+ *
+ * @return 1 if the line was expanded, 0 if it has no reference, -1 on error.
+ */
+int history_expand(char* line, size_t size)
+{
+    if (line[0] != '!' || line[1] == '\0' || line[1] == ' ' || line[1] == '=')
+    {
+        return 0;
+    }
+
+    size_t reference_length = strcspn(line, " \t\n");
+    char reference[HISTORY_MAX_LINE];
+    snprintf(reference, sizeof(reference), "%.*s", (int)reference_length, line);
+
+    int count = history_count();
+    int number = 0;
+    if (strcmp(reference, "!!") == 0)
+    {
+        number = count;
+    }
+    else if (reference[1] == '-' || (reference[1] >= '0' && reference[1] <= '9'))
+    {
+        char* end;
+        long value = strtol(reference + 1, &end, 10);
+        if (*end == '\0')
+        {
+            number = value < 0 ? count + 1 + (int)value : (int)value;
+        }
+    }
+    else
+    {
+        // !prefix is the most recent command that starts with prefix
+        const char* prefix = reference + 1;
+        size_t prefix_length = strlen(prefix);
+        char candidate[HISTORY_MAX_LINE];
+        for (int found = history_search(prefix, 0); found > 0; found = history_search(prefix, found))
+        {
+            if (history_get(found, candidate, sizeof(candidate)) >= 0 &&
+                strncmp(candidate, prefix, prefix_length) == 0)
+            {
+                number = found;
+                break;
+            }
+        }
+    }
+
+    char command[HISTORY_MAX_LINE];
+    if (number < 1 || history_get(number, command, sizeof(command)) == -1)
+    {
+        fprintf(stderr, "history: %s: event not found\n", reference);
+        return -1;
+    }
+
+    char expanded[HISTORY_MAX_LINE * 2];
+    int length = snprintf(expanded, sizeof(expanded), "%s%s", command, line + reference_length);
+    if (length < 0 || (size_t)length >= size)
+    {
+        fprintf(stderr, "history: %s: expansion too long\n", reference);
+        return -1;
+    }
+    memcpy(line, expanded, length + 1);
+    return 1;
+}
+
+/**
+ * @brief Lists the last commands or the ones that contain a text.
+ *
+ * @param arg A count, "-s text", or NULL for the whole history.
+ */
+void command_history(char* arg)
+{
+    if (history_init() == -1)
+    {
+        fprintf(stderr, "history: history file not available\n");
+        return;
+    }
+
+    char command[HISTORY_MAX_LINE];
+    if (arg != NULL && strncmp(arg, "-s", 2) == 0 && (arg[2] == ' ' || arg[2] == '\0'))
+    {
+        const char* text = arg + 2;
+        text += strspn(text, " ");
+        if (*text == '\0')
+        {
+            fprintf(stderr, "Usage: history -s text\n");
+            return;
+        }
+
+        // Matches are found newest first and printed oldest first
+        int capacity = 64;
+        int found_count = 0;
+        int* found = malloc(capacity * sizeof(int));
+        for (int number = history_search(text, 0); found != NULL && number > 0; number = history_search(text, number))
+        {
+            if (found_count == capacity)
+            {
+                capacity *= 2;
+                int* grown = realloc(found, capacity * sizeof(int));
+                if (grown == NULL)
+                {
+                    break;
+                }
+                found = grown;
+            }
+            found[found_count++] = number;
+        }
+        for (int i = found_count - 1; i >= 0; i--)
+        {
+            history_get(found[i], command, sizeof(command));
+            printf("%5d  %s\n", found[i], command);
+        }
+        free(found);
+        return;
+    }
+
+    int count = history_count();
+    int first = 1;
+    if (arg != NULL)
+    {
+        char* end;
+        long last = strtol(arg, &end, 10);
+        if (*end != '\0' || last < 0)
+        {
+            fprintf(stderr, "Usage: history [n] | history -s text\n");
+            return;
+        }
+        first = count - (int)last + 1 > 1 ? count - (int)last + 1 : 1;
+    }
+    for (int number = first; number <= count; number++)
+    {
+        history_get(number, command, sizeof(command));
+        printf("%5d  %s\n", number, command);
+    }
+}
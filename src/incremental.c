@@ -0,0 +1,402 @@
+#define _GNU_SOURCE
+#include "../include/incremental.h"
+#include "../include/hash.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Last successful run of an annotated command.
+ */
+typedef struct
+{
+    /** @brief Hash of the command line and its annotation */
+    uint64_t key;
+    /** @brief Hash of the names and contents of its inputs and outputs */
+    uint64_t fingerprint;
+} Step;
+
+/**
+ * @brief Content hash of a file with the metadata it had when it was hashed.
+ */
+typedef struct
+{
+    char* path;
+    uint64_t hash;
+    int64_t size;
+    int64_t modified_ns;
+    int64_t changed_ns;
+    uint64_t device;
+    uint64_t inode;
+} FileHash;
+
+static struct
+{
+    char* path;
+    Step* steps;
+    size_t step_count;
+    size_t step_capacity;
+    FileHash* files;
+    size_t file_count;
+    size_t file_capacity;
+} state = {NULL, NULL, 0, 0, NULL, 0, 0};
+
+/**
+ * @brief Grows an array of the state so it holds one more element.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+static int reserve(void** array, size_t* capacity, size_t count, size_t element)
+{
+    if (count < *capacity)
+    {
+        return 0;
+    }
+    size_t grown = *capacity == 0 ? 16 : *capacity * 2;
+    void* resized = realloc(*array, grown * element);
+    if (resized == NULL)
+    {
+        return -1;
+    }
+    *array = resized;
+    *capacity = grown;
+    return 0;
+}
+
+static Step* find_step(uint64_t key)
+{
+    for (size_t i = 0; i < state.step_count; i++)
+    {
+        if (state.steps[i].key == key)
+        {
+            return &state.steps[i];
+        }
+    }
+    return NULL;
+}
+
+static FileHash* find_file(const char* path)
+{
+    for (size_t i = 0; i < state.file_count; i++)
+    {
+        if (strcmp(state.files[i].path, path) == 0)
+        {
+            return &state.files[i];
+        }
+    }
+    return NULL;
+}
+
+static int64_t nanoseconds(struct timespec time)
+{
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**
+ * @brief Returns the content hash of a file, reusing the one already known.
+ *
+ * The file is only read again when its size, modification and change times,
+ * device or inode differ from the ones it had when it was last hashed.
+ *
+ * @param path The file.
+ * @param hash Where the hash is stored.
+ * @return 0 on success, -1 if the file cannot be read.
+ */
+static int content_hash(const char* path, uint64_t* hash)
+{
+    struct stat info;
+    if (stat(path, &info) == -1)
+    {
+        return -1;
+    }
+
+    FileHash* known = find_file(path);
+    if (known != NULL && known->size == (int64_t)info.st_size && known->modified_ns == nanoseconds(info.st_mtim) &&
+        known->changed_ns == nanoseconds(info.st_ctim) && known->device == (uint64_t)info.st_dev &&
+        known->inode == (uint64_t)info.st_ino)
+    {
+        *hash = known->hash;
+        return 0;
+    }
+
+    if (hash_file(path, hash) == -1)
+    {
+        return -1;
+    }
+    if (known == NULL)
+    {
+        char* copy = strdup(path);
+        if (copy == NULL ||
+            reserve((void**)&state.files, &state.file_capacity, state.file_count, sizeof(FileHash)) == -1)
+        {
+            free(copy);
+            return 0;
+        }
+        known = &state.files[state.file_count++];
+        known->path = copy;
+    }
+    known->hash = *hash;
+    known->size = (int64_t)info.st_size;
+    known->modified_ns = nanoseconds(info.st_mtim);
+    known->changed_ns = nanoseconds(info.st_ctim);
+    known->device = (uint64_t)info.st_dev;
+    known->inode = (uint64_t)info.st_ino;
+    return 0;
+}
+
+/**
+ * @brief Length of a command line without its trailing newline and blanks.
+ */
+static size_t command_length(const char* command)
+{
+    size_t length = strlen(command);
+    while (length > 0 && strchr(" \t\r\n", command[length - 1]) != NULL)
+    {
+        length--;
+    }
+    return length;
+}
+
+static uint64_t step_key(const char* annotation, const char* command)
+{
+    uint64_t key = hash64(command, command_length(command), 0);
+    return hash64(annotation, command_length(annotation), key);
+}
+
+/**
+ * @brief Hashes the names and the contents of the files of an annotation.
+ *
+ * The annotation is a list of words; in=FILES names inputs and out=FILES
+ * outputs, each a comma separated list. Other words are ignored.
+ *
+ * @param annotation The text of the annotation.
+ * @param fingerprint Where the hash is stored.
+ * @return 0 on success, -1 if one of the files cannot be read.
+ */
+static int fingerprint_files(const char* annotation, uint64_t* fingerprint)
+{
+    char* words = strdup(annotation);
+    if (words == NULL)
+    {
+        return -1;
+    }
+
+    uint64_t result = 0;
+    int status = 0;
+    char* word_state;
+    for (char* word = strtok_r(words, " \t\r\n", &word_state); word != NULL && status == 0;
+         word = strtok_r(NULL, " \t\r\n", &word_state))
+    {
+        uint64_t kind;
+        if (strncmp(word, "in=", 3) == 0)
+        {
+            kind = 1;
+            word += 3;
+        }
+        else if (strncmp(word, "out=", 4) == 0)
+        {
+            kind = 2;
+            word += 4;
+        }
+        else
+        {
+            continue;
+        }
+
+        char* file_state;
+        for (char* file = strtok_r(word, ",", &file_state); file != NULL;
+             file = strtok_r(NULL, ",", &file_state))
+        {
+            uint64_t content;
+            if (content_hash(file, &content) == -1)
+            {
+                status = -1;
+                break;
+            }
+            result = hash64(file, strlen(file) + 1, result ^ kind);
+            result = hash64(&content, sizeof(content), result);
+        }
+    }
+    free(words);
+    *fingerprint = result;
+    return status;
+}
+
+/**
+ * @brief Writes the state next to its file and renames it over the old one.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int save_state(void)
+{
+    char temporary[PATH_MAX];
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", state.path) >= (int)sizeof(temporary))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    FILE* file = fopen(temporary, "we");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    fprintf(file, "# survivorShell incremental state\n");
+    for (size_t i = 0; i < state.step_count; i++)
+    {
+        fprintf(file, "step %016" PRIx64 " %016" PRIx64 "\n", state.steps[i].key, state.steps[i].fingerprint);
+    }
+    for (size_t i = 0; i < state.file_count; i++)
+    {
+        const FileHash* known = &state.files[i];
+        fprintf(file, "file %016" PRIx64 " %" PRId64 " %" PRId64 " %" PRId64 " %" PRIu64 " %" PRIu64 " %s\n",
+                known->hash, known->size, known->modified_ns, known->changed_ns, known->device, known->inode,
+                known->path);
+    }
+
+    if (fclose(file) != 0 || rename(temporary, state.path) == -1)
+    {
+        unlink(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Loads the state of the previous runs.
+ *
+ * Lines that cannot be parsed are dropped, the state only speeds runs up
+ * and a lost entry just runs its command again.
+ *
+ * @param path The state file.
+ * @return 0 on success, -1 if the file exists but cannot be read.
+ */
+int incremental_open(const char* path)
+{
+    incremental_close();
+    state.path = strdup(path);
+    if (state.path == NULL)
+    {
+        return -1;
+    }
+
+    FILE* file = fopen(path, "re");
+    if (file == NULL)
+    {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    char* line = NULL;
+    size_t size = 0;
+    while (getline(&line, &size, file) != -1)
+    {
+        Step step;
+        FileHash known;
+        int offset = 0;
+        if (sscanf(line, "step %" SCNx64 " %" SCNx64, &step.key, &step.fingerprint) == 2)
+        {
+            if (reserve((void**)&state.steps, &state.step_capacity, state.step_count, sizeof(Step)) == 0)
+            {
+                state.steps[state.step_count++] = step;
+            }
+        }
+        else if (sscanf(line, "file %" SCNx64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNu64 " %" SCNu64 " %n",
+                        &known.hash, &known.size, &known.modified_ns, &known.changed_ns, &known.device,
+                        &known.inode, &offset) == 6 &&
+                 offset > 0)
+        {
+            line[strcspn(line, "\n")] = '\0';
+            known.path = strdup(line + offset);
+            if (known.path != NULL && known.path[0] != '\0' &&
+                reserve((void**)&state.files, &state.file_capacity, state.file_count, sizeof(FileHash)) == 0)
+            {
+                state.files[state.file_count++] = known;
+            }
+            else
+            {
+                free(known.path);
+            }
+        }
+    }
+    free(line);
+    fclose(file);
+    return 0;
+}
+
+void incremental_close(void)
+{
+    for (size_t i = 0; i < state.file_count; i++)
+    {
+        free(state.files[i].path);
+    }
+    free(state.files);
+    free(state.steps);
+    free(state.path);
+    state.files = NULL;
+    state.steps = NULL;
+    state.path = NULL;
+    state.file_count = state.file_capacity = 0;
+    state.step_count = state.step_capacity = 0;
+}
+
+/**
+ * @brief Returns 1 if an annotated command can be skipped.
+ *
+ * @param annotation The in= and out= lists of files.
+ * @param command The command line.
+ * @return 1 if its last run succeeded and its files still hash the same, 0 otherwise.
+ */
+int incremental_is_current(const char* annotation, const char* command)
+{
+    Step* step = find_step(step_key(annotation, command));
+    uint64_t fingerprint;
+    if (step == NULL || fingerprint_files(annotation, &fingerprint) == -1)
+    {
+        return 0;
+    }
+    return step->fingerprint == fingerprint;
+}
+
+/**
+ * @brief Records the end of an annotated command and saves the state.
+ *
+ * A command that succeeded but left one of its files missing is forgotten
+ * like a failure, as make would run it again.
+ *
+ * @param annotation The in= and out= lists of files.
+ * @param command The command line.
+ * @param status The exit status of the command.
+ * @return 0 on success, -1 if the state could not be saved.
+ */
+int incremental_record(const char* annotation, const char* command, int status)
+{
+    if (state.path == NULL)
+    {
+        return -1;
+    }
+
+    uint64_t key = step_key(annotation, command);
+    uint64_t fingerprint;
+    Step* step = find_step(key);
+    if (status == 0 && fingerprint_files(annotation, &fingerprint) == 0)
+    {
+        if (step == NULL)
+        {
+            if (reserve((void**)&state.steps, &state.step_capacity, state.step_count, sizeof(Step)) == -1)
+            {
+                return -1;
+            }
+            step = &state.steps[state.step_count++];
+            step->key = key;
+        }
+        step->fingerprint = fingerprint;
+    }
+    else if (step != NULL)
+    {
+        *step = state.steps[--state.step_count];
+    }
+    return save_state();
+}
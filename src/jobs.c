@@ -0,0 +1,661 @@
+#include "../include/jobs.h"
+#include "../include/colors.h"
+#include "../include/executions.h"
+#include "../include/supervisor.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/wait.h>
+
+static Job job_table[JOBS_MAX];
+
+// Process that owns the job table, forked children act as subshells
+static pid_t owner = 0;
+static pid_t shell_pgid = 0;
+static int terminal_fd = -1;
+static struct termios shell_modes;
+
+// Job holding the terminal, read by the signal handler
+static Job* volatile foreground_job = NULL;
+
+/**
+ * @brief Signal names accepted by the kill command.
+ */
+static const struct
+{
+    const char* name;
+    int number;
+} signal_names[] = {
+    {"HUP", SIGHUP},   {"INT", SIGINT},   {"QUIT", SIGQUIT}, {"KILL", SIGKILL}, {"USR1", SIGUSR1},
+    {"USR2", SIGUSR2}, {"ALRM", SIGALRM}, {"TERM", SIGTERM}, {"CONT", SIGCONT}, {"STOP", SIGSTOP},
+    {"TSTP", SIGTSTP}, {"TTIN", SIGTTIN}, {"TTOU", SIGTTOU},
+};
+
+/**
+ * @brief Returns 1 when running in a forked child of the shell instead of the shell itself.
+ */
+static int is_subshell(void)
+{
+    return owner != getpid();
+}
+
+/**
+ * @brief Takes the terminal and makes the shell the leader of its own process group.
+ */
+void job_control_init(void)
+{
+    owner = getpid();
+    shell_pgid = getpgrp();
+    if (!isatty(STDIN_FILENO))
+    {
+        return;
+    }
+
+    // Wait until the shell runs in the foreground before taking over the terminal
+    while (tcgetpgrp(STDIN_FILENO) != (shell_pgid = getpgrp()))
+    {
+        kill(-shell_pgid, SIGTTIN);
+    }
+
+    signal(SIGTTOU, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+
+    // A session leader already leads its group and cannot move
+    if (setpgid(0, 0) == -1 && errno != EPERM)
+    {
+        perror("setpgid");
+        return;
+    }
+    shell_pgid = getpgrp();
+    terminal_fd = STDIN_FILENO;
+    tcsetpgrp(terminal_fd, shell_pgid);
+    tcgetattr(terminal_fd, &shell_modes);
+}
+
+/**
+ * @brief Creates a job in the first free entry, using the smallest free job number.
+ *
+ * @param command The text shown by the jobs command.
+ * @param background 1 if the job runs without the terminal.
+ * @return The job, or NULL if the table is full.
+ */
+Job* job_create(const char* command, int background)
+{
+    Job* job = NULL;
+    int id = 1;
+    for (int retry = 1; retry;)
+    {
+        retry = 0;
+        for (int i = 0; i < JOBS_MAX; i++)
+        {
+            if (job_table[i].id == id)
+            {
+                id++;
+                retry = 1;
+            }
+            else if (job_table[i].id == 0 && job == NULL)
+            {
+                job = &job_table[i];
+            }
+        }
+    }
+    if (job == NULL)
+    {
+        return NULL;
+    }
+
+    memset(job, 0, sizeof(Job));
+    job->id = id;
+    job->background = background;
+    job->state = JOB_RUNNING;
+    snprintf(job->command, sizeof(job->command), "%s", command);
+    return job;
+}
+
+/**
+ * @brief Frees the entry of a job.
+ */
+static void job_release(Job* job)
+{
+    memset(job, 0, sizeof(Job));
+}
+
+/**
+ * @brief Returns the process group to use for the next process of a job.
+ */
+pid_t job_process_group(const Job* job)
+{
+    if (job == NULL || is_subshell())
+    {
+        return -1;
+    }
+    return job->pgid;
+}
+
+/**
+ * @brief Returns the terminal a foreground job should take, -1 for none.
+ */
+int job_terminal(const Job* job)
+{
+    if (job == NULL || job->background || is_subshell())
+    {
+        return -1;
+    }
+    return terminal_fd;
+}
+
+/**
+ * @brief Recomputes the state of a job from the state of its processes.
+ */
+static void update_job_state(Job* job)
+{
+    int running = 0;
+    int stopped = 0;
+    for (int i = 0; i < job->process_count; i++)
+    {
+        running += job->process_states[i] == JOB_RUNNING;
+        stopped += job->process_states[i] == JOB_STOPPED;
+    }
+    job->state = running > 0 ? JOB_RUNNING : (stopped > 0 ? JOB_STOPPED : JOB_DONE);
+}
+
+/**
+ * @brief Returns the exit code shown for a wait status.
+ */
+static int exit_code(int status)
+{
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/**
+ * @brief Reports a finished background job and prints the output it collected.
+ */
+static void report_done(Job* job)
+{
+    printf("\n" COLOR_YELLOW "[%d] Done (%d) %s" COLOR_RESET "\n", job->id, exit_code(job->status), job->command);
+
+    if (job->output_path[0] != '\0')
+    {
+        FILE* file = fopen(job->output_path, "r");
+        if (file != NULL)
+        {
+            char line[256];
+            while (fgets(line, sizeof(line), file) != NULL)
+            {
+                printf("%s", line);
+            }
+            fclose(file);
+        }
+        unlink(job->output_path);
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Reaps a process that did not fit in its job, so its watcher is released.
+ */
+static void reap_untracked(pid_t pid, int status, void* data)
+{
+    (void)pid;
+    (void)status;
+    (void)data;
+}
+
+/**
+ * @brief Updates a job when one of its processes ends, stops or continues.
+ *
+ * Called from the supervision loop.
+ */
+static void job_process_event(pid_t pid, int status, void* data)
+{
+    Job* job = data;
+    int index = 0;
+    while (index < job->process_count && job->pids[index] != pid)
+    {
+        index++;
+    }
+    if (index == job->process_count)
+    {
+        return;
+    }
+
+    JobState previous = job->state;
+    if (WIFSTOPPED(status))
+    {
+        job->process_states[index] = JOB_STOPPED;
+    }
+    else if (WIFCONTINUED(status))
+    {
+        job->process_states[index] = JOB_RUNNING;
+    }
+    else
+    {
+        job->process_states[index] = JOB_DONE;
+        if (index == job->process_count - 1)
+        {
+            job->status = status;
+        }
+    }
+    update_job_state(job);
+
+    if (!job->background || job == foreground_job)
+    {
+        return;
+    }
+    if (job->state == JOB_DONE)
+    {
+        report_done(job);
+        job_release(job);
+    }
+    else if (job->state == JOB_STOPPED && previous != JOB_STOPPED)
+    {
+        printf("\n" COLOR_YELLOW "[%d]+ Stopped %s" COLOR_RESET "\n", job->id, job->command);
+        fflush(stdout);
+    }
+}
+
+/**
+ * @brief Tells whether more processes fit in a job.
+ *
+ * @param job The job, NULL for commands that run without one.
+ * @param count The number of processes about to be launched.
+ * @return 1 if they fit, 0 otherwise.
+ */
+int job_has_room(const Job* job, int count)
+{
+    return job == NULL || job->process_count + count <= JOB_MAX_PROCESSES;
+}
+
+/**
+ * @brief Adds a process to a job, its process group and the supervision loop.
+ *
+ * @param job The job.
+ * @param pid The new process.
+ */
+void job_add_process(Job* job, pid_t pid)
+{
+    if (job->process_count == JOB_MAX_PROCESSES)
+    {
+        // Callers check job_has_room before forking; should one not, the process is still reaped
+        fprintf(stderr, "[%d] too many processes, %d is not part of the job\n", job->id, (int)pid);
+        supervisor_watch(pid, reap_untracked, NULL);
+        return;
+    }
+
+    int index = job->process_count++;
+    job->pids[index] = pid;
+    job->process_states[index] = JOB_RUNNING;
+    job->state = JOB_RUNNING;
+
+    if (!is_subshell())
+    {
+        // Done in the parent too, so the group exists whichever process runs first
+        if (job->pgid == 0)
+        {
+            job->pgid = pid;
+        }
+        setpgid(pid, job->pgid);
+    }
+
+    if (supervisor_watch_stops(pid, job_process_event, job) == -1)
+    {
+        job->process_states[index] = JOB_DONE;
+        update_job_state(job);
+    }
+}
+
+/**
+ * @brief Prepares a forked child of a job before it runs its command.
+ *
+ * @param job The job, may be NULL.
+ */
+void job_setup_child(const Job* job)
+{
+    // Only children of the shell itself get their own group, subshells keep theirs
+    if (job != NULL && owner != 0 && owner == getppid())
+    {
+        pid_t pgid = job->pgid != 0 ? job->pgid : getpid();
+        setpgid(0, pgid);
+        if (!job->background && terminal_fd >= 0)
+        {
+            tcsetpgrp(terminal_fd, pgid);
+        }
+    }
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+}
+
+/**
+ * @brief Gives the terminal to a job and waits until it ends or stops.
+ *
+ * @param job The foreground job.
+ * @return The wait status of its last process, or -1 if it was stopped.
+ */
+int job_wait(Job* job)
+{
+    int has_terminal = terminal_fd >= 0 && !is_subshell() && job->pgid > 0;
+
+    update_job_state(job);
+    foreground_job = job;
+    if (has_terminal)
+    {
+        tcsetpgrp(terminal_fd, job->pgid);
+    }
+
+    while (job->state == JOB_RUNNING)
+    {
+        supervisor_dispatch(-1);
+    }
+
+    foreground_job = NULL;
+    if (has_terminal)
+    {
+        tcsetpgrp(terminal_fd, shell_pgid);
+        if (job->state == JOB_STOPPED)
+        {
+            job->has_modes = tcgetattr(terminal_fd, &job->modes) == 0;
+        }
+        tcsetattr(terminal_fd, TCSADRAIN, &shell_modes);
+    }
+
+    if (job->state == JOB_STOPPED)
+    {
+        job->background = 1;
+        printf("\n" COLOR_YELLOW "[%d]+ Stopped %s" COLOR_RESET "\n", job->id, job->command);
+        last_exit_status = 128 + SIGTSTP;
+        return -1;
+    }
+
+    int status = job->status;
+    last_exit_status = exit_code(status);
+    job_release(job);
+    return status;
+}
+
+/**
+ * @brief Forwards a signal to the whole foreground job.
+ *
+ * Only async-signal-safe calls are used, it runs inside the signal handler.
+ *
+ * @param signo The signal to forward.
+ * @return 1 if there was a foreground job, 0 otherwise.
+ */
+int job_forward_signal(int signo)
+{
+    Job* job = foreground_job;
+    if (job == NULL)
+    {
+        return 0;
+    }
+
+    if (job->pgid > 0 && !is_subshell())
+    {
+        kill(-job->pgid, signo);
+        return 1;
+    }
+    for (int i = 0; i < job->process_count; i++)
+    {
+        if (job->process_states[i] != JOB_DONE)
+        {
+            kill(job->pids[i], signo);
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Finds the job named by %N, %% or %+, the most recent one when spec is NULL.
+ */
+static Job* find_job(const char* spec)
+{
+    if (spec != NULL && strcmp(spec, "%%") != 0 && strcmp(spec, "%+") != 0)
+    {
+        int id = atoi(spec[0] == '%' ? spec + 1 : spec);
+        for (int i = 0; i < JOBS_MAX; i++)
+        {
+            if (id > 0 && job_table[i].id == id)
+            {
+                return &job_table[i];
+            }
+        }
+        return NULL;
+    }
+
+    Job* latest = NULL;
+    for (int i = 0; i < JOBS_MAX; i++)
+    {
+        if (job_table[i].id != 0 && job_table[i].background && (latest == NULL || job_table[i].id > latest->id))
+        {
+            latest = &job_table[i];
+        }
+    }
+    return latest;
+}
+
+/**
+ * @brief Sends a signal to every process of a job.
+ */
+static void signal_job(const Job* job, int signo)
+{
+    if (job->pgid > 0)
+    {
+        kill(-job->pgid, signo);
+        return;
+    }
+    for (int i = 0; i < job->process_count; i++)
+    {
+        if (job->process_states[i] != JOB_DONE)
+        {
+            kill(job->pids[i], signo);
+        }
+    }
+}
+
+/**
+ * @brief Marks the stopped processes of a job as running again after SIGCONT.
+ */
+static void resume_job(Job* job)
+{
+    for (int i = 0; i < job->process_count; i++)
+    {
+        if (job->process_states[i] == JOB_STOPPED)
+        {
+            job->process_states[i] = JOB_RUNNING;
+        }
+    }
+    update_job_state(job);
+    signal_job(job, SIGCONT);
+}
+
+/**
+ * @brief Lists the background and stopped jobs.
+ */
+void command_jobs(char* arg)
+{
+    (void)arg;
+    for (int i = 0; i < JOBS_MAX; i++)
+    {
+        Job* job = &job_table[i];
+        if (job->id != 0 && job->background)
+        {
+            printf("[%d] %-8s %6d  %s\n", job->id, job->state == JOB_STOPPED ? "Stopped" : "Running", (int)job->pgid,
+                   job->command);
+        }
+    }
+}
+
+/**
+ * @brief Parses a signal given as a number, a name or a SIG-prefixed name.
+ *
+ * @return The signal number, or -1 if it is unknown.
+ */
+int job_parse_signal(const char* text)
+{
+    char* end = NULL;
+    long number = strtol(text, &end, 10);
+    if (end != text && *end == '\0')
+    {
+        return number > 0 && number < NSIG ? (int)number : -1;
+    }
+
+    if (strncmp(text, "SIG", 3) == 0)
+    {
+        text += 3;
+    }
+    for (size_t i = 0; i < sizeof(signal_names) / sizeof(signal_names[0]); i++)
+    {
+        if (strcmp(text, signal_names[i].name) == 0)
+        {
+            return signal_names[i].number;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Parses a process target of kill.
+ *
+ * The whole text has to be a number. A negative number is the process
+ * group of its absolute value; 0 and -1, which kill would read as the
+ * group of the shell and every process, are refused.
+ *
+ * @param text The target.
+ * @param pid Where the pid, or the negated pgid, is stored.
+ * @return 0 on success, -1 if the target is invalid.
+ */
+int job_parse_pid(const char* text, pid_t* pid)
+{
+    char* end = NULL;
+    errno = 0;
+    long number = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || number == 0 || number == -1 || number > INT_MAX ||
+        number < -(long)INT_MAX)
+    {
+        return -1;
+    }
+    *pid = (pid_t)number;
+    return 0;
+}
+
+/**
+ * @brief Sends a signal to jobs or processes.
+ *
+ * @param arg The signal and the %job or pid targets.
+ */
+void command_kill(char* arg)
+{
+    int signo = SIGTERM;
+    char* saveptr = NULL;
+    char* token = arg != NULL ? strtok_r(arg, " \t", &saveptr) : NULL;
+
+    if (token != NULL && token[0] == '-' && strcmp(token, "--") != 0)
+    {
+        const char* name = token + 1;
+        if (strcmp(token, "-s") == 0)
+        {
+            name = strtok_r(NULL, " \t", &saveptr);
+        }
+        signo = name != NULL ? job_parse_signal(name) : -1;
+        if (signo == -1)
+        {
+            fprintf(stderr, "kill: invalid signal: %s\n", name != NULL ? name : "");
+            return;
+        }
+        token = strtok_r(NULL, " \t", &saveptr);
+    }
+    // After --, a negative target is a process group rather than a signal
+    if (token != NULL && strcmp(token, "--") == 0)
+    {
+        token = strtok_r(NULL, " \t", &saveptr);
+    }
+
+    if (token == NULL)
+    {
+        fprintf(stderr, "Usage: kill [-SIGNAL | -s SIGNAL] [--] %%job|pid|-pgid ...\n");
+        return;
+    }
+
+    for (; token != NULL; token = strtok_r(NULL, " \t", &saveptr))
+    {
+        if (token[0] == '%')
+        {
+            Job* job = find_job(token);
+            if (job == NULL)
+            {
+                fprintf(stderr, "kill: %s: no such job\n", token);
+                continue;
+            }
+            signal_job(job, signo);
+            // A stopped job only acts on the signal once it runs again
+            if (job->state == JOB_STOPPED && signo != SIGSTOP && signo != SIGTSTP && signo != SIGCONT)
+            {
+                resume_job(job);
+            }
+        }
+        else
+        {
+            pid_t pid;
+            if (job_parse_pid(token, &pid) == -1)
+            {
+                fprintf(stderr, "kill: %s: invalid pid\n", token);
+            }
+            else if (kill(pid, signo) == -1)
+            {
+                fprintf(stderr, "kill: %s: %s\n", token, strerror(errno));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Resumes a job in the foreground and waits for it.
+ *
+ * @param arg The %job, the most recent job when NULL.
+ */
+void command_fg(char* arg)
+{
+    Job* job = find_job(arg);
+    if (job == NULL)
+    {
+        fprintf(stderr, "fg: no such job\n");
+        return;
+    }
+
+    printf("%s\n", job->command);
+    fflush(stdout);
+    job->background = 0;
+    if (terminal_fd >= 0 && job->has_modes)
+    {
+        tcsetattr(terminal_fd, TCSADRAIN, &job->modes);
+    }
+    if (terminal_fd >= 0 && job->pgid > 0)
+    {
+        tcsetpgrp(terminal_fd, job->pgid);
+    }
+    resume_job(job);
+    job_wait(job);
+}
+
+/**
+ * @brief Resumes a stopped job in the background.
+ *
+ * @param arg The %job, the most recent job when NULL.
+ */
+void command_bg(char* arg)
+{
+    Job* job = find_job(arg);
+    if (job == NULL)
+    {
+        fprintf(stderr, "bg: no such job\n");
+        return;
+    }
+
+    job->background = 1;
+    resume_job(job);
+    printf("[%d] %s &\n", job->id, job->command);
+}
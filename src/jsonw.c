@@ -0,0 +1,376 @@
+#include "../include/jsonw.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char digit_pairs[201] = "00010203040506070809"
+                                     "10111213141516171819"
+                                     "20212223242526272829"
+                                     "30313233343536373839"
+                                     "40414243444546474849"
+                                     "50515253545556575859"
+                                     "60616263646566676869"
+                                     "70717273747576777879"
+                                     "80818283848586878889"
+                                     "90919293949596979899";
+
+static const uint64_t powers_of_ten[10] = {1,      10,      100,      1000,      10000,
+                                           100000, 1000000, 10000000, 100000000, 1000000000};
+
+/**
+ * @brief Makes room for more bytes at the end of the buffer.
+ *
+ * @return 1 if they fit, 0 if memory ran out, which marks the writer as failed.
+ */
+static int reserve(JsonWriter* writer, size_t bytes)
+{
+    if (writer->length + bytes <= writer->capacity)
+    {
+        return 1;
+    }
+    if (writer->failed)
+    {
+        return 0;
+    }
+    size_t capacity = writer->capacity == 0 ? 256 : writer->capacity;
+    while (capacity < writer->length + bytes)
+    {
+        capacity *= 2;
+    }
+    char* grown = realloc(writer->buffer, capacity);
+    if (grown == NULL)
+    {
+        writer->failed = 1;
+        return 0;
+    }
+    writer->buffer = grown;
+    writer->capacity = capacity;
+    return 1;
+}
+
+static void append(JsonWriter* writer, const char* bytes, size_t length)
+{
+    if (reserve(writer, length))
+    {
+        memcpy(writer->buffer + writer->length, bytes, length);
+        writer->length += length;
+    }
+}
+
+static void append_char(JsonWriter* writer, char character)
+{
+    if (reserve(writer, 1))
+    {
+        writer->buffer[writer->length++] = character;
+    }
+}
+
+/**
+ * @brief Writes the comma due before a value or a key of the current container.
+ */
+static void separate(JsonWriter* writer)
+{
+    if (writer->after_key)
+    {
+        writer->after_key = 0;
+        return;
+    }
+    uint64_t bit = 1ULL << writer->depth;
+    if (writer->depth > 0 && !(writer->first & bit))
+    {
+        append_char(writer, ',');
+    }
+    writer->first &= ~bit;
+}
+
+/**
+ * @brief Formats an unsigned integer into the end of a scratch buffer.
+ *
+ * Two digits are produced per division from a table of digit pairs.
+ *
+ * @return The first digit written.
+ */
+static char* format_unsigned(uint64_t value, char* end)
+{
+    char* cursor = end;
+    while (value >= 100)
+    {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--cursor = digit_pairs[pair + 1];
+        *--cursor = digit_pairs[pair];
+    }
+    if (value >= 10)
+    {
+        *--cursor = digit_pairs[value * 2 + 1];
+        *--cursor = digit_pairs[value * 2];
+    }
+    else
+    {
+        *--cursor = (char)('0' + value);
+    }
+    return cursor;
+}
+
+static void open_container(JsonWriter* writer, char bracket)
+{
+    separate(writer);
+    if (writer->depth + 1 >= JSONW_MAX_DEPTH)
+    {
+        writer->failed = 1;
+        return;
+    }
+    append_char(writer, bracket);
+    writer->depth++;
+    writer->first |= 1ULL << writer->depth;
+}
+
+static void close_container(JsonWriter* writer, char bracket)
+{
+    if (writer->depth > 0)
+    {
+        writer->depth--;
+    }
+    writer->after_key = 0;
+    append_char(writer, bracket);
+}
+
+/**
+ * @brief Appends a string between quotes, escaping what JSON requires.
+ *
+ * Runs of characters that need no escape are copied at once.
+ */
+static void append_quoted(JsonWriter* writer, const char* value)
+{
+    static const char hex[] = "0123456789abcdef";
+    append_char(writer, '"');
+    const unsigned char* start = (const unsigned char*)value;
+    const unsigned char* cursor = start;
+    while (1)
+    {
+        while (*cursor >= 0x20 && *cursor != '"' && *cursor != '\\')
+        {
+            cursor++;
+        }
+        append(writer, (const char*)start, (size_t)(cursor - start));
+        if (*cursor == '\0')
+        {
+            break;
+        }
+
+        char escape[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t length = 2;
+        switch (*cursor)
+        {
+        case '"':
+            escape[1] = '"';
+            break;
+        case '\\':
+            escape[1] = '\\';
+            break;
+        case '\n':
+            escape[1] = 'n';
+            break;
+        case '\r':
+            escape[1] = 'r';
+            break;
+        case '\t':
+            escape[1] = 't';
+            break;
+        case '\b':
+            escape[1] = 'b';
+            break;
+        case '\f':
+            escape[1] = 'f';
+            break;
+        default:
+            escape[1] = 'u';
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = hex[*cursor >> 4];
+            escape[5] = hex[*cursor & 0xf];
+            length = 6;
+            break;
+        }
+        append(writer, escape, length);
+        start = ++cursor;
+    }
+    append_char(writer, '"');
+}
+
+/**
+ * @brief Prepares a writer with a buffer of the given size.
+ *
+ * @param writer The writer.
+ * @param capacity The initial size of its buffer, it grows when a document does not fit.
+ * @return 0 on success, -1 if the buffer cannot be allocated.
+ */
+int jsonw_init(JsonWriter* writer, size_t capacity)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->first = 1;
+    if (capacity > 0)
+    {
+        writer->buffer = malloc(capacity);
+        if (writer->buffer == NULL)
+        {
+            return -1;
+        }
+        writer->capacity = capacity;
+    }
+    return 0;
+}
+
+void jsonw_reset(JsonWriter* writer)
+{
+    writer->length = 0;
+    writer->first = 1;
+    writer->depth = 0;
+    writer->after_key = 0;
+    writer->failed = 0;
+}
+
+void jsonw_free(JsonWriter* writer)
+{
+    free(writer->buffer);
+    memset(writer, 0, sizeof(*writer));
+}
+
+void jsonw_begin_object(JsonWriter* writer)
+{
+    open_container(writer, '{');
+}
+
+void jsonw_end_object(JsonWriter* writer)
+{
+    close_container(writer, '}');
+}
+
+void jsonw_begin_array(JsonWriter* writer)
+{
+    open_container(writer, '[');
+}
+
+void jsonw_end_array(JsonWriter* writer)
+{
+    close_container(writer, ']');
+}
+
+void jsonw_key(JsonWriter* writer, const char* key)
+{
+    separate(writer);
+    append_quoted(writer, key);
+    append_char(writer, ':');
+    writer->after_key = 1;
+}
+
+void jsonw_string(JsonWriter* writer, const char* value)
+{
+    separate(writer);
+    append_quoted(writer, value);
+}
+
+void jsonw_int(JsonWriter* writer, int64_t value)
+{
+    separate(writer);
+    char scratch[24];
+    char* end = scratch + sizeof(scratch);
+    // Negated as unsigned so INT64_MIN does not overflow
+    char* start = format_unsigned(value < 0 ? -(uint64_t)value : (uint64_t)value, end);
+    if (value < 0)
+    {
+        *--start = '-';
+    }
+    append(writer, start, (size_t)(end - start));
+}
+
+/**
+ * @brief Writes a double in fixed point.
+ *
+ * The value is scaled by 10^decimals and rounded to an integer, whose
+ * integer and fractional parts are then formatted like integers. This
+ * avoids the locale and format parsing of printf. Values whose scaled form
+ * does not fit exactly in a double fall back to snprintf, in exponent form
+ * from 1e21 on so the text stays short.
+ *
+ * @param writer The writer.
+ * @param value The value.
+ * @param decimals The number of digits after the point, from 0 to 9.
+ */
+void jsonw_double(JsonWriter* writer, double value, int decimals)
+{
+    if (!isfinite(value))
+    {
+        jsonw_null(writer);
+        return;
+    }
+    if (decimals < 0)
+    {
+        decimals = 0;
+    }
+    else if (decimals > 9)
+    {
+        decimals = 9;
+    }
+
+    uint64_t scale = powers_of_ten[decimals];
+    double scaled = fabs(value) * (double)scale;
+    if (scaled >= 9007199254740992.0)
+    {
+        separate(writer);
+        char text[40];
+        int length = fabs(value) < 1e21 ? snprintf(text, sizeof(text), "%.*f", decimals, value)
+                                         : snprintf(text, sizeof(text), "%.17g", value);
+        append(writer, text, (size_t)length);
+        return;
+    }
+
+    separate(writer);
+    // Halves round to even, as printf does
+    uint64_t rounded = (uint64_t)nearbyint(scaled);
+    char scratch[48];
+    char* end = scratch + sizeof(scratch);
+    char* start = end;
+    if (decimals > 0)
+    {
+        uint64_t fraction = rounded % scale;
+        for (int i = 0; i < decimals; i++)
+        {
+            *--start = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        *--start = '.';
+    }
+    start = format_unsigned(rounded / scale, start);
+    if (value < 0 && rounded != 0)
+    {
+        *--start = '-';
+    }
+    append(writer, start, (size_t)(end - start));
+}
+
+void jsonw_bool(JsonWriter* writer, int value)
+{
+    separate(writer);
+    if (value)
+    {
+        append(writer, "true", 4);
+    }
+    else
+    {
+        append(writer, "false", 5);
+    }
+}
+
+void jsonw_null(JsonWriter* writer)
+{
+    separate(writer);
+    append(writer, "null", 4);
+}
+
+void jsonw_newline(JsonWriter* writer)
+{
+    append_char(writer, '\n');
+}
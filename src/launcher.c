@@ -0,0 +1,316 @@
+#define _GNU_SOURCE
+#include "../include/launcher.h"
+#include "../include/limit.h"
+#include "../include/placement.h"
+#include "../include/zygote.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+LaunchContext launch_context = {NULL, NULL};
+
+// Job control signals the shell ignores or handles, restored to their default in children
+static const int child_default_signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD};
+
+/**
+ * @brief Sets every descriptor of the options to -1 (inherit).
+ *
+ * @param options The options to initialize.
+ */
+void launch_options_init(LaunchOptions* options)
+{
+    options->stdin_fd = -1;
+    options->stdout_fd = -1;
+    options->stderr_fd = -1;
+    options->process_group = -1;
+    options->terminal_fd = -1;
+    options->limits = launch_context.limits;
+    options->placement = launch_context.placement;
+    options->stage = 0;
+}
+
+/**
+ * @brief Splits a command line on spaces and tabs into an argument vector.
+ *
+ * @param line The command line, tokenized in place.
+ * @param args The output vector, always NULL terminated.
+ * @param max_args The maximum number of arguments to store.
+ * @return The number of arguments stored.
+ */
+int split_arguments(char* line, char* args[], int max_args)
+{
+    int count = 0;
+    char* saveptr = NULL;
+    char* token = strtok_r(line, " \t", &saveptr);
+    while (token != NULL && count < max_args)
+    {
+        args[count++] = token;
+        token = strtok_r(NULL, " \t", &saveptr);
+    }
+    args[count] = NULL;
+    return count;
+}
+
+/**
+ * @brief Adds a dup2 action for a descriptor that should replace a standard one.
+ */
+static int add_redirection(posix_spawn_file_actions_t* actions, int fd, int target)
+{
+    if (fd < 0 || fd == target)
+    {
+        return 0;
+    }
+    return posix_spawn_file_actions_adddup2(actions, fd, target);
+}
+
+/**
+ * @brief Moves a descriptor over a standard one in a forked child.
+ */
+static int move_descriptor(int fd, int target)
+{
+    if (fd < 0 || fd == target)
+    {
+        return 0;
+    }
+    return dup2(fd, target) == -1 ? -1 : 0;
+}
+
+/**
+ * @brief Prepares a forked child the same way posix_spawnp prepares a spawned one.
+ *
+ * The terminal is taken while SIGTTOU is still ignored, before the default
+ * signals are restored.
+ *
+ * @param options The options of the child.
+ * @return 0 on success, -1 with errno set.
+ */
+int launch_setup_child(const LaunchOptions* options)
+{
+    if (options->process_group >= 0 && setpgid(0, options->process_group) == -1)
+    {
+        return -1;
+    }
+    if (options->terminal_fd >= 0)
+    {
+        tcsetpgrp(options->terminal_fd, getpgrp());
+    }
+
+    if (move_descriptor(options->stdin_fd, STDIN_FILENO) == -1 ||
+        move_descriptor(options->stdout_fd, STDOUT_FILENO) == -1 ||
+        move_descriptor(options->stderr_fd, STDERR_FILENO) == -1)
+    {
+        return -1;
+    }
+
+    struct sigaction default_action;
+    memset(&default_action, 0, sizeof(default_action));
+    default_action.sa_handler = SIG_DFL;
+    sigemptyset(&default_action.sa_mask);
+    for (size_t i = 0; i < sizeof(child_default_signals) / sizeof(child_default_signals[0]); i++)
+    {
+        sigaction(child_default_signals[i], &default_action, NULL);
+    }
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    sigprocmask(SIG_SETMASK, &empty_mask, NULL);
+
+    if (placement_apply_in_child(options->placement, options->stage) == -1)
+    {
+        return -1;
+    }
+    return limits_apply_in_child(options->limits);
+}
+
+/**
+ * @brief Takes the terminal back after a child that had taken it failed to run its program.
+ *
+ * @param options The options of the child, may be NULL.
+ */
+static void reclaim_terminal(const LaunchOptions* options)
+{
+    if (options != NULL && options->terminal_fd >= 0)
+    {
+        int error = errno;
+        tcsetpgrp(options->terminal_fd, getpgrp());
+        errno = error;
+    }
+}
+
+/**
+ * @brief Launches a program with fork and execvp for options posix_spawnp cannot express.
+ *
+ * A close-on-exec pipe reports setup and exec errors back to the parent, so
+ * the caller sees the same errno it would get from posix_spawnp.
+ *
+ * @param argv The argument vector, argv[0] is searched in PATH.
+ * @param options The options of the child.
+ * @return The pid of the child, or -1 with errno set.
+ */
+static pid_t launch_forked(char* const argv[], const LaunchOptions* options)
+{
+    int error_pipe[2];
+    if (pipe2(error_pipe, O_CLOEXEC) == -1)
+    {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(error_pipe[0]);
+        if (launch_setup_child(options) == 0)
+        {
+            execvp(argv[0], argv);
+        }
+        int error = errno;
+        ssize_t written = write(error_pipe[1], &error, sizeof(error));
+        (void)written;
+        _exit(127);
+    }
+    close(error_pipe[1]);
+    if (pid == -1)
+    {
+        int error = errno;
+        close(error_pipe[0]);
+        errno = error;
+        return -1;
+    }
+
+    int error = 0;
+    ssize_t length;
+    do
+    {
+        length = read(error_pipe[0], &error, sizeof(error));
+    } while (length == -1 && errno == EINTR);
+    close(error_pipe[0]);
+    if (length == (ssize_t)sizeof(error))
+    {
+        // The child never ran the program, collect it here
+        waitpid(pid, NULL, 0);
+        errno = error;
+        reclaim_terminal(options);
+        return -1;
+    }
+    return pid;
+}
+
+/**
+ * @brief Launches a program with posix_spawnp.
+ *
+ * posix_spawnp avoids copying the page tables of the shell, so launching a
+ * child costs the same no matter how much memory the shell is using. When the
+ * zygote runs, it launches the child from its own small image instead. Only
+ * children with limits or a placement fall back to fork.
+ *
+ * @param argv The argument vector, argv[0] is searched in PATH.
+ * @param options The descriptors for the child, or NULL to inherit them.
+ * @return The pid of the child, or -1 with errno set.
+ */
+pid_t launch_process(char* const argv[], const LaunchOptions* options)
+{
+    if (argv == NULL || argv[0] == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (options != NULL && (options->limits != NULL || options->placement != NULL))
+    {
+        // Pending output of the shell must appear before the output of the child
+        fflush(stdout);
+        return launch_forked(argv, options);
+    }
+
+    if (zygote_available())
+    {
+        pid_t pid = zygote_launch(argv, options);
+        if (pid != -1 || errno != ENOTCONN)
+        {
+            if (pid == -1)
+            {
+                reclaim_terminal(options);
+            }
+            return pid;
+        }
+    }
+
+    posix_spawn_file_actions_t actions;
+    int error = posix_spawn_file_actions_init(&actions);
+    if (error != 0)
+    {
+        errno = error;
+        return -1;
+    }
+
+    if (options != NULL)
+    {
+        error = add_redirection(&actions, options->stdin_fd, STDIN_FILENO);
+        if (error == 0)
+        {
+            error = add_redirection(&actions, options->stdout_fd, STDOUT_FILENO);
+        }
+        if (error == 0)
+        {
+            error = add_redirection(&actions, options->stderr_fd, STDERR_FILENO);
+        }
+    }
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 35)
+    // The child takes the terminal itself, so it never runs before its group owns it
+    if (error == 0 && options != NULL && options->terminal_fd >= 0)
+    {
+        error = posix_spawn_file_actions_addtcsetpgrp_np(&actions, options->terminal_fd);
+    }
+#endif
+
+    // The child starts with an empty signal mask even if the shell blocks SIGCHLD,
+    // and with the default job control signals the shell ignores or handles
+    posix_spawnattr_t attributes;
+    sigset_t empty_mask;
+    sigset_t default_signals;
+    sigemptyset(&empty_mask);
+    sigemptyset(&default_signals);
+    for (size_t i = 0; i < sizeof(child_default_signals) / sizeof(child_default_signals[0]); i++)
+    {
+        sigaddset(&default_signals, child_default_signals[i]);
+    }
+    if (error == 0)
+    {
+        error = posix_spawnattr_init(&attributes);
+    }
+    if (error == 0)
+    {
+        short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+        posix_spawnattr_setsigmask(&attributes, &empty_mask);
+        posix_spawnattr_setsigdefault(&attributes, &default_signals);
+        if (options != NULL && options->process_group >= 0)
+        {
+            flags |= POSIX_SPAWN_SETPGROUP;
+            posix_spawnattr_setpgroup(&attributes, options->process_group);
+        }
+        posix_spawnattr_setflags(&attributes, flags);
+    }
+
+    // Pending output of the shell must appear before the output of the child
+    fflush(stdout);
+
+    pid_t pid = -1;
+    if (error == 0)
+    {
+        error = posix_spawnp(&pid, argv[0], &actions, &attributes, argv, environ);
+        posix_spawnattr_destroy(&attributes);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (error != 0)
+    {
+        errno = error;
+        reclaim_terminal(options);
+        return -1;
+    }
+    return pid;
+}
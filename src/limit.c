@@ -0,0 +1,724 @@
+#define _GNU_SOURCE
+#include "../include/limit.h"
+#include "../include/colors.h"
+#include "../include/commands.h"
+#include "../include/launcher.h"
+#include "../include/shell.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+// Period used for cpu.max, a quota of 100% is one whole CPU
+#define CPU_PERIOD_USEC 100000
+
+/**
+ * @brief A limit option that maps to setrlimit.
+ */
+typedef struct
+{
+    const char* name;
+    int resource;
+    /** @brief 1 if the value accepts K, M, G and T suffixes */
+    int is_size;
+} RlimitOption;
+
+static const RlimitOption rlimit_options[] = {
+    {"cputime", RLIMIT_CPU, 0}, {"as", RLIMIT_AS, 1},       {"data", RLIMIT_DATA, 1},   {"fsize", RLIMIT_FSIZE, 1},
+    {"nofile", RLIMIT_NOFILE, 0}, {"nproc", RLIMIT_NPROC, 0}, {"stack", RLIMIT_STACK, 1}, {"core", RLIMIT_CORE, 1},
+};
+
+// Directory the job cgroups are created in, resolved on first use
+static char cgroup_parent[PATH_MAX];
+static int cgroup_state = 0; // 0 unknown, 1 ready, -1 unavailable
+static int cgroup_counter = 0;
+
+/**
+ * @brief Parses a number with an optional binary K, M, G or T suffix.
+ *
+ * @param text The text to parse, "max" and "unlimited" give RLIM_INFINITY.
+ * @param is_size 1 to accept suffixes.
+ * @param value Where the value is stored.
+ * @return 0 on success, -1 if the text is not a valid value.
+ */
+static int parse_value(const char* text, int is_size, unsigned long long* value)
+{
+    if (strcmp(text, "max") == 0 || strcmp(text, "unlimited") == 0)
+    {
+        *value = RLIM_INFINITY;
+        return 0;
+    }
+
+    char* end;
+    errno = 0;
+    unsigned long long number = strtoull(text, &end, 10);
+    if (errno != 0 || end == text || text[0] == '-')
+    {
+        return -1;
+    }
+    if (is_size && *end != '\0' && end[1] == '\0')
+    {
+        const char* suffixes = "KMGT";
+        const char* suffix = strchr(suffixes, *end == 'k' ? 'K' : *end);
+        if (suffix == NULL)
+        {
+            return -1;
+        }
+        number <<= 10 * (suffix - suffixes + 1);
+        end++;
+    }
+    if (*end != '\0')
+    {
+        return -1;
+    }
+    *value = number;
+    return 0;
+}
+
+/**
+ * @brief Parses the io option into an io.max line.
+ *
+ * The device is a block device path or MAJOR:MINOR, followed by rbps, wbps,
+ * riops and wiops values: io=/dev/sda,rbps=10M,wiops=100.
+ */
+static int parse_io(char* text, char* io_max, size_t size)
+{
+    char* saveptr = NULL;
+    char* device = strtok_r(text, ",", &saveptr);
+    if (device == NULL)
+    {
+        return -1;
+    }
+
+    unsigned int major_number;
+    unsigned int minor_number;
+    struct stat info;
+    if (device[0] == '/')
+    {
+        if (stat(device, &info) == -1 || !S_ISBLK(info.st_mode))
+        {
+            fprintf(stderr, "limit: %s is not a block device\n", device);
+            return -1;
+        }
+        major_number = major(info.st_rdev);
+        minor_number = minor(info.st_rdev);
+    }
+    else if (sscanf(device, "%u:%u", &major_number, &minor_number) != 2)
+    {
+        return -1;
+    }
+
+    int length = snprintf(io_max, size, "%u:%u", major_number, minor_number);
+    char* setting;
+    int settings = 0;
+    while ((setting = strtok_r(NULL, ",", &saveptr)) != NULL)
+    {
+        char* value_text = strchr(setting, '=');
+        if (value_text == NULL)
+        {
+            return -1;
+        }
+        *value_text++ = '\0';
+        if (strcmp(setting, "rbps") != 0 && strcmp(setting, "wbps") != 0 && strcmp(setting, "riops") != 0 &&
+            strcmp(setting, "wiops") != 0)
+        {
+            return -1;
+        }
+        unsigned long long value;
+        if (parse_value(value_text, 1, &value) == -1)
+        {
+            return -1;
+        }
+        if (value == RLIM_INFINITY)
+        {
+            length += snprintf(io_max + length, size - length, " %s=max", setting);
+        }
+        else
+        {
+            length += snprintf(io_max + length, size - length, " %s=%llu", setting, value);
+        }
+        if ((size_t)length >= size)
+        {
+            return -1;
+        }
+        settings++;
+    }
+    return settings > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Parses one name=value option into the limits.
+ *
+ * @return 0 on success, -1 after printing an error.
+ */
+static int parse_option(char* option, JobLimits* limits)
+{
+    char* value_text = strchr(option, '=');
+    *value_text++ = '\0';
+    unsigned long long value;
+
+    if (strcmp(option, "cpu") == 0)
+    {
+        size_t length = strlen(value_text);
+        if (length > 0 && value_text[length - 1] == '%')
+        {
+            value_text[length - 1] = '\0';
+        }
+        if (parse_value(value_text, 0, &value) == -1 || value == 0)
+        {
+            fprintf(stderr, "limit: invalid cpu percentage %s\n", value_text);
+            return -1;
+        }
+        if (value == RLIM_INFINITY)
+        {
+            snprintf(limits->cpu_max, sizeof(limits->cpu_max), "max %d", CPU_PERIOD_USEC);
+        }
+        else
+        {
+            snprintf(limits->cpu_max, sizeof(limits->cpu_max), "%llu %d", value * (CPU_PERIOD_USEC / 100),
+                     CPU_PERIOD_USEC);
+        }
+        return 0;
+    }
+    if (strcmp(option, "mem") == 0)
+    {
+        if (parse_value(value_text, 1, &value) == -1)
+        {
+            fprintf(stderr, "limit: invalid memory size %s\n", value_text);
+            return -1;
+        }
+        if (value == RLIM_INFINITY)
+        {
+            strcpy(limits->memory_max, "max");
+        }
+        else
+        {
+            snprintf(limits->memory_max, sizeof(limits->memory_max), "%llu", value);
+        }
+        return 0;
+    }
+    if (strcmp(option, "io") == 0)
+    {
+        if (parse_io(value_text, limits->io_max, sizeof(limits->io_max)) == -1)
+        {
+            fprintf(stderr, "limit: invalid io limit, expected io=DEVICE,rbps=N,wbps=N,riops=N,wiops=N\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(rlimit_options) / sizeof(rlimit_options[0]); i++)
+    {
+        if (strcmp(option, rlimit_options[i].name) != 0)
+        {
+            continue;
+        }
+        if (parse_value(value_text, rlimit_options[i].is_size, &value) == -1)
+        {
+            fprintf(stderr, "limit: invalid value for %s: %s\n", option, value_text);
+            return -1;
+        }
+
+        // A later value for the same resource replaces the earlier one
+        int index = 0;
+        while (index < limits->rlimit_count && limits->resources[index] != rlimit_options[i].resource)
+        {
+            index++;
+        }
+        if (index == LIMIT_MAX_RLIMITS)
+        {
+            fprintf(stderr, "limit: too many limits\n");
+            return -1;
+        }
+        if (index == limits->rlimit_count)
+        {
+            limits->rlimit_count++;
+        }
+        limits->resources[index] = rlimit_options[i].resource;
+        limits->values[index].rlim_cur = value;
+        limits->values[index].rlim_max = value;
+        return 0;
+    }
+
+    fprintf(stderr, "limit: unknown limit %s\n", option);
+    return -1;
+}
+
+/**
+ * @brief Parses the options of a limit prefix into the limits.
+ *
+ * @param options The options separated by blanks, tokenized in place.
+ * @param limits The limits to update, those of an enclosing limit included.
+ * @return 1 if cpu, mem or io ask for a cgroup, 0 if only rlimits are set,
+ * -1 after printing an error.
+ */
+int limits_parse(char* options, JobLimits* limits)
+{
+    int wants_cgroup = 0;
+    char* saveptr = NULL;
+    for (char* option = strtok_r(options, " \t", &saveptr); option != NULL; option = strtok_r(NULL, " \t", &saveptr))
+    {
+        if (parse_option(option, limits) == -1)
+        {
+            return -1;
+        }
+        if (strcmp(option, "cpu") == 0 || strcmp(option, "mem") == 0 || strcmp(option, "io") == 0)
+        {
+            wants_cgroup = 1;
+        }
+    }
+    return wants_cgroup;
+}
+
+/**
+ * @brief Writes a value to a file of a cgroup directory.
+ *
+ * @return 0 on success, -1 with errno set.
+ */
+static int cgroup_write(const char* directory, const char* name, const char* value)
+{
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", directory, name) >= (int)sizeof(path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    ssize_t written = write(fd, value, strlen(value));
+    int error = errno;
+    close(fd);
+    errno = error;
+    return written == -1 ? -1 : 0;
+}
+
+/**
+ * @brief Reads a file of a cgroup directory into a NUL terminated buffer.
+ *
+ * @return The number of bytes read, or -1 with errno set.
+ */
+static ssize_t cgroup_read(const char* directory, const char* name, char* buffer, size_t size)
+{
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", directory, name) >= (int)sizeof(path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    buffer[length > 0 ? length : 0] = '\0';
+    return length;
+}
+
+/**
+ * @brief Finds the cgroup v2 directory the job cgroups are created in.
+ *
+ * SURVSHELL_CGROUP names a delegated cgroup; otherwise the cgroup of the shell
+ * is read from /proc/self/cgroup.
+ */
+static int cgroup_locate(char* path, size_t size)
+{
+    const char* configured = getenv("SURVSHELL_CGROUP");
+    if (configured != NULL && configured[0] != '\0')
+    {
+        snprintf(path, size, "%s", configured);
+    }
+    else
+    {
+        FILE* file = fopen("/proc/self/cgroup", "r");
+        if (file == NULL)
+        {
+            return -1;
+        }
+        char line[PATH_MAX];
+        int found = 0;
+        while (!found && fgets(line, sizeof(line), file) != NULL)
+        {
+            if (strncmp(line, "0::", 3) == 0)
+            {
+                line[strcspn(line, "\n")] = '\0';
+                const char* relative = strcmp(line + 3, "/") == 0 ? "" : line + 3;
+                found = snprintf(path, size, "/sys/fs/cgroup%s", relative) < (int)size;
+            }
+        }
+        fclose(file);
+        if (!found)
+        {
+            return -1;
+        }
+    }
+
+    char controllers[256];
+    return cgroup_read(path, "cgroup.controllers", controllers, sizeof(controllers)) == -1 ? -1 : 0;
+}
+
+/**
+ * @brief Enables the cpu, memory and io controllers for the children of a cgroup.
+ *
+ * Controllers are enabled one by one so a missing one does not block the others.
+ *
+ * @return 0 on success, -1 if the cgroup still has processes of its own.
+ */
+static int cgroup_enable_controllers(const char* path)
+{
+    static const char* controllers[] = {"+cpu", "+memory", "+io"};
+    for (size_t i = 0; i < sizeof(controllers) / sizeof(controllers[0]); i++)
+    {
+        if (cgroup_write(path, "cgroup.subtree_control", controllers[i]) == -1 && errno == EBUSY)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Moves the shell into a new leaf child of its cgroup.
+ *
+ * cgroup v2 only delegates controllers from cgroups without processes of their
+ * own, so the shell leaves room for the job cgroups. Other processes of the
+ * cgroup are not the shell's to move: when there are any, the shell goes back
+ * and a delegated cgroup has to be given with SURVSHELL_CGROUP.
+ *
+ * @return 0 on success, -1 if the cgroup cannot be emptied.
+ */
+static int cgroup_move_to_leaf(const char* path)
+{
+    char leaf[PATH_MAX];
+    if (snprintf(leaf, sizeof(leaf), "%s/shell-%d", path, (int)getpid()) >= (int)sizeof(leaf))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (mkdir(leaf, 0755) == -1 && errno != EEXIST)
+    {
+        return -1;
+    }
+
+    char pid[16];
+    snprintf(pid, sizeof(pid), "%d", (int)getpid());
+    if (cgroup_write(leaf, "cgroup.procs", pid) == -1)
+    {
+        rmdir(leaf);
+        return -1;
+    }
+    char others[16];
+    if (cgroup_read(path, "cgroup.procs", others, sizeof(others)) > 0)
+    {
+        fprintf(stderr, "limit: %s has processes other than the shell, not moving them\n", path);
+        cgroup_write(path, "cgroup.procs", pid);
+        rmdir(leaf);
+        errno = EBUSY;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Resolves the parent of the job cgroups and delegates the controllers to it once.
+ *
+ * @return 0 if job cgroups can be created, -1 otherwise.
+ */
+static int cgroup_prepare(void)
+{
+    if (cgroup_state == 0)
+    {
+        cgroup_state = -1;
+        if (cgroup_locate(cgroup_parent, sizeof(cgroup_parent)) == 0)
+        {
+            if (cgroup_enable_controllers(cgroup_parent) == 0 ||
+                (cgroup_move_to_leaf(cgroup_parent) == 0 && cgroup_enable_controllers(cgroup_parent) == 0))
+            {
+                cgroup_state = 1;
+            }
+        }
+    }
+    return cgroup_state == 1 ? 0 : -1;
+}
+
+/**
+ * @brief Creates the cgroup of a command line and writes its limits.
+ *
+ * @return 0 on success, -1 after printing an error.
+ */
+static int cgroup_create(JobLimits* limits)
+{
+    if (cgroup_prepare() == -1)
+    {
+        fprintf(stderr, "limit: no writable cgroup v2 hierarchy for cpu, mem and io limits "
+                        "(set SURVSHELL_CGROUP to a delegated cgroup)\n");
+        return -1;
+    }
+
+    int length = snprintf(limits->cgroup_path, sizeof(limits->cgroup_path), "%s/job-%d-%d", cgroup_parent,
+                          (int)getpid(), ++cgroup_counter);
+    if (length >= (int)sizeof(limits->cgroup_path))
+    {
+        errno = ENAMETOOLONG;
+    }
+    if (length >= (int)sizeof(limits->cgroup_path) || mkdir(limits->cgroup_path, 0755) == -1)
+    {
+        fprintf(stderr, "limit: %s: %s\n", limits->cgroup_path, strerror(errno));
+        limits->cgroup_path[0] = '\0';
+        return -1;
+    }
+
+    const char* files[] = {"cpu.max", "memory.max", "io.max"};
+    const char* values[] = {limits->cpu_max, limits->memory_max, limits->io_max};
+    for (int i = 0; i < 3; i++)
+    {
+        if (values[i][0] != '\0' && cgroup_write(limits->cgroup_path, files[i], values[i]) == -1)
+        {
+            fprintf(stderr, "limit: cannot write %s: %s\n", files[i], strerror(errno));
+            rmdir(limits->cgroup_path);
+            limits->cgroup_path[0] = '\0';
+            return -1;
+        }
+    }
+
+    limits->cgroup_fd = open(limits->cgroup_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (limits->cgroup_fd == -1)
+    {
+        perror("limit: open cgroup");
+        rmdir(limits->cgroup_path);
+        limits->cgroup_path[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the value of a "key value" line of a cgroup stat file, 0 if missing.
+ */
+static unsigned long long stat_value(const char* text, const char* key)
+{
+    size_t length = strlen(key);
+    const char* line = text;
+    while (line != NULL && *line != '\0')
+    {
+        if (strncmp(line, key, length) == 0 && line[length] == ' ')
+        {
+            return strtoull(line + length + 1, NULL, 10);
+        }
+        line = strchr(line, '\n');
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds up a key=value field over every device of io.stat.
+ */
+static unsigned long long io_stat_total(const char* text, const char* key)
+{
+    unsigned long long total = 0;
+    size_t length = strlen(key);
+    for (const char* field = strstr(text, key); field != NULL; field = strstr(field + length, key))
+    {
+        if (field[-1] == ' ' && field[length] == '=')
+        {
+            total += strtoull(field + length + 1, NULL, 10);
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Formats a byte count with a binary unit.
+ */
+static void format_bytes(unsigned long long bytes, char* buffer, size_t size)
+{
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = (double)bytes;
+    int unit = 0;
+    while (value >= 1024.0 && unit < 4)
+    {
+        value /= 1024.0;
+        unit++;
+    }
+    snprintf(buffer, size, unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+}
+
+/**
+ * @brief Prints the usage of the command line from the stat files of its cgroup.
+ */
+static void cgroup_report(const JobLimits* limits)
+{
+    char text[4096];
+    unsigned long long usage = 0;
+    unsigned long long user = 0;
+    unsigned long long system = 0;
+    unsigned long long throttled = 0;
+    if (cgroup_read(limits->cgroup_path, "cpu.stat", text, sizeof(text)) > 0)
+    {
+        usage = stat_value(text, "usage_usec");
+        user = stat_value(text, "user_usec");
+        system = stat_value(text, "system_usec");
+        throttled = stat_value(text, "throttled_usec");
+    }
+
+    // memory.peak needs Linux 5.19, older kernels only give the current usage
+    unsigned long long peak = 0;
+    if (cgroup_read(limits->cgroup_path, "memory.peak", text, sizeof(text)) > 0 ||
+        cgroup_read(limits->cgroup_path, "memory.current", text, sizeof(text)) > 0)
+    {
+        peak = strtoull(text, NULL, 10);
+    }
+    unsigned long long oom_kills = 0;
+    if (cgroup_read(limits->cgroup_path, "memory.events", text, sizeof(text)) > 0)
+    {
+        oom_kills = stat_value(text, "oom_kill");
+    }
+
+    unsigned long long read_bytes = 0;
+    unsigned long long written_bytes = 0;
+    if (cgroup_read(limits->cgroup_path, "io.stat", text, sizeof(text)) > 0)
+    {
+        read_bytes = io_stat_total(text, "rbytes");
+        written_bytes = io_stat_total(text, "wbytes");
+    }
+
+    char peak_text[32];
+    char read_text[32];
+    char written_text[32];
+    format_bytes(peak, peak_text, sizeof(peak_text));
+    format_bytes(read_bytes, read_text, sizeof(read_text));
+    format_bytes(written_bytes, written_text, sizeof(written_text));
+    printf(COLOR_CYAN "limit: cpu %.2fs (user %.2fs, system %.2fs, throttled %.2fs), memory peak %s, io read %s, "
+                      "written %s" COLOR_RESET "\n",
+           usage / 1e6, user / 1e6, system / 1e6, throttled / 1e6, peak_text, read_text, written_text);
+    if (oom_kills > 0)
+    {
+        printf(COLOR_RED "limit: %llu process(es) killed for exceeding the memory limit" COLOR_RESET "\n", oom_kills);
+    }
+}
+
+/**
+ * @brief Reports the usage and removes the cgroup of a command line.
+ *
+ * A cgroup that still has processes, such as a stopped job or a daemon the
+ * command left behind, is kept so its limits stay in force.
+ */
+static void cgroup_release(JobLimits* limits)
+{
+    cgroup_report(limits);
+    close(limits->cgroup_fd);
+    limits->cgroup_fd = -1;
+    if (rmdir(limits->cgroup_path) == -1)
+    {
+        fprintf(stderr, "limit: %s still has processes, keeping it\n", limits->cgroup_path);
+    }
+}
+
+/**
+ * @brief Joins the cgroup and sets the resource limits in a forked child.
+ *
+ * Writing 0 to cgroup.procs moves the calling process, so no pid has to be
+ * formatted between fork and exec.
+ *
+ * @param limits The limits, or NULL.
+ * @return 0 on success, -1 with errno set.
+ */
+int limits_apply_in_child(const JobLimits* limits)
+{
+    if (limits == NULL)
+    {
+        return 0;
+    }
+
+    if (limits->cgroup_fd >= 0)
+    {
+        int fd = openat(limits->cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            return -1;
+        }
+        ssize_t written = write(fd, "0", 1);
+        int error = errno;
+        close(fd);
+        if (written != 1)
+        {
+            errno = error;
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < limits->rlimit_count; i++)
+    {
+        if (setrlimit(limits->resources[i], &limits->values[i]) == -1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the rest of the line with the given limits.
+ *
+ * Limits of an enclosing limit command are inherited and can be overridden.
+ *
+ * @param arg The options followed by the command line.
+ */
+void command_limit(char* arg)
+{
+    const JobLimits* previous = launch_context.limits;
+    JobLimits limits;
+    if (previous != NULL)
+    {
+        limits = *previous;
+    }
+    else
+    {
+        memset(&limits, 0, sizeof(limits));
+        limits.cgroup_fd = -1;
+    }
+
+    char* options;
+    char* command_line = split_prefix_options(arg, &options);
+    if (command_line == NULL)
+    {
+        fprintf(stderr, "Usage: limit [cpu=P%%] [mem=SIZE] [io=DEVICE,rbps=N,wbps=N] [cputime=S] [as=SIZE] [data=SIZE]"
+                        " [fsize=SIZE] [nofile=N] [nproc=N] [stack=SIZE] [core=SIZE] [--] command\n");
+        return;
+    }
+
+    int wants_cgroup = limits_parse(options, &limits);
+    if (wants_cgroup == -1)
+    {
+        return;
+    }
+
+    // New cgroup settings get a cgroup of their own, otherwise the enclosing one is shared
+    if (wants_cgroup)
+    {
+        limits.cgroup_path[0] = '\0';
+        limits.cgroup_fd = -1;
+        if (cgroup_create(&limits) == -1)
+        {
+            return;
+        }
+    }
+
+    launch_context.limits = &limits;
+    choose_execution(command_line);
+    launch_context.limits = previous;
+
+    if (wants_cgroup)
+    {
+        cgroup_release(&limits);
+    }
+}
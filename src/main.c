@@ -2,6 +2,7 @@
 #include "../include/executions.h"
 #include "../include/monitor.h"
 #include "../include/shell.h"
+#include "../include/supervisor.h"
 
 #include <cjson/cJSON.h>
 #include <stdio.h>
@@ -11,12 +12,12 @@
 int main(int argc, char* argv[])
 {
     // Initialize the shell
-    init_shell(argc, argv);
-    // Start the main loop of the shell
-    while (1)
+    int result = init_shell(argc, argv);
+    // Keep supervising the children that are still running (background jobs, monitor)
+    while (supervisor_pending() > 0)
     {
-        sleep(1);
+        supervisor_dispatch(-1);
     }
 
-    return 0;
+    return result;
 }
@@ -1,23 +1,283 @@
 #include "../include/monitor.h"
+#include "../include/cpustat.h"
+#include "../include/devstats.h"
+#include "../include/pacer.h"
+#include "../include/procevents.h"
+#include "../include/psi.h"
+#include "../include/sampler.h"
+#include "../include/selfstats.h"
+#include "../include/statusquery.h"
+#include "../include/supervisor.h"
 #include "../lab1/include/metrics.h"
 
+#include <limits.h>
+#include <strings.h>
+#include <time.h>
+
 static pid_t monitor_pid = -1;
 static int monitoring = 0;
 
+/**
+ * @brief Called by the supervision loop when the monitor process ends.
+ *
+ * A monitor stopped with stop_monitor is expected to end; any other exit is
+ * reported. A stopped or continued monitor is still running and stays ours.
+ */
+static void monitor_exited(pid_t pid, int status, void* data)
+{
+    (void)data;
+    if (WIFSTOPPED(status) || WIFCONTINUED(status))
+    {
+        return;
+    }
+    if (monitoring && pid == monitor_pid)
+    {
+        printf("\nMonitor exited unexpectedly (status %d).\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        fflush(stdout);
+        monitor_pid = -1;
+        monitoring = 0;
+    }
+}
+
+/**
+ * @brief Parses a positive number of an option, with an optional unit.
+ *
+ * @param text The digits of the value.
+ * @param units The accepted units and their factors, as "ms=1" or "k=1024,m=1048576".
+ * @param value Where the value is stored.
+ * @return 0 on success, -1 if the value is not a positive number with one of the units.
+ */
+static int parse_option_number(const char* text, const char* units, long long* value)
+{
+    char* end;
+    errno = 0;
+    long long number = strtoll(text, &end, 10);
+    if (end == text || number <= 0 || errno == ERANGE)
+    {
+        return -1;
+    }
+    if (*end == '\0')
+    {
+        *value = number;
+        return 0;
+    }
+
+    size_t length = strlen(end);
+    for (const char* unit = units; *unit != '\0'; unit += strcspn(unit, ",") + (unit[strcspn(unit, ",")] == ','))
+    {
+        const char* equals = strchr(unit, '=');
+        if ((size_t)(equals - unit) == length && strncasecmp(unit, end, length) == 0)
+        {
+            long long factor = atoll(equals + 1);
+            if (number > LLONG_MAX / factor)
+            {
+                return -1;
+            }
+            *value = number * factor;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Starts the sampler thread of the shell.
+ *
+ * Usage: start_monitor [--jsonl PATH] [--binary PATH] [interval=MS]
+ * [adaptive=on|off|FASTEST/SLOWEST] [rotate=BYTES] [keep=N] [events=on|off]
+ * [psi=off|RESOURCE:STALL/WINDOW] [overhead=on|off].
+ * Without outputs, the samples only feed the time-series store read by
+ * monitor_history. An adaptive interval replaces interval: it goes from
+ * FASTEST while the metrics move or are close to an alert to SLOWEST while
+ * they are steady, 100ms/30s with adaptive=on. overhead=on adds the cost
+ * of the monitor to the JSON lines. With events on, the default, the process count follows
+ * the kernel process events when the shell may subscribe to them. Pressure
+ * triggers are armed for every resource unless psi=off; psi=memory:150ms/2s
+ * replaces the threshold of one resource.
+ *
+ * @param arg The options of start_monitor.
+ */
+static void start_sampler(char* arg)
+{
+    SamplerOptions options;
+    sampler_options_init(&options);
+    char* state;
+    for (char* word = strtok_r(arg, " \t\n", &state); word != NULL; word = strtok_r(NULL, " \t\n", &state))
+    {
+        long long value;
+        if (strcmp(word, "--jsonl") == 0 || strcmp(word, "--binary") == 0)
+        {
+            char* path = strtok_r(NULL, " \t\n", &state);
+            if (path == NULL)
+            {
+                break;
+            }
+            if (word[2] == 'j')
+            {
+                options.jsonl_path = path;
+            }
+            else
+            {
+                options.binary_path = path;
+            }
+        }
+        else if (strncmp(word, "interval=", 9) == 0)
+        {
+            if (parse_option_number(word + 9, "ms=1,s=1000", &value) == -1 || value > 3600000)
+            {
+                fprintf(stderr, "start_monitor: invalid interval %s\n", word + 9);
+                return;
+            }
+            options.interval_ms = (int)value;
+        }
+        else if (strcmp(word, "adaptive=on") == 0 || strcmp(word, "adaptive=off") == 0)
+        {
+            int on = word[10] == 'n';
+            options.fastest_ms = on ? PACER_FASTEST_MS : 0;
+            options.slowest_ms = on ? PACER_SLOWEST_MS : 0;
+        }
+        else if (strncmp(word, "adaptive=", 9) == 0)
+        {
+            char* slowest = strchr(word + 9, '/');
+            long long fastest_ms;
+            if (slowest == NULL)
+            {
+                fprintf(stderr, "start_monitor: invalid adaptive interval %s\n", word + 9);
+                return;
+            }
+            *slowest++ = '\0';
+            if (parse_option_number(word + 9, "ms=1,s=1000,m=60000", &fastest_ms) == -1 ||
+                parse_option_number(slowest, "ms=1,s=1000,m=60000", &value) == -1 ||
+                fastest_ms < SAMPLER_MIN_INTERVAL_MS || value < fastest_ms || value > 3600000)
+            {
+                fprintf(stderr, "start_monitor: invalid adaptive interval %s/%s\n", word + 9, slowest);
+                return;
+            }
+            options.fastest_ms = (int)fastest_ms;
+            options.slowest_ms = (int)value;
+        }
+        else if (strncmp(word, "rotate=", 7) == 0)
+        {
+            if (parse_option_number(word + 7, "k=1024,m=1048576,g=1073741824", &value) == -1)
+            {
+                fprintf(stderr, "start_monitor: invalid rotation size %s\n", word + 7);
+                return;
+            }
+            options.rotate_bytes = (size_t)value;
+        }
+        else if (strncmp(word, "keep=", 5) == 0)
+        {
+            options.keep_files = atoi(word + 5);
+            if (options.keep_files < 0 || options.keep_files > 1000)
+            {
+                fprintf(stderr, "start_monitor: invalid number of kept files %s\n", word + 5);
+                return;
+            }
+        }
+        else if (strcmp(word, "overhead=on") == 0 || strcmp(word, "overhead=off") == 0)
+        {
+            options.export_overhead = word[10] == 'n';
+        }
+        else if (strcmp(word, "events=on") == 0 || strcmp(word, "events=off") == 0)
+        {
+            options.process_events = word[8] == 'n';
+        }
+        else if (strcmp(word, "psi=off") == 0)
+        {
+            for (int resource = 0; resource < PSI_RESOURCES; resource++)
+            {
+                options.pressure_triggers[resource].stall_us = 0;
+            }
+        }
+        else if (strncmp(word, "psi=", 4) == 0)
+        {
+            PsiTrigger trigger;
+            int resource = psi_parse_trigger(word + 4, &trigger);
+            if (resource == -1)
+            {
+                fprintf(stderr, "start_monitor: invalid pressure trigger %s\n", word + 4);
+                return;
+            }
+            options.pressure_triggers[resource] = trigger;
+        }
+        else
+        {
+            fprintf(stderr, "start_monitor: unknown option %s\n", word);
+            fprintf(stderr, "Usage: start_monitor [--jsonl PATH] [--binary PATH] [interval=MS]"
+                            " [adaptive=on|off|FASTEST/SLOWEST] [rotate=BYTES] [keep=N] [events=on|off]"
+                            " [psi=off|RESOURCE:STALL/WINDOW] [overhead=on|off]\n");
+            return;
+        }
+    }
+    if (sampler_running())
+    {
+        printf("The sampler is already running.\n");
+        return;
+    }
+    if (sampler_start(&options) == -1)
+    {
+        perror("start_monitor");
+        return;
+    }
+    if (options.slowest_ms > 0)
+    {
+        printf("Sampler started, every %d to %d ms depending on activity", options.fastest_ms, options.slowest_ms);
+    }
+    else
+    {
+        printf("Sampler started, every %d ms", sampler_interval());
+    }
+    if (options.jsonl_path != NULL)
+    {
+        printf(", JSON lines to %s", options.jsonl_path);
+    }
+    if (options.binary_path != NULL)
+    {
+        printf(", binary record to %s", options.binary_path);
+    }
+    if (procevents_active())
+    {
+        printf(", process count from netlink events");
+    }
+    unsigned armed = sampler_pressure_triggers();
+    for (int resource = 0, first = 1; resource < PSI_RESOURCES; resource++)
+    {
+        if (armed & (1u << resource))
+        {
+            printf("%s%s", first ? ", pressure triggers on " : " ", psi_resource_names[resource]);
+            first = 0;
+        }
+    }
+    printf(".\n");
+}
+
 /**
  * @brief Starts the system monitor in a child process.
  *
  * It forks a new process to run the monitor program. The child process's
  * standard output and error are redirected to /dev/null to run silently.
  * The parent process updates the monitor status and prints a confirmation message.
+ * With options, the samples are taken by a thread of the shell instead and
+ * written as JSON lines to a file or FIFO (--jsonl) or to a compressed and
+ * rotated binary record (--binary), and always to the time-series store.
+ *
+ * @param arg The options of the command, may be NULL.
  */
-void start_monitor()
+void start_monitor(char* arg)
 {
+    if (arg != NULL && arg[strspn(arg, " \t\n")] != '\0')
+    {
+        start_sampler(arg);
+        return;
+    }
+
     if (monitor_pid == -1)
     {
         monitor_pid = fork();
         if (monitor_pid == 0)
         {
+            // Its own process group keeps Ctrl-C at the prompt away from the monitor
+            setpgid(0, 0);
             int devnull = open("/dev/null", O_RDWR);
             if (devnull != -1)
             {
@@ -29,9 +289,14 @@ void start_monitor()
             perror("execlp failed");
             exit(EXIT_FAILURE);
         }
+        else if (monitor_pid == -1)
+        {
+            perror("fork");
+        }
         else
         {
             monitoring = 1;
+            supervisor_watch(monitor_pid, monitor_exited, NULL);
             printf("Monitor started.\n");
         }
     }
@@ -45,14 +310,35 @@ void start_monitor()
  * @brief Stops the system monitor.
  *
  * It sends a SIGTERM signal to the monitor process to terminate it and waits
- * for the process to exit. It then resets the monitor status.
+ * for the process to exit through the supervision loop. It then resets the monitor status.
+ * A running sampler thread is stopped as well.
+ *
+ * @param arg Unused.
  */
-void stop_monitor()
+void stop_monitor(char* arg)
 {
+    (void)arg;
+    if (sampler_running())
+    {
+        uint64_t dropped = sampler_dropped();
+        sampler_stop();
+        printf("Sampler stopped");
+        if (dropped > 0)
+        {
+            printf(" (%llu lines dropped)", (unsigned long long)dropped);
+        }
+        printf(".\n");
+        if (monitor_pid == -1)
+        {
+            return;
+        }
+    }
+
     if (monitor_pid != -1)
     {
+        monitoring = 0;
         kill(monitor_pid, SIGTERM);
-        waitpid(monitor_pid, NULL, 0);
+        supervisor_wait(monitor_pid, NULL);
         monitor_pid = -1;
         monitoring = 0;
         printf("Monitor stopped.\n");
@@ -63,15 +349,208 @@ void stop_monitor()
     }
 }
 
+/**
+ * @brief Prints the usage of every CPU since the previous per-core view.
+ *
+ * The two latest readings of /proc/stat are kept between calls; the first
+ * view, or one after a CPU went offline or online, measures over
+ * CPUSTAT_FIRST_INTERVAL_MS. The spread line shows what the aggregate
+ * hides: the least and most busy CPUs and the standard deviation.
+ */
+static void show_cpu_cores(void)
+{
+    static CpuTimes readings[2];
+    static int newest = 0;
+    static CpuUsage usage;
+
+    int older = newest;
+    newest = 1 - newest;
+    if (cpustat_read(&readings[newest]) == -1)
+    {
+        printf("Error getting CPU usage per core\n\n");
+        return;
+    }
+    if (cpustat_usage(&readings[older], &readings[newest], &usage) == -1)
+    {
+        struct timespec pause = {0, CPUSTAT_FIRST_INTERVAL_MS * 1000000L};
+        nanosleep(&pause, NULL);
+        older = newest;
+        newest = 1 - newest;
+        if (cpustat_read(&readings[newest]) == -1 || cpustat_usage(&readings[older], &readings[newest], &usage) == -1)
+        {
+            printf("Error getting CPU usage per core\n\n");
+            return;
+        }
+    }
+
+    CpuSpread spread;
+    cpustat_spread(&usage, &spread);
+    const float* total = usage.total;
+    printf("=== CPU Usage per Core (%d CPUs) ===\n", usage.count);
+    printf("All CPUs: %.2f%% busy, user %.2f%%, system %.2f%%, irq %.2f%%, iowait %.2f%%, steal %.2f%%\n",
+           total[CPUSTAT_BUSY], total[CPUSTAT_USER_SHARE], total[CPUSTAT_SYSTEM_SHARE], total[CPUSTAT_IRQ_SHARE],
+           total[CPUSTAT_IOWAIT_SHARE], total[CPUSTAT_STEAL_SHARE]);
+    printf("Spread: min %.2f%% (cpu%d), max %.2f%% (cpu%d), average %.2f%%, deviation %.2f\n\n", spread.minimum,
+           spread.coolest, spread.maximum, spread.hottest, spread.average, spread.deviation);
+    printf("%-7s %7s %7s %7s %7s %7s %7s\n", "CPU", "BUSY%", "USER%", "SYS%", "IRQ%", "IOWAIT%", "STEAL%");
+    for (int cpu = 0; cpu < usage.count; cpu++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "cpu%d", usage.id[cpu]);
+        printf("%-7s %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f\n", name, usage.share[CPUSTAT_BUSY][cpu],
+               usage.share[CPUSTAT_USER_SHARE][cpu], usage.share[CPUSTAT_SYSTEM_SHARE][cpu],
+               usage.share[CPUSTAT_IRQ_SHARE][cpu], usage.share[CPUSTAT_IOWAIT_SHARE][cpu],
+               usage.share[CPUSTAT_STEAL_SHARE][cpu]);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Prints the activity of every disk and network interface since the previous per-device view.
+ *
+ * The devices are the ones the "devices" filters of config.json keep. The
+ * first view measures over DEVSTATS_FIRST_INTERVAL_MS.
+ */
+static void show_devices(void)
+{
+    const MonitorConfig* config = config_hold();
+    if (config == NULL || devstats_update(config) == -1)
+    {
+        config_release(config);
+        printf("Error getting disk and network usage per device\n\n");
+        return;
+    }
+    DiskRates disks[64];
+    InterfaceRates interfaces[64];
+    int disk_count = devstats_disks(disks, 64);
+    int interface_count = devstats_interfaces(interfaces, 64);
+    if (disk_count == 0 && interface_count == 0)
+    {
+        struct timespec pause = {0, DEVSTATS_FIRST_INTERVAL_MS * 1000000L};
+        nanosleep(&pause, NULL);
+        devstats_update(config);
+        disk_count = devstats_disks(disks, 64);
+        interface_count = devstats_interfaces(interfaces, 64);
+    }
+    config_release(config);
+
+    printf("=== Disk Usage per Device ===\n");
+    printf("%-12s %9s %9s %11s %11s %10s %7s\n", "DEVICE", "READS/s", "WRITES/s", "READ KB/s", "WRITE KB/s",
+           "LATENCY", "UTIL%");
+    for (int index = 0; index < disk_count; index++)
+    {
+        printf("%-12s %9.1f %9.1f %11.1f %11.1f %8.2fms %7.2f\n", disks[index].name, disks[index].reads_per_second,
+               disks[index].writes_per_second, disks[index].read_bytes_per_second / 1024,
+               disks[index].write_bytes_per_second / 1024, disks[index].latency_ms, disks[index].utilization);
+    }
+    printf("\n=== Network Usage per Interface ===\n");
+    printf("%-12s %11s %11s %9s %9s %9s %9s %8s\n", "INTERFACE", "RX KB/s", "TX KB/s", "RX pkt/s", "TX pkt/s",
+           "RX drop/s", "TX drop/s", "ERRORS/s");
+    for (int index = 0; index < interface_count; index++)
+    {
+        printf("%-12s %11.1f %11.1f %9.1f %9.1f %9.1f %9.1f %8.1f\n", interfaces[index].name,
+               interfaces[index].receive_bytes_per_second / 1024, interfaces[index].transmit_bytes_per_second / 1024,
+               interfaces[index].receive_packets_per_second, interfaces[index].transmit_packets_per_second,
+               interfaces[index].receive_drops_per_second, interfaces[index].transmit_drops_per_second,
+               interfaces[index].errors_per_second);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Prints the pressure stall information of cpu, memory and io.
+ *
+ * "some" is the share of time at least one task waited on the resource
+ * and "full" the share of time all non-idle tasks did. The trigger column
+ * counts the stall notifications of the sampler thread.
+ */
+static void show_pressure(void)
+{
+    printf("=== Pressure Stall Information ===\n");
+    printf("%-8s %-5s %8s %8s %8s %14s %9s\n", "RESOURCE", "", "AVG10%", "AVG60%", "AVG300%", "TOTAL ms", "TRIGGERS");
+    unsigned armed = sampler_pressure_triggers();
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        PsiStats stats;
+        if (psi_read(resource, &stats) == -1)
+        {
+            printf("%-8s not available, the kernel has no PSI support or it is disabled\n",
+                   psi_resource_names[resource]);
+            continue;
+        }
+        char fired[24] = "-";
+        if (armed & (1u << resource))
+        {
+            snprintf(fired, sizeof(fired), "%llu", (unsigned long long)psi_trigger_count(resource));
+        }
+        printf("%-8s %-5s %8.2f %8.2f %8.2f %14llu %9s\n", psi_resource_names[resource], "some", stats.some.avg10,
+               stats.some.avg60, stats.some.avg300, (unsigned long long)(stats.some.total_us / 1000), fired);
+        printf("%-8s %-5s %8.2f %8.2f %8.2f %14llu\n", "", "full", stats.full.avg10, stats.full.avg60,
+               stats.full.avg300, (unsigned long long)(stats.full.total_us / 1000));
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Prints what the sampler thread costs, per source.
+ *
+ * The latest sample and the average since start_monitor are shown side by
+ * side. System calls are the read and write calls the kernel counts per
+ * thread, and heap the growth of the bytes in use in the allocator.
+ */
+static void show_overhead(void)
+{
+    SelfStats stats;
+    uint64_t samples = selfstats_read(&stats);
+    if (samples == 0)
+    {
+        printf("No sample measured yet, start the sampler with start_monitor\n\n");
+        return;
+    }
+    printf("=== Monitor Overhead (%llu samples, every %d ms) ===\n", (unsigned long long)samples, sampler_interval());
+    printf("%-16s %10s %10s %9s %9s %10s %10s %9s %9s\n", "SOURCE", "LAST us", "AVG us", "SYSCALLS", "AVG", "BYTES",
+           "AVG", "HEAP", "AVG");
+    for (int source = 0; source <= SELF_SOURCES; source++)
+    {
+        SelfCost last = source < SELF_SOURCES ? stats.last[source] : selfstats_sum(stats.last);
+        SelfCost total = source < SELF_SOURCES ? stats.total[source] : selfstats_sum(stats.total);
+        double count = (double)samples;
+        printf("%-16s %10.1f %10.1f %9llu %9.1f %10llu %10.0f %+9lld %+9.0f\n",
+               source < SELF_SOURCES ? selfstats_source_names[source] : "total", (double)last.time_ns / 1000,
+               (double)total.time_ns / 1000 / count, (unsigned long long)last.syscalls, (double)total.syscalls / count,
+               (unsigned long long)last.bytes_read, (double)total.bytes_read / count,
+               (long long)last.heap_bytes, (double)total.heap_bytes / count);
+    }
+    printf("CPU time of the sampler thread: %.1f us last sample, %.1f us on average\n",
+           (double)stats.last_cpu_ns / 1000, (double)stats.total_cpu_ns / 1000 / (double)samples);
+    if (!stats.counts_io)
+    {
+        printf("System calls and bytes are not counted, /proc/thread-self/io cannot be read\n");
+    }
+    printf("\n");
+}
+
 /**
  * @brief Displays the status of the system monitor.
  *
- * It provides an interactive menu to allow the user to choose a specific
- * metric to view. It reads the metric data from a named pipe (FIFO),
- * parses the JSON response, and prints the requested information.
+ * Without arguments, it provides an interactive menu to allow the user to
+ * choose a specific metric to view. With arguments, such as
+ * "cpu,memory --format json --watch 500ms", it prints the metrics without
+ * reading stdin, for scripts and pipelines.
+ *
+ * @param arg The metrics and options of the non-interactive form, may be NULL.
  */
-void status_monitor()
+void status_monitor(char* arg)
 {
+    if (arg != NULL && arg[strspn(arg, " \t\n")] != '\0')
+    {
+        StatusQuery query;
+        if (statusquery_parse(arg, &query) == 0 && statusquery_run(&query) == -1)
+        {
+            perror("status_monitor");
+        }
+        return;
+    }
     int option = 0;
     printf("Monitoring running (PID: %d).\n\n", getpid());
 
@@ -84,14 +563,25 @@ void status_monitor()
     printf("    6. Context Switches\n");
     printf("    7. All Metrics\n");
     printf("    8. Exit\n");
-    printf("    Select an option (1-8): ");
-    if (scanf("%d", &option) != 1)
+    printf("    9. CPU Usage per Core\n");
+    printf("    10. Disk and Network Usage per Device\n");
+    printf("    11. Pressure Stall Information\n");
+    printf("    12. Monitor Overhead\n");
+    printf("    Select an option (1-12): ");
+    int read = scanf("%d", &option);
+    // The rest of the line is consumed so the next reader of stdin starts on a new line
+    for (int character = 0; read != EOF && character != '\n' && character != EOF;)
+    {
+        character = getchar();
+    }
+    if (read != 1)
     {
         fprintf(stderr, "Error reading input\n");
         return;
     }
     printf("\n");
 
+    // Exit keeps the number it always had, views are added after it
     if (option == 8)
     {
         return;
@@ -239,8 +729,24 @@ void status_monitor()
         printf("\n");
         break;
 
+    case 9:
+        show_cpu_cores();
+        break;
+
+    case 10:
+        show_devices();
+        break;
+
+    case 11:
+        show_pressure();
+        break;
+
+    case 12:
+        show_overhead();
+        break;
+
     default:
-        printf("Invalid option. Please select 1-8.\n\n");
+        printf("Invalid option. Please select 1-12.\n\n");
         break;
     }
 }
\ No newline at end of file
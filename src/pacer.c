@@ -0,0 +1,163 @@
+#include "../include/pacer.h"
+
+#include <math.h>
+
+/**
+ * @brief Change of a metric from which a sample is busy or hot
+ * Percentages are compared in points, the other metrics relatively to
+ * their previous value, which is at least floor so that near-zero values
+ * do not turn every small change into a jump
+ */
+typedef struct
+{
+    int relative;
+    double busy;
+    double hot;
+    double floor;
+} MetricPace;
+
+static const MetricPace metric_paces[SAMPLER_METRICS] = {
+    {.relative = 0, .busy = 2, .hot = 10},                     // cpu, in points
+    {.relative = 0, .busy = 1, .hot = 5},                      // memory
+    {.relative = 0, .busy = 2, .hot = 10},                     // disk
+    {.relative = 1, .busy = 0.10, .hot = 0.50, .floor = 4096}, // network, bytes per second
+    {.relative = 1, .busy = 0.02, .hot = 0.10, .floor = 50},   // processes
+    {.relative = 1, .busy = 0.10, .hot = 0.50, .floor = 1000}, // context switches
+};
+
+/** @brief Change of a pressure, in points, from which a sample is busy or hot */
+#define PRESSURE_BUSY 1.0
+#define PRESSURE_HOT 5.0
+
+/** @brief Share of a threshold within which a metric is close to an alert */
+#define ALERT_MARGIN 0.10
+
+static PaceLevel level_of(double change, double busy, double hot)
+{
+    return change >= hot ? PACE_HOT : change >= busy ? PACE_BUSY : PACE_CALM;
+}
+
+/**
+ * @brief Starts a pacer at its shortest interval.
+ *
+ * The first samples come fast until the pacer has seen the system is calm.
+ *
+ * @param pacer The pacer.
+ * @param fastest_ms The shortest interval, at least SAMPLER_MIN_INTERVAL_MS.
+ * @param slowest_ms The longest interval, at least the shortest.
+ */
+void pacer_init(Pacer* pacer, int fastest_ms, int slowest_ms)
+{
+    pacer->fastest_ms = fastest_ms < SAMPLER_MIN_INTERVAL_MS ? SAMPLER_MIN_INTERVAL_MS : fastest_ms;
+    pacer->slowest_ms = slowest_ms < pacer->fastest_ms ? pacer->fastest_ms : slowest_ms;
+    pacer->interval_ms = pacer->fastest_ms;
+    pacer->has_previous = 0;
+}
+
+/**
+ * @brief Rates a sample against the previous one and the alert rules.
+ *
+ * The level is the highest of every metric: a change larger than the busy
+ * or hot step of the metric, or a value within ALERT_MARGIN of the
+ * threshold of a rule, or of its clear value while the rule fires, since
+ * that is where an alert is about to change and its timing matters.
+ * Metrics that could not be read are ignored.
+ *
+ * @param pacer The pacer holding the previous sample.
+ * @param sample The new sample.
+ * @param config The configuration holding the alert rules, NULL for none.
+ * @param firing The bit per firing rule of the configuration.
+ * @return The level of the sample.
+ */
+PaceLevel pacer_level(const Pacer* pacer, const MetricSample* sample, const MonitorConfig* config,
+                      uint64_t firing)
+{
+    PaceLevel level = PACE_CALM;
+    for (int rule = 0; config != NULL && rule < config->rule_count && level != PACE_HOT; rule++)
+    {
+        double value = sampler_metric(sample, config->rules[rule].metric);
+        double boundary = (firing >> rule) & 1 ? config->rules[rule].clear : config->rules[rule].threshold;
+        double margin = fabs(boundary) * ALERT_MARGIN;
+        if (value >= 0 && fabs(value - boundary) <= (margin > 1 ? margin : 1))
+        {
+            level = PACE_HOT;
+        }
+    }
+    if (!pacer->has_previous)
+    {
+        return level;
+    }
+
+    for (int metric = 0; metric < SAMPLER_METRICS && level != PACE_HOT; metric++)
+    {
+        double value = sampler_metric(sample, metric);
+        double previous = sampler_metric(&pacer->previous, metric);
+        if (value < 0 || previous < 0)
+        {
+            continue;
+        }
+        const MetricPace* pace = &metric_paces[metric];
+        double change = fabs(value - previous);
+        if (pace->relative)
+        {
+            change /= previous > pace->floor ? previous : pace->floor;
+        }
+        PaceLevel metric_level = level_of(change, pace->busy, pace->hot);
+        level = metric_level > level ? metric_level : level;
+    }
+    for (int resource = 0; resource < PSI_RESOURCES && level != PACE_HOT; resource++)
+    {
+        if (sample->pressure[resource] >= 0 && pacer->previous.pressure[resource] >= 0)
+        {
+            PaceLevel resource_level = level_of(fabs(sample->pressure[resource] - pacer->previous.pressure[resource]),
+                                                PRESSURE_BUSY, PRESSURE_HOT);
+            level = resource_level > level ? resource_level : level;
+        }
+    }
+    return level;
+}
+
+/**
+ * @brief Takes a sample into account and returns the interval until the next one.
+ *
+ * The interval drops at once when the system becomes interesting and only
+ * grows by half at every calm sample, so a burst is followed closely and a
+ * steady system reaches the longest interval after about fifteen samples.
+ *
+ * @param pacer The pacer.
+ * @param sample The new sample, kept to compare the next one with.
+ * @param config The configuration holding the alert rules, NULL for none.
+ * @param firing The bit per firing rule of the configuration.
+ * @return The interval until the next sample, in milliseconds.
+ */
+int pacer_update(Pacer* pacer, const MetricSample* sample, const MonitorConfig* config, uint64_t firing)
+{
+    switch (pacer_level(pacer, sample, config, firing))
+    {
+    case PACE_HOT:
+        pacer->interval_ms = pacer->fastest_ms;
+        break;
+    case PACE_BUSY:
+        pacer->interval_ms /= 2;
+        break;
+    default:
+        pacer->interval_ms += pacer->interval_ms / 2;
+        break;
+    }
+    if (pacer->interval_ms < pacer->fastest_ms)
+    {
+        pacer->interval_ms = pacer->fastest_ms;
+    }
+    if (pacer->interval_ms > pacer->slowest_ms)
+    {
+        pacer->interval_ms = pacer->slowest_ms;
+    }
+    pacer->previous = *sample;
+    pacer->has_previous = 1;
+    return pacer->interval_ms;
+}
+
+void pacer_wake(Pacer* pacer)
+{
+    pacer->interval_ms = pacer->fastest_ms;
+}
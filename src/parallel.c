@@ -0,0 +1,594 @@
+#define _GNU_SOURCE
+#include "../include/parallel.h"
+#include "../include/colors.h"
+#include "../include/executions.h"
+#include "../include/launcher.h"
+#include "../include/supervisor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/**
+ * @brief Source of the arguments handed to each job.
+ */
+typedef struct
+{
+    /** @brief Arguments given on the command line after ::: */
+    char** items;
+    int count;
+    int next;
+
+    /** @brief Stream with one argument per line (stdin or a :::: file) */
+    FILE* stream;
+    char* line;
+    size_t capacity;
+} ArgumentSource;
+
+/**
+ * @brief Command template shared by every job.
+ */
+typedef struct
+{
+    char** words;
+    int word_count;
+
+    /** @brief Text replaced by the job arguments, NULL to append them */
+    const char* placeholder;
+
+    /** @brief Number of arguments consumed by each job */
+    int per_job;
+} JobTemplate;
+
+/**
+ * @brief A running job of the pool.
+ */
+typedef struct
+{
+    pid_t pid;
+    int output_fd;
+    struct WorkerPool* pool;
+} ParallelSlot;
+
+/**
+ * @brief Bounded pool of workers, reaped by the supervision loop.
+ */
+typedef struct WorkerPool
+{
+    ParallelSlot slots[PARALLEL_MAX_JOBS];
+    int max_jobs;
+    int running;
+    int launched;
+    int failed;
+} WorkerPool;
+
+/**
+ * @brief Returns the number of online CPUs, at least 1.
+ */
+static int online_cpus(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+/**
+ * @brief Parses a job count, 0 meaning one job per online CPU.
+ */
+static int parse_job_count(const char* text)
+{
+    char* end = NULL;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0)
+    {
+        return -1;
+    }
+    if (value == 0)
+    {
+        value = online_cpus();
+    }
+    return value > PARALLEL_MAX_JOBS ? PARALLEL_MAX_JOBS : (int)value;
+}
+
+/**
+ * @brief Splits the builtin argument into a heap allocated word array.
+ */
+static char** split_words(char* arg, int* count)
+{
+    int capacity = 16;
+    char** words = malloc(capacity * sizeof(char*));
+    char* saveptr = NULL;
+    *count = 0;
+    if (words == NULL)
+    {
+        return NULL;
+    }
+    for (char* word = strtok_r(arg, " \t", &saveptr); word != NULL; word = strtok_r(NULL, " \t", &saveptr))
+    {
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            char** grown = realloc(words, capacity * sizeof(char*));
+            if (grown == NULL)
+            {
+                free(words);
+                return NULL;
+            }
+            words = grown;
+        }
+        words[(*count)++] = word;
+    }
+    return words;
+}
+
+/**
+ * @brief Returns a copy of the next argument, or NULL when the source is exhausted.
+ */
+static char* next_argument(ArgumentSource* source)
+{
+    if (source->stream == NULL)
+    {
+        return source->next < source->count ? strdup(source->items[source->next++]) : NULL;
+    }
+
+    ssize_t length;
+    while ((length = getline(&source->line, &source->capacity, source->stream)) != -1)
+    {
+        source->line[strcspn(source->line, "\n")] = '\0';
+        if (source->line[0] != '\0')
+        {
+            return strdup(source->line);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Replaces every occurrence of the placeholder in a template word.
+ */
+static char* replace_placeholder(const char* word, const char* placeholder, const char* value)
+{
+    size_t placeholder_length = strlen(placeholder);
+    size_t value_length = strlen(value);
+    size_t occurrences = 0;
+    for (const char* p = strstr(word, placeholder); p != NULL; p = strstr(p + placeholder_length, placeholder))
+    {
+        occurrences++;
+    }
+
+    char* result = malloc(strlen(word) + occurrences * value_length + 1);
+    if (result == NULL)
+    {
+        return NULL;
+    }
+
+    char* out = result;
+    const char* p;
+    while ((p = strstr(word, placeholder)) != NULL)
+    {
+        memcpy(out, word, p - word);
+        out += p - word;
+        memcpy(out, value, value_length);
+        out += value_length;
+        word = p + placeholder_length;
+    }
+    strcpy(out, word);
+    return result;
+}
+
+/**
+ * @brief Creates an anonymous file that collects the output of one job.
+ */
+static int create_output_file(void)
+{
+    int fd = memfd_create("parallel-job", MFD_CLOEXEC);
+    if (fd != -1)
+    {
+        return fd;
+    }
+
+    char path[] = "/tmp/parallel-job-XXXXXX";
+    fd = mkostemp(path, O_CLOEXEC);
+    if (fd != -1)
+    {
+        unlink(path);
+    }
+    return fd;
+}
+
+/**
+ * @brief Writes the whole buffer, retrying on short writes.
+ */
+static void write_all(int fd, const char* buffer, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, buffer, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        buffer += written;
+        length -= written;
+    }
+}
+
+/**
+ * @brief Prints the collected output of a finished job as a single block.
+ */
+static void flush_job_output(int fd)
+{
+    char buffer[8192];
+    ssize_t length;
+
+    fflush(stdout);
+    if (lseek(fd, 0, SEEK_SET) == 0)
+    {
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+        {
+            write_all(STDOUT_FILENO, buffer, length);
+        }
+    }
+    close(fd);
+}
+
+/**
+ * @brief Prints the output of a finished job and frees its slot.
+ *
+ * Called from the supervision loop when the job ends.
+ */
+static void job_finished(pid_t pid, int status, void* data)
+{
+    ParallelSlot* job = data;
+    (void)pid;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        job->pool->failed++;
+    }
+    if (job->output_fd != -1)
+    {
+        flush_job_output(job->output_fd);
+    }
+    job->pid = 0;
+    job->pool->running--;
+}
+
+/**
+ * @brief Builds the argument vector of one job and launches it into a free slot.
+ */
+static void pool_launch(WorkerPool* pool, const JobTemplate* job, char** arguments, int argument_count)
+{
+    char* argv[LAUNCH_MAX_ARGS + 1];
+    char* owned[LAUNCH_MAX_ARGS];
+    int argc = 0;
+    int owned_count = 0;
+
+    // Several arguments share a single placeholder separated by spaces
+    char joined[4096] = "";
+    for (int i = 0; i < argument_count && job->placeholder != NULL; i++)
+    {
+        if (i > 0)
+        {
+            strncat(joined, " ", sizeof(joined) - strlen(joined) - 1);
+        }
+        strncat(joined, arguments[i], sizeof(joined) - strlen(joined) - 1);
+    }
+
+    for (int i = 0; i < job->word_count && argc < LAUNCH_MAX_ARGS; i++)
+    {
+        if (job->placeholder != NULL && strstr(job->words[i], job->placeholder) != NULL)
+        {
+            char* word = replace_placeholder(job->words[i], job->placeholder, joined);
+            if (word != NULL)
+            {
+                owned[owned_count++] = word;
+                argv[argc++] = word;
+            }
+        }
+        else
+        {
+            argv[argc++] = job->words[i];
+        }
+    }
+    for (int i = 0; i < argument_count && job->placeholder == NULL && argc < LAUNCH_MAX_ARGS; i++)
+    {
+        argv[argc++] = arguments[i];
+    }
+    argv[argc] = NULL;
+
+    ParallelSlot* slot = pool->slots;
+    while (slot->pid != 0)
+    {
+        slot++;
+    }
+
+    LaunchOptions options;
+    launch_options_init(&options);
+    int devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    int output_fd = create_output_file();
+    options.stdin_fd = devnull;
+    options.stdout_fd = output_fd;
+    options.stderr_fd = output_fd;
+    // With a per-stage placement every worker slot keeps its own CPU
+    options.stage = (int)(slot - pool->slots);
+
+    pool->launched++;
+    pid_t pid = launch_process(argv, &options);
+    if (pid == -1)
+    {
+        fprintf(stderr, COLOR_RED "parallel: cannot run %s: %s" COLOR_RESET "\n", argv[0], strerror(errno));
+        pool->failed++;
+        if (output_fd != -1)
+        {
+            close(output_fd);
+        }
+    }
+    if (devnull != -1)
+    {
+        close(devnull);
+    }
+    for (int i = 0; i < owned_count; i++)
+    {
+        free(owned[i]);
+    }
+    if (pid == -1)
+    {
+        return;
+    }
+
+    slot->pid = pid;
+    slot->output_fd = output_fd;
+    slot->pool = pool;
+    pool->running++;
+
+    if (supervisor_watch(pid, job_finished, slot) == -1)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        job_finished(pid, status, slot);
+    }
+}
+
+/**
+ * @brief Runs every argument of the source through the pool.
+ */
+static void run_pool(const JobTemplate* job, ArgumentSource* source, int max_jobs)
+{
+    WorkerPool pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.max_jobs = max_jobs;
+
+    char* arguments[LAUNCH_MAX_ARGS];
+    int exhausted = 0;
+    interrupt_received = 0;
+    while (1)
+    {
+        // After Ctrl-C no new job starts and the running ones are interrupted too
+        if (interrupt_received && !exhausted)
+        {
+            exhausted = 1;
+            for (int i = 0; i < PARALLEL_MAX_JOBS; i++)
+            {
+                if (pool.slots[i].pid != 0)
+                {
+                    kill(pool.slots[i].pid, SIGINT);
+                }
+            }
+        }
+
+        while (!exhausted && pool.running < pool.max_jobs)
+        {
+            int count = 0;
+            char* argument;
+            while (count < job->per_job && (argument = next_argument(source)) != NULL)
+            {
+                arguments[count++] = argument;
+            }
+            if (count < job->per_job)
+            {
+                exhausted = 1;
+            }
+            if (count > 0)
+            {
+                pool_launch(&pool, job, arguments, count);
+            }
+            for (int i = 0; i < count; i++)
+            {
+                free(arguments[i]);
+            }
+        }
+
+        if (pool.running == 0)
+        {
+            break;
+        }
+        // Sleeps until a job ends, its handler frees the slot for the next argument
+        supervisor_dispatch(-1);
+    }
+
+    if (pool.failed > 0)
+    {
+        fprintf(stderr, COLOR_RED "%d of %d jobs failed" COLOR_RESET "\n", pool.failed, pool.launched);
+    }
+}
+
+/**
+ * @brief Runs a command template over arguments given after ::: or read from a :::: file.
+ *
+ * @param arg The options, the template and the arguments.
+ */
+void command_parallel(char* arg)
+{
+    if (arg == NULL)
+    {
+        fprintf(stderr, "Usage: parallel [-j N] command {} ::: args... | :::: file\n");
+        return;
+    }
+
+    int word_count = 0;
+    char** words = split_words(arg, &word_count);
+    if (words == NULL)
+    {
+        perror("malloc");
+        return;
+    }
+
+    int max_jobs = online_cpus();
+    int i = 0;
+    while (i < word_count && words[i][0] == '-')
+    {
+        const char* value = NULL;
+        if (strcmp(words[i], "-j") == 0 || strcmp(words[i], "--jobs") == 0)
+        {
+            value = i + 1 < word_count ? words[++i] : "";
+        }
+        else if (strncmp(words[i], "-j", 2) == 0)
+        {
+            value = words[i] + 2;
+        }
+        else
+        {
+            break;
+        }
+        max_jobs = parse_job_count(value);
+        if (max_jobs == -1)
+        {
+            fprintf(stderr, "parallel: invalid number of jobs: %s\n", value);
+            free(words);
+            return;
+        }
+        i++;
+    }
+
+    JobTemplate job = {.words = words + i, .word_count = 0, .placeholder = NULL, .per_job = 1};
+    while (i < word_count && strcmp(words[i], ":::") != 0 && strcmp(words[i], "::::") != 0)
+    {
+        if (strstr(words[i], "{}") != NULL)
+        {
+            job.placeholder = "{}";
+        }
+        job.word_count++;
+        i++;
+    }
+
+    ArgumentSource source = {0};
+    if (job.word_count == 0 || i >= word_count)
+    {
+        fprintf(stderr, "Usage: parallel [-j N] command {} ::: args... | :::: file\n");
+        free(words);
+        return;
+    }
+
+    if (strcmp(words[i], "::::") == 0)
+    {
+        if (i + 1 >= word_count || (source.stream = fopen(words[i + 1], "r")) == NULL)
+        {
+            fprintf(stderr, "parallel: cannot open argument file\n");
+            free(words);
+            return;
+        }
+    }
+    else
+    {
+        source.items = words + i + 1;
+        source.count = word_count - i - 1;
+    }
+
+    run_pool(&job, &source, max_jobs);
+
+    if (source.stream != NULL)
+    {
+        fclose(source.stream);
+    }
+    free(source.line);
+    free(words);
+}
+
+/**
+ * @brief Runs a command template over the lines read from stdin.
+ *
+ * @param arg The options and the template.
+ */
+void command_xargs(char* arg)
+{
+    static char default_command[] = "echo";
+    char* default_words[] = {default_command};
+    int word_count = 0;
+    char** words = NULL;
+    if (arg != NULL)
+    {
+        words = split_words(arg, &word_count);
+        if (words == NULL)
+        {
+            perror("malloc");
+            return;
+        }
+    }
+
+    int max_jobs = 1;
+    JobTemplate job = {.words = default_words, .word_count = 1, .placeholder = NULL, .per_job = 1};
+    int i = 0;
+    while (i < word_count && words[i][0] == '-')
+    {
+        if (i + 1 >= word_count)
+        {
+            break;
+        }
+        if (strcmp(words[i], "-P") == 0)
+        {
+            max_jobs = parse_job_count(words[i + 1]);
+        }
+        else if (strcmp(words[i], "-n") == 0)
+        {
+            job.per_job = atoi(words[i + 1]);
+        }
+        else if (strcmp(words[i], "-I") == 0)
+        {
+            job.placeholder = words[i + 1];
+        }
+        else
+        {
+            break;
+        }
+        i += 2;
+    }
+
+    if (max_jobs == -1 || job.per_job < 1 || job.per_job > LAUNCH_MAX_ARGS)
+    {
+        fprintf(stderr, "Usage: xargs [-P N] [-n M] [-I replstr] command [initial-arguments]\n");
+        free(words);
+        return;
+    }
+    // -I runs one command per input line, like the standard xargs
+    if (job.placeholder != NULL)
+    {
+        job.per_job = 1;
+    }
+    if (i < word_count)
+    {
+        job.words = words + i;
+        job.word_count = word_count - i;
+    }
+
+    // Read through a private stream so the shell's stdin buffer is left untouched
+    ArgumentSource source = {0};
+    int input_fd = dup(STDIN_FILENO);
+    source.stream = input_fd != -1 ? fdopen(input_fd, "r") : NULL;
+    if (source.stream == NULL)
+    {
+        perror("xargs");
+        free(words);
+        return;
+    }
+
+    run_pool(&job, &source, max_jobs);
+
+    fclose(source.stream);
+    free(source.line);
+    free(words);
+}
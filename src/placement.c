@@ -0,0 +1,444 @@
+#define _GNU_SOURCE
+#include "../include/placement.h"
+#include "../include/commands.h"
+#include "../include/launcher.h"
+#include "../include/shell.h"
+
+#include <errno.h>
+#include <sys/syscall.h>
+
+// Memory policy modes of set_mempolicy, numaif.h is not needed for them
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#define MPOL_BIND 2
+#define MPOL_INTERLEAVE 3
+#endif
+
+/**
+ * @brief Position of a CPU in the cache topology, used to order the CPUs of a placement.
+ */
+typedef struct
+{
+    int cpu;
+    int package;
+    int cache;
+    int thread;
+    int core;
+} CpuPosition;
+
+// Placement given with --pin and --numa, used when no pin command is active
+static CpuPlacement default_placement;
+
+/**
+ * @brief Parses a list such as 0-3,8,10-11 into a set of flags.
+ *
+ * @param text The list.
+ * @param flags Output flags, flags[i] is set to 1 for every listed number.
+ * @param max_value The number of flags.
+ * @return The number of listed values, or -1 if the list is invalid.
+ */
+static int parse_list(const char* text, char* flags, int max_value)
+{
+    memset(flags, 0, max_value);
+    int count = 0;
+    const char* cursor = text;
+    while (*cursor != '\0')
+    {
+        char* end;
+        long first = strtol(cursor, &end, 10);
+        long last = first;
+        if (end == cursor || first < 0)
+        {
+            return -1;
+        }
+        if (*end == '-')
+        {
+            cursor = end + 1;
+            last = strtol(cursor, &end, 10);
+            if (end == cursor || last < first)
+            {
+                return -1;
+            }
+        }
+        if (last >= max_value)
+        {
+            return -1;
+        }
+        for (long value = first; value <= last; value++)
+        {
+            count += !flags[value];
+            flags[value] = 1;
+        }
+        if (*end == ',')
+        {
+            end++;
+        }
+        else if (*end != '\0' && *end != '\n')
+        {
+            return -1;
+        }
+        cursor = end;
+        if (*cursor == '\n')
+        {
+            break;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Reads a small file of sysfs.
+ *
+ * @return 0 on success, -1 if the file cannot be read.
+ */
+static int read_sysfs(const char* path, char* buffer, size_t size)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    int result = fgets(buffer, size, file) != NULL ? 0 : -1;
+    fclose(file);
+    return result;
+}
+
+/**
+ * @brief Reads an integer attribute of a CPU from sysfs, -1 if it is missing.
+ */
+static int read_cpu_attribute(int cpu, const char* attribute)
+{
+    char path[128];
+    char value[32];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", cpu, attribute);
+    return read_sysfs(path, value, sizeof(value)) == 0 ? atoi(value) : -1;
+}
+
+/**
+ * @brief Orders CPU positions by package, last level cache, SMT thread and core.
+ */
+static int compare_positions(const void* left, const void* right)
+{
+    const CpuPosition* a = left;
+    const CpuPosition* b = right;
+    if (a->package != b->package)
+    {
+        return a->package - b->package;
+    }
+    if (a->cache != b->cache)
+    {
+        return a->cache - b->cache;
+    }
+    if (a->thread != b->thread)
+    {
+        return a->thread - b->thread;
+    }
+    if (a->core != b->core)
+    {
+        return a->core - b->core;
+    }
+    return a->cpu - b->cpu;
+}
+
+/**
+ * @brief Fills the CPU list of a placement in cache topology order.
+ *
+ * CPUs of the same package and last level cache are next to each other, and
+ * the first thread of every core comes before the SMT siblings, so
+ * consecutive pipeline stages run on distinct cores that share a cache.
+ */
+static void set_cpus(CpuPlacement* placement, const char* flags)
+{
+    static CpuPosition positions[PLACEMENT_MAX_CPUS];
+    int count = 0;
+    for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++)
+    {
+        if (!flags[cpu])
+        {
+            continue;
+        }
+        CpuPosition* position = &positions[count++];
+        position->cpu = cpu;
+        position->package = read_cpu_attribute(cpu, "topology/physical_package_id");
+        position->core = read_cpu_attribute(cpu, "topology/core_id");
+        position->cache = read_cpu_attribute(cpu, "cache/index3/id");
+        if (position->cache == -1)
+        {
+            position->cache = read_cpu_attribute(cpu, "cache/index2/id");
+        }
+
+        // The first CPU of the sibling list is the first thread of the core
+        char path[128];
+        char siblings[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+        position->thread = read_sysfs(path, siblings, sizeof(siblings)) == 0 && atoi(siblings) != cpu;
+    }
+
+    qsort(positions, count, sizeof(positions[0]), compare_positions);
+    for (int i = 0; i < count; i++)
+    {
+        placement->cpus[i] = positions[i].cpu;
+    }
+    placement->cpu_count = count;
+}
+
+/**
+ * @brief Adds the CPUs of the given NUMA nodes to a set of CPU flags.
+ *
+ * @return 0 on success, -1 if a node does not exist.
+ */
+static int add_node_cpus(const char* nodes, char* cpu_flags)
+{
+    static char node_cpu_flags[PLACEMENT_MAX_CPUS];
+    for (int node = 0; node < PLACEMENT_MAX_NODES; node++)
+    {
+        if (!nodes[node])
+        {
+            continue;
+        }
+        char path[128];
+        char list[1024];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        if (read_sysfs(path, list, sizeof(list)) == -1)
+        {
+            fprintf(stderr, "pin: NUMA node %d does not exist\n", node);
+            return -1;
+        }
+        if (parse_list(list, node_cpu_flags, PLACEMENT_MAX_CPUS) > 0)
+        {
+            for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++)
+            {
+                cpu_flags[cpu] |= node_cpu_flags[cpu];
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses the options of a placement.
+ *
+ * @param spec The space separated options, tokenized in place.
+ * @param placement The placement to update.
+ * @return 0 on success, -1 after printing an error.
+ */
+int placement_parse(char* spec, CpuPlacement* placement)
+{
+    static char cpu_flags[PLACEMENT_MAX_CPUS];
+    static char node_flags[PLACEMENT_MAX_NODES];
+    int has_cpus = 0;
+    int has_nodes = 0;
+    int memory_mode = -1;
+
+    char* saveptr = NULL;
+    for (char* option = strtok_r(spec, " \t", &saveptr); option != NULL; option = strtok_r(NULL, " \t", &saveptr))
+    {
+        char* value = strchr(option, '=');
+        if (value == NULL)
+        {
+            fprintf(stderr, "pin: invalid option %s\n", option);
+            return -1;
+        }
+        *value++ = '\0';
+
+        if (strcmp(option, "cpus") == 0)
+        {
+            if (parse_list(value, cpu_flags, PLACEMENT_MAX_CPUS) <= 0)
+            {
+                fprintf(stderr, "pin: invalid CPU list %s\n", value);
+                return -1;
+            }
+            has_cpus = 1;
+        }
+        else if (strcmp(option, "node") == 0)
+        {
+            if (parse_list(value, node_flags, PLACEMENT_MAX_NODES) <= 0)
+            {
+                fprintf(stderr, "pin: invalid node list %s\n", value);
+                return -1;
+            }
+            has_nodes = 1;
+        }
+        else if (strcmp(option, "mem") == 0)
+        {
+            if (strcmp(value, "bind") == 0)
+            {
+                memory_mode = MPOL_BIND;
+            }
+            else if (strcmp(value, "interleave") == 0)
+            {
+                memory_mode = MPOL_INTERLEAVE;
+            }
+            else if (strcmp(value, "preferred") == 0)
+            {
+                memory_mode = MPOL_PREFERRED;
+            }
+            else
+            {
+                fprintf(stderr, "pin: unknown memory policy %s\n", value);
+                return -1;
+            }
+        }
+        else if (strcmp(option, "layout") == 0)
+        {
+            if (strcmp(value, "set") != 0 && strcmp(value, "siblings") != 0)
+            {
+                fprintf(stderr, "pin: unknown layout %s\n", value);
+                return -1;
+            }
+            placement->per_stage = strcmp(value, "siblings") == 0;
+        }
+        else
+        {
+            fprintf(stderr, "pin: unknown option %s\n", option);
+            return -1;
+        }
+    }
+
+    if (memory_mode != -1 && !has_nodes)
+    {
+        fprintf(stderr, "pin: mem needs a node list\n");
+        return -1;
+    }
+
+    if (has_nodes)
+    {
+        // Without an explicit CPU list the processes run on the CPUs of the nodes
+        if (!has_cpus)
+        {
+            memset(cpu_flags, 0, sizeof(cpu_flags));
+            if (add_node_cpus(node_flags, cpu_flags) == -1)
+            {
+                return -1;
+            }
+            has_cpus = 1;
+        }
+        memset(placement->nodes, 0, sizeof(placement->nodes));
+        for (int node = 0; node < PLACEMENT_MAX_NODES; node++)
+        {
+            if (node_flags[node])
+            {
+                placement->nodes[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+            }
+        }
+        placement->memory_mode = memory_mode != -1 ? memory_mode : MPOL_BIND;
+    }
+    if (has_cpus)
+    {
+        set_cpus(placement, cpu_flags);
+        if (placement->cpu_count == 0)
+        {
+            fprintf(stderr, "pin: the nodes have no CPUs\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses a placement and makes it the default of the session.
+ *
+ * @param spec The placement specification.
+ * @return 0 on success, -1 on error.
+ */
+int placement_set_default(char* spec)
+{
+    CpuPlacement placement = launch_context.placement != NULL ? *launch_context.placement : (CpuPlacement){0};
+    if (launch_context.placement == NULL)
+    {
+        placement.memory_mode = -1;
+    }
+    if (placement_parse(spec, &placement) == -1)
+    {
+        return -1;
+    }
+    default_placement = placement;
+    launch_context.placement = &default_placement;
+    return 0;
+}
+
+/**
+ * @brief Sets the memory policy and the CPU affinity in a forked child.
+ *
+ * The memory policy is inherited across exec, so it applies to every
+ * allocation of the program.
+ *
+ * @param placement The placement, or NULL.
+ * @param stage The position of the process in its pipeline.
+ * @return 0 on success, -1 with errno set.
+ */
+int placement_apply_in_child(const CpuPlacement* placement, int stage)
+{
+    if (placement == NULL)
+    {
+        return 0;
+    }
+
+    if (placement->memory_mode != -1 &&
+        syscall(SYS_set_mempolicy, placement->memory_mode, placement->nodes, PLACEMENT_MAX_NODES + 1) == -1)
+    {
+        return -1;
+    }
+
+    if (placement->cpu_count > 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (placement->per_stage)
+        {
+            CPU_SET(placement->cpus[(stage < 0 ? 0 : stage) % placement->cpu_count], &set);
+        }
+        else
+        {
+            for (int i = 0; i < placement->cpu_count; i++)
+            {
+                CPU_SET(placement->cpus[i], &set);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) == -1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the rest of the line with the given CPU and NUMA placement.
+ *
+ * Options of an enclosing pin command or of --pin and --numa are inherited
+ * and can be overridden.
+ *
+ * @param arg The options followed by the command line.
+ */
+void command_pin(char* arg)
+{
+    const CpuPlacement* previous = launch_context.placement;
+    CpuPlacement placement;
+    if (previous != NULL)
+    {
+        placement = *previous;
+    }
+    else
+    {
+        memset(&placement, 0, sizeof(placement));
+        placement.memory_mode = -1;
+    }
+
+    char* options;
+    char* command_line = split_prefix_options(arg, &options);
+    if (command_line == NULL)
+    {
+        fprintf(stderr, "Usage: pin [cpus=LIST] [node=LIST] [mem=bind|interleave|preferred] [layout=set|siblings] "
+                        "[--] command\n");
+        return;
+    }
+    if (placement_parse(options, &placement) == -1)
+    {
+        return;
+    }
+
+    launch_context.placement = &placement;
+    choose_execution(command_line);
+    launch_context.placement = previous;
+}
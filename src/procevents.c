@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+#include "../include/procevents.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Slot of a PID that was removed, probing goes on past it */
+#define REMOVED_PID ((pid_t)-1)
+
+/**
+ * @brief Subscription message to the proc connector.
+ */
+typedef struct __attribute__((packed))
+{
+    struct nlmsghdr header;
+    struct cn_msg message;
+    enum proc_cn_mcast_op operation;
+} Subscription;
+
+static struct
+{
+    int fd;
+    int error;
+    /** @brief Open addressing set of live PIDs, 0 for a free slot */
+    pid_t* pids;
+    int size;
+    int count;
+    int removed;
+    /** @brief Second the current counters belong to */
+    time_t second;
+    int forks;
+    int execs;
+    int exits;
+    pthread_mutex_t lock;
+    ProcEventStats stats;
+} events = {.fd = -1, .pids = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static unsigned slot_of(pid_t pid)
+{
+    return ((uint32_t)pid * 2654435761u) & (unsigned)(events.size - 1);
+}
+
+static int set_rehash(int size);
+
+static void set_add(pid_t pid)
+{
+    if ((events.count + events.removed + 1) * 10 > events.size * 7 &&
+        set_rehash(events.count * 4 > events.size ? events.size * 2 : events.size) == -1)
+    {
+        return;
+    }
+    unsigned slot = slot_of(pid);
+    int reuse = -1;
+    while (events.pids[slot] != 0)
+    {
+        if (events.pids[slot] == pid)
+        {
+            return;
+        }
+        if (events.pids[slot] == REMOVED_PID && reuse == -1)
+        {
+            reuse = (int)slot;
+        }
+        slot = (slot + 1) & (unsigned)(events.size - 1);
+    }
+    if (reuse != -1)
+    {
+        slot = (unsigned)reuse;
+        events.removed--;
+    }
+    events.pids[slot] = pid;
+    events.count++;
+}
+
+static void set_remove(pid_t pid)
+{
+    for (unsigned slot = slot_of(pid); events.pids[slot] != 0; slot = (slot + 1) & (unsigned)(events.size - 1))
+    {
+        if (events.pids[slot] == pid)
+        {
+            events.pids[slot] = REMOVED_PID;
+            events.count--;
+            events.removed++;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Moves the live PIDs into a table of the given size, dropping the removed slots.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+static int set_rehash(int size)
+{
+    pid_t* pids = calloc((size_t)size, sizeof(pid_t));
+    if (pids == NULL)
+    {
+        return -1;
+    }
+    pid_t* old = events.pids;
+    int old_size = events.size;
+    events.pids = pids;
+    events.size = size;
+    events.count = events.removed = 0;
+    for (int slot = 0; slot < old_size; slot++)
+    {
+        if (old[slot] > 0)
+        {
+            set_add(old[slot]);
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/**
+ * @brief Rebuilds the live set from the numeric entries of /proc.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int set_rescan(void)
+{
+    DIR* proc = opendir("/proc");
+    if (proc == NULL)
+    {
+        return -1;
+    }
+    memset(events.pids, 0, (size_t)events.size * sizeof(pid_t));
+    events.count = events.removed = 0;
+    struct dirent* entry;
+    while ((entry = readdir(proc)) != NULL)
+    {
+        if (entry->d_name[0] >= '1' && entry->d_name[0] <= '9')
+        {
+            set_add((pid_t)atoi(entry->d_name));
+        }
+    }
+    closedir(proc);
+    return 0;
+}
+
+/**
+ * @brief Publishes the counters of the current second once it is over.
+ */
+static void roll_second(time_t now)
+{
+    if (now == events.second)
+    {
+        return;
+    }
+    pthread_mutex_lock(&events.lock);
+    // A gap of more than one second had no event in its last second
+    int last_complete = now == events.second + 1;
+    events.stats.forks_per_second = last_complete ? events.forks : 0;
+    events.stats.execs_per_second = last_complete ? events.execs : 0;
+    events.stats.exits_per_second = last_complete ? events.exits : 0;
+    if (events.forks >= PROCEVENTS_STORM_FORKS)
+    {
+        events.stats.storms++;
+    }
+    pthread_mutex_unlock(&events.lock);
+    events.forks = events.execs = events.exits = 0;
+    events.second = now;
+}
+
+static void publish_count(void)
+{
+    pthread_mutex_lock(&events.lock);
+    events.stats.processes = events.count;
+    pthread_mutex_unlock(&events.lock);
+}
+
+/**
+ * @brief Subscribes to the process events of the kernel proc connector.
+ *
+ * The subscription comes before the scan of /proc, so a process started
+ * in between is seen by both; adding it twice to the set is harmless.
+ *
+ * @return The descriptor to poll, or -1 on error with the reason kept for procevents_stats.
+ */
+int procevents_open(void)
+{
+    if (events.fd != -1)
+    {
+        return events.fd;
+    }
+    events.fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_CONNECTOR);
+    struct sockaddr_nl address = {.nl_family = AF_NETLINK, .nl_groups = CN_IDX_PROC, .nl_pid = 0};
+    Subscription subscription;
+    memset(&subscription, 0, sizeof(subscription));
+    subscription.header.nlmsg_len = sizeof(subscription);
+    subscription.header.nlmsg_type = NLMSG_DONE;
+    subscription.message.id.idx = CN_IDX_PROC;
+    subscription.message.id.val = CN_VAL_PROC;
+    subscription.message.len = sizeof(enum proc_cn_mcast_op);
+    subscription.operation = PROC_CN_MCAST_LISTEN;
+
+    if (events.fd == -1 || bind(events.fd, (struct sockaddr*)&address, sizeof(address)) == -1 ||
+        send(events.fd, &subscription, sizeof(subscription), 0) == -1 || set_rehash(4096) == -1 ||
+        set_rescan() == -1)
+    {
+        int saved = errno;
+        procevents_close();
+        events.error = saved;
+        errno = saved;
+        return -1;
+    }
+
+    events.error = 0;
+    events.second = time(NULL);
+    events.forks = events.execs = events.exits = 0;
+    pthread_mutex_lock(&events.lock);
+    memset(&events.stats, 0, sizeof(events.stats));
+    events.stats.listening = 1;
+    pthread_mutex_unlock(&events.lock);
+    publish_count();
+    return events.fd;
+}
+
+/**
+ * @brief Applies one event to the live set and the counters.
+ *
+ * Thread creations and ends are events too; only the ones of a thread
+ * group leader start or end a process.
+ */
+static void apply_event(const struct proc_event* event)
+{
+    switch (event->what)
+    {
+    case PROC_EVENT_FORK:
+        if (event->event_data.fork.child_pid == event->event_data.fork.child_tgid)
+        {
+            set_add(event->event_data.fork.child_tgid);
+            events.forks++;
+        }
+        break;
+    case PROC_EVENT_EXEC:
+        events.execs++;
+        break;
+    case PROC_EVENT_EXIT:
+        if (event->event_data.exit.process_pid == event->event_data.exit.process_tgid)
+        {
+            set_remove(event->event_data.exit.process_tgid);
+            events.exits++;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Reads the pending events and applies them to the live set.
+ *
+ * ENOBUFS means the socket buffer overflowed and events were lost, which a
+ * fork storm can cause; the set is then rebuilt from /proc.
+ *
+ * @return The number of events applied, -1 on error.
+ */
+int procevents_drain(void)
+{
+    if (events.fd == -1)
+    {
+        return -1;
+    }
+    static char buffer[16 * 1024] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int applied = 0;
+    int error;
+    while (1)
+    {
+        ssize_t length = recv(events.fd, buffer, sizeof(buffer), 0);
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == ENOBUFS)
+            {
+                set_rescan();
+                pthread_mutex_lock(&events.lock);
+                events.stats.resyncs++;
+                pthread_mutex_unlock(&events.lock);
+                continue;
+            }
+            error = errno;
+            break;
+        }
+        roll_second(time(NULL));
+        for (struct nlmsghdr* header = (struct nlmsghdr*)buffer; NLMSG_OK(header, (size_t)length);
+             header = NLMSG_NEXT(header, length))
+        {
+            if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP)
+            {
+                continue;
+            }
+            struct cn_msg* message = NLMSG_DATA(header);
+            if (message->id.idx == CN_IDX_PROC && message->id.val == CN_VAL_PROC)
+            {
+                apply_event((struct proc_event*)message->data);
+                applied++;
+            }
+        }
+    }
+    roll_second(time(NULL));
+    publish_count();
+    return error == EAGAIN || error == EWOULDBLOCK ? applied : -1;
+}
+
+int procevents_active(void)
+{
+    return events.fd != -1;
+}
+
+int procevents_count(void)
+{
+    pthread_mutex_lock(&events.lock);
+    int count = events.stats.processes;
+    pthread_mutex_unlock(&events.lock);
+    return count;
+}
+
+void procevents_stats(ProcEventStats* stats)
+{
+    pthread_mutex_lock(&events.lock);
+    *stats = events.stats;
+    stats->listening = events.fd != -1;
+    stats->error = events.error;
+    pthread_mutex_unlock(&events.lock);
+}
+
+void procevents_close(void)
+{
+    if (events.fd != -1)
+    {
+        close(events.fd);
+        events.fd = -1;
+    }
+    free(events.pids);
+    events.pids = NULL;
+    events.size = events.count = events.removed = 0;
+    pthread_mutex_lock(&events.lock);
+    events.stats.listening = 0;
+    pthread_mutex_unlock(&events.lock);
+}
+
+/**
+ * @brief Builtin showing the state of the process event listener.
+ *
+ * The listener runs in the sampler thread, started by start_monitor.
+ *
+ * @param arg Unused.
+ */
+void command_proc_events(char* arg)
+{
+    (void)arg;
+    ProcEventStats stats;
+    procevents_stats(&stats);
+    if (!stats.listening)
+    {
+        if (stats.error != 0)
+        {
+            printf("Process events: scanning /proc, netlink unavailable: %s\n", strerror(stats.error));
+        }
+        else
+        {
+            printf("Process events: not listening, start the sampler with start_monitor events=on\n");
+        }
+        return;
+    }
+    printf("Process events: netlink proc connector\n");
+    printf("Processes: %d\n", stats.processes);
+    printf("Last second: %d forks, %d execs, %d exits\n", stats.forks_per_second, stats.execs_per_second,
+           stats.exits_per_second);
+    printf("Fork storms: %llu (from %d forks/s)\n", (unsigned long long)stats.storms, PROCEVENTS_STORM_FORKS);
+    printf("Rescans after lost events: %llu\n", (unsigned long long)stats.resyncs);
+}
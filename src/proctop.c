@@ -0,0 +1,613 @@
+#define _GNU_SOURCE
+#include "../include/proctop.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Record of a process kept across scans.
+ */
+typedef struct
+{
+    pid_t pid;
+    /** @brief Open stat file of the process, -1 when it is opened for each read */
+    int stat_fd;
+    /** @brief Open io file of the process, -1 when it is opened for each read */
+    int io_fd;
+    /** @brief 0 once the io file turned out unreadable, it is then not tried again */
+    int io_readable;
+    /** @brief Scan the process was last seen in */
+    uint32_t generation;
+    /** @brief Start time of the process in ticks, tells a reused PID apart */
+    uint64_t start_time;
+    uint64_t cpu_ticks;
+    uint64_t io_bytes;
+    ProcessUsage usage;
+} ProcessEntry;
+
+/**
+ * @brief Layout of the records returned by getdents64.
+ */
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static struct
+{
+    int proc_fd;
+    ProcessEntry* entries;
+    int count;
+    int capacity;
+    /** @brief Open addressing table of entry indexes by PID, -1 for a free slot */
+    int* index;
+    int index_size;
+    uint32_t generation;
+    int open_fds;
+    int fd_budget;
+    struct timespec last_scan;
+    long ticks_per_second;
+    long page_size;
+} table = {.proc_fd = -1, .entries = NULL, .index = NULL};
+
+static unsigned hash_pid(pid_t pid, int size)
+{
+    return ((uint32_t)pid * 2654435761u) & (unsigned)(size - 1);
+}
+
+static int find_entry(pid_t pid)
+{
+    for (unsigned slot = hash_pid(pid, table.index_size);; slot = (slot + 1) & (unsigned)(table.index_size - 1))
+    {
+        int entry = table.index[slot];
+        if (entry == -1 || table.entries[entry].pid == pid)
+        {
+            return entry;
+        }
+    }
+}
+
+static void index_entry(int entry)
+{
+    unsigned slot = hash_pid(table.entries[entry].pid, table.index_size);
+    while (table.index[slot] != -1)
+    {
+        slot = (slot + 1) & (unsigned)(table.index_size - 1);
+    }
+    table.index[slot] = entry;
+}
+
+/**
+ * @brief Rebuilds the PID index, at least twice as large as the entries.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+static int rebuild_index(void)
+{
+    int size = table.index_size == 0 ? 1024 : table.index_size;
+    while (size < table.capacity * 2)
+    {
+        size *= 2;
+    }
+    if (size != table.index_size)
+    {
+        int* index = realloc(table.index, (size_t)size * sizeof(int));
+        if (index == NULL)
+        {
+            return -1;
+        }
+        table.index = index;
+        table.index_size = size;
+    }
+    memset(table.index, 0xff, (size_t)table.index_size * sizeof(int));
+    for (int entry = 0; entry < table.count; entry++)
+    {
+        index_entry(entry);
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets up /proc and the descriptor budget on first use.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int table_open(void)
+{
+    if (table.proc_fd != -1)
+    {
+        return 0;
+    }
+    table.proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (table.proc_fd == -1)
+    {
+        return -1;
+    }
+    // Half of the limit stays free for the shell and the commands it runs
+    struct rlimit limit;
+    table.fd_budget = getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+                          ? (int)(limit.rlim_cur / 2)
+                          : 512;
+    table.ticks_per_second = sysconf(_SC_CLK_TCK);
+    table.page_size = sysconf(_SC_PAGESIZE);
+    table.count = table.capacity = 0;
+    table.open_fds = 0;
+    return rebuild_index();
+}
+
+/**
+ * @brief Opens a file of a process, kept open if the budget allows it.
+ *
+ * @param kept Set to 1 if the descriptor should stay open.
+ * @return The descriptor, or -1 on error.
+ */
+static int open_process_file(pid_t pid, const char* name, int* kept)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "%d/%s", (int)pid, name);
+    int fd = openat(table.proc_fd, path, O_RDONLY | O_CLOEXEC);
+    *kept = fd != -1 && table.open_fds < table.fd_budget;
+    if (*kept)
+    {
+        table.open_fds++;
+    }
+    return fd;
+}
+
+/**
+ * @brief Reads a file of a process, through its kept descriptor or a transient one.
+ *
+ * @param fd The kept descriptor, replaced when a new one is kept.
+ * @return The number of bytes read, -1 on error.
+ */
+static ssize_t read_process_file(pid_t pid, const char* name, int* fd, char* buffer, size_t size)
+{
+    if (*fd != -1)
+    {
+        return pread(*fd, buffer, size - 1, 0);
+    }
+    int kept;
+    int transient = open_process_file(pid, name, &kept);
+    if (transient == -1)
+    {
+        return -1;
+    }
+    ssize_t length = pread(transient, buffer, size - 1, 0);
+    if (kept)
+    {
+        *fd = transient;
+    }
+    else
+    {
+        close(transient);
+    }
+    return length;
+}
+
+static void close_entry(ProcessEntry* entry)
+{
+    if (entry->stat_fd != -1)
+    {
+        close(entry->stat_fd);
+        table.open_fds--;
+    }
+    if (entry->io_fd != -1)
+    {
+        close(entry->io_fd);
+        table.open_fds--;
+    }
+    entry->stat_fd = entry->io_fd = -1;
+}
+
+/**
+ * @brief Parses the unsigned field at a position of a stat line.
+ *
+ * @param cursor Moved past the field and the space after it.
+ */
+static uint64_t next_field(const char** cursor)
+{
+    const char* text = *cursor;
+    uint64_t value = 0;
+    if (*text == '-')
+    {
+        text++;
+    }
+    while (*text >= '0' && *text <= '9')
+    {
+        value = value * 10 + (uint64_t)(*text - '0');
+        text++;
+    }
+    while (*text == ' ')
+    {
+        text++;
+    }
+    *cursor = text;
+    return value;
+}
+
+static void skip_fields(const char** cursor, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const char* space = strchr(*cursor, ' ');
+        *cursor = space == NULL ? *cursor + strlen(*cursor) : space + 1;
+    }
+}
+
+/**
+ * @brief Reads the stat and io files of a process into its entry.
+ *
+ * The command is between the first '(' and the last ')', since it may hold
+ * both; the fields after it are counted from the state, field 3.
+ *
+ * @param elapsed The seconds since the previous scan, 0 on the first one.
+ * @return 0 on success, -1 if the process is gone.
+ */
+static int update_entry(ProcessEntry* entry, double elapsed)
+{
+    char buffer[1024];
+    ssize_t length = read_process_file(entry->pid, "stat", &entry->stat_fd, buffer, sizeof(buffer));
+    if (length <= 0)
+    {
+        return -1;
+    }
+    buffer[length] = '\0';
+    char* open = strchr(buffer, '(');
+    char* close_paren = strrchr(buffer, ')');
+    if (open == NULL || close_paren == NULL || close_paren[1] != ' ')
+    {
+        return -1;
+    }
+
+    size_t name_length = (size_t)(close_paren - open - 1);
+    if (name_length >= sizeof(entry->usage.command))
+    {
+        name_length = sizeof(entry->usage.command) - 1;
+    }
+    memcpy(entry->usage.command, open + 1, name_length);
+    entry->usage.command[name_length] = '\0';
+
+    // Fields 3 to 13, then utime and stime (14, 15), then 16 to 21, starttime (22), vsize (23) and rss (24)
+    const char* cursor = close_paren + 2;
+    skip_fields(&cursor, 11);
+    uint64_t ticks = next_field(&cursor);
+    ticks += next_field(&cursor);
+    skip_fields(&cursor, 6);
+    uint64_t start_time = next_field(&cursor);
+    next_field(&cursor);
+    uint64_t rss_pages = next_field(&cursor);
+
+    int reused = entry->start_time != start_time;
+    double previous_ticks = reused ? (double)ticks : (double)entry->cpu_ticks;
+    entry->usage.cpu_percent =
+        elapsed > 0 ? ((double)ticks - previous_ticks) * 100.0 / ((double)table.ticks_per_second * elapsed) : 0;
+    entry->cpu_ticks = ticks;
+    entry->start_time = start_time;
+    entry->usage.rss_bytes = rss_pages * (uint64_t)table.page_size;
+
+    entry->usage.io_rate = -1;
+    if (!entry->io_readable)
+    {
+        return 0;
+    }
+    length = read_process_file(entry->pid, "io", &entry->io_fd, buffer, sizeof(buffer));
+    if (length <= 0)
+    {
+        // Other users' processes hide their io file, it is not tried again
+        entry->io_readable = 0;
+        return 0;
+    }
+    buffer[length] = '\0';
+    uint64_t io_bytes = 0;
+    // Only the lines that start with the key, cancelled_write_bytes is not written to the device
+    char* saveptr = NULL;
+    for (char* line = strtok_r(buffer, "\n", &saveptr); line != NULL; line = strtok_r(NULL, "\n", &saveptr))
+    {
+        unsigned long long bytes;
+        if (sscanf(line, "read_bytes: %llu", &bytes) == 1 || sscanf(line, "write_bytes: %llu", &bytes) == 1)
+        {
+            io_bytes += bytes;
+        }
+    }
+    entry->usage.io_rate =
+        elapsed > 0 && !reused && io_bytes >= entry->io_bytes ? (double)(io_bytes - entry->io_bytes) / elapsed : 0;
+    entry->io_bytes = io_bytes;
+    return 0;
+}
+
+/**
+ * @brief Finds or adds the entry of a PID listed in /proc.
+ *
+ * @return The index of the entry, -1 if memory is exhausted.
+ */
+static int entry_for(pid_t pid)
+{
+    int entry = find_entry(pid);
+    if (entry != -1)
+    {
+        return entry;
+    }
+    if (table.count == table.capacity)
+    {
+        int capacity = table.capacity == 0 ? 512 : table.capacity * 2;
+        ProcessEntry* entries = realloc(table.entries, (size_t)capacity * sizeof(ProcessEntry));
+        if (entries == NULL)
+        {
+            return -1;
+        }
+        table.entries = entries;
+        table.capacity = capacity;
+        if (table.capacity * 2 > table.index_size && rebuild_index() == -1)
+        {
+            return -1;
+        }
+    }
+    entry = table.count++;
+    ProcessEntry* added = &table.entries[entry];
+    memset(added, 0, sizeof(*added));
+    added->pid = pid;
+    added->usage.pid = pid;
+    added->stat_fd = added->io_fd = -1;
+    added->io_readable = 1;
+    index_entry(entry);
+    return entry;
+}
+
+/**
+ * @brief Scans the processes and updates their usage.
+ *
+ * Entries of processes not listed any more are closed and dropped at the
+ * end, and the index is rebuilt over the remaining ones. Between scans the
+ * table keeps its arrays, so a steady system costs no allocation.
+ *
+ * @return The number of processes, -1 on error.
+ */
+int proctop_scan(void)
+{
+    if (table_open() == -1)
+    {
+        return -1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = table.generation == 0 ? 0
+                                           : (double)(now.tv_sec - table.last_scan.tv_sec) +
+                                                 (double)(now.tv_nsec - table.last_scan.tv_nsec) / 1e9;
+    table.last_scan = now;
+    table.generation++;
+
+    static char buffer[64 * 1024];
+    lseek(table.proc_fd, 0, SEEK_SET);
+    long length;
+    while ((length = syscall(SYS_getdents64, table.proc_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (long offset = 0; offset < length;)
+        {
+            struct linux_dirent64* record = (struct linux_dirent64*)(buffer + offset);
+            offset += record->d_reclen;
+            if (record->d_type != DT_DIR || record->d_name[0] < '1' || record->d_name[0] > '9')
+            {
+                continue;
+            }
+            int entry = entry_for((pid_t)atoi(record->d_name));
+            if (entry == -1)
+            {
+                return -1;
+            }
+            ProcessEntry* process = &table.entries[entry];
+            if (update_entry(process, process->generation + 1 == table.generation ? elapsed : 0) == 0)
+            {
+                process->generation = table.generation;
+            }
+        }
+    }
+    if (length == -1)
+    {
+        return -1;
+    }
+
+    int kept = 0;
+    for (int entry = 0; entry < table.count; entry++)
+    {
+        if (table.entries[entry].generation == table.generation)
+        {
+            table.entries[kept++] = table.entries[entry];
+        }
+        else
+        {
+            close_entry(&table.entries[entry]);
+        }
+    }
+    if (kept != table.count)
+    {
+        table.count = kept;
+        rebuild_index();
+    }
+    return table.count;
+}
+
+static double order_value(const ProcessUsage* usage, ProcessOrder order)
+{
+    switch (order)
+    {
+    case PROCTOP_BY_RSS:
+        return (double)usage->rss_bytes;
+    case PROCTOP_BY_IO:
+        return usage->io_rate;
+    default:
+        return usage->cpu_percent;
+    }
+}
+
+/**
+ * @brief Returns the processes using the most of a resource.
+ *
+ * The heaviest ones are kept sorted in the output while the table is read
+ * once, which costs O(processes × count) for the few rows shown.
+ *
+ * @param top Where the processes are stored, the heaviest first.
+ * @param count The size of top.
+ * @param order The resource to rank by.
+ * @return The number of processes stored.
+ */
+int proctop_top(ProcessUsage* top, int count, ProcessOrder order)
+{
+    int used = 0;
+    for (int entry = 0; entry < table.count; entry++)
+    {
+        const ProcessUsage* usage = &table.entries[entry].usage;
+        double value = order_value(usage, order);
+        if (used == count && (count == 0 || value <= order_value(&top[count - 1], order)))
+        {
+            continue;
+        }
+        int position = used < count ? used++ : count - 1;
+        while (position > 0 && order_value(&top[position - 1], order) < value)
+        {
+            top[position] = top[position - 1];
+            position--;
+        }
+        top[position] = *usage;
+    }
+    return used;
+}
+
+int proctop_lookup(pid_t pid, ProcessUsage* usage)
+{
+    if (table.proc_fd == -1)
+    {
+        return 0;
+    }
+    int entry = find_entry(pid);
+    if (entry == -1)
+    {
+        return 0;
+    }
+    *usage = table.entries[entry].usage;
+    return 1;
+}
+
+int proctop_open_descriptors(void)
+{
+    return table.open_fds;
+}
+
+void proctop_close(void)
+{
+    for (int entry = 0; entry < table.count; entry++)
+    {
+        close_entry(&table.entries[entry]);
+    }
+    if (table.proc_fd != -1)
+    {
+        close(table.proc_fd);
+    }
+    free(table.entries);
+    free(table.index);
+    table.entries = NULL;
+    table.index = NULL;
+    table.proc_fd = -1;
+    table.count = table.capacity = table.index_size = 0;
+    table.generation = 0;
+}
+
+/**
+ * @brief Formats a number of bytes with a binary unit.
+ */
+static void format_bytes(double bytes, char* text, size_t size)
+{
+    static const char* units[] = {"B", "K", "M", "G", "T"};
+    int unit = 0;
+    while (bytes >= 1024 && unit < 4)
+    {
+        bytes /= 1024;
+        unit++;
+    }
+    snprintf(text, size, unit == 0 ? "%.0f%s" : "%.1f%s", bytes, units[unit]);
+}
+
+/**
+ * @brief Builtin listing the processes using the most CPU, memory or I/O.
+ *
+ * The table lives as long as the shell, so each ps_top measures the usage
+ * since the previous one; the first one scans twice, a short interval apart.
+ *
+ * @param arg The count and the order.
+ */
+void command_ps_top(char* arg)
+{
+    int count = PROCTOP_DEFAULT_COUNT;
+    ProcessOrder order = PROCTOP_BY_CPU;
+    char* state;
+    for (char* word = arg == NULL ? NULL : strtok_r(arg, " \t\n", &state); word != NULL;
+         word = strtok_r(NULL, " \t\n", &state))
+    {
+        if (strcmp(word, "sort=cpu") == 0)
+        {
+            order = PROCTOP_BY_CPU;
+        }
+        else if (strcmp(word, "sort=rss") == 0)
+        {
+            order = PROCTOP_BY_RSS;
+        }
+        else if (strcmp(word, "sort=io") == 0)
+        {
+            order = PROCTOP_BY_IO;
+        }
+        else if (atoi(word) > 0 && atoi(word) <= 1000)
+        {
+            count = atoi(word);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: ps_top [N] [sort=cpu|rss|io]\n");
+            return;
+        }
+    }
+
+    int first = table.generation == 0;
+    int processes = proctop_scan();
+    if (processes != -1 && first)
+    {
+        struct timespec pause = {0, PROCTOP_FIRST_INTERVAL_MS * 1000000L};
+        nanosleep(&pause, NULL);
+        processes = proctop_scan();
+    }
+    if (processes == -1)
+    {
+        perror("ps_top");
+        return;
+    }
+
+    ProcessUsage* top = malloc((size_t)count * sizeof(ProcessUsage));
+    if (top == NULL)
+    {
+        perror("ps_top");
+        return;
+    }
+    int shown = proctop_top(top, count, order);
+    printf("%d processes, %d descriptors kept open\n", processes, table.open_fds);
+    printf("%7s  %-16s %7s %9s %10s\n", "PID", "COMMAND", "CPU%", "RSS", "IO/s");
+    for (int i = 0; i < shown; i++)
+    {
+        char rss[16];
+        char io[16] = "-";
+        format_bytes((double)top[i].rss_bytes, rss, sizeof(rss));
+        if (top[i].io_rate >= 0)
+        {
+            format_bytes(top[i].io_rate, io, sizeof(io));
+        }
+        printf("%7d  %-16s %7.1f %9s %10s\n", (int)top[i].pid, top[i].command, top[i].cpu_percent, rss, io);
+    }
+    free(top);
+}
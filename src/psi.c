@@ -0,0 +1,248 @@
+#define _GNU_SOURCE
+#include "../include/psi.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+const char* const psi_resource_names[PSI_RESOURCES] = {"cpu", "memory", "io"};
+
+static struct
+{
+    /** @brief Bit per resource whose trigger fired since the last warning */
+    unsigned pending;
+    uint64_t fired[PSI_RESOURCES];
+} triggers = {0, {0}};
+
+/**
+ * @brief Parses one line of a pressure file after its some or full word.
+ */
+static void parse_line(const char* text, PsiLine* line)
+{
+    const char* value;
+    line->avg10 = (value = strstr(text, "avg10=")) != NULL ? strtod(value + 6, NULL) : 0;
+    line->avg60 = (value = strstr(text, "avg60=")) != NULL ? strtod(value + 6, NULL) : 0;
+    line->avg300 = (value = strstr(text, "avg300=")) != NULL ? strtod(value + 7, NULL) : 0;
+    line->total_us = (value = strstr(text, "total=")) != NULL ? strtoull(value + 6, NULL, 10) : 0;
+}
+
+/**
+ * @brief Parses the text of a pressure file.
+ *
+ * The full line is missing for cpu on kernels before 5.13; it is then zero.
+ *
+ * @param text The content of the file.
+ * @param stats Where the pressure is stored.
+ * @return 0 on success, -1 if there is no some line.
+ */
+int psi_parse(const char* text, PsiStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (strncmp(text, "some ", 5) != 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    const char* end = strchr(text, '\n');
+    char some[256];
+    size_t length = end != NULL ? (size_t)(end - text) : strlen(text);
+    snprintf(some, sizeof(some), "%.*s", (int)length, text);
+    parse_line(some, &stats->some);
+    if (end != NULL && strncmp(end + 1, "full ", 5) == 0)
+    {
+        parse_line(end + 1, &stats->full);
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads /proc/pressure/RESOURCE.
+ *
+ * @param resource The resource.
+ * @param stats Where the pressure is stored.
+ * @return 0 on success, -1 if the kernel has no PSI support or it is disabled.
+ */
+int psi_read(PsiResource resource, PsiStats* stats)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/pressure/%s", psi_resource_names[resource]);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    char text[512];
+    ssize_t length;
+    do
+    {
+        length = read(fd, text, sizeof(text) - 1);
+    } while (length == -1 && errno == EINTR);
+    close(fd);
+    if (length <= 0)
+    {
+        // Reads fail with EOPNOTSUPP when the kernel was booted with psi=0
+        return -1;
+    }
+    text[length] = '\0';
+    return psi_parse(text, stats);
+}
+
+void psi_default_triggers(PsiTrigger defaults[PSI_RESOURCES])
+{
+    defaults[PSI_CPU] = (PsiTrigger){0, PSI_DEFAULT_WINDOW_US / 2, PSI_DEFAULT_WINDOW_US};
+    defaults[PSI_MEMORY] = (PsiTrigger){0, PSI_DEFAULT_WINDOW_US / 10, PSI_DEFAULT_WINDOW_US};
+    defaults[PSI_IO] = (PsiTrigger){0, PSI_DEFAULT_WINDOW_US / 5, PSI_DEFAULT_WINDOW_US};
+}
+
+/**
+ * @brief Parses a duration with a us, ms or s unit, s when there is none.
+ *
+ * @return The character after the duration, NULL if it is invalid.
+ */
+static const char* parse_duration(const char* text, uint32_t* microseconds)
+{
+    char* end;
+    double value = strtod(text, &end);
+    double factor = 1000000;
+    if (end == text || value < 0)
+    {
+        return NULL;
+    }
+    if (strncmp(end, "us", 2) == 0)
+    {
+        factor = 1;
+        end += 2;
+    }
+    else if (strncmp(end, "ms", 2) == 0)
+    {
+        factor = 1000;
+        end += 2;
+    }
+    else if (*end == 's')
+    {
+        end++;
+    }
+    if (value * factor > UINT32_MAX)
+    {
+        return NULL;
+    }
+    *microseconds = (uint32_t)(value * factor);
+    return end;
+}
+
+/**
+ * @brief Parses a trigger option: RESOURCE[:some|:full]:STALL/WINDOW.
+ *
+ * For example memory:150ms/2s fires when some task waited on memory for
+ * 150 ms within 2 s. A stall of 0 disables the trigger of the resource.
+ *
+ * @param text The option.
+ * @param trigger Where the trigger is stored.
+ * @return The resource of the trigger, -1 if the text is invalid.
+ */
+int psi_parse_trigger(const char* text, PsiTrigger* trigger)
+{
+    int resource;
+    size_t length = strcspn(text, ":");
+    for (resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        if (strlen(psi_resource_names[resource]) == length && strncmp(text, psi_resource_names[resource], length) == 0)
+        {
+            break;
+        }
+    }
+    if (resource == PSI_RESOURCES || text[length] != ':')
+    {
+        return -1;
+    }
+    text += length + 1;
+    trigger->full = 0;
+    if (strncmp(text, "some:", 5) == 0 || strncmp(text, "full:", 5) == 0)
+    {
+        trigger->full = text[0] == 'f';
+        text += 5;
+    }
+    text = parse_duration(text, &trigger->stall_us);
+    if (text == NULL || *text != '/' || (text = parse_duration(text + 1, &trigger->window_us)) == NULL ||
+        *text != '\0' || trigger->stall_us > trigger->window_us)
+    {
+        return -1;
+    }
+    return resource;
+}
+
+/**
+ * @brief Arms a kernel trigger on a pressure file.
+ *
+ * The descriptor is kept open for as long as the trigger is wanted. The
+ * kernel accepts windows from 500 ms to 10 s, and from unprivileged users
+ * only multiples of 2 s.
+ *
+ * @param resource The resource to watch.
+ * @param trigger The stall threshold and window.
+ * @return The descriptor to poll for POLLPRI, -1 on error.
+ */
+int psi_trigger_open(PsiResource resource, const PsiTrigger* trigger)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/pressure/%s", psi_resource_names[resource]);
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    char threshold[64];
+    int length = snprintf(threshold, sizeof(threshold), "%s %u %u", trigger->full ? "full" : "some",
+                          trigger->stall_us, trigger->window_us);
+    // The kernel expects the terminating NUL to be written as well
+    if (write(fd, threshold, (size_t)length + 1) == -1)
+    {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+void psi_trigger_fired(PsiResource resource)
+{
+    __atomic_add_fetch(&triggers.fired[resource], 1, __ATOMIC_RELAXED);
+    __atomic_or_fetch(&triggers.pending, 1u << resource, __ATOMIC_RELEASE);
+}
+
+uint64_t psi_trigger_count(PsiResource resource)
+{
+    return __atomic_load_n(&triggers.fired[resource], __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Prints a warning on stderr if a trigger fired since the last warning.
+ *
+ * It is called before each command line, so a batch run or a user about
+ * to start more jobs learns that the host is stalling.
+ *
+ * @return 1 if a warning was printed, 0 otherwise.
+ */
+int psi_warn_pending(void)
+{
+    unsigned pending = __atomic_exchange_n(&triggers.pending, 0, __ATOMIC_ACQUIRE);
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        if ((pending & (1u << resource)) == 0)
+        {
+            continue;
+        }
+        PsiStats stats;
+        if (psi_read(resource, &stats) == 0)
+        {
+            fprintf(stderr, "Warning: %s pressure, tasks stalled %.2f%% of the last 10 s (all tasks %.2f%%)\n",
+                    psi_resource_names[resource], stats.some.avg10, stats.full.avg10);
+        }
+        else
+        {
+            fprintf(stderr, "Warning: %s pressure went over its threshold\n", psi_resource_names[resource]);
+        }
+    }
+    return pending != 0;
+}
@@ -0,0 +1,658 @@
+#define _GNU_SOURCE
+#include "../include/recorder.h"
+#include "../include/jsonw.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define RECORDER_MAGIC "SURVREC1"
+#define RECORDER_HEADER_BYTES 16
+#define BLOCK_HEADER_BYTES 8
+
+/**
+ * @brief Worst case size of one sample in a block, in bits.
+ *
+ * A timestamp takes 4 prefix bits and 64 bits, a metric 2 prefix bits,
+ * 5 bits of leading zeros, 6 bits of length and 64 bits.
+ */
+#define SAMPLE_MAX_BITS (4 + 64 + RECORDER_FIELDS * (2 + 5 + 6 + 64))
+
+/** @brief Leading zero count meaning no previous window in a block */
+#define NO_WINDOW 0xff
+
+static void store_le32(unsigned char* bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static uint32_t load_le32(const unsigned char* bytes)
+{
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+/**
+ * @brief Appends the low bits of a value to the block, most significant first.
+ */
+static void put_bits(MetricRecorder* recorder, uint64_t value, int count)
+{
+    while (count > 0)
+    {
+        int free_bits = 8 - (int)(recorder->bit_length & 7);
+        int take = count < free_bits ? count : free_bits;
+        unsigned chunk = (unsigned)(value >> (count - take)) & ((1u << take) - 1);
+        recorder->block[recorder->bit_length >> 3] |= (unsigned char)(chunk << (free_bits - take));
+        recorder->bit_length += (size_t)take;
+        count -= take;
+    }
+}
+
+/**
+ * @brief Reader of the bits of a block.
+ */
+typedef struct
+{
+    const unsigned char* data;
+    size_t bit_length;
+    size_t position;
+    int overrun;
+} BitReader;
+
+static uint64_t get_bits(BitReader* reader, int count)
+{
+    if (reader->position + (size_t)count > reader->bit_length)
+    {
+        reader->overrun = 1;
+        return 0;
+    }
+    uint64_t value = 0;
+    while (count > 0)
+    {
+        int available = 8 - (int)(reader->position & 7);
+        int take = count < available ? count : available;
+        unsigned byte = reader->data[reader->position >> 3];
+        value = (value << take) | ((byte >> (available - take)) & ((1u << take) - 1));
+        reader->position += (size_t)take;
+        count -= take;
+    }
+    return value;
+}
+
+/**
+ * @brief Sign-extends the low bits of a value.
+ */
+static int64_t sign_extend(uint64_t value, int bits)
+{
+    uint64_t sign = 1ULL << (bits - 1);
+    return (int64_t)((value ^ sign) - sign);
+}
+
+static void sample_values(const MetricSample* sample, uint64_t values[RECORDER_FIELDS])
+{
+    double fields[RECORDER_FIELDS] = {sample->cpu_usage,    sample->memory_usage,          sample->disk_usage,
+                                      sample->network_rate, (double)sample->process_count, (double)sample->context_switches};
+    memcpy(values, fields, sizeof(fields));
+}
+
+static void set_sample_values(MetricSample* sample, const uint64_t values[RECORDER_FIELDS])
+{
+    double fields[RECORDER_FIELDS];
+    memcpy(fields, values, sizeof(fields));
+    sample->cpu_usage = fields[0];
+    sample->memory_usage = fields[1];
+    sample->disk_usage = fields[2];
+    sample->network_rate = fields[3];
+    sample->process_count = (int)fields[4];
+    sample->context_switches = (int)fields[5];
+}
+
+static void start_block(MetricRecorder* recorder)
+{
+    memset(recorder->block, 0, sizeof(recorder->block));
+    recorder->bit_length = 0;
+    recorder->count = 0;
+    recorder->previous_delta = 0;
+    memset(recorder->previous_leading, NO_WINDOW, sizeof(recorder->previous_leading));
+}
+
+/**
+ * @brief Opens the file of the record, writing the header of a new one.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int open_file(MetricRecorder* recorder)
+{
+    recorder->fd = open(recorder->path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (recorder->fd == -1)
+    {
+        return -1;
+    }
+
+    struct stat info;
+    unsigned char header[RECORDER_HEADER_BYTES] = {0};
+    if (fstat(recorder->fd, &info) == -1)
+    {
+        goto fail;
+    }
+    if (info.st_size > 0)
+    {
+        if (pread(recorder->fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+            memcmp(header, RECORDER_MAGIC, 8) != 0 || load_le32(header + 8) != RECORDER_FIELDS)
+        {
+            errno = EINVAL;
+            goto fail;
+        }
+        recorder->file_bytes = (size_t)info.st_size;
+        return 0;
+    }
+
+    memcpy(header, RECORDER_MAGIC, 8);
+    store_le32(header + 8, RECORDER_FIELDS);
+    if (write(recorder->fd, header, sizeof(header)) != (ssize_t)sizeof(header))
+    {
+        goto fail;
+    }
+    recorder->file_bytes = sizeof(header);
+    return 0;
+
+fail:;
+    int saved = errno;
+    close(recorder->fd);
+    recorder->fd = -1;
+    errno = saved;
+    return -1;
+}
+
+/**
+ * @brief Shifts path.N to path.N+1, dropping the oldest one, and starts a new path.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int rotate(MetricRecorder* recorder)
+{
+    close(recorder->fd);
+    recorder->fd = -1;
+
+    char from[PATH_MAX];
+    char to[PATH_MAX];
+    for (int index = recorder->keep_files; index >= 1; index--)
+    {
+        snprintf(to, sizeof(to), "%s.%d", recorder->path, index);
+        if (index == 1)
+        {
+            snprintf(from, sizeof(from), "%s", recorder->path);
+        }
+        else
+        {
+            snprintf(from, sizeof(from), "%s.%d", recorder->path, index - 1);
+        }
+        if (rename(from, to) == -1 && errno != ENOENT)
+        {
+            return -1;
+        }
+    }
+    if (recorder->keep_files == 0)
+    {
+        unlink(recorder->path);
+    }
+    return open_file(recorder);
+}
+
+/**
+ * @brief Opens a record, appending to it if it already exists.
+ *
+ * @param recorder The writer to prepare.
+ * @param path The file of the record.
+ * @param rotate_bytes The size from which the file is rotated.
+ * @param keep_files The number of rotated files kept.
+ * @return 0 on success, -1 on error.
+ */
+int recorder_open(MetricRecorder* recorder, const char* path, size_t rotate_bytes, int keep_files)
+{
+    recorder->path = strdup(path);
+    if (recorder->path == NULL)
+    {
+        return -1;
+    }
+    recorder->rotate_bytes = rotate_bytes;
+    recorder->keep_files = keep_files < 0 ? 0 : keep_files;
+    start_block(recorder);
+    if (open_file(recorder) == -1)
+    {
+        free(recorder->path);
+        recorder->path = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the open block with one writev and rotates a full file.
+ *
+ * @param recorder The writer.
+ * @return 0 on success, -1 on error. The block is dropped either way.
+ */
+int recorder_flush(MetricRecorder* recorder)
+{
+    if (recorder->count == 0 || recorder->fd == -1)
+    {
+        return 0;
+    }
+
+    unsigned char header[BLOCK_HEADER_BYTES];
+    size_t payload = (recorder->bit_length + 7) / 8;
+    store_le32(header, (uint32_t)payload);
+    store_le32(header + 4, (uint32_t)recorder->count);
+    struct iovec parts[2] = {{header, sizeof(header)}, {recorder->block, payload}};
+    ssize_t written = writev(recorder->fd, parts, 2);
+    start_block(recorder);
+    if (written != (ssize_t)(sizeof(header) + payload))
+    {
+        return -1;
+    }
+
+    recorder->file_bytes += (size_t)written;
+    if (recorder->rotate_bytes > 0 && recorder->file_bytes >= recorder->rotate_bytes)
+    {
+        return rotate(recorder);
+    }
+    return 0;
+}
+
+/**
+ * @brief Encodes the metrics of a sample as XORs with the previous values.
+ *
+ * An unchanged value is a 0 bit. Otherwise, when the meaningful bits of the
+ * XOR fit in the window of the previous one, the prefix 10 is followed by
+ * the bits of that window; else 11 is followed by the leading zero count,
+ * the number of meaningful bits and those bits, which become the window.
+ */
+static void put_values(MetricRecorder* recorder, const uint64_t values[RECORDER_FIELDS])
+{
+    for (int i = 0; i < RECORDER_FIELDS; i++)
+    {
+        uint64_t xor = values[i] ^ recorder->previous_values[i];
+        recorder->previous_values[i] = values[i];
+        if (xor == 0)
+        {
+            put_bits(recorder, 0, 1);
+            continue;
+        }
+
+        int leading = __builtin_clzll(xor);
+        int trailing = __builtin_ctzll(xor);
+        if (leading > 31)
+        {
+            leading = 31;
+        }
+        if (recorder->previous_leading[i] != NO_WINDOW && leading >= recorder->previous_leading[i] &&
+            trailing >= recorder->previous_trailing[i])
+        {
+            int meaningful = 64 - recorder->previous_leading[i] - recorder->previous_trailing[i];
+            put_bits(recorder, 2, 2);
+            put_bits(recorder, xor >> recorder->previous_trailing[i], meaningful);
+        }
+        else
+        {
+            int meaningful = 64 - leading - trailing;
+            put_bits(recorder, 3, 2);
+            put_bits(recorder, (uint64_t)leading, 5);
+            put_bits(recorder, (uint64_t)(meaningful & 63), 6);
+            put_bits(recorder, xor >> trailing, meaningful);
+            recorder->previous_leading[i] = (uint8_t)leading;
+            recorder->previous_trailing[i] = (uint8_t)trailing;
+        }
+    }
+}
+
+/**
+ * @brief Appends a sample to the open block.
+ *
+ * The first sample of a block is stored in full. The next timestamps are
+ * stored as the change of their delta: a 0 bit when the interval did not
+ * change, else a prefix of 10, 110 or 1110 with 7, 9 or 12 bits, or 1111
+ * with all 64 bits. Metrics follow as XORs with the previous values.
+ *
+ * @param recorder The writer.
+ * @param sample The sample.
+ * @return 0 on success, -1 if a block could not be written.
+ */
+int recorder_append(MetricRecorder* recorder, const MetricSample* sample)
+{
+    int status = 0;
+    if (recorder->count == RECORDER_BLOCK_SAMPLES || recorder->bit_length + SAMPLE_MAX_BITS > RECORDER_BLOCK_BYTES * 8)
+    {
+        status = recorder_flush(recorder);
+    }
+
+    uint64_t values[RECORDER_FIELDS];
+    sample_values(sample, values);
+    if (recorder->count == 0)
+    {
+        put_bits(recorder, (uint64_t)sample->timestamp_ms, 64);
+        for (int i = 0; i < RECORDER_FIELDS; i++)
+        {
+            put_bits(recorder, values[i], 64);
+            recorder->previous_values[i] = values[i];
+        }
+    }
+    else
+    {
+        int64_t delta = sample->timestamp_ms - recorder->previous_timestamp;
+        int64_t change = delta - recorder->previous_delta;
+        recorder->previous_delta = delta;
+        if (change == 0)
+        {
+            put_bits(recorder, 0, 1);
+        }
+        else if (change >= -64 && change <= 63)
+        {
+            put_bits(recorder, 2, 2);
+            put_bits(recorder, (uint64_t)change, 7);
+        }
+        else if (change >= -256 && change <= 255)
+        {
+            put_bits(recorder, 6, 3);
+            put_bits(recorder, (uint64_t)change, 9);
+        }
+        else if (change >= -2048 && change <= 2047)
+        {
+            put_bits(recorder, 14, 4);
+            put_bits(recorder, (uint64_t)change, 12);
+        }
+        else
+        {
+            put_bits(recorder, 15, 4);
+            put_bits(recorder, (uint64_t)change, 64);
+        }
+        put_values(recorder, values);
+    }
+    recorder->previous_timestamp = sample->timestamp_ms;
+    recorder->count++;
+    return status;
+}
+
+void recorder_close(MetricRecorder* recorder)
+{
+    if (recorder->path == NULL)
+    {
+        return;
+    }
+    recorder_flush(recorder);
+    if (recorder->fd != -1)
+    {
+        close(recorder->fd);
+        recorder->fd = -1;
+    }
+    free(recorder->path);
+    recorder->path = NULL;
+}
+
+/**
+ * @brief Decodes the samples of one block, the reverse of recorder_append.
+ *
+ * @return 0 on success, -1 if the block is truncated.
+ */
+static int decode_block(const unsigned char* payload, size_t length, uint32_t count, RecordHandler handler,
+                        void* data)
+{
+    BitReader reader = {payload, length * 8, 0, 0};
+    MetricSample sample;
+    // Pressure is not recorded
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        sample.pressure[resource] = -1;
+    }
+    uint64_t values[RECORDER_FIELDS];
+    uint8_t leading[RECORDER_FIELDS];
+    uint8_t trailing[RECORDER_FIELDS];
+    int64_t delta = 0;
+
+    for (uint32_t index = 0; index < count; index++)
+    {
+        if (index == 0)
+        {
+            sample.timestamp_ms = (int64_t)get_bits(&reader, 64);
+            for (int i = 0; i < RECORDER_FIELDS; i++)
+            {
+                values[i] = get_bits(&reader, 64);
+                leading[i] = NO_WINDOW;
+            }
+        }
+        else
+        {
+            int64_t change = 0;
+            if (get_bits(&reader, 1) == 1)
+            {
+                if (get_bits(&reader, 1) == 0)
+                {
+                    change = sign_extend(get_bits(&reader, 7), 7);
+                }
+                else if (get_bits(&reader, 1) == 0)
+                {
+                    change = sign_extend(get_bits(&reader, 9), 9);
+                }
+                else if (get_bits(&reader, 1) == 0)
+                {
+                    change = sign_extend(get_bits(&reader, 12), 12);
+                }
+                else
+                {
+                    change = (int64_t)get_bits(&reader, 64);
+                }
+            }
+            delta += change;
+            sample.timestamp_ms += delta;
+
+            for (int i = 0; i < RECORDER_FIELDS; i++)
+            {
+                if (get_bits(&reader, 1) == 0)
+                {
+                    continue;
+                }
+                if (get_bits(&reader, 1) == 1)
+                {
+                    leading[i] = (uint8_t)get_bits(&reader, 5);
+                    int meaningful = (int)get_bits(&reader, 6);
+                    if (meaningful == 0)
+                    {
+                        meaningful = 64;
+                    }
+                    if (leading[i] + meaningful > 64)
+                    {
+                        return -1;
+                    }
+                    trailing[i] = (uint8_t)(64 - leading[i] - meaningful);
+                }
+                else if (leading[i] == NO_WINDOW)
+                {
+                    return -1;
+                }
+                int meaningful = 64 - leading[i] - trailing[i];
+                values[i] ^= get_bits(&reader, meaningful) << trailing[i];
+            }
+        }
+        if (reader.overrun)
+        {
+            return -1;
+        }
+        set_sample_values(&sample, values);
+        handler(&sample, data);
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads the samples of a record file.
+ *
+ * A truncated last block, left by a writer that was killed while writing
+ * it, ends the record without an error.
+ *
+ * @param path The file of the record.
+ * @param handler The function called for every sample.
+ * @param data The pointer passed to the handler.
+ * @return The number of samples read, -1 on error.
+ */
+long recorder_read(const char* path, RecordHandler handler, void* data)
+{
+    FILE* file = fopen(path, "re");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    unsigned char header[RECORDER_HEADER_BYTES];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, RECORDER_MAGIC, 8) != 0 ||
+        load_le32(header + 8) != RECORDER_FIELDS)
+    {
+        fclose(file);
+        errno = EINVAL;
+        return -1;
+    }
+
+    static unsigned char payload[RECORDER_BLOCK_BYTES];
+    long total = 0;
+    unsigned char block_header[BLOCK_HEADER_BYTES];
+    while (fread(block_header, 1, sizeof(block_header), file) == sizeof(block_header))
+    {
+        uint32_t length = load_le32(block_header);
+        uint32_t count = load_le32(block_header + 4);
+        if (length > sizeof(payload) || count > RECORDER_BLOCK_SAMPLES || fread(payload, 1, length, file) != length ||
+            decode_block(payload, length, count, handler, data) == -1)
+        {
+            break;
+        }
+        total += count;
+    }
+    fclose(file);
+    return total;
+}
+
+/**
+ * @brief Prints a sample as a line of CSV, unreadable metrics are empty.
+ */
+static void print_csv(const MetricSample* sample, void* data)
+{
+    (void)data;
+    printf("%lld", (long long)sample->timestamp_ms);
+    const double fields[4] = {sample->cpu_usage, sample->memory_usage, sample->disk_usage, sample->network_rate};
+    for (int i = 0; i < 4; i++)
+    {
+        if (fields[i] >= 0)
+        {
+            printf(",%.2f", fields[i]);
+        }
+        else
+        {
+            printf(",");
+        }
+    }
+    const int counts[2] = {sample->process_count, sample->context_switches};
+    for (int i = 0; i < 2; i++)
+    {
+        if (counts[i] >= 0)
+        {
+            printf(",%d", counts[i]);
+        }
+        else
+        {
+            printf(",");
+        }
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Prints a sample as a JSON line, the way start_monitor --jsonl writes it.
+ */
+static void print_json(const MetricSample* sample, void* data)
+{
+    JsonWriter* writer = data;
+    jsonw_reset(writer);
+    sampler_write_json(writer, sample);
+    jsonw_newline(writer);
+    fwrite(writer->buffer, 1, writer->length, stdout);
+}
+
+/**
+ * @brief Builtin converting records back to CSV or JSON Lines.
+ *
+ * Usage: monitor_dump [--csv|--json] FILE. FILE.N down to FILE.1 are read
+ * before FILE, so rotated records come out oldest first.
+ *
+ * @param arg The options and the file.
+ */
+void command_monitor_dump(char* arg)
+{
+    int json = 0;
+    char* path = NULL;
+    char* state;
+    for (char* word = strtok_r(arg, " \t\n", &state); word != NULL; word = strtok_r(NULL, " \t\n", &state))
+    {
+        if (strcmp(word, "--json") == 0)
+        {
+            json = 1;
+        }
+        else if (strcmp(word, "--csv") == 0)
+        {
+            json = 0;
+        }
+        else
+        {
+            path = word;
+        }
+    }
+    if (path == NULL)
+    {
+        fprintf(stderr, "Usage: monitor_dump [--csv|--json] FILE\n");
+        return;
+    }
+
+    int oldest = 0;
+    char rotated[PATH_MAX];
+    while (oldest < 1000)
+    {
+        snprintf(rotated, sizeof(rotated), "%s.%d", path, oldest + 1);
+        if (access(rotated, F_OK) == -1)
+        {
+            break;
+        }
+        oldest++;
+    }
+
+    JsonWriter writer;
+    if (json && jsonw_init(&writer, 256) == -1)
+    {
+        perror("monitor_dump");
+        return;
+    }
+    if (!json)
+    {
+        printf("timestamp_ms,cpu,memory,disk,network,processes,context_switches\n");
+    }
+    for (int index = oldest; index >= 0; index--)
+    {
+        if (index > 0)
+        {
+            snprintf(rotated, sizeof(rotated), "%s.%d", path, index);
+        }
+        else
+        {
+            snprintf(rotated, sizeof(rotated), "%s", path);
+        }
+        if (recorder_read(rotated, json ? print_json : print_csv, &writer) == -1)
+        {
+            fprintf(stderr, "monitor_dump: %s: %s\n", rotated, strerror(errno));
+        }
+    }
+    if (json)
+    {
+        jsonw_free(&writer);
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,670 @@
+#define _GNU_SOURCE
+#include "../include/sampler.h"
+#include "../include/alerts.h"
+#include "../include/config.h"
+#include "../include/pacer.h"
+#include "../include/procevents.h"
+#include "../include/psi.h"
+#include "../include/recorder.h"
+#include "../include/selfstats.h"
+#include "../include/timeseries.h"
+#include "../lab1/include/metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static struct
+{
+    pthread_t thread;
+    int running;
+    /** @brief Written by sampler_stop to wake the thread up */
+    int stop_fd;
+    /** @brief Expires at the deadline of the next sample */
+    int timer_fd;
+    int output_fd;
+    /** @brief Proc connector socket, -1 when processes are counted by scanning /proc */
+    int events_fd;
+    /** @brief Armed pressure triggers, -1 for none */
+    int pressure_fds[PSI_RESOURCES];
+    /** @brief Watch on config.json, -1 when it is not reloaded */
+    int config_fd;
+    /** @brief Binary record of the samples, when recording is set */
+    MetricRecorder recorder;
+    int recording;
+    /** @brief Read by the main thread while the sampler thread may change it */
+    int interval_ms;
+    /** @brief Interval of the configuration adopted last, 0 if it sets none */
+    int configured_interval_ms;
+    /** @brief 1 to add the cost of the previous sample to the JSON lines */
+    int export_overhead;
+    /** @brief 1 when the pacer chooses the interval */
+    int adaptive;
+    Pacer pacer;
+    pthread_mutex_t lock;
+    MetricSample latest;
+    int has_latest;
+    uint64_t dropped;
+} sampler = {.running = 0,
+             .stop_fd = -1,
+             .timer_fd = -1,
+             .output_fd = -1,
+             .events_fd = -1,
+             .pressure_fds = {-1, -1, -1},
+             .config_fd = -1,
+             .lock = PTHREAD_MUTEX_INITIALIZER};
+
+const char* const sampler_metric_names[SAMPLER_METRICS] = {"cpu",     "memory",    "disk",
+                                                            "network", "processes", "context_switches"};
+
+double sampler_metric(const MetricSample* sample, int metric)
+{
+    switch (metric)
+    {
+    case 0:
+        return sample->cpu_usage;
+    case 1:
+        return sample->memory_usage;
+    case 2:
+        return sample->disk_usage;
+    case 3:
+        return sample->network_rate;
+    case 4:
+        return sample->process_count;
+    case 5:
+        return sample->context_switches;
+    default:
+        return -1;
+    }
+}
+
+int sampler_metric_is_count(int metric)
+{
+    switch (metric)
+    {
+    case 4:
+    case 5:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int sampler_metric_index(const char* name)
+{
+    for (int metric = 0; metric < SAMPLER_METRICS; metric++)
+    {
+        if (strcmp(name, sampler_metric_names[metric]) == 0)
+        {
+            return metric;
+        }
+    }
+    return -1;
+}
+
+static int64_t wall_clock_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int64_t monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Reads every metric into a sample.
+ *
+ * Metrics disabled in the configuration are not read and stay -1. While
+ * the process events are followed, the process count is the size of their
+ * live set instead of a new scan of /proc. On the sampler thread, the cost
+ * of every source is charged to it as it is read.
+ *
+ * @param sample Where the readings are stored.
+ */
+void sampler_collect(MetricSample* sample)
+{
+    const MonitorConfig* config = config_hold();
+    const int* enabled = config != NULL ? config->metrics : (const int[SAMPLER_METRICS]){1, 1, 1, 1, 1, 1};
+    sample->timestamp_ms = wall_clock_ms();
+    sample->cpu_usage = enabled[0] ? get_cpu_usage() : -1;
+    sample->context_switches = enabled[5] ? get_context_switchs() : -1;
+    selfstats_mark(SELF_STAT);
+    sample->memory_usage = enabled[1] ? get_memory_usage() : -1;
+    selfstats_mark(SELF_MEMINFO);
+    sample->disk_usage = enabled[2] ? get_IOdisk() : -1;
+    selfstats_mark(SELF_DISKSTATS);
+    sample->network_rate = enabled[3] ? get_network_transfer_rate() : -1;
+    selfstats_mark(SELF_NET_DEV);
+    sample->process_count = !enabled[4] ? -1 : procevents_active() ? procevents_count() : get_processcounter();
+    selfstats_mark(SELF_PROCESSES);
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        PsiStats stats;
+        sample->pressure[resource] = psi_read(resource, &stats) == 0 ? stats.some.avg10 : -1;
+    }
+    selfstats_mark(SELF_PRESSURE);
+    config_release(config);
+}
+
+static void write_percentage(JsonWriter* writer, const char* key, double value)
+{
+    jsonw_key(writer, key);
+    if (value >= 0)
+    {
+        jsonw_double(writer, value, 2);
+    }
+    else
+    {
+        jsonw_null(writer);
+    }
+}
+
+static void write_count(JsonWriter* writer, const char* key, int value)
+{
+    jsonw_key(writer, key);
+    if (value >= 0)
+    {
+        jsonw_int(writer, value);
+    }
+    else
+    {
+        jsonw_null(writer);
+    }
+}
+
+static const char* const pressure_keys[PSI_RESOURCES] = {"cpu_pressure", "memory_pressure", "io_pressure"};
+
+/**
+ * @brief Writes the keys of a sample into an open JSON object.
+ *
+ * The keys follow the names of the metrics in config.json, and values are
+ * written with the two decimals status_monitor shows.
+ */
+static void write_fields(JsonWriter* writer, const MetricSample* sample)
+{
+    jsonw_key(writer, "timestamp_ms");
+    jsonw_int(writer, sample->timestamp_ms);
+    write_percentage(writer, "cpu", sample->cpu_usage);
+    write_percentage(writer, "memory", sample->memory_usage);
+    write_percentage(writer, "disk", sample->disk_usage);
+    write_percentage(writer, "network", sample->network_rate);
+    write_count(writer, "processes", sample->process_count);
+    write_count(writer, "context_switches", sample->context_switches);
+    // Without PSI in the kernel, or for samples of a binary record, the keys are left out
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        if (sample->pressure[resource] >= 0)
+        {
+            write_percentage(writer, pressure_keys[resource], sample->pressure[resource]);
+        }
+    }
+}
+
+/**
+ * @brief Serializes a sample as one JSON object.
+ *
+ * @param writer The writer receiving the object.
+ * @param sample The sample.
+ */
+void sampler_write_json(JsonWriter* writer, const MetricSample* sample)
+{
+    jsonw_begin_object(writer);
+    write_fields(writer, sample);
+    jsonw_end_object(writer);
+}
+
+/**
+ * @brief Opens the output of the JSON lines.
+ *
+ * A FIFO is opened read-write so the open does not wait for a reader, and
+ * non-blocking so a full pipe drops lines instead of stalling the sampler.
+ * Other paths are regular files the lines are appended to.
+ *
+ * @return The descriptor, or -1 on error.
+ */
+static int open_output(const char* path)
+{
+    struct stat info;
+    if (stat(path, &info) == 0 && S_ISFIFO(info.st_mode))
+    {
+        return open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    }
+    return open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+
+/**
+ * @brief Takes the interval of the configuration in use when it sets a new one.
+ *
+ * An interval that stays the same across reloads is not applied again, so
+ * one given to start_monitor holds until config.json changes it.
+ *
+ * @return The change of the interval, in milliseconds.
+ */
+static int adopt_interval(void)
+{
+    const MonitorConfig* config = config_hold();
+    int change = 0;
+    if (config != NULL && config->interval_ms != 0 && config->interval_ms != sampler.configured_interval_ms)
+    {
+        change = config->interval_ms - sampler.interval_ms;
+        __atomic_store_n(&sampler.interval_ms, config->interval_ms, __ATOMIC_RELAXED);
+    }
+    sampler.configured_interval_ms = config != NULL ? config->interval_ms : 0;
+    config_release(config);
+    return change;
+}
+
+/**
+ * @brief Adds the cost of the previous sample to a JSON line.
+ *
+ * The object is the last key of the line; the cost of the sample being
+ * written is not known before the line is.
+ */
+static void write_overhead(JsonWriter* writer)
+{
+    SelfStats stats;
+    if (selfstats_read(&stats) == 0)
+    {
+        return;
+    }
+    SelfCost cost = selfstats_sum(stats.last);
+    jsonw_key(writer, "monitor");
+    jsonw_begin_object(writer);
+    jsonw_key(writer, "sample_us");
+    jsonw_double(writer, (double)cost.time_ns / 1000, 1);
+    jsonw_key(writer, "cpu_us");
+    jsonw_double(writer, (double)stats.last_cpu_ns / 1000, 1);
+    jsonw_key(writer, "syscalls");
+    jsonw_int(writer, (int64_t)cost.syscalls);
+    jsonw_key(writer, "bytes_read");
+    jsonw_int(writer, (int64_t)cost.bytes_read);
+    jsonw_key(writer, "heap_bytes");
+    jsonw_int(writer, cost.heap_bytes);
+    jsonw_end_object(writer);
+}
+
+/**
+ * @brief Sets the timer of the sampler to a deadline.
+ *
+ * The deadline is absolute, so the time spent sampling and handling events
+ * does not add up from one sample to the next; a deadline already past
+ * expires at once.
+ *
+ * @param deadline_ms The deadline on CLOCK_MONOTONIC, in milliseconds.
+ */
+static void arm_timer(int64_t deadline_ms)
+{
+    struct itimerspec due = {.it_value = {.tv_sec = deadline_ms / 1000, .tv_nsec = deadline_ms % 1000 * 1000000}};
+    timerfd_settime(sampler.timer_fd, TFD_TIMER_ABSTIME, &due, NULL);
+}
+
+/**
+ * @brief Body of the sampler thread.
+ *
+ * The writer is allocated once; every sample is serialized into the same
+ * buffer and sent with one write, which a pipe keeps whole since a line is
+ * shorter than PIPE_BUF. The binary record encodes into its block buffer
+ * and only writes when a block is full. Between samples the thread sleeps
+ * in one poll: on the timer of the next deadline, on the stop descriptor,
+ * so sampler_stop does not wait for the interval to end, on the process
+ * events, which are applied as they come, on the pressure triggers, which
+ * the kernel wakes with POLLPRI, and on the watch of config.json. Samples
+ * are due at fixed deadlines so the events do not shift them. A saved
+ * config.json is loaded between two samples and replaces the configuration
+ * in one pointer exchange: the sample being taken keeps the configuration
+ * it started with, the time-series store is left as it is, and a new
+ * interval moves the pending deadline. With an adaptive interval, the
+ * pacer picks every deadline and a pressure trigger brings the next sample
+ * forward to now.
+ */
+static void* sampler_main(void* data)
+{
+    (void)data;
+    JsonWriter writer;
+    if (jsonw_init(&writer, 512) == -1)
+    {
+        return NULL;
+    }
+
+    // poll skips the entries whose descriptor is -1
+    struct pollfd waited[4 + PSI_RESOURCES] = {{.fd = sampler.stop_fd, .events = POLLIN},
+                                               {.fd = sampler.timer_fd, .events = POLLIN},
+                                               {.fd = sampler.events_fd, .events = POLLIN},
+                                               {.fd = sampler.config_fd, .events = POLLIN}};
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        waited[4 + resource] = (struct pollfd){.fd = sampler.pressure_fds[resource], .events = POLLPRI};
+    }
+    int64_t deadline = monotonic_ms();
+    int stopping = 0;
+    selfstats_open();
+    while (!stopping)
+    {
+        selfstats_begin();
+        if (waited[2].fd != -1)
+        {
+            // Also closes the per-second counters of quiet seconds
+            procevents_drain();
+            selfstats_mark(SELF_PROCESSES);
+        }
+        const MonitorConfig* config = config_hold();
+        MetricSample sample;
+        sampler_collect(&sample);
+
+        pthread_mutex_lock(&sampler.lock);
+        sampler.latest = sample;
+        sampler.has_latest = 1;
+        pthread_mutex_unlock(&sampler.lock);
+        timeseries_add(&sample);
+        if (config != NULL)
+        {
+            alerts_evaluate(config, &sample);
+        }
+        if (sampler.adaptive)
+        {
+            int interval_ms = pacer_update(&sampler.pacer, &sample, config, alerts_firing());
+            __atomic_store_n(&sampler.interval_ms, interval_ms, __ATOMIC_RELAXED);
+        }
+        config_release(config);
+        // The configurations the main thread held during a reload
+        config_collect();
+
+        if (sampler.output_fd != -1)
+        {
+            jsonw_reset(&writer);
+            jsonw_begin_object(&writer);
+            write_fields(&writer, &sample);
+            if (sampler.export_overhead)
+            {
+                write_overhead(&writer);
+            }
+            jsonw_end_object(&writer);
+            jsonw_newline(&writer);
+            if (writer.failed || write(sampler.output_fd, writer.buffer, writer.length) != (ssize_t)writer.length)
+            {
+                __atomic_add_fetch(&sampler.dropped, 1, __ATOMIC_RELAXED);
+            }
+        }
+        if (sampler.recording && recorder_append(&sampler.recorder, &sample) == -1)
+        {
+            __atomic_add_fetch(&sampler.dropped, 1, __ATOMIC_RELAXED);
+        }
+        selfstats_mark(SELF_OUTPUTS);
+        selfstats_end();
+
+        deadline += sampler.interval_ms;
+        int64_t now = monotonic_ms();
+        if (deadline < now - sampler.interval_ms)
+        {
+            // Samples that fell behind are skipped rather than taken in a burst
+            deadline = now;
+        }
+        arm_timer(deadline);
+        int due = 0;
+        while (!stopping && !due)
+        {
+            if (poll(waited, 4 + PSI_RESOURCES, -1) == -1)
+            {
+                continue;
+            }
+            stopping = waited[0].revents != 0;
+            uint64_t expirations;
+            due = waited[1].revents != 0 && read(sampler.timer_fd, &expirations, sizeof(expirations)) > 0;
+            if (waited[2].revents != 0 && procevents_drain() == -1)
+            {
+                // The socket failed, the count goes back to scans of /proc
+                procevents_close();
+                waited[2].fd = -1;
+            }
+            if (waited[3].revents != 0)
+            {
+                int changed = config_watch_changed(waited[3].fd);
+                if (changed == -1)
+                {
+                    close(sampler.config_fd);
+                    sampler.config_fd = waited[3].fd = -1;
+                }
+                else if (changed && config_reload() == 0 && !sampler.adaptive)
+                {
+                    deadline += adopt_interval();
+                    arm_timer(deadline);
+                }
+            }
+            for (int resource = 0; resource < PSI_RESOURCES; resource++)
+            {
+                short events = waited[4 + resource].revents;
+                if (events & POLLERR)
+                {
+                    // The pressure file went away
+                    close(sampler.pressure_fds[resource]);
+                    sampler.pressure_fds[resource] = waited[4 + resource].fd = -1;
+                }
+                else if (events & POLLPRI)
+                {
+                    psi_trigger_fired(resource);
+                    if (sampler.adaptive)
+                    {
+                        pacer_wake(&sampler.pacer);
+                        deadline = monotonic_ms();
+                        arm_timer(deadline);
+                    }
+                }
+            }
+        }
+    }
+
+    selfstats_close();
+    jsonw_free(&writer);
+    return NULL;
+}
+
+void sampler_options_init(SamplerOptions* options)
+{
+    options->jsonl_path = NULL;
+    options->binary_path = NULL;
+    options->interval_ms = 0;
+    options->fastest_ms = 0;
+    options->slowest_ms = 0;
+    options->export_overhead = 0;
+    options->rotate_bytes = RECORDER_DEFAULT_ROTATE;
+    options->keep_files = RECORDER_DEFAULT_KEEP;
+    options->process_events = 1;
+    psi_default_triggers(options->pressure_triggers);
+}
+
+/**
+ * @brief Closes the outputs and the stop descriptor of the sampler.
+ *
+ * The open block of the binary record is written first.
+ */
+static void close_outputs(void)
+{
+    if (sampler.stop_fd != -1)
+    {
+        close(sampler.stop_fd);
+    }
+    if (sampler.timer_fd != -1)
+    {
+        close(sampler.timer_fd);
+    }
+    if (sampler.output_fd != -1)
+    {
+        close(sampler.output_fd);
+    }
+    if (sampler.recording)
+    {
+        recorder_close(&sampler.recorder);
+    }
+    if (sampler.events_fd != -1)
+    {
+        procevents_close();
+    }
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        if (sampler.pressure_fds[resource] != -1)
+        {
+            close(sampler.pressure_fds[resource]);
+            sampler.pressure_fds[resource] = -1;
+        }
+    }
+    if (sampler.config_fd != -1)
+    {
+        close(sampler.config_fd);
+    }
+    sampler.stop_fd = sampler.timer_fd = sampler.output_fd = sampler.events_fd = sampler.config_fd = -1;
+    sampler.recording = 0;
+}
+
+/**
+ * @brief Starts the sampler thread of the shell.
+ *
+ * The thread is created with every signal blocked, so signals keep going
+ * to the main thread and SIGCHLD stays with the supervision loop. The
+ * interval of the options comes first, then the one of config.json, then
+ * SAMPLER_DEFAULT_INTERVAL_MS, unless the options bound an adaptive
+ * interval.
+ *
+ * @param options The outputs and the interval of the sampler.
+ * @return 0 on success, -1 on error.
+ */
+int sampler_start(const SamplerOptions* options)
+{
+    if (sampler.running)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if ((options->jsonl_path != NULL && (sampler.output_fd = open_output(options->jsonl_path)) == -1) ||
+        (options->binary_path != NULL && recorder_open(&sampler.recorder, options->binary_path,
+                                                       options->rotate_bytes, options->keep_files) == -1))
+    {
+        int saved = errno;
+        close_outputs();
+        errno = saved;
+        return -1;
+    }
+    sampler.recording = options->binary_path != NULL;
+    sampler.stop_fd = eventfd(0, EFD_CLOEXEC);
+    sampler.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sampler.stop_fd == -1 || sampler.timer_fd == -1)
+    {
+        int saved = errno;
+        close_outputs();
+        errno = saved;
+        return -1;
+    }
+    sampler.has_latest = 0;
+    sampler.dropped = 0;
+    // Read again so a file edited while the sampler was stopped applies; an invalid one keeps the last configuration
+    config_reload();
+    const MonitorConfig* config = config_hold();
+    if (config == NULL)
+    {
+        close_outputs();
+        errno = ENOMEM;
+        return -1;
+    }
+    int interval_ms = options->interval_ms > 0 ? options->interval_ms : config->interval_ms;
+    interval_ms = interval_ms > 0 ? interval_ms : SAMPLER_DEFAULT_INTERVAL_MS;
+    sampler.interval_ms = interval_ms < SAMPLER_MIN_INTERVAL_MS ? SAMPLER_MIN_INTERVAL_MS : interval_ms;
+    sampler.configured_interval_ms = config->interval_ms;
+    config_release(config);
+    sampler.export_overhead = options->export_overhead;
+    sampler.adaptive = options->slowest_ms > 0;
+    if (sampler.adaptive)
+    {
+        pacer_init(&sampler.pacer, options->fastest_ms, options->slowest_ms);
+        sampler.interval_ms = sampler.pacer.interval_ms;
+    }
+    // Without inotify the configuration only changes on the next start
+    sampler.config_fd = config_watch_open();
+    // Without the permission to subscribe, processes are counted by scanning /proc
+    sampler.events_fd = options->process_events ? procevents_open() : -1;
+    // Triggers the kernel refuses, for lack of PSI or of privileges for the window, are left out
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        const PsiTrigger* trigger = &options->pressure_triggers[resource];
+        sampler.pressure_fds[resource] = trigger->stall_us > 0 ? psi_trigger_open(resource, trigger) : -1;
+    }
+
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int error = pthread_create(&sampler.thread, NULL, sampler_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (error != 0)
+    {
+        close_outputs();
+        errno = error;
+        return -1;
+    }
+    sampler.running = 1;
+    return 0;
+}
+
+void sampler_stop(void)
+{
+    if (!sampler.running)
+    {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(sampler.stop_fd, &one, sizeof(one)) == -1)
+    {
+        perror("sampler");
+    }
+    pthread_join(sampler.thread, NULL);
+    close_outputs();
+    alerts_reset();
+    sampler.running = 0;
+}
+
+unsigned sampler_pressure_triggers(void)
+{
+    unsigned armed = 0;
+    for (int resource = 0; resource < PSI_RESOURCES; resource++)
+    {
+        armed |= (unsigned)(sampler.pressure_fds[resource] != -1) << resource;
+    }
+    return armed;
+}
+
+int sampler_interval(void)
+{
+    return __atomic_load_n(&sampler.interval_ms, __ATOMIC_RELAXED);
+}
+
+int sampler_running(void)
+{
+    return sampler.running;
+}
+
+int sampler_latest(MetricSample* sample)
+{
+    pthread_mutex_lock(&sampler.lock);
+    int available = sampler.has_latest;
+    if (available)
+    {
+        *sample = sampler.latest;
+    }
+    pthread_mutex_unlock(&sampler.lock);
+    return available;
+}
+
+uint64_t sampler_dropped(void)
+{
+    return __atomic_load_n(&sampler.dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,216 @@
+#define _GNU_SOURCE
+#include "../include/selfstats.h"
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+const char* const selfstats_source_names[SELF_SOURCES] = {"/proc/stat",    "/proc/meminfo",  "/proc/diskstats",
+                                                          "/proc/net/dev", "processes",      "/proc/pressure",
+                                                          "outputs"};
+
+/**
+ * @brief Counters of the thread at the previous mark
+ */
+typedef struct
+{
+    /** @brief Time before the counters were read, and after, when the next part starts */
+    uint64_t time_ns;
+    uint64_t resumed_ns;
+    uint64_t syscalls;
+    uint64_t bytes_read;
+    uint64_t heap_bytes;
+    uint64_t cpu_ns;
+} Checkpoint;
+
+static struct
+{
+    /** @brief /proc/thread-self/io of the measured thread, -1 when it cannot be read */
+    int io_fd;
+    /** @brief Length of the previous read of io_fd, counted by the kernel in the next one */
+    size_t io_length;
+    Checkpoint mark;
+    Checkpoint start;
+    SelfCost sample[SELF_SOURCES];
+    pthread_mutex_t lock;
+    SelfStats stats;
+} self = {.io_fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+/** @brief 1 on the measured thread */
+static _Thread_local int measured = 0;
+
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Returns the bytes the allocator of the C library has handed out and not got back.
+ *
+ * mallinfo2 covers every thread of the process, so what the shell thread
+ * allocates while a sample is taken is charged to the sampler too; the
+ * shell mostly waits for input meanwhile. Chunks served by mmap are counted
+ * in hblkhd rather than uordblks.
+ */
+static uint64_t heap_in_use(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return (uint64_t)(info.uordblks + info.hblkhd);
+}
+
+/**
+ * @brief Returns the value of a field of /proc/thread-self/io.
+ */
+static uint64_t io_field(const char* text, const char* name)
+{
+    const char* field = strstr(text, name);
+    return field != NULL ? strtoull(field + strlen(name), NULL, 10) : 0;
+}
+
+/**
+ * @brief Reads the counters of the thread.
+ *
+ * The kernel counts the read of /proc/thread-self/io after filling it, so
+ * the previous read is part of the counters and is taken back out: one
+ * system call and the bytes it returned.
+ */
+static void checkpoint(Checkpoint* point)
+{
+    point->time_ns = clock_ns(CLOCK_MONOTONIC);
+    point->heap_bytes = heap_in_use();
+    point->cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    point->syscalls = point->bytes_read = 0;
+    if (self.io_fd != -1)
+    {
+        char text[256];
+        ssize_t length = pread(self.io_fd, text, sizeof(text) - 1, 0);
+        if (length > 0)
+        {
+            text[length] = '\0';
+            point->syscalls = io_field(text, "syscr: ") + io_field(text, "syscw: ");
+            point->bytes_read = io_field(text, "rchar: ");
+            self.io_length = (size_t)length;
+        }
+    }
+    point->resumed_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+/**
+ * @brief Starts measuring the calling thread, clearing the statistics.
+ *
+ * @return 0 on success, -1 if system calls and bytes read cannot be counted.
+ */
+int selfstats_open(void)
+{
+    pthread_mutex_lock(&self.lock);
+    memset(&self.stats, 0, sizeof(self.stats));
+    self.io_fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+    self.stats.counts_io = self.io_fd != -1;
+    pthread_mutex_unlock(&self.lock);
+    measured = 1;
+    return self.io_fd != -1 ? 0 : -1;
+}
+
+void selfstats_begin(void)
+{
+    if (!measured)
+    {
+        return;
+    }
+    memset(self.sample, 0, sizeof(self.sample));
+    checkpoint(&self.mark);
+    self.start = self.mark;
+}
+
+/**
+ * @brief Charges what the thread used since the previous mark to a source.
+ *
+ * A mark costs two clock reads and, when system calls are counted, one
+ * pread of /proc/thread-self/io, whose time, call and bytes are not charged.
+ *
+ * @param source The source the cost goes to.
+ */
+void selfstats_mark(SelfSource source)
+{
+    if (!measured)
+    {
+        return;
+    }
+    Checkpoint point;
+    size_t previous_length = self.io_length;
+    checkpoint(&point);
+    SelfCost* cost = &self.sample[source];
+    cost->time_ns += point.time_ns - self.mark.resumed_ns;
+    cost->heap_bytes += (int64_t)(point.heap_bytes - self.mark.heap_bytes);
+    if (point.syscalls > self.mark.syscalls)
+    {
+        cost->syscalls += point.syscalls - self.mark.syscalls - 1;
+        uint64_t bytes_read = point.bytes_read - self.mark.bytes_read;
+        cost->bytes_read += bytes_read > previous_length ? bytes_read - previous_length : 0;
+    }
+    self.mark = point;
+}
+
+/**
+ * @brief Ends a sample and publishes its cost to selfstats_read.
+ */
+void selfstats_end(void)
+{
+    if (!measured)
+    {
+        return;
+    }
+    uint64_t cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - self.start.cpu_ns;
+    pthread_mutex_lock(&self.lock);
+    self.stats.samples++;
+    memcpy(self.stats.last, self.sample, sizeof(self.sample));
+    for (int source = 0; source < SELF_SOURCES; source++)
+    {
+        self.stats.total[source].time_ns += self.sample[source].time_ns;
+        self.stats.total[source].syscalls += self.sample[source].syscalls;
+        self.stats.total[source].bytes_read += self.sample[source].bytes_read;
+        self.stats.total[source].heap_bytes += self.sample[source].heap_bytes;
+    }
+    self.stats.last_cpu_ns = cpu_ns;
+    self.stats.total_cpu_ns += cpu_ns;
+    pthread_mutex_unlock(&self.lock);
+}
+
+void selfstats_close(void)
+{
+    if (!measured)
+    {
+        return;
+    }
+    if (self.io_fd != -1)
+    {
+        close(self.io_fd);
+        self.io_fd = -1;
+    }
+    measured = 0;
+}
+
+uint64_t selfstats_read(SelfStats* stats)
+{
+    pthread_mutex_lock(&self.lock);
+    *stats = self.stats;
+    pthread_mutex_unlock(&self.lock);
+    return stats->samples;
+}
+
+SelfCost selfstats_sum(const SelfCost costs[SELF_SOURCES])
+{
+    SelfCost sum = {0, 0, 0, 0};
+    for (int source = 0; source < SELF_SOURCES; source++)
+    {
+        sum.time_ns += costs[source].time_ns;
+        sum.syscalls += costs[source].syscalls;
+        sum.bytes_read += costs[source].bytes_read;
+        sum.heap_bytes += costs[source].heap_bytes;
+    }
+    return sum;
+}
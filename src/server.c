@@ -0,0 +1,654 @@
+#define _GNU_SOURCE
+#include "../include/server.h"
+#include "../include/executions.h"
+#include "../include/shell.h"
+#include "../include/supervisor.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Tags stored in the epoll events that are not client sources
+#define TAG_LISTEN UINT32_MAX
+#define TAG_STOP (UINT32_MAX - 1)
+
+// Sources of a client, the tag of a source is client index * SOURCE_COUNT + source
+enum
+{
+    SOURCE_SOCKET,
+    SOURCE_STDOUT,
+    SOURCE_STDERR,
+    SOURCE_COUNT
+};
+
+/**
+ * @brief A connected client and the request it is running.
+ */
+typedef struct
+{
+    int fd;
+
+    char* input;
+    size_t input_length;
+    size_t input_capacity;
+
+    char* output;
+    size_t output_length;
+    size_t output_sent;
+    size_t output_capacity;
+
+    /** @brief Worker running the current request, 0 when idle */
+    pid_t worker;
+    /** @brief Read ends of the worker's stdout and stderr, -1 once closed */
+    int pipes[2];
+    int exited;
+    int status;
+
+    /** @brief The client will not send more requests */
+    int closing;
+    /** @brief The pipes are not read until the client takes its output */
+    int paused;
+} Client;
+
+static struct
+{
+    int epoll_fd;
+    int listen_fd;
+    int stop_pipe[2];
+    Client clients[SERVER_MAX_CLIENTS];
+} server = {.epoll_fd = -1, .listen_fd = -1, .stop_pipe = {-1, -1}};
+
+static void start_request(int index);
+
+/**
+ * @brief Wakes the event loop up to stop the server.
+ */
+static void server_stop_handler(int signo)
+{
+    (void)signo;
+    int error = errno;
+    ssize_t written = write(server.stop_pipe[1], "", 1);
+    (void)written;
+    errno = error;
+}
+
+static int watch(int fd, uint32_t events, uint32_t tag)
+{
+    struct epoll_event event = {.events = events, .data.u32 = tag};
+    return epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static void rewatch(int fd, uint32_t events, uint32_t tag)
+{
+    struct epoll_event event = {.events = events, .data.u32 = tag};
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+static uint32_t tag_of(int index, int source)
+{
+    return (uint32_t)(index * SOURCE_COUNT + source);
+}
+
+/**
+ * @brief Grows a buffer so it can hold a number of bytes.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+static int reserve(char** buffer, size_t* capacity, size_t needed)
+{
+    if (needed <= *capacity)
+    {
+        return 0;
+    }
+    size_t new_capacity = *capacity == 0 ? 4096 : *capacity;
+    while (new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
+    char* new_buffer = realloc(*buffer, new_capacity);
+    if (new_buffer == NULL)
+    {
+        return -1;
+    }
+    *buffer = new_buffer;
+    *capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * @brief Adds a frame to the output of a client.
+ */
+static int queue_frame(Client* client, char type, const void* payload, uint32_t length)
+{
+    if (reserve(&client->output, &client->output_capacity, client->output_length + 5 + length) == -1)
+    {
+        return -1;
+    }
+    uint32_t network_length = htonl(length);
+    char* end = client->output + client->output_length;
+    end[0] = type;
+    memcpy(end + 1, &network_length, sizeof(network_length));
+    memcpy(end + 5, payload, length);
+    client->output_length += 5 + length;
+    return 0;
+}
+
+/**
+ * @brief Stops reading the output of a worker while its client is behind, and resumes it.
+ */
+static void pause_worker(int index, int paused)
+{
+    Client* client = &server.clients[index];
+    if (client->paused == paused)
+    {
+        return;
+    }
+    client->paused = paused;
+    for (int i = 0; i < 2; i++)
+    {
+        if (client->pipes[i] != -1)
+        {
+            rewatch(client->pipes[i], paused ? 0 : EPOLLIN, tag_of(index, SOURCE_STDOUT + i));
+        }
+    }
+}
+
+/**
+ * @brief Disconnects a client and stops the request it was running.
+ */
+static void close_client(int index)
+{
+    Client* client = &server.clients[index];
+    if (client->worker > 0)
+    {
+        // The worker leads the group of everything its request started
+        kill(-client->worker, SIGTERM);
+        client->worker = 0;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        if (client->pipes[i] != -1)
+        {
+            close(client->pipes[i]);
+            client->pipes[i] = -1;
+        }
+    }
+    close(client->fd);
+    free(client->input);
+    free(client->output);
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+    client->pipes[0] = -1;
+    client->pipes[1] = -1;
+}
+
+/**
+ * @brief Sends as much pending output as the socket takes.
+ *
+ * @return 0 if the client is still connected, -1 if it was closed.
+ */
+static int flush_client(int index)
+{
+    Client* client = &server.clients[index];
+    while (client->output_sent < client->output_length)
+    {
+        ssize_t sent = send(client->fd, client->output + client->output_sent,
+                            client->output_length - client->output_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent == -1 && errno == EAGAIN)
+        {
+            break;
+        }
+        if (sent <= 0)
+        {
+            close_client(index);
+            return -1;
+        }
+        client->output_sent += sent;
+    }
+
+    size_t pending = client->output_length - client->output_sent;
+    if (pending == 0)
+    {
+        client->output_length = 0;
+        client->output_sent = 0;
+    }
+    uint32_t events = (client->closing ? 0 : EPOLLIN) | (pending > 0 ? EPOLLOUT : 0);
+    rewatch(client->fd, events, tag_of(index, SOURCE_SOCKET));
+    pause_worker(index, pending > SERVER_MAX_PENDING);
+    if (pending == 0 && client->worker == 0)
+    {
+        // The next request starts once the answer of the previous one is sent
+        start_request(index);
+    }
+    return client->fd == -1 ? -1 : 0;
+}
+
+/**
+ * @brief Sends the exit status once the worker ended and its output was read.
+ */
+static void finish_request(int index)
+{
+    Client* client = &server.clients[index];
+    if (client->worker == 0 || !client->exited || client->pipes[0] != -1 || client->pipes[1] != -1)
+    {
+        return;
+    }
+    uint32_t status = htonl((uint32_t)client->status);
+    queue_frame(client, SERVER_FRAME_EXIT, &status, sizeof(status));
+    client->worker = 0;
+    client->exited = 0;
+    client->paused = 0;
+    flush_client(index);
+}
+
+/**
+ * @brief Records the end of a worker.
+ */
+static void worker_event(pid_t pid, int status, void* data)
+{
+    int index = (int)(intptr_t)data;
+    Client* client = &server.clients[index];
+    if (WIFSTOPPED(status) || WIFCONTINUED(status) || client->worker != pid)
+    {
+        // Stale events of a worker whose client already left
+        return;
+    }
+    client->exited = 1;
+    client->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    finish_request(index);
+}
+
+/**
+ * @brief Runs a request in the forked worker and exits with its status.
+ */
+static void run_worker(char* command, int stdout_fd, int stderr_fd)
+{
+    setpgid(0, 0);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    int null_fd = open("/dev/null", O_RDONLY);
+    if (null_fd != -1)
+    {
+        dup2(null_fd, STDIN_FILENO);
+        close(null_fd);
+    }
+    dup2(stdout_fd, STDOUT_FILENO);
+    dup2(stderr_fd, STDERR_FILENO);
+    close(stdout_fd);
+    close(stderr_fd);
+
+    // Other clients must see their connection end when the server closes it
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        if (server.clients[i].fd != -1)
+        {
+            close(server.clients[i].fd);
+        }
+    }
+    close(server.listen_fd);
+    close(server.epoll_fd);
+
+    choose_execution(command);
+    fflush(stdout);
+    fflush(stderr);
+    _exit(last_exit_status & 0xff);
+}
+
+/**
+ * @brief Starts the next complete request of a client if it is idle.
+ */
+static void start_request(int index)
+{
+    Client* client = &server.clients[index];
+    if (client->worker != 0)
+    {
+        return;
+    }
+
+    uint32_t length = 0;
+    if (client->input_length >= sizeof(length))
+    {
+        memcpy(&length, client->input, sizeof(length));
+        length = ntohl(length);
+    }
+    if (client->input_length < sizeof(length) || (length < SHELL_MAX_LINE && client->input_length < 4 + length))
+    {
+        if (client->closing && client->output_length == 0)
+        {
+            // Everything the client sent was answered
+            close_client(index);
+        }
+        return;
+    }
+    if (length >= SHELL_MAX_LINE)
+    {
+        const char message[] = "request too long\n";
+        uint32_t status = htonl(2);
+        queue_frame(client, SERVER_FRAME_STDERR, message, sizeof(message) - 1);
+        queue_frame(client, SERVER_FRAME_EXIT, &status, sizeof(status));
+        client->closing = 1;
+        client->input_length = 0;
+        flush_client(index);
+        return;
+    }
+
+    char command[SHELL_MAX_LINE];
+    memcpy(command, client->input + 4, length);
+    command[length] = '\0';
+    client->input_length -= 4 + length;
+    memmove(client->input, client->input + 4 + length, client->input_length);
+
+    int output_pipe[2];
+    int error_pipe[2];
+    if (pipe2(output_pipe, O_CLOEXEC) == -1)
+    {
+        perror("pipe2");
+        close_client(index);
+        return;
+    }
+    if (pipe2(error_pipe, O_CLOEXEC) == -1)
+    {
+        perror("pipe2");
+        close(output_pipe[0]);
+        close(output_pipe[1]);
+        close_client(index);
+        return;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(output_pipe[0]);
+        close(error_pipe[0]);
+        run_worker(command, output_pipe[1], error_pipe[1]);
+    }
+    close(output_pipe[1]);
+    close(error_pipe[1]);
+    if (pid == -1)
+    {
+        perror("fork");
+        close(output_pipe[0]);
+        close(error_pipe[0]);
+        close_client(index);
+        return;
+    }
+
+    // Both sides set the group, so it exists before anyone signals it
+    setpgid(pid, pid);
+    client->worker = pid;
+    client->exited = 0;
+    client->pipes[0] = output_pipe[0];
+    client->pipes[1] = error_pipe[0];
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(client->pipes[i], F_SETFL, O_NONBLOCK);
+        watch(client->pipes[i], client->paused ? 0 : EPOLLIN, tag_of(index, SOURCE_STDOUT + i));
+    }
+    if (supervisor_watch(pid, worker_event, (void*)(intptr_t)index) == -1)
+    {
+        close_client(index);
+    }
+}
+
+/**
+ * @brief Forwards what a worker wrote to its client.
+ *
+ * @param which 0 for the standard output, 1 for the standard error.
+ */
+static void read_worker_output(int index, int which)
+{
+    Client* client = &server.clients[index];
+    char buffer[65536];
+    ssize_t length = read(client->pipes[which], buffer, sizeof(buffer));
+    if (length == -1 && (errno == EINTR || errno == EAGAIN))
+    {
+        return;
+    }
+    if (length > 0)
+    {
+        queue_frame(client, which == 0 ? SERVER_FRAME_STDOUT : SERVER_FRAME_STDERR, buffer, (uint32_t)length);
+        flush_client(index);
+        return;
+    }
+
+    close(client->pipes[which]);
+    client->pipes[which] = -1;
+    finish_request(index);
+}
+
+/**
+ * @brief Reads the requests a client sent.
+ */
+static void read_requests(int index)
+{
+    Client* client = &server.clients[index];
+    if (reserve(&client->input, &client->input_capacity, client->input_length + 4096) == -1)
+    {
+        close_client(index);
+        return;
+    }
+    ssize_t length = recv(client->fd, client->input + client->input_length,
+                          client->input_capacity - client->input_length, MSG_DONTWAIT);
+    if (length == -1 && (errno == EINTR || errno == EAGAIN))
+    {
+        return;
+    }
+    if (length <= 0)
+    {
+        // Requests already received still run and get their answers
+        client->closing = 1;
+        flush_client(index);
+        return;
+    }
+    client->input_length += length;
+    start_request(index);
+}
+
+/**
+ * @brief Accepts the pending connections.
+ */
+static void accept_clients(void)
+{
+    while (1)
+    {
+        int fd = accept4(server.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                perror("accept4");
+            }
+            return;
+        }
+
+        int index = 0;
+        while (index < SERVER_MAX_CLIENTS && server.clients[index].fd != -1)
+        {
+            index++;
+        }
+        if (index == SERVER_MAX_CLIENTS || watch(fd, EPOLLIN, tag_of(index, SOURCE_SOCKET)) == -1)
+        {
+            close(fd);
+            continue;
+        }
+        server.clients[index].fd = fd;
+    }
+}
+
+/**
+ * @brief Creates the listening socket, replacing the file of a server that is gone.
+ *
+ * @return The socket, or -1 on error.
+ */
+static int open_socket(const char* path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "server: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        perror("socket");
+        return -1;
+    }
+    int bound = bind(fd, (struct sockaddr*)&address, sizeof(address));
+    if (bound == -1 && errno == EADDRINUSE)
+    {
+        // Only a socket nobody answers on is stale
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int in_use = probe != -1 && connect(probe, (struct sockaddr*)&address, sizeof(address)) == 0;
+        if (probe != -1)
+        {
+            close(probe);
+        }
+        if (in_use)
+        {
+            fprintf(stderr, "server: %s is in use by another server\n", path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+        bound = bind(fd, (struct sockaddr*)&address, sizeof(address));
+    }
+    if (bound == -1 || listen(fd, SOMAXCONN) == -1)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Runs the server loop until SIGINT or SIGTERM.
+ *
+ * The epoll instance of the server is itself waited for with
+ * supervisor_wait_readable, so the ends of the workers are dispatched by the
+ * supervision loop between two rounds of socket and pipe events.
+ *
+ * @param path The path of the socket.
+ * @return 0 when stopped by a signal, -1 on error.
+ */
+int server_run(const char* path)
+{
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        server.clients[i].fd = -1;
+        server.clients[i].pipes[0] = -1;
+        server.clients[i].pipes[1] = -1;
+    }
+
+    server.listen_fd = open_socket(path);
+    if (server.listen_fd == -1)
+    {
+        return -1;
+    }
+    server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (server.epoll_fd == -1 || pipe2(server.stop_pipe, O_CLOEXEC | O_NONBLOCK) == -1)
+    {
+        perror("server");
+        close(server.listen_fd);
+        unlink(path);
+        return -1;
+    }
+    watch(server.listen_fd, EPOLLIN, TAG_LISTEN);
+    watch(server.stop_pipe[0], EPOLLIN, TAG_STOP);
+
+    struct sigaction action = {.sa_handler = server_stop_handler};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("Serving commands on %s\n", path);
+    fflush(stdout);
+
+    int stopping = 0;
+    int result = 0;
+    while (!stopping)
+    {
+        int ready = supervisor_wait_readable(server.epoll_fd);
+        if (ready == -1)
+        {
+            result = -1;
+            break;
+        }
+        if (ready == 0)
+        {
+            continue;
+        }
+
+        struct epoll_event events[64];
+        int count = epoll_wait(server.epoll_fd, events, 64, 0);
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t tag = events[i].data.u32;
+            if (tag == TAG_STOP)
+            {
+                stopping = 1;
+                continue;
+            }
+            if (tag == TAG_LISTEN)
+            {
+                accept_clients();
+                continue;
+            }
+
+            int index = (int)(tag / SOURCE_COUNT);
+            int source = (int)(tag % SOURCE_COUNT);
+            Client* client = &server.clients[index];
+            if (client->fd == -1)
+            {
+                // Closed by an earlier event of this round
+                continue;
+            }
+            if (source == SOURCE_SOCKET)
+            {
+                if ((events[i].events & EPOLLOUT) && flush_client(index) == -1)
+                {
+                    continue;
+                }
+                if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !client->closing)
+                {
+                    read_requests(index);
+                }
+                else if (events[i].events & (EPOLLHUP | EPOLLERR))
+                {
+                    close_client(index);
+                }
+            }
+            else if (client->pipes[source - SOURCE_STDOUT] != -1)
+            {
+                read_worker_output(index, source - SOURCE_STDOUT);
+            }
+        }
+    }
+
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        if (server.clients[i].fd != -1)
+        {
+            close_client(i);
+        }
+    }
+    close(server.listen_fd);
+    close(server.epoll_fd);
+    close(server.stop_pipe[0]);
+    close(server.stop_pipe[1]);
+    unlink(path);
+    return result;
+}
@@ -1,24 +1,26 @@
 #include "../include/shell.h"
+#include "../include/alerts.h"
 #include "../include/colors.h"
+#include "../include/completion.h"
+#include "../include/editor.h"
+#include "../include/history.h"
+#include "../include/incremental.h"
+#include "../include/jobs.h"
+#include "../include/placement.h"
+#include "../include/psi.h"
+#include "../include/server.h"
+#include "../include/supervisor.h"
+#include "../include/zygote.h"
 
 void prompt(void);
+void prompt_text(char* buffer, size_t size);
 void choose_execution(char* command);
 
 /**
- * @brief Initializes the shell and handles command input.
- *
- * This function serves as the main entry point for the shell. It prints a
- * welcome message, sets up signal handlers, and then either reads commands
- * from a specified batch file or enters an interactive loop to handle
- * user input from stdin.
- *
- * @param argc The number of command-line arguments.
- * @param argv An array of command-line argument strings.
- * @return Returns 0 upon successful execution.
+ * @brief Prints the welcome banner of interactive and batch sessions.
  */
-int init_shell(int argc, char* argv[])
+static void print_banner(void)
 {
-    // Welcome message!!
     printf(COLOR_CYAN COLOR_BOLD);
     printf("╔════════════════════════════════════════════════╗\n");
     printf("║              SURVIVAL TERMINAL v1.0            ║\n");
@@ -29,36 +31,181 @@ int init_shell(int argc, char* argv[])
     printf(COLOR_RESET);
     printf("System resources loaded... [OK]\n");
     printf("Monitoring connection established... [OK]\n\n");
+}
+
+/**
+ * @brief Initializes the shell and handles command input.
+ *
+ * This function serves as the main entry point for the shell. It prints a
+ * welcome message, sets up signal handlers, applies the --pin and --numa
+ * placement options, starts the launch helper asked for with --zygote, and
+ * then either serves commands on the socket given with --server (without the
+ * banner), reads commands from a specified batch file, where --incremental
+ * skips the commands annotated with "#@ in=... out=..." whose files still
+ * have the content of their last successful run, or enters an
+ * interactive loop to handle user input from the line editor, which records
+ * every line in the history. The interactive loop waits for input and for
+ * finished children in the same supervision loop.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv An array of command-line argument strings.
+ * @return Returns 0 upon successful execution, EXIT_FAILURE if the server could not start.
+ */
+int init_shell(int argc, char* argv[])
+{
+    // A server answers machines, they get no banner
+    int serving = 0;
+    for (int i = 1; i + 1 < argc && !serving; i++)
+    {
+        serving = strcmp(argv[i], "--server") == 0;
+    }
+
+    // Welcome message!!
+    if (!serving)
+    {
+        print_banner();
+    }
 
     setup_signals();
+    supervisor_init();
+    job_control_init();
 
-    if (argc > 1)
+    // --pin CPUS and --numa NODES place every command of the session, --zygote launches them from a helper,
+    // --incremental skips the annotated batch commands whose files did not change
+    int first_argument = 1;
+    int incremental = 0;
+    while (first_argument < argc)
     {
-        FILE* file = fopen(argv[1], "r");
+        if (strcmp(argv[first_argument], "--zygote") == 0)
+        {
+            zygote_start();
+            first_argument++;
+            continue;
+        }
+        if (strcmp(argv[first_argument], "--incremental") == 0)
+        {
+            incremental = 1;
+            first_argument++;
+            continue;
+        }
+        if (first_argument + 1 >= argc ||
+            (strcmp(argv[first_argument], "--pin") != 0 && strcmp(argv[first_argument], "--numa") != 0))
+        {
+            break;
+        }
+
+        char spec[256];
+        const char* value = argv[first_argument + 1];
+        if (strchr(value, '=') != NULL)
+        {
+            snprintf(spec, sizeof(spec), "%s", value);
+        }
+        else
+        {
+            snprintf(spec, sizeof(spec), "%s=%s", strcmp(argv[first_argument], "--pin") == 0 ? "cpus" : "node", value);
+        }
+        if (placement_set_default(spec) == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
+        first_argument += 2;
+    }
+
+    if (first_argument + 1 < argc && strcmp(argv[first_argument], "--server") == 0)
+    {
+        return server_run(argv[first_argument + 1]) == -1 ? EXIT_FAILURE : 0;
+    }
+
+    if (argc > first_argument)
+    {
+        FILE* file = fopen(argv[first_argument], "r");
         if (file == NULL)
         {
-            printf(COLOR_RED "Error opening file: %s" COLOR_RESET, argv[1]);
+            printf(COLOR_RED "Error opening file: %s" COLOR_RESET, argv[first_argument]);
             perror("fopen");
             exit(EXIT_FAILURE);
         }
 
-        char command[256];
+        const char* state_file = getenv("SURVSHELL_STATE");
+        if (incremental && incremental_open(state_file != NULL ? state_file : INCREMENTAL_STATE_FILE) == -1)
+        {
+            perror("incremental state");
+            incremental = 0;
+        }
+
+        // Comment lines are skipped, a "#@" one annotates the files of the next command
+        char command[SHELL_MAX_LINE];
+        char annotation[SHELL_MAX_LINE] = "";
         while (fgets(command, sizeof(command), file) != NULL)
         {
-            choose_execution(command);
+            const char* text = command + strspn(command, " \t");
+            if (text[0] == '#')
+            {
+                if (strncmp(text, INCREMENTAL_ANNOTATION, strlen(INCREMENTAL_ANNOTATION)) == 0)
+                {
+                    snprintf(annotation, sizeof(annotation), "%s", text + strlen(INCREMENTAL_ANNOTATION));
+                }
+                continue;
+            }
+            if (!incremental || annotation[0] == '\0')
+            {
+                choose_execution(command);
+                continue;
+            }
+
+            if (incremental_is_current(annotation, command))
+            {
+                printf("Up to date, skipped: %.*s\n", (int)strcspn(command, "\n"), command);
+            }
+            else
+            {
+                // choose_execution tokenizes the line in place
+                char line[SHELL_MAX_LINE];
+                snprintf(line, sizeof(line), "%s", command);
+                choose_execution(command);
+                if (incremental_record(annotation, line, last_exit_status) == -1)
+                {
+                    perror("incremental state");
+                }
+            }
+            annotation[0] = '\0';
         }
         fclose(file);
+        incremental_close();
     }
     else
     {
-        char command[256];
+        // Unbuffered, so readiness of the descriptor matches what fgets can read
+        setvbuf(stdin, NULL, _IONBF, 0);
+        history_init();
+        completion_init();
+        EditorHooks hooks = {history_count, history_get, history_search, completion_find, completion_each};
+        editor_set_hooks(&hooks);
+
+        char command[SHELL_MAX_LINE];
         while (1)
         {
-            prompt();
-            if (fgets(command, sizeof(command), stdin) != NULL)
+            char text[PROMPT_MAX_LENGTH];
+            prompt_text(text, sizeof(text));
+            // Jobs finishing while the user types are reported and the line is shown again
+            if (editor_read_line(text, command, sizeof(command)) == -1)
             {
-                choose_execution(command);
+                printf("\n");
+                break;
             }
+
+            // History references are shown expanded and stored as such
+            int expanded = history_expand(command, sizeof(command));
+            if (expanded == -1)
+            {
+                continue;
+            }
+            if (expanded == 1)
+            {
+                printf("%s\n", command);
+            }
+            history_add(command);
+            choose_execution(command);
         }
     }
     return 0;
@@ -71,6 +218,23 @@ int init_shell(int argc, char* argv[])
  * hostname, and working directory, similar to a standard shell.
  */
 void prompt()
+{
+    char text[PROMPT_MAX_LENGTH];
+    prompt_text(text, sizeof(text));
+    fputs(text, stdout);
+}
+
+/**
+ * @brief Formats the command prompt.
+ *
+ * The prompt holds the current user, hostname and working directory with
+ * their colors, so the line editor can draw it again while a line is edited.
+ * Alerts of the monitor that are firing are shown before them.
+ *
+ * @param buffer Where the prompt is stored.
+ * @param size The size of the buffer.
+ */
+void prompt_text(char* buffer, size_t size)
 {
     char* user = getenv("USER");
     if (user == NULL)
@@ -92,8 +256,18 @@ void prompt()
         exit(EXIT_FAILURE);
     }
 
-    printf(COLOR_GREEN "%s" COLOR_RESET "@" COLOR_BLUE "%s" COLOR_RESET ":" COLOR_YELLOW "%s" COLOR_RESET "$ ", user,
-           hostname, cwd);
+    // Firing alerts of the monitor come first
+    size_t alert = 0;
+    if (alerts_firing() != 0)
+    {
+        const MonitorConfig* config = config_hold();
+        alert = (size_t)alerts_prompt_text(config, buffer, size);
+        config_release(config);
+    }
+    alert = alert < size ? alert : 0;
+    snprintf(buffer + alert, size - alert,
+             COLOR_GREEN "%s" COLOR_RESET "@" COLOR_BLUE "%s" COLOR_RESET ":" COLOR_YELLOW "%s" COLOR_RESET "$ ", user,
+             hostname, cwd);
 }
 
 /**
@@ -101,18 +275,32 @@ void prompt()
  *
  * It inspects the command string for special characters to determine
  * if it should be executed in the background ('&'), piped ('|'),
- * with I/O redirection ('<' or '>'), or as a standard command.
+ * with I/O redirection ('<' or '>'), or as a standard command. Prefix
+ * commands such as limit are run before the pipes and redirections of
+ * their line are looked at.
  *
  * @param command The command string to analyze and execute.
  */
 void choose_execution(char* command)
 {
     command[strcspn(command, "\n")] = 0;
+    if (command[strspn(command, " \t")] == '\0')
+    {
+        return; // Empty line
+    }
+    // Internal commands succeed unless they report otherwise
+    last_exit_status = 0;
+    // A stall reported by the pressure triggers is shown before more work is started
+    psi_warn_pending();
 
     if (command[strlen(command) - 1] == '&')
     {
         execute_command_secondplane(command);
     }
+    else if (is_prefix_command(command))
+    {
+        execute_command(command);
+    }
     else if (strchr(command, '|') != NULL)
     {
         execute_piped_commands(command);
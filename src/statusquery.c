@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#include "../include/statusquery.h"
+#include "../include/executions.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Parses an interval such as 500ms, 2s or 1m; a number alone is in milliseconds.
+ *
+ * @return The interval in milliseconds, or -1 if it is invalid or shorter than SAMPLER_MIN_INTERVAL_MS.
+ */
+static long parse_interval(const char* text)
+{
+    char* end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    long factor = 0;
+    if (strcmp(end, "") == 0 || strcmp(end, "ms") == 0)
+    {
+        factor = 1;
+    }
+    else if (strcmp(end, "s") == 0)
+    {
+        factor = 1000;
+    }
+    else if (strcmp(end, "m") == 0)
+    {
+        factor = 60000;
+    }
+    if (end == text || errno == ERANGE || factor == 0 || value > 86400000 / factor ||
+        value * factor < SAMPLER_MIN_INTERVAL_MS)
+    {
+        return -1;
+    }
+    return value * factor;
+}
+
+/**
+ * @brief Reads the comma-separated metric names of a query.
+ *
+ * @return 0 on success, -1 for an unknown name.
+ */
+static int parse_metrics(char* list, StatusQuery* query)
+{
+    char* state;
+    for (char* name = strtok_r(list, ",", &state); name != NULL; name = strtok_r(NULL, ",", &state))
+    {
+        int metric = sampler_metric_index(name);
+        if (metric == -1)
+        {
+            fprintf(stderr, "status_monitor: unknown metric %s\n", name);
+            return -1;
+        }
+        if (query->metric_count < SAMPLER_METRICS)
+        {
+            query->metrics[query->metric_count++] = metric;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses the arguments of the non-interactive status_monitor.
+ *
+ * The metrics come first, as a comma-separated list of the names of
+ * config.json; the options may follow in any order.
+ *
+ * @param arg The arguments, changed by the parsing.
+ * @param query Where the query is stored.
+ * @return 0 on success, -1 with a message on stderr if the arguments are invalid.
+ */
+int statusquery_parse(char* arg, StatusQuery* query)
+{
+    memset(query, 0, sizeof(*query));
+    query->format = QUERY_PLAIN;
+    char* state;
+    for (char* word = strtok_r(arg, " \t\n", &state); word != NULL; word = strtok_r(NULL, " \t\n", &state))
+    {
+        char* value = strncmp(word, "--", 2) == 0 ? strtok_r(NULL, " \t\n", &state) : NULL;
+        if (strcmp(word, "--format") == 0 && value != NULL)
+        {
+            if (strcmp(value, "plain") == 0 || strcmp(value, "csv") == 0 || strcmp(value, "json") == 0)
+            {
+                query->format = value[0] == 'p' ? QUERY_PLAIN : value[0] == 'c' ? QUERY_CSV : QUERY_JSON;
+                continue;
+            }
+            fprintf(stderr, "status_monitor: unknown format %s, use json, csv or plain\n", value);
+            return -1;
+        }
+        if (strcmp(word, "--watch") == 0 && value != NULL)
+        {
+            long interval = parse_interval(value);
+            if (interval == -1)
+            {
+                fprintf(stderr, "status_monitor: invalid watch interval %s\n", value);
+                return -1;
+            }
+            query->watch_ms = (int)interval;
+            continue;
+        }
+        if (strcmp(word, "--count") == 0 && value != NULL)
+        {
+            if ((query->count = atol(value)) <= 0)
+            {
+                fprintf(stderr, "status_monitor: invalid count %s\n", value);
+                return -1;
+            }
+            continue;
+        }
+        if (value == NULL && word[0] != '-' && query->metric_count == 0)
+        {
+            if (parse_metrics(word, query) == -1)
+            {
+                return -1;
+            }
+            continue;
+        }
+        fprintf(stderr, "Usage: status_monitor [METRIC,...] [--format json|csv|plain] [--watch INTERVAL] [--count N]\n");
+        return -1;
+    }
+    for (int metric = 0; query->metric_count == 0 && metric < SAMPLER_METRICS; metric++)
+    {
+        query->metrics[metric] = metric;
+    }
+    query->metric_count = query->metric_count == 0 ? SAMPLER_METRICS : query->metric_count;
+    return 0;
+}
+
+/**
+ * @brief Appends formatted text to a buffer, cutting it at the end of the buffer.
+ */
+__attribute__((format(printf, 4, 5))) static void append(char* buffer, size_t size, size_t* length,
+                                                         const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    int written = vsnprintf(buffer + *length, size - *length, format, arguments);
+    va_end(arguments);
+    if (written > 0)
+    {
+        *length += (size_t)written < size - *length ? (size_t)written : size - *length - 1;
+    }
+}
+
+/**
+ * @brief Formats one sample of a query.
+ *
+ * Plain output holds the values alone, so one metric can be read straight
+ * into a variable; CSV and JSON lines start with the timestamp of the
+ * sample. A metric that could not be read is "-" in plain output, empty in
+ * CSV and null in JSON.
+ *
+ * @param query The metrics and the format.
+ * @param sample The sample.
+ * @param header 1 to start with the CSV header.
+ * @param buffer Where the text is stored.
+ * @param size The size of the buffer.
+ * @return The length of the text.
+ */
+size_t statusquery_render(const StatusQuery* query, const MetricSample* sample, int header, char* buffer,
+                          size_t size)
+{
+    size_t length = 0;
+    if (size == 0)
+    {
+        return 0;
+    }
+    buffer[0] = '\0';
+    if (header && query->format == QUERY_CSV)
+    {
+        append(buffer, size, &length, "timestamp_ms");
+        for (int index = 0; index < query->metric_count; index++)
+        {
+            append(buffer, size, &length, ",%s", sampler_metric_names[query->metrics[index]]);
+        }
+        append(buffer, size, &length, "\n");
+    }
+    if (query->format == QUERY_JSON)
+    {
+        append(buffer, size, &length, "{\"timestamp_ms\":%lld", (long long)sample->timestamp_ms);
+    }
+    else if (query->format == QUERY_CSV)
+    {
+        append(buffer, size, &length, "%lld", (long long)sample->timestamp_ms);
+    }
+
+    for (int index = 0; index < query->metric_count; index++)
+    {
+        int metric = query->metrics[index];
+        double value = sampler_metric(sample, metric);
+        const char* separator = query->format == QUERY_PLAIN ? (index == 0 ? "" : " ") : ",";
+        if (query->format == QUERY_JSON)
+        {
+            append(buffer, size, &length, ",\"%s\":", sampler_metric_names[metric]);
+            separator = "";
+        }
+        if (value < 0)
+        {
+            const char* missing = query->format == QUERY_JSON ? "null" : query->format == QUERY_CSV ? "" : "-";
+            append(buffer, size, &length, "%s%s", separator, missing);
+        }
+        else if (sampler_metric_is_count(metric))
+        {
+            append(buffer, size, &length, "%s%.0f", separator, value);
+        }
+        else
+        {
+            append(buffer, size, &length, "%s%.2f", separator, value);
+        }
+    }
+    append(buffer, size, &length, "%s", query->format == QUERY_JSON ? "}\n" : "\n");
+    return length;
+}
+
+/**
+ * @brief Writes the whole text, across short writes.
+ */
+static int write_all(const char* text, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(STDOUT_FILENO, text, length);
+        if (written == -1 && errno != EINTR)
+        {
+            return -1;
+        }
+        if (written > 0)
+        {
+            text += written;
+            length -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints a query without reading stdin.
+ *
+ * While the sampler thread runs, its latest sample is printed and nothing
+ * is read from /proc; otherwise the metrics are collected for each output.
+ * Every output is rendered into one buffer and sent with one write, so
+ * lines of a watch piped to another program arrive whole. A watch keeps
+ * absolute deadlines and ends on Ctrl-C.
+ *
+ * @param query The query.
+ * @return 0 on success, -1 if the output failed.
+ */
+int statusquery_run(const StatusQuery* query)
+{
+    // Text printf left in the buffer of stdout goes first
+    fflush(stdout);
+    interrupt_received = 0;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    char buffer[1024];
+    for (long printed = 0; query->count == 0 || printed < query->count; printed++)
+    {
+        MetricSample sample;
+        if (!sampler_latest(&sample))
+        {
+            sampler_collect(&sample);
+        }
+        size_t length = statusquery_render(query, &sample, printed == 0, buffer, sizeof(buffer));
+        if (write_all(buffer, length) == -1)
+        {
+            return -1;
+        }
+        if (query->watch_ms == 0)
+        {
+            break;
+        }
+        deadline.tv_sec += query->watch_ms / 1000;
+        deadline.tv_nsec += query->watch_ms % 1000 * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!interrupt_received && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        {
+        }
+        if (interrupt_received)
+        {
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,434 @@
+#include "../include/supervisor.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+
+// Tags stored in the epoll events that are not watcher indexes
+#define TAG_SIGNAL UINT32_MAX
+#define TAG_INPUT (UINT32_MAX - 1)
+
+/**
+ * @brief A child of the shell being watched.
+ */
+typedef struct
+{
+    pid_t pid;
+    int pidfd;
+    ChildEventHandler handler;
+    void* data;
+    /** @brief 1 if stops and continues are passed to the handler too */
+    int stops;
+    int awaited;
+    int finished;
+    int status;
+} Watcher;
+
+/**
+ * @brief State of the supervision loop, owned by a single process.
+ */
+static struct
+{
+    pid_t owner;
+    int epoll_fd;
+    int signal_fd;
+    int input_ready;
+    int use_pidfd;
+    int count;
+    sigset_t original_mask;
+    Watcher watchers[SUPERVISOR_MAX_CHILDREN];
+} supervisor = {.owner = 0, .epoll_fd = -1, .signal_fd = -1};
+
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Restores the original signal mask in forked children.
+ *
+ * The loop itself is rebuilt lazily because its owner no longer matches.
+ */
+static void supervisor_atfork_child(void)
+{
+    if (supervisor.signal_fd != -1)
+    {
+        sigprocmask(SIG_SETMASK, &supervisor.original_mask, NULL);
+    }
+}
+
+static void register_atfork(void)
+{
+    pthread_atfork(NULL, NULL, supervisor_atfork_child);
+}
+
+/**
+ * @brief Opens a pidfd for the child, returns -1 if the kernel does not support it.
+ */
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/**
+ * @brief Closes the descriptors inherited from the parent's loop.
+ */
+static void discard_inherited_state(void)
+{
+    for (int i = 0; i < SUPERVISOR_MAX_CHILDREN; i++)
+    {
+        if (supervisor.watchers[i].pid != 0 && supervisor.watchers[i].pidfd != -1)
+        {
+            close(supervisor.watchers[i].pidfd);
+        }
+    }
+    memset(supervisor.watchers, 0, sizeof(supervisor.watchers));
+    supervisor.count = 0;
+    if (supervisor.epoll_fd != -1)
+    {
+        close(supervisor.epoll_fd);
+        supervisor.epoll_fd = -1;
+    }
+    if (supervisor.signal_fd != -1)
+    {
+        close(supervisor.signal_fd);
+        supervisor.signal_fd = -1;
+    }
+}
+
+/**
+ * @brief Creates the epoll instance and the SIGCHLD signalfd, and probes pidfd support.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int supervisor_init(void)
+{
+    pid_t self = getpid();
+    if (supervisor.owner == self)
+    {
+        return 0;
+    }
+    pthread_once(&atfork_once, register_atfork);
+    discard_inherited_state();
+
+    supervisor.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (supervisor.epoll_fd == -1)
+    {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    // Exits arrive on the pidfds, stops and continues only as SIGCHLD on the signalfd
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &supervisor.original_mask);
+    supervisor.signal_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (supervisor.signal_fd == -1)
+    {
+        perror("signalfd");
+        sigprocmask(SIG_SETMASK, &supervisor.original_mask, NULL);
+        close(supervisor.epoll_fd);
+        supervisor.epoll_fd = -1;
+        return -1;
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = TAG_SIGNAL};
+    epoll_ctl(supervisor.epoll_fd, EPOLL_CTL_ADD, supervisor.signal_fd, &event);
+
+    int probe = open_pidfd(self);
+    supervisor.use_pidfd = probe != -1;
+    if (probe != -1)
+    {
+        close(probe);
+    }
+
+    supervisor.owner = self;
+    return 0;
+}
+
+/**
+ * @brief Returns the index of the watcher of a pid, or -1.
+ */
+static int find_watcher(pid_t pid)
+{
+    for (int i = 0; i < SUPERVISOR_MAX_CHILDREN; i++)
+    {
+        if (supervisor.watchers[i].pid == pid)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Frees the slot of a watcher.
+ */
+static void release_watcher(int index)
+{
+    memset(&supervisor.watchers[index], 0, sizeof(Watcher));
+    supervisor.count--;
+}
+
+/**
+ * @brief Registers a child in the loop.
+ *
+ * @param pid The child to watch.
+ * @param handler The function called when it ends, or NULL.
+ * @param data The pointer passed to the handler.
+ * @param stops 1 to call the handler when the child stops or continues too.
+ * @return 0 on success, -1 on error.
+ */
+static int watch_child(pid_t pid, ChildEventHandler handler, void* data, int stops)
+{
+    if (supervisor_init() == -1)
+    {
+        return -1;
+    }
+
+    int index = find_watcher(0);
+    if (index == -1)
+    {
+        fprintf(stderr, "supervisor: too many children\n");
+        return -1;
+    }
+
+    Watcher* watcher = &supervisor.watchers[index];
+    watcher->pid = pid;
+    watcher->pidfd = -1;
+    watcher->handler = handler;
+    watcher->data = data;
+    watcher->stops = stops;
+    watcher->awaited = 0;
+    watcher->finished = 0;
+    supervisor.count++;
+
+    if (supervisor.use_pidfd)
+    {
+        // A pidfd of a child that already exited is readable right away, so no exit is lost
+        watcher->pidfd = open_pidfd(pid);
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = (uint32_t)index};
+        if (watcher->pidfd == -1 || epoll_ctl(supervisor.epoll_fd, EPOLL_CTL_ADD, watcher->pidfd, &event) == -1)
+        {
+            perror("pidfd_open");
+            if (watcher->pidfd != -1)
+            {
+                close(watcher->pidfd);
+            }
+            release_watcher(index);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int supervisor_watch(pid_t pid, ChildEventHandler handler, void* data)
+{
+    return watch_child(pid, handler, data, 0);
+}
+
+int supervisor_watch_stops(pid_t pid, ChildEventHandler handler, void* data)
+{
+    return watch_child(pid, handler, data, 1);
+}
+
+/**
+ * @brief Reaps the child of a watcher if it has ended and runs its handler.
+ *
+ * Watchers registered with supervisor_watch_stops also get the stops and
+ * continues, which keep the watcher; the others only ever see the exit.
+ *
+ * @return 1 if the child changed state, 0 otherwise.
+ */
+static int check_watcher(int index)
+{
+    Watcher* watcher = &supervisor.watchers[index];
+    int status;
+    int options = WNOHANG | (watcher->stops ? WUNTRACED | WCONTINUED : 0);
+    if (watcher->pid == 0 || watcher->finished || waitpid(watcher->pid, &status, options) != watcher->pid)
+    {
+        return 0;
+    }
+
+    if (WIFSTOPPED(status) || WIFCONTINUED(status))
+    {
+        if (watcher->handler != NULL)
+        {
+            watcher->handler(watcher->pid, status, watcher->data);
+        }
+        // Continued children produce no output worth a new prompt
+        return WIFSTOPPED(status);
+    }
+
+    if (watcher->pidfd != -1)
+    {
+        epoll_ctl(supervisor.epoll_fd, EPOLL_CTL_DEL, watcher->pidfd, NULL);
+        close(watcher->pidfd);
+        watcher->pidfd = -1;
+    }
+    watcher->finished = 1;
+    watcher->status = status;
+
+    pid_t pid = watcher->pid;
+    ChildEventHandler handler = watcher->handler;
+    void* data = watcher->data;
+    // Watchers without a waiter are released before the handler so it can watch new children
+    if (!watcher->awaited && handler != NULL)
+    {
+        release_watcher(index);
+    }
+    if (handler != NULL)
+    {
+        handler(pid, status, data);
+    }
+    return 1;
+}
+
+/**
+ * @brief Waits for events and dispatches them.
+ *
+ * @param timeout_ms The maximum time to block, -1 for no limit.
+ * @return The number of children that ended, or -1 on error.
+ */
+int supervisor_dispatch(int timeout_ms)
+{
+    if (supervisor_init() == -1)
+    {
+        return -1;
+    }
+
+    struct epoll_event events[64];
+    int ready = epoll_wait(supervisor.epoll_fd, events, 64, timeout_ms);
+    if (ready == -1)
+    {
+        // Interrupted by a forwarded signal, the caller simply loops again
+        return errno == EINTR ? 0 : -1;
+    }
+
+    int ended = 0;
+    for (int i = 0; i < ready; i++)
+    {
+        uint32_t tag = events[i].data.u32;
+        if (tag == TAG_INPUT)
+        {
+            supervisor.input_ready = 1;
+        }
+        else if (tag == TAG_SIGNAL)
+        {
+            // SIGCHLD coalesces, so every watched child is checked once the signalfd is drained
+            struct signalfd_siginfo info;
+            while (read(supervisor.signal_fd, &info, sizeof(info)) == sizeof(info))
+            {
+            }
+            for (int j = 0; j < SUPERVISOR_MAX_CHILDREN; j++)
+            {
+                ended += check_watcher(j);
+            }
+        }
+        else if (tag < SUPERVISOR_MAX_CHILDREN)
+        {
+            ended += check_watcher((int)tag);
+        }
+    }
+    return ended;
+}
+
+/**
+ * @brief Waits for a child while other children keep being supervised.
+ *
+ * @param pid The child to wait for.
+ * @param status Where the wait status is stored, may be NULL.
+ * @return 0 on success, -1 on error.
+ */
+int supervisor_wait(pid_t pid, int* status)
+{
+    int index = supervisor_init() == 0 ? find_watcher(pid) : -1;
+    if (index == -1 && supervisor_watch(pid, NULL, NULL) == 0)
+    {
+        index = find_watcher(pid);
+    }
+    if (index == -1)
+    {
+        // Without the loop the child is still reaped the classic way
+        return waitpid(pid, status, 0) == pid ? 0 : -1;
+    }
+
+    supervisor.watchers[index].awaited = 1;
+    // The status may already be there if the child ended during an earlier round
+    check_watcher(index);
+    while (!supervisor.watchers[index].finished)
+    {
+        if (supervisor_dispatch(-1) == -1)
+        {
+            perror("epoll_wait");
+            return -1;
+        }
+    }
+
+    if (status != NULL)
+    {
+        *status = supervisor.watchers[index].status;
+    }
+    release_watcher(index);
+    return 0;
+}
+
+/**
+ * @brief Blocks until the descriptor is readable or a child handler has run.
+ *
+ * @param fd The descriptor to wait for.
+ * @return 1 if the descriptor is readable, 0 if a child ended first, -1 on error.
+ */
+int supervisor_wait_readable(int fd)
+{
+    if (supervisor_init() == -1)
+    {
+        return -1;
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = TAG_INPUT};
+    if (epoll_ctl(supervisor.epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+    {
+        // Regular files are always readable and cannot be added to epoll
+        return 1;
+    }
+
+    int result = 0;
+    supervisor.input_ready = 0;
+    while (1)
+    {
+        int ended = supervisor_dispatch(-1);
+        if (ended == -1)
+        {
+            result = -1;
+            break;
+        }
+        if (supervisor.input_ready)
+        {
+            result = 1;
+            break;
+        }
+        if (ended > 0)
+        {
+            break;
+        }
+    }
+
+    epoll_ctl(supervisor.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    return result;
+}
+
+/**
+ * @brief Returns the number of watched children.
+ */
+int supervisor_pending(void)
+{
+    return supervisor.owner == getpid() ? supervisor.count : 0;
+}
@@ -0,0 +1,448 @@
+#define _GNU_SOURCE
+#include "../include/timeseries.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+
+/** @brief Quantile estimated in every bucket */
+#define QUANTILE 0.95
+
+/**
+ * @brief Rollups of the samples of one metric in one time slot.
+ *
+ * The 95th percentile is estimated with the P² algorithm: five markers whose
+ * heights follow the minimum, the 47.5th, 95th and 97.5th percentiles and
+ * the maximum, moved by parabolic interpolation as samples arrive. Until
+ * five samples are seen, the markers hold the samples themselves, sorted.
+ */
+typedef struct
+{
+    /** @brief First second of the slot, 0 for an empty bucket */
+    int64_t start_s;
+    double sum;
+    float min;
+    float max;
+    uint32_t count;
+    float heights[5];
+    uint16_t positions[5];
+} Bucket;
+
+/**
+ * @brief Ring of buckets of one resolution for every metric.
+ */
+typedef struct
+{
+    int resolution_s;
+    int size;
+    Bucket* buckets;
+} Ring;
+
+static Bucket second_buckets[SAMPLER_METRICS][900];
+static Bucket ten_second_buckets[SAMPLER_METRICS][720];
+static Bucket minute_buckets[SAMPLER_METRICS][1440];
+
+static struct
+{
+    pthread_mutex_t lock;
+    Ring rings[TIMESERIES_RESOLUTIONS];
+} store = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .rings = {{1, 900, &second_buckets[0][0]}, {10, 720, &ten_second_buckets[0][0]}, {60, 1440, &minute_buckets[0][0]}},
+};
+
+static Bucket* bucket_at(const Ring* ring, int metric, int64_t slot)
+{
+    return &ring->buckets[(size_t)metric * ring->size + (size_t)(slot % ring->size)];
+}
+
+/**
+ * @brief Adds a value to the P² estimator of a bucket, count included.
+ */
+static void estimator_add(Bucket* bucket, float value)
+{
+    float* q = bucket->heights;
+    uint16_t* n = bucket->positions;
+
+    if (bucket->count < 5)
+    {
+        int i = (int)bucket->count;
+        while (i > 0 && q[i - 1] > value)
+        {
+            q[i] = q[i - 1];
+            i--;
+        }
+        q[i] = value;
+        bucket->count++;
+        if (bucket->count == 5)
+        {
+            for (int marker = 0; marker < 5; marker++)
+            {
+                n[marker] = (uint16_t)(marker + 1);
+            }
+        }
+        return;
+    }
+    if (bucket->count >= UINT16_MAX - 1)
+    {
+        // Positions are 16 bits wide, later samples only move the extremes
+        q[0] = fminf(q[0], value);
+        q[4] = fmaxf(q[4], value);
+        bucket->count++;
+        return;
+    }
+
+    int cell;
+    if (value < q[0])
+    {
+        q[0] = value;
+        cell = 0;
+    }
+    else if (value >= q[4])
+    {
+        q[4] = value;
+        cell = 3;
+    }
+    else
+    {
+        cell = 0;
+        while (value >= q[cell + 1])
+        {
+            cell++;
+        }
+    }
+    for (int marker = cell + 1; marker < 5; marker++)
+    {
+        n[marker]++;
+    }
+    bucket->count++;
+
+    static const double increments[5] = {0, QUANTILE / 2, QUANTILE, (1 + QUANTILE) / 2, 1};
+    for (int i = 1; i <= 3; i++)
+    {
+        double desired = 1 + (bucket->count - 1) * increments[i];
+        double offset = desired - n[i];
+        if ((offset >= 1 && n[i + 1] - n[i] > 1) || (offset <= -1 && n[i - 1] - n[i] < -1))
+        {
+            int step = offset > 0 ? 1 : -1;
+            double below = n[i] - n[i - 1];
+            double above = n[i + 1] - n[i];
+            double parabolic = q[i] + step / (double)(n[i + 1] - n[i - 1]) *
+                                          ((below + step) * (q[i + 1] - q[i]) / above +
+                                           (above - step) * (q[i] - q[i - 1]) / below);
+            if (q[i - 1] < parabolic && parabolic < q[i + 1])
+            {
+                q[i] = (float)parabolic;
+            }
+            else
+            {
+                q[i] += step * (q[i + step] - q[i]) / (float)(n[i + step] - n[i]);
+            }
+            n[i] = (uint16_t)(n[i] + step);
+        }
+    }
+}
+
+/**
+ * @brief Returns the 95th percentile estimated in a bucket.
+ */
+static double estimator_value(const Bucket* bucket)
+{
+    if (bucket->count >= 5)
+    {
+        return bucket->heights[2];
+    }
+    int index = (int)ceil(QUANTILE * bucket->count) - 1;
+    return bucket->heights[index < 0 ? 0 : index];
+}
+
+void timeseries_reset(void)
+{
+    pthread_mutex_lock(&store.lock);
+    memset(second_buckets, 0, sizeof(second_buckets));
+    memset(ten_second_buckets, 0, sizeof(ten_second_buckets));
+    memset(minute_buckets, 0, sizeof(minute_buckets));
+    pthread_mutex_unlock(&store.lock);
+}
+
+/**
+ * @brief Adds a sample to every resolution of the store.
+ *
+ * A bucket still holding an older slot of its ring is cleared first.
+ *
+ * @param sample The sample.
+ */
+void timeseries_add(const MetricSample* sample)
+{
+    int64_t second = sample->timestamp_ms / 1000;
+    pthread_mutex_lock(&store.lock);
+    for (int r = 0; r < TIMESERIES_RESOLUTIONS; r++)
+    {
+        const Ring* ring = &store.rings[r];
+        int64_t slot = second / ring->resolution_s;
+        for (int metric = 0; metric < SAMPLER_METRICS; metric++)
+        {
+            double value = sampler_metric(sample, metric);
+            if (value < 0)
+            {
+                continue;
+            }
+            Bucket* bucket = bucket_at(ring, metric, slot);
+            if (bucket->start_s != slot * ring->resolution_s)
+            {
+                memset(bucket, 0, sizeof(*bucket));
+                bucket->start_s = slot * ring->resolution_s;
+                bucket->min = bucket->max = (float)value;
+            }
+            bucket->min = fminf(bucket->min, (float)value);
+            bucket->max = fmaxf(bucket->max, (float)value);
+            bucket->sum += value;
+            estimator_add(bucket, (float)value);
+        }
+    }
+    pthread_mutex_unlock(&store.lock);
+}
+
+/**
+ * @brief Picks the ring for a window, the finest one that covers it.
+ *
+ * @return The ring, or NULL if the window is longer than every ring.
+ */
+static const Ring* ring_for(int window_s)
+{
+    for (int r = 0; r < TIMESERIES_RESOLUTIONS; r++)
+    {
+        if (window_s <= store.rings[r].resolution_s * store.rings[r].size)
+        {
+            return &store.rings[r];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the k-th smallest value of an array, reordering it.
+ *
+ * Quickselect with a middle pivot, linear on average.
+ */
+static double select_kth(double* values, int count, int k)
+{
+    int low = 0;
+    int high = count - 1;
+    while (low < high)
+    {
+        double pivot = values[low + (high - low) / 2];
+        int i = low;
+        int j = high;
+        while (i <= j)
+        {
+            while (values[i] < pivot)
+            {
+                i++;
+            }
+            while (values[j] > pivot)
+            {
+                j--;
+            }
+            if (i <= j)
+            {
+                double swap = values[i];
+                values[i++] = values[j];
+                values[j--] = swap;
+            }
+        }
+        if (k <= j)
+        {
+            high = j;
+        }
+        else if (k >= i)
+        {
+            low = i;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return values[k];
+}
+
+/**
+ * @brief Summarizes a metric over the window ending at a time.
+ *
+ * Every bucket of the window is visited once; minimum, maximum and average
+ * come from their rollups and the 95th percentile is selected among their
+ * averages, which at one sample per second are the samples themselves.
+ *
+ * @param metric The index of the metric.
+ * @param end_s The last second of the window.
+ * @param window_s The length of the window, in seconds.
+ * @param summary Where the summary is stored.
+ * @return 0 on success, -1 if the window is empty, too long or the metric unknown.
+ */
+int timeseries_query(int metric, int64_t end_s, int window_s, SeriesSummary* summary)
+{
+    const Ring* ring = ring_for(window_s);
+    if (metric < 0 || metric >= SAMPLER_METRICS || window_s <= 0 || ring == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Only used under the lock
+    static double averages[1440];
+    int64_t last = end_s / ring->resolution_s;
+    int64_t first = (end_s - window_s + 1) / ring->resolution_s;
+    double sum = 0;
+    memset(summary, 0, sizeof(*summary));
+    summary->resolution_s = ring->resolution_s;
+
+    pthread_mutex_lock(&store.lock);
+    for (int64_t slot = first; slot <= last; slot++)
+    {
+        const Bucket* bucket = bucket_at(ring, metric, slot);
+        if (bucket->start_s != slot * ring->resolution_s || bucket->count == 0)
+        {
+            continue;
+        }
+        if (summary->points == 0 || bucket->min < summary->min)
+        {
+            summary->min = bucket->min;
+        }
+        if (summary->points == 0 || bucket->max > summary->max)
+        {
+            summary->max = bucket->max;
+        }
+        sum += bucket->sum;
+        summary->count += bucket->count;
+        averages[summary->points++] = bucket->sum / bucket->count;
+    }
+    if (summary->points > 0)
+    {
+        int k = (int)ceil(QUANTILE * summary->points) - 1;
+        summary->p95 = select_kth(averages, summary->points, k < 0 ? 0 : k);
+        summary->average = sum / summary->count;
+    }
+    pthread_mutex_unlock(&store.lock);
+
+    if (summary->points == 0)
+    {
+        errno = ENODATA;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses a window such as 90, 90s, 15m or 2h into seconds.
+ *
+ * @return The number of seconds, -1 if the window is not valid.
+ */
+static int parse_window(const char* text)
+{
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (end == text || value <= 0)
+    {
+        return -1;
+    }
+    long factor = 1;
+    if (strcmp(end, "m") == 0)
+    {
+        factor = 60;
+    }
+    else if (strcmp(end, "h") == 0)
+    {
+        factor = 3600;
+    }
+    else if (strcmp(end, "d") == 0)
+    {
+        factor = 86400;
+    }
+    else if (*end != '\0' && strcmp(end, "s") != 0)
+    {
+        return -1;
+    }
+    return value > 86400 * 2 / factor ? -1 : (int)(value * factor);
+}
+
+/**
+ * @brief Prints the buckets of a window with their own rollups.
+ */
+static void print_series(int metric, int64_t end_s, int window_s)
+{
+    const Ring* ring = ring_for(window_s);
+    int64_t last = end_s / ring->resolution_s;
+    int64_t first = (end_s - window_s + 1) / ring->resolution_s;
+    printf("%-20s %10s %10s %10s %10s %6s\n", "time", "min", "avg", "p95", "max", "count");
+
+    pthread_mutex_lock(&store.lock);
+    for (int64_t slot = first; slot <= last; slot++)
+    {
+        const Bucket* bucket = bucket_at(ring, metric, slot);
+        if (bucket->start_s != slot * ring->resolution_s || bucket->count == 0)
+        {
+            continue;
+        }
+        char when[32];
+        time_t start = (time_t)bucket->start_s;
+        struct tm local;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime_r(&start, &local));
+        printf("%-20s %10.2f %10.2f %10.2f %10.2f %6u\n", when, bucket->min, bucket->sum / bucket->count,
+               estimator_value(bucket), bucket->max, bucket->count);
+    }
+    pthread_mutex_unlock(&store.lock);
+}
+
+/**
+ * @brief Builtin showing a metric over a past window.
+ *
+ * Usage: monitor_history METRIC WINDOW [--series]. The store is fed by the
+ * sampler thread, so it only holds what was sampled since start_monitor.
+ *
+ * @param arg The metric, the window and the option.
+ */
+void command_monitor_history(char* arg)
+{
+    char* words[3] = {NULL, NULL, NULL};
+    int count = 0;
+    int series = 0;
+    char* state;
+    for (char* word = strtok_r(arg, " \t\n", &state); word != NULL; word = strtok_r(NULL, " \t\n", &state))
+    {
+        if (strcmp(word, "--series") == 0)
+        {
+            series = 1;
+        }
+        else if (count < 3)
+        {
+            words[count++] = word;
+        }
+    }
+
+    int metric = count == 2 ? sampler_metric_index(words[0]) : -1;
+    int window_s = count == 2 ? parse_window(words[1]) : -1;
+    if (metric == -1 || window_s == -1 || ring_for(window_s) == NULL)
+    {
+        fprintf(stderr, "Usage: monitor_history METRIC WINDOW [--series]\n");
+        fprintf(stderr, "Metrics: cpu, memory, disk, network, processes, context_switches; window up to 24h\n");
+        return;
+    }
+
+    int64_t now = (int64_t)time(NULL);
+    SeriesSummary summary;
+    if (timeseries_query(metric, now, window_s, &summary) == -1)
+    {
+        printf("No samples of %s in the last %s, start the sampler with start_monitor interval=MS.\n", words[0],
+               words[1]);
+        return;
+    }
+    if (series)
+    {
+        print_series(metric, now, window_s);
+    }
+    printf("%s over the last %s (%d points of %ds, %ld samples): min %.2f avg %.2f p95 %.2f max %.2f\n", words[0],
+           words[1], summary.points, summary.resolution_s, summary.count, summary.min, summary.average, summary.p95,
+           summary.max);
+}
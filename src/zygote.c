@@ -0,0 +1,510 @@
+#define _GNU_SOURCE
+#include "../include/zygote.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+// Stack of the clone child, which only runs until it execs
+#define ZYGOTE_STACK_SIZE (64 * 1024)
+
+// Descriptors of a request: working directory, stdin, stdout, stderr and the terminal
+#define ZYGOTE_MAX_FDS 5
+
+// Signals the shell ignores or handles, restored to their default in children
+static const int child_default_signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD};
+
+/**
+ * @brief Fixed part of a launch request, followed by the argument and
+ * environment strings, each ended by a NUL.
+ */
+typedef struct
+{
+    int32_t process_group;
+    int32_t has_terminal;
+    uint32_t argument_count;
+    uint32_t environment_count;
+} ZygoteRequest;
+
+/**
+ * @brief Answer to a launch request.
+ */
+typedef struct
+{
+    int32_t pid;
+    int32_t error;
+} ZygoteReply;
+
+/**
+ * @brief What the clone child needs, it shares the memory of the zygote.
+ */
+typedef struct
+{
+    pid_t process_group;
+    int fds[ZYGOTE_MAX_FDS];
+    char** argv;
+    char** envp;
+    volatile int error;
+} ZygoteChild;
+
+static struct
+{
+    pid_t owner;
+    pid_t pid;
+    int fd;
+} zygote = {.owner = 0, .pid = 0, .fd = -1};
+
+/**
+ * @brief Runs a program found in the PATH of its own environment.
+ *
+ * execvpe would search the PATH of the zygote, and setenv cannot be used in
+ * a child that shares the memory of its parent.
+ */
+static void exec_in_path(char** argv, char** envp)
+{
+    if (strchr(argv[0], '/') != NULL)
+    {
+        execve(argv[0], argv, envp);
+        return;
+    }
+
+    const char* path = "/usr/local/bin:/usr/bin:/bin";
+    for (char** variable = envp; *variable != NULL; variable++)
+    {
+        if (strncmp(*variable, "PATH=", 5) == 0)
+        {
+            path = *variable + 5;
+        }
+    }
+
+    int denied = 0;
+    size_t name_length = strlen(argv[0]);
+    while (1)
+    {
+        const char* end = strchrnul(path, ':');
+        size_t directory_length = end - path;
+        char candidate[PATH_MAX];
+        if (directory_length + name_length + 2 <= sizeof(candidate))
+        {
+            // An empty entry is the current directory
+            size_t length = 0;
+            if (directory_length > 0)
+            {
+                memcpy(candidate, path, directory_length);
+                candidate[directory_length] = '/';
+                length = directory_length + 1;
+            }
+            memcpy(candidate + length, argv[0], name_length + 1);
+            execve(candidate, argv, envp);
+            if (errno == EACCES)
+            {
+                denied = 1;
+            }
+            else if (errno != ENOENT && errno != ENOTDIR)
+            {
+                return;
+            }
+        }
+        if (*end == '\0')
+        {
+            break;
+        }
+        path = end + 1;
+    }
+    errno = denied ? EACCES : ENOENT;
+}
+
+/**
+ * @brief Prepares the clone child and runs the program.
+ *
+ * The child shares the memory of the suspended zygote, so it only makes
+ * system calls and reports a failure through the shared error field.
+ */
+static int zygote_child(void* data)
+{
+    ZygoteChild* child = data;
+    if (setpgid(0, child->process_group) == -1)
+    {
+        child->error = errno;
+        _exit(127);
+    }
+    if (child->fds[4] >= 0)
+    {
+        tcsetpgrp(child->fds[4], getpgrp());
+    }
+    for (int target = 0; target < 3; target++)
+    {
+        if (dup2(child->fds[target + 1], target) == -1)
+        {
+            child->error = errno;
+            _exit(127);
+        }
+    }
+    if (fchdir(child->fds[0]) == -1)
+    {
+        child->error = errno;
+        _exit(127);
+    }
+
+    struct sigaction action = {.sa_handler = SIG_DFL};
+    sigemptyset(&action.sa_mask);
+    for (size_t i = 0; i < sizeof(child_default_signals) / sizeof(child_default_signals[0]); i++)
+    {
+        sigaction(child_default_signals[i], &action, NULL);
+    }
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    sigprocmask(SIG_SETMASK, &empty_mask, NULL);
+
+    exec_in_path(child->argv, child->envp);
+    child->error = errno;
+    _exit(127);
+}
+
+/**
+ * @brief Splits the strings of a request into the argument and environment vectors.
+ *
+ * @return 0 on success, -1 if the request is malformed.
+ */
+static int parse_strings(char* strings, size_t length, uint32_t argument_count, uint32_t environment_count,
+                         char** vector)
+{
+    if (argument_count == 0 || argument_count + environment_count + 2 > ZYGOTE_MAX_STRINGS)
+    {
+        return -1;
+    }
+    uint32_t total = argument_count + environment_count;
+    size_t offset = 0;
+    for (uint32_t i = 0; i < total; i++)
+    {
+        char* end = offset < length ? memchr(strings + offset, '\0', length - offset) : NULL;
+        if (end == NULL)
+        {
+            return -1;
+        }
+        // The environment starts after the NULL that ends the arguments
+        vector[i < argument_count ? i : i + 1] = strings + offset;
+        offset = end - strings + 1;
+    }
+    vector[argument_count] = NULL;
+    vector[total + 1] = NULL;
+    return 0;
+}
+
+/**
+ * @brief Serves launch requests until the shell closes its end of the socket.
+ */
+static void zygote_serve(int fd)
+{
+    static char message[ZYGOTE_MAX_REQUEST];
+    static char* vector[ZYGOTE_MAX_STRINGS];
+    static char stack[ZYGOTE_STACK_SIZE] __attribute__((aligned(16)));
+
+    // The zygote leaves the terminal's signals to the jobs and the shell
+    setpgid(0, 0);
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    while (1)
+    {
+        union
+        {
+            char buffer[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = {.iov_base = message, .iov_len = sizeof(message)};
+        struct msghdr header = {
+            .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = sizeof(control)};
+        ssize_t length = recvmsg(fd, &header, MSG_CMSG_CLOEXEC);
+        if (length == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (length <= 0)
+        {
+            return;
+        }
+
+        ZygoteChild child = {.fds = {-1, -1, -1, -1, -1}};
+        int fd_count = 0;
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            fd_count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(child.fds, CMSG_DATA(cmsg), fd_count * sizeof(int));
+        }
+
+        ZygoteReply reply = {.pid = -1, .error = EINVAL};
+        ZygoteRequest request;
+        if ((size_t)length >= sizeof(request) && fd_count >= 4 && !(header.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+        {
+            memcpy(&request, message, sizeof(request));
+            if ((request.has_terminal != 0) == (fd_count == 5) &&
+                parse_strings(message + sizeof(request), length - sizeof(request), request.argument_count,
+                              request.environment_count, vector) == 0)
+            {
+                child.process_group = request.process_group;
+                child.argv = vector;
+                child.envp = vector + request.argument_count + 1;
+                child.error = 0;
+                // The zygote sleeps until the child execs or exits, the child's parent is the shell
+                pid_t pid = clone(zygote_child, stack + sizeof(stack), CLONE_VM | CLONE_VFORK | CLONE_PARENT | SIGCHLD,
+                                  &child);
+                reply.pid = pid;
+                reply.error = pid == -1 ? errno : child.error;
+            }
+        }
+        for (int i = 0; i < fd_count; i++)
+        {
+            close(child.fds[i]);
+        }
+        while (send(fd, &reply, sizeof(reply), MSG_NOSIGNAL) == -1 && errno == EINTR)
+        {
+        }
+    }
+}
+
+/**
+ * @brief Closes the descriptors a freshly forked zygote inherited from the shell.
+ */
+static void close_inherited_fds(int keep)
+{
+    long max = sysconf(_SC_OPEN_MAX);
+    if (max < 0 || max > 65536)
+    {
+        max = 65536;
+    }
+    for (int fd = 3; fd < max; fd++)
+    {
+        if (fd != keep)
+        {
+            close(fd);
+        }
+    }
+}
+
+/**
+ * @brief Forks the zygote and keeps the shell's end of its socket.
+ *
+ * Called early, before the history, the completion trie or any job exists,
+ * so the zygote's image stays the size of a freshly started shell.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int zygote_start(void)
+{
+    if (zygote_available())
+    {
+        return 0;
+    }
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == -1)
+    {
+        perror("zygote: socketpair");
+        return -1;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        perror("zygote: fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        close_inherited_fds(fds[1]);
+        zygote_serve(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    zygote.owner = getpid();
+    zygote.pid = pid;
+    zygote.fd = fds[0];
+    return 0;
+}
+
+/**
+ * @brief Closes the socket so the zygote ends, and collects it.
+ */
+void zygote_stop(void)
+{
+    if (zygote.fd == -1)
+    {
+        return;
+    }
+    close(zygote.fd);
+    zygote.fd = -1;
+    if (zygote.owner == getpid())
+    {
+        waitpid(zygote.pid, NULL, 0);
+    }
+    zygote.pid = 0;
+}
+
+/**
+ * @brief Returns 1 if this process started the zygote and it is still running.
+ */
+int zygote_available(void)
+{
+    return zygote.fd != -1 && zygote.owner == getpid();
+}
+
+/**
+ * @brief Forgets a zygote that stopped answering, later launches fall back to the shell.
+ */
+static void zygote_lost(void)
+{
+    close(zygote.fd);
+    zygote.fd = -1;
+    waitpid(zygote.pid, NULL, WNOHANG);
+    fprintf(stderr, "zygote: helper lost, launching from the shell\n");
+}
+
+/**
+ * @brief Sends a launch request with its descriptors and reads the answer.
+ *
+ * The standard descriptors are always passed, the shell's own ones when the
+ * options inherit them, since redirections move them in the shell.
+ *
+ * @param argv The argument vector.
+ * @param options The options of the child.
+ * @return The pid of the child, or -1 with errno set (ENOTCONN to fall back).
+ */
+pid_t zygote_launch(char* const argv[], const LaunchOptions* options)
+{
+    if (!zygote_available())
+    {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    // Header, then the arguments and the environment
+    char* message = malloc(ZYGOTE_MAX_REQUEST);
+    if (message == NULL)
+    {
+        errno = ENOTCONN;
+        return -1;
+    }
+    ZygoteRequest request = {.has_terminal = options != NULL && options->terminal_fd >= 0};
+    request.process_group = options != NULL && options->process_group >= 0 ? options->process_group : getpgrp();
+    size_t length = sizeof(request);
+    int fits = 1;
+    for (int part = 0; part < 2 && fits; part++)
+    {
+        char* const* strings = part == 0 ? argv : environ;
+        for (int i = 0; strings[i] != NULL && fits; i++)
+        {
+            size_t size = strlen(strings[i]) + 1;
+            fits = length + size <= ZYGOTE_MAX_REQUEST &&
+                   request.argument_count + request.environment_count + 2 < ZYGOTE_MAX_STRINGS;
+            if (fits)
+            {
+                memcpy(message + length, strings[i], size);
+                length += size;
+                *(part == 0 ? &request.argument_count : &request.environment_count) += 1;
+            }
+        }
+    }
+    memcpy(message, &request, sizeof(request));
+
+    int cwd_fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (!fits || cwd_fd == -1)
+    {
+        // Huge environments and unreadable directories are left to the shell
+        free(message);
+        if (cwd_fd != -1)
+        {
+            close(cwd_fd);
+        }
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    int fds[ZYGOTE_MAX_FDS] = {cwd_fd, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, -1};
+    int fd_count = 4;
+    if (options != NULL)
+    {
+        fds[1] = options->stdin_fd >= 0 ? options->stdin_fd : STDIN_FILENO;
+        fds[2] = options->stdout_fd >= 0 ? options->stdout_fd : STDOUT_FILENO;
+        fds[3] = options->stderr_fd >= 0 ? options->stderr_fd : STDERR_FILENO;
+        if (request.has_terminal)
+        {
+            fds[fd_count++] = options->terminal_fd;
+        }
+    }
+
+    union
+    {
+        char buffer[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {.iov_base = message, .iov_len = length};
+    struct msghdr header = {.msg_iov = &iov,
+                            .msg_iovlen = 1,
+                            .msg_control = control.buffer,
+                            .msg_controllen = CMSG_SPACE(fd_count * sizeof(int))};
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fd_count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, fd_count * sizeof(int));
+
+    // Pending output of the shell must appear before the output of the child
+    fflush(stdout);
+
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(zygote.fd, &header, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+    close(cwd_fd);
+    free(message);
+
+    ZygoteReply reply;
+    ssize_t received = -1;
+    if (sent == (ssize_t)length)
+    {
+        do
+        {
+            received = recv(zygote.fd, &reply, sizeof(reply), 0);
+        } while (received == -1 && errno == EINTR);
+    }
+    if (received != (ssize_t)sizeof(reply))
+    {
+        zygote_lost();
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    if (reply.pid == -1)
+    {
+        // The zygote could not clone, the shell may still be able to
+        errno = ENOTCONN;
+        return -1;
+    }
+    if (reply.error != 0)
+    {
+        // The child never ran the program, it is our child, so collect it here
+        waitpid(reply.pid, NULL, 0);
+        errno = reply.error;
+        return -1;
+    }
+    return reply.pid;
+}
@@ -0,0 +1,140 @@
+#include "../include/alerts.h"
+#include "unity.h"
+#include <unistd.h>
+
+static const char* log_path = "/tmp/test_alerts.log";
+static MonitorConfig config;
+
+static MetricSample sample_at(int64_t timestamp_ms, double cpu, double memory)
+{
+    MetricSample sample = {timestamp_ms, cpu, memory, -1, -1, 100, 10, {-1, -1, -1}};
+    return sample;
+}
+
+void setUp(void)
+{
+    memset(&config, 0, sizeof(config));
+    config.generation = 1000;
+    config.alert_prompt = 1;
+    config.alert_log = (char*)log_path;
+    const char* rules[] = {"cpu > 90% for 30s clear 80%", "memory >= 50"};
+    for (int rule = 0; rule < 2; rule++)
+    {
+        TEST_ASSERT_EQUAL_INT(0, config_compile_rule(rules[rule], &config.rules[rule]));
+        config.rule_texts[rule] = (char*)rules[rule];
+    }
+    config.rule_count = 2;
+    unlink(log_path);
+}
+
+void tearDown(void)
+{
+    alerts_reset();
+    unlink(log_path);
+}
+
+void test_compile_rules(void)
+{
+    AlertRule rule;
+    TEST_ASSERT_EQUAL_INT(0, config_compile_rule("processes < 10 for 2m", &rule));
+    TEST_ASSERT_EQUAL_INT(RULE_BELOW, rule.comparison);
+    TEST_ASSERT_EQUAL_UINT32(120000, rule.hold_ms);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 11.0f, rule.clear);
+    TEST_ASSERT_EQUAL_INT(-1, config_compile_rule("temperature > 10", &rule));
+    TEST_ASSERT_EQUAL_INT(-1, config_compile_rule("cpu = 10", &rule));
+    TEST_ASSERT_EQUAL_INT(-1, config_compile_rule("cpu > 90 clear 95", &rule));
+    TEST_ASSERT_EQUAL_INT(-1, config_compile_rule("cpu > 90 for soon", &rule));
+}
+
+void test_rule_fires_after_its_duration(void)
+{
+    MetricSample sample = sample_at(1000000, 95, 10);
+    alerts_evaluate(&config, &sample);
+    TEST_ASSERT_EQUAL_UINT64(0, alerts_firing());
+    sample = sample_at(1020000, 95, 10);
+    alerts_evaluate(&config, &sample);
+    TEST_ASSERT_EQUAL_UINT64(0, alerts_firing());
+    sample = sample_at(1030000, 96, 10);
+    alerts_evaluate(&config, &sample);
+    TEST_ASSERT_EQUAL_UINT64(1, alerts_firing());
+
+    char prompt[256];
+    TEST_ASSERT_TRUE(alerts_prompt_text(&config, prompt, sizeof(prompt)) > 0);
+    TEST_ASSERT_NOT_NULL(strstr(prompt, "cpu > 90% for 30s"));
+}
+
+void test_hysteresis_keeps_the_alert(void)
+{
+    MetricSample sample = sample_at(1000000, 20, 60);
+    alerts_evaluate(&config, &sample);
+    TEST_ASSERT_EQUAL_UINT64(2, alerts_firing());
+    // Between the clear value, 45, and the threshold the alert stays
+    sample = sample_at(1001000, 20, 47);
+    alerts_evaluate(&config, &sample);
+    TEST_ASSERT_EQUAL_UINT64(2, alerts_firing());
+    sample = sample_at(1002000, 20, 40);
+    alerts_evaluate(&config, &sample);
+    TEST_ASSERT_EQUAL_UINT64(0, alerts_firing());
+
+    FILE* log = fopen(log_path, "r");
+    TEST_ASSERT_NOT_NULL(log);
+    char line[512];
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), log));
+    TEST_ASSERT_NOT_NULL(strstr(line, " firing memory >= 50: memory is 60.00"));
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), log));
+    TEST_ASSERT_NOT_NULL(strstr(line, " cleared memory >= 50: memory is 40.00"));
+    TEST_ASSERT_NULL(fgets(line, sizeof(line), log));
+    fclose(log);
+}
+
+void test_hook_receives_the_alert(void)
+{
+    const char* output = "/tmp/test_alerts.hook";
+    unlink(output);
+    config.alert_hook = "echo \"$2 $3 $4\" > /tmp/test_alerts.hook";
+    MetricSample sample = sample_at(1000000, 20, 70);
+    alerts_evaluate(&config, &sample);
+    for (int wait = 0; wait < 100 && access(output, F_OK) != 0; wait++)
+    {
+        usleep(20000);
+    }
+    usleep(50000);
+    FILE* file = fopen(output, "r");
+    TEST_ASSERT_NOT_NULL(file);
+    char line[128];
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), file));
+    TEST_ASSERT_EQUAL_STRING("firing memory 70.00\n", line);
+    fclose(file);
+    unlink(output);
+}
+
+void test_reload_keeps_unchanged_rules(void)
+{
+    MetricSample sample = sample_at(1000000, 95, 60);
+    alerts_evaluate(&config, &sample);
+    TEST_ASSERT_EQUAL_UINT64(2, alerts_firing());
+
+    // The memory rule moves first and the cpu rule is replaced
+    MonitorConfig reloaded = config;
+    reloaded.generation = 1001;
+    reloaded.rules[0] = config.rules[1];
+    reloaded.rule_texts[0] = config.rule_texts[1];
+    TEST_ASSERT_EQUAL_INT(0, config_compile_rule("cpu > 90% for 20s", &reloaded.rules[1]));
+    sample = sample_at(1020000, 95, 60);
+    alerts_evaluate(&reloaded, &sample);
+    TEST_ASSERT_EQUAL_UINT64(1, alerts_firing());
+    sample = sample_at(1040000, 95, 60);
+    alerts_evaluate(&reloaded, &sample);
+    TEST_ASSERT_EQUAL_UINT64(3, alerts_firing());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_compile_rules);
+    RUN_TEST(test_rule_fires_after_its_duration);
+    RUN_TEST(test_hysteresis_keeps_the_alert);
+    RUN_TEST(test_hook_receives_the_alert);
+    RUN_TEST(test_reload_keeps_unchanged_rules);
+    return UNITY_END();
+}
@@ -0,0 +1,127 @@
+#include "../include/cache.h"
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char path[64];
+
+/**
+ * @brief Stores a result whose output is the given text, padded to a size.
+ */
+static void store(const char* key, const char* text, size_t size, int status)
+{
+    char* output = calloc(1, size + 1);
+    snprintf(output, size + 1, "%s", text);
+    CacheEntry entry = {.output = output, .output_length = size, .errors = "", .errors_length = 0, .status = status};
+    TEST_ASSERT_EQUAL_INT(0, cache_store(key, strlen(key), &entry));
+    free(output);
+}
+
+static int lookup(const char* key, CacheEntry* entry)
+{
+    return cache_lookup(key, strlen(key), 60000, entry);
+}
+
+void setUp(void)
+{
+    snprintf(path, sizeof(path), "/tmp/test_cache_%d", (int)getpid());
+    unlink(path);
+    TEST_ASSERT_EQUAL_INT(0, cache_open(path));
+}
+
+void tearDown(void)
+{
+    cache_close();
+    unlink(path);
+}
+
+void test_cache_replays_stored_result(void)
+{
+    CacheEntry stored = {.output = "Linux\n", .output_length = 6, .errors = "warning\n", .errors_length = 8, .status = 3};
+    TEST_ASSERT_EQUAL_INT(0, cache_store("uname", 5, &stored));
+
+    CacheEntry entry;
+    TEST_ASSERT_EQUAL_INT(1, lookup("uname", &entry));
+    TEST_ASSERT_EQUAL_STRING("Linux\n", entry.output);
+    TEST_ASSERT_EQUAL_STRING("warning\n", entry.errors);
+    TEST_ASSERT_EQUAL_INT(3, entry.status);
+    cache_entry_free(&entry);
+
+    TEST_ASSERT_EQUAL_INT(0, lookup("unam", &entry));
+    TEST_ASSERT_EQUAL_INT(0, cache_lookup("uname", 5, -1, &entry));
+}
+
+void test_cache_replaces_result_with_same_key(void)
+{
+    store("date", "first", 5, 0);
+    store("date", "second", 6, 0);
+    CacheEntry entry;
+    TEST_ASSERT_EQUAL_INT(1, lookup("date", &entry));
+    TEST_ASSERT_EQUAL_STRING("second", entry.output);
+    cache_entry_free(&entry);
+}
+
+void test_cache_keeps_used_results_when_full(void)
+{
+    size_t size = CACHE_ARENA_SIZE / 8;
+    store("used", "used", size, 0);
+    store("unused", "unused", size, 0);
+    for (int i = 0; i < 12; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "filler%d", i);
+        store(key, key, size, 0);
+
+        // Hits move the result away from the oldest ones
+        CacheEntry entry;
+        TEST_ASSERT_EQUAL_INT(1, lookup("used", &entry));
+        cache_entry_free(&entry);
+    }
+
+    CacheEntry entry;
+    TEST_ASSERT_EQUAL_INT(0, lookup("unused", &entry));
+    TEST_ASSERT_EQUAL_INT(0, lookup("filler0", &entry));
+    TEST_ASSERT_EQUAL_INT(1, lookup("filler11", &entry));
+    cache_entry_free(&entry);
+}
+
+void test_cache_is_shared_through_its_file(void)
+{
+    store("shared", "value", 5, 0);
+    cache_close();
+    TEST_ASSERT_EQUAL_INT(0, cache_open(path));
+    CacheEntry entry;
+    TEST_ASSERT_EQUAL_INT(1, lookup("shared", &entry));
+    TEST_ASSERT_EQUAL_STRING("value", entry.output);
+    cache_entry_free(&entry);
+}
+
+void test_cached_line_with_redirection_always_runs(void)
+{
+    char target[80];
+    char line[128];
+    snprintf(target, sizeof(target), "%s.out", path);
+    setenv("SURVSHELL_CACHE", path, 1);
+
+    // The line is parsed in place, so it is written again for each run
+    for (int run = 0; run < 2; run++)
+    {
+        snprintf(line, sizeof(line), "echo written > %s", target);
+        command_cached(line);
+        TEST_ASSERT_EQUAL_INT(0, access(target, F_OK));
+        unlink(target);
+    }
+    unsetenv("SURVSHELL_CACHE");
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cache_replays_stored_result);
+    RUN_TEST(test_cache_replaces_result_with_same_key);
+    RUN_TEST(test_cache_keeps_used_results_when_full);
+    RUN_TEST(test_cache_is_shared_through_its_file);
+    RUN_TEST(test_cached_line_with_redirection_always_runs);
+    return UNITY_END();
+}
@@ -4,13 +4,6 @@
 #include <string.h>
 #include <unistd.h>
 
-// Mock functions to avoid dependencies during testing
-void set_foreground_pid(pid_t pid)
-{
-    // Mock implementation
-    (void)pid;
-}
-
 void setUp(void)
 {
     // Setup before each test
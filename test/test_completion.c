@@ -0,0 +1,108 @@
+#include "../include/completion.h"
+#include "unity.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char directory[] = "/tmp/test_completion_XXXXXX";
+
+/**
+ * @brief Creates a file in the test directory with the given mode.
+ */
+static void create_file(const char* name, mode_t mode)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    int fd = open(path, O_CREAT | O_WRONLY, mode);
+    close(fd);
+    chmod(path, mode);
+}
+
+static void count_name(const char* name, void* data)
+{
+    (void)name;
+    (*(int*)data)++;
+}
+
+void setUp(void)
+{
+    mkdtemp(directory);
+    create_file("gradle", 0755);
+    create_file("grep", 0755);
+    create_file("grepdiff", 0755);
+    create_file("notes.txt", 0644);
+    setenv("PATH", directory, 1);
+    completion_init();
+}
+
+void tearDown(void)
+{
+    const char* names[] = {"gradle", "grep", "grepdiff", "notes.txt", "groovy"};
+    for (int i = 0; i < 5; i++)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+        unlink(path);
+    }
+    rmdir(directory);
+    strcpy(directory, "/tmp/test_completion_XXXXXX");
+    completion_close();
+}
+
+void test_completion_extends_common_prefix(void)
+{
+    char common[64];
+    TEST_ASSERT_EQUAL_INT(3, completion_find("gr", common, sizeof(common)));
+    TEST_ASSERT_EQUAL_STRING("gr", common);
+    TEST_ASSERT_EQUAL_INT(2, completion_find("gre", common, sizeof(common)));
+    TEST_ASSERT_EQUAL_STRING("grep", common);
+    TEST_ASSERT_EQUAL_INT(1, completion_find("gra", common, sizeof(common)));
+    TEST_ASSERT_EQUAL_STRING("gradle", common);
+}
+
+void test_completion_skips_non_executables(void)
+{
+    char common[64];
+    TEST_ASSERT_EQUAL_INT(0, completion_find("notes", common, sizeof(common)));
+}
+
+void test_completion_includes_internal_commands(void)
+{
+    char common[64];
+    TEST_ASSERT_EQUAL_INT(1, completion_find("start_m", common, sizeof(common)));
+    TEST_ASSERT_EQUAL_STRING("start_monitor", common);
+}
+
+void test_completion_follows_directory_changes(void)
+{
+    char common[64];
+    create_file("groovy", 0755);
+    TEST_ASSERT_EQUAL_INT(1, completion_find("gro", common, sizeof(common)));
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/grepdiff", directory);
+    unlink(path);
+    TEST_ASSERT_EQUAL_INT(1, completion_find("gre", common, sizeof(common)));
+    TEST_ASSERT_EQUAL_STRING("grep", common);
+}
+
+void test_completion_each_visits_matches(void)
+{
+    int count = 0;
+    TEST_ASSERT_EQUAL_INT(3, completion_each("gr", 10, count_name, &count));
+    TEST_ASSERT_EQUAL_INT(3, count);
+    TEST_ASSERT_EQUAL_INT(2, completion_each("gr", 2, count_name, &count));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_completion_extends_common_prefix);
+    RUN_TEST(test_completion_skips_non_executables);
+    RUN_TEST(test_completion_includes_internal_commands);
+    RUN_TEST(test_completion_follows_directory_changes);
+    RUN_TEST(test_completion_each_visits_matches);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+#include "../include/config.h"
+#include "unity.h"
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const char* config_file = "/tmp/test_config/config.json";
+
+static void save(const char* path, const char* text)
+{
+    FILE* file = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    fputs(text, file);
+    fclose(file);
+}
+
+void setUp(void)
+{
+    mkdir("/tmp/test_config", 0755);
+    setenv("SURVSHELL_CONFIG", config_file, 1);
+}
+
+void tearDown(void)
+{
+    unlink(config_file);
+    unlink("/tmp/test_config/config.json.new");
+    rmdir("/tmp/test_config");
+}
+
+void test_sampler_interval(void)
+{
+    save(config_file, "{\"sampler\": {\"interval_ms\": 250}}");
+    MonitorConfig* config = config_load(config_file);
+    TEST_ASSERT_NOT_NULL(config);
+    TEST_ASSERT_EQUAL_INT(250, config->interval_ms);
+    config_free(config);
+
+    save(config_file, "{\"sampler\": {\"interval_ms\": 1}}");
+    TEST_ASSERT_NULL(config_load(config_file));
+    save(config_file, "{\"metrics\": {\"disk\": false}}");
+    config = config_load(config_file);
+    TEST_ASSERT_NOT_NULL(config);
+    TEST_ASSERT_EQUAL_INT(0, config->interval_ms);
+    TEST_ASSERT_EQUAL_INT(0, config->metrics[2]);
+    config_free(config);
+}
+
+void test_invalid_reload_keeps_the_configuration(void)
+{
+    save(config_file, "{\"sampler\": {\"interval_ms\": 500}}");
+    TEST_ASSERT_EQUAL_INT(0, config_reload());
+    save(config_file, "{\"sampler\": ");
+    TEST_ASSERT_EQUAL_INT(-1, config_reload());
+    const MonitorConfig* config = config_hold();
+    TEST_ASSERT_NOT_NULL(config);
+    TEST_ASSERT_EQUAL_INT(500, config->interval_ms);
+    config_release(config);
+}
+
+void test_held_configuration_outlives_a_reload(void)
+{
+    save(config_file, "{\"sampler\": {\"interval_ms\": 100}}");
+    TEST_ASSERT_EQUAL_INT(0, config_reload());
+    const MonitorConfig* held = config_hold();
+    TEST_ASSERT_EQUAL_PTR(held, config_hold());
+    uint64_t generation = held->generation;
+
+    save(config_file, "{\"sampler\": {\"interval_ms\": 200}}");
+    TEST_ASSERT_EQUAL_INT(0, config_reload());
+    config_collect();
+    // Still held twice, so still readable
+    TEST_ASSERT_EQUAL_UINT64(generation, held->generation);
+    TEST_ASSERT_EQUAL_INT(100, held->interval_ms);
+    config_release(held);
+    config_release(held);
+
+    const MonitorConfig* current = config_hold();
+    TEST_ASSERT_EQUAL_INT(200, current->interval_ms);
+    TEST_ASSERT_TRUE(current->generation > generation);
+    config_release(current);
+    config_collect();
+}
+
+static void* hold_once(void* unused)
+{
+    (void)unused;
+    const MonitorConfig* config = config_hold();
+    config_release(config);
+    return (void*)config;
+}
+
+void test_exited_threads_give_their_slot_back(void)
+{
+    save(config_file, "{}");
+    TEST_ASSERT_EQUAL_INT(0, config_reload());
+    for (int i = 0; i < 3 * CONFIG_READERS; i++)
+    {
+        pthread_t thread;
+        void* held = NULL;
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, hold_once, NULL));
+        TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, &held));
+        TEST_ASSERT_NOT_NULL(held);
+    }
+}
+
+void test_watch_reports_saves(void)
+{
+    save(config_file, "{}");
+    int fd = config_watch_open();
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    TEST_ASSERT_EQUAL_INT(0, config_watch_changed(fd));
+
+    // Saved the way editors do, by renaming a new file over the old one
+    save("/tmp/test_config/config.json.new", "{\"sampler\": {\"interval_ms\": 50}}");
+    struct pollfd waited = {.fd = fd, .events = POLLIN};
+    TEST_ASSERT_EQUAL_INT(1, poll(&waited, 1, 1000));
+    TEST_ASSERT_EQUAL_INT(0, config_watch_changed(fd));
+    TEST_ASSERT_EQUAL_INT(0, rename("/tmp/test_config/config.json.new", config_file));
+    TEST_ASSERT_EQUAL_INT(1, poll(&waited, 1, 1000));
+    TEST_ASSERT_EQUAL_INT(1, config_watch_changed(fd));
+    close(fd);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sampler_interval);
+    RUN_TEST(test_invalid_reload_keeps_the_configuration);
+    RUN_TEST(test_held_configuration_outlives_a_reload);
+    RUN_TEST(test_exited_threads_give_their_slot_back);
+    RUN_TEST(test_watch_reports_saves);
+    return UNITY_END();
+}
@@ -0,0 +1,90 @@
+#include "../include/cpustat.h"
+#include "unity.h"
+
+static CpuTimes before;
+static CpuTimes after;
+static CpuUsage usage;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+    cpustat_free_times(&before);
+    cpustat_free_times(&after);
+    cpustat_free_usage(&usage);
+}
+
+void test_parse_reads_every_cpu_line(void)
+{
+    const char* text = "cpu  40 0 20 100 10 0 0 30 0 0\n"
+                       "cpu0 10 0 5 50 5 0 0 10 0 0\n"
+                       "cpu2 30 0 15 50 5 0 0 20\n"
+                       "intr 12345 0 0\n";
+    TEST_ASSERT_EQUAL_INT(2, cpustat_parse(text, &before));
+    TEST_ASSERT_EQUAL_INT(0, before.id[0]);
+    TEST_ASSERT_EQUAL_INT(2, before.id[1]);
+    TEST_ASSERT_EQUAL_UINT64(30, before.ticks[CPUSTAT_USER][1]);
+    TEST_ASSERT_EQUAL_UINT64(20, before.ticks[CPUSTAT_STEAL][1]);
+    TEST_ASSERT_EQUAL_UINT64(100, before.total[CPUSTAT_IDLE]);
+}
+
+void test_usage_splits_each_cpu(void)
+{
+    TEST_ASSERT_EQUAL_INT(2, cpustat_parse("cpu  0 0 0 0 0 0 0 0\ncpu0 0 0 0 0 0 0 0 0\ncpu1 0 0 0 0 0 0 0 0\n", &before));
+    // cpu0 is fully busy in user time, cpu1 waits on I/O half of the time and has a quarter stolen
+    TEST_ASSERT_EQUAL_INT(2, cpustat_parse("cpu  100 0 0 25 50 0 0 25\ncpu0 100 0 0 0 0 0 0 0\n"
+                                           "cpu1 0 0 0 25 50 0 0 25\n",
+                                           &after));
+    TEST_ASSERT_EQUAL_INT(2, cpustat_usage(&before, &after, &usage));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f, usage.share[CPUSTAT_BUSY][0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f, usage.share[CPUSTAT_USER_SHARE][0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 25.0f, usage.share[CPUSTAT_BUSY][1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, usage.share[CPUSTAT_IOWAIT_SHARE][1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 25.0f, usage.share[CPUSTAT_STEAL_SHARE][1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 62.5f, usage.total[CPUSTAT_BUSY]);
+
+    CpuSpread spread;
+    cpustat_spread(&usage, &spread);
+    TEST_ASSERT_EQUAL_INT(1, spread.coolest);
+    TEST_ASSERT_EQUAL_INT(0, spread.hottest);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 62.5f, spread.average);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 37.5f, spread.deviation);
+}
+
+void test_total_of_many_cpus_does_not_wrap(void)
+{
+    // Over 2^32 ticks between the aggregate lines, a few hours of a large machine
+    TEST_ASSERT_EQUAL_INT(1, cpustat_parse("cpu  0 0 0 0 0 0 0 0\ncpu0 0 0 0 0 0 0 0 0\n", &before));
+    TEST_ASSERT_EQUAL_INT(1, cpustat_parse("cpu  3000000000 0 0 9000000000 0 0 0 0\ncpu0 30 0 0 90 0 0 0 0\n", &after));
+    TEST_ASSERT_EQUAL_INT(1, cpustat_usage(&before, &after, &usage));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 25.0f, usage.share[CPUSTAT_BUSY][0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 25.0f, usage.total[CPUSTAT_BUSY]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 25.0f, usage.total[CPUSTAT_USER_SHARE]);
+}
+
+void test_changed_cpu_set_is_refused(void)
+{
+    TEST_ASSERT_EQUAL_INT(1, cpustat_parse("cpu  1 0 0 1 0 0 0 0\ncpu0 1 0 0 1 0 0 0 0\n", &before));
+    TEST_ASSERT_EQUAL_INT(1, cpustat_parse("cpu  2 0 0 2 0 0 0 0\ncpu1 2 0 0 2 0 0 0 0\n", &after));
+    TEST_ASSERT_EQUAL_INT(-1, cpustat_usage(&before, &after, &usage));
+}
+
+void test_reads_this_machine(void)
+{
+    TEST_ASSERT_TRUE(cpustat_read(&before) > 0);
+    TEST_ASSERT_EQUAL_INT(before.count, cpustat_read(&after));
+    TEST_ASSERT_EQUAL_INT(before.count, cpustat_usage(&before, &after, &usage));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_reads_every_cpu_line);
+    RUN_TEST(test_usage_splits_each_cpu);
+    RUN_TEST(test_total_of_many_cpus_does_not_wrap);
+    RUN_TEST(test_changed_cpu_set_is_refused);
+    RUN_TEST(test_reads_this_machine);
+    return UNITY_END();
+}
@@ -0,0 +1,102 @@
+#include "../include/devstats.h"
+#include "unity.h"
+#include <unistd.h>
+
+static const char* path = "/tmp/test_devstats_config.json";
+static MonitorConfig* config = NULL;
+
+void setUp(void)
+{
+    FILE* file = fopen(path, "w");
+    fputs("{\"metrics\": {\"disk\": false},\n"
+          " \"devices\": {\"disks\": {\"include\": [\"sd*\", \"nvme*\"], \"exclude\": [\"sdz\"]},\n"
+          "             \"interfaces\": {\"exclude\": [\"lo\", \"veth*\"]}}}\n",
+          file);
+    fclose(file);
+    config = config_load(path);
+}
+
+void tearDown(void)
+{
+    config_free(config);
+    devstats_reset();
+    unlink(path);
+}
+
+void test_config_reads_metrics_and_filters(void)
+{
+    TEST_ASSERT_NOT_NULL(config);
+    TEST_ASSERT_EQUAL_INT(1, config->metrics[sampler_metric_index("cpu")]);
+    TEST_ASSERT_EQUAL_INT(0, config->metrics[sampler_metric_index("disk")]);
+    TEST_ASSERT_EQUAL_INT(1, config_device_selected(&config->disks, "sda"));
+    TEST_ASSERT_EQUAL_INT(1, config_device_selected(&config->disks, "nvme0n1"));
+    TEST_ASSERT_EQUAL_INT(0, config_device_selected(&config->disks, "sdz"));
+    TEST_ASSERT_EQUAL_INT(0, config_device_selected(&config->disks, "loop0"));
+    TEST_ASSERT_EQUAL_INT(1, config_device_selected(&config->interfaces, "eth0"));
+    TEST_ASSERT_EQUAL_INT(0, config_device_selected(&config->interfaces, "veth12ab"));
+}
+
+void test_invalid_config_is_refused(void)
+{
+    FILE* file = fopen(path, "w");
+    fputs("{\"devices\": {\"disks\": {\"include\": \"sd*\"}}}", file);
+    fclose(file);
+    TEST_ASSERT_NULL(config_load(path));
+    TEST_ASSERT_NULL(config_load("/nonexistent/config.json"));
+}
+
+void test_disk_rates_and_latency(void)
+{
+    const char* before = "   8       0 sda 100 0 800 50 200 0 1600 150 0 100 200\n"
+                         "   7       0 loop0 5 0 10 1 0 0 0 0 0 1 1\n";
+    const char* after = "   8       0 sda 150 0 1800 150 250 0 2600 250 1 600 900\n"
+                        "   7       0 loop0 9 0 20 2 0 0 0 0 0 2 2\n";
+    TEST_ASSERT_EQUAL_INT(1, devstats_parse(before, NULL, 1000, config));
+    DiskRates rates[4];
+    TEST_ASSERT_EQUAL_INT(0, devstats_disks(rates, 4));
+    TEST_ASSERT_EQUAL_INT(1, devstats_parse(after, NULL, 2000, config));
+    TEST_ASSERT_EQUAL_INT(1, devstats_disks(rates, 4));
+    TEST_ASSERT_EQUAL_STRING("sda", rates[0].name);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, (float)rates[0].reads_per_second);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, (float)rates[0].writes_per_second);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 512000.0f, (float)rates[0].read_bytes_per_second);
+    // 200 ms spent on 100 requests
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 2.0f, (float)rates[0].latency_ms);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, (float)rates[0].utilization);
+}
+
+void test_interface_rates_skip_excluded(void)
+{
+    const char* header = "Inter-|   Receive                                                |  Transmit\n"
+                         " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs "
+                         "drop fifo colls carrier compressed\n";
+    char before[512];
+    char after[512];
+    snprintf(before, sizeof(before),
+             "%s    lo: 1000 10 0 0 0 0 0 0 1000 10 0 0 0 0 0 0\n"
+             "  eth0: 2000 20 0 1 0 0 0 0 4000 40 0 0 0 0 0 0\n",
+             header);
+    snprintf(after, sizeof(after),
+             "%s    lo: 9000 90 0 0 0 0 0 0 9000 90 0 0 0 0 0 0\n"
+             "  eth0: 4048 30 1 3 0 0 0 0 8096 80 1 2 0 0 0 0\n",
+             header);
+    TEST_ASSERT_EQUAL_INT(1, devstats_parse(NULL, before, 1000, config));
+    TEST_ASSERT_EQUAL_INT(1, devstats_parse(NULL, after, 1500, config));
+    InterfaceRates rates[4];
+    TEST_ASSERT_EQUAL_INT(1, devstats_interfaces(rates, 4));
+    TEST_ASSERT_EQUAL_STRING("eth0", rates[0].name);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 4096.0f, (float)rates[0].receive_bytes_per_second);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 80.0f, (float)rates[0].transmit_packets_per_second);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 4.0f, (float)rates[0].receive_drops_per_second);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 4.0f, (float)rates[0].errors_per_second);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_config_reads_metrics_and_filters);
+    RUN_TEST(test_invalid_config_is_refused);
+    RUN_TEST(test_disk_rates_and_latency);
+    RUN_TEST(test_interface_rates_skip_excluded);
+    return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#define _GNU_SOURCE
+#include "../include/editor.h"
+#include "unity.h"
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+
+static int terminal = -1;
+static int keyboard = -1;
+// What the editor wrote to the terminal during the last edit
+static char screen[8192];
+static size_t screen_length;
+
+static const char* entries[] = {"ls -l", "pwd"};
+
+static int history_count(void)
+{
+    return 2;
+}
+
+static int history_get(int number, char* buffer, size_t size)
+{
+    return snprintf(buffer, size, "%s", entries[number - 1]);
+}
+
+/**
+ * @brief Types keys on the terminal and runs the editor on it.
+ *
+ * The terminal starts in raw mode, so the keys reach the editor as they were
+ * typed even though they are queued before it switches the modes itself.
+ */
+static int edit(const char* keys, char* line, size_t size)
+{
+    TEST_ASSERT_EQUAL_INT((int)strlen(keys), (int)write(keyboard, keys, strlen(keys)));
+    fflush(stdout);
+    int original_stdin = dup(STDIN_FILENO);
+    int original_stdout = dup(STDOUT_FILENO);
+    dup2(terminal, STDIN_FILENO);
+    dup2(terminal, STDOUT_FILENO);
+    int length = editor_read_line("$ ", line, size);
+    dup2(original_stdin, STDIN_FILENO);
+    dup2(original_stdout, STDOUT_FILENO);
+    close(original_stdin);
+    close(original_stdout);
+
+    ssize_t count = read(keyboard, screen, sizeof(screen) - 1);
+    screen_length = count > 0 ? (size_t)count : 0;
+    screen[screen_length] = '\0';
+    return length;
+}
+
+void setUp(void)
+{
+    keyboard = posix_openpt(O_RDWR | O_NOCTTY);
+    TEST_ASSERT_NOT_EQUAL(-1, keyboard);
+    TEST_ASSERT_EQUAL_INT(0, grantpt(keyboard));
+    TEST_ASSERT_EQUAL_INT(0, unlockpt(keyboard));
+    terminal = open(ptsname(keyboard), O_RDWR | O_NOCTTY);
+    TEST_ASSERT_NOT_EQUAL(-1, terminal);
+
+    struct termios modes;
+    tcgetattr(terminal, &modes);
+    cfmakeraw(&modes);
+    tcsetattr(terminal, TCSANOW, &modes);
+    struct winsize window = {.ws_row = 24, .ws_col = 80};
+    ioctl(terminal, TIOCSWINSZ, &window);
+    fcntl(keyboard, F_SETFL, O_NONBLOCK);
+
+    EditorHooks hooks = {NULL, NULL, NULL, NULL, NULL};
+    editor_set_hooks(&hooks);
+}
+
+void tearDown(void)
+{
+    close(terminal);
+    close(keyboard);
+}
+
+void test_typed_line_is_returned(void)
+{
+    char line[64];
+    TEST_ASSERT_EQUAL_INT(7, edit("echo hi\r", line, sizeof(line)));
+    TEST_ASSERT_EQUAL_STRING("echo hi", line);
+}
+
+void test_edits_move_the_gap(void)
+{
+    char line[64];
+    // Left, then an insertion before the last character
+    edit("ac\033[Db\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("abc", line);
+    // Ctrl-A, Delete, End, Backspace
+    edit("xabcy\001\033[3~\033[F\177\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("abc", line);
+    // Ctrl-W drops the previous word, Ctrl-A and Ctrl-K the whole line
+    edit("hello world\027there\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("hello there", line);
+    edit("abc\001\013xyz\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("xyz", line);
+    // Ctrl-U drops what is before the cursor
+    edit("abcdef\033[D\033[D\025\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("ef", line);
+}
+
+void test_long_lines_grow_the_buffer_and_are_cut(void)
+{
+    char keys[400];
+    char line[1024];
+    // Past the first capacity of the buffer, then the gap goes back to the start of the line
+    size_t length = 0;
+    for (int i = 0; i < 300; i++)
+    {
+        keys[length++] = (char)('a' + i % 26);
+    }
+    memcpy(keys + length, "\001X\r", 4);
+    TEST_ASSERT_EQUAL_INT(301, edit(keys, line, sizeof(line)));
+    TEST_ASSERT_EQUAL_CHAR('X', line[0]);
+    TEST_ASSERT_EQUAL_CHAR('a', line[1]);
+    TEST_ASSERT_EQUAL_CHAR('n', line[300]);
+
+    char small[4];
+    TEST_ASSERT_EQUAL_INT(3, edit("abcdef\r", small, sizeof(small)));
+    TEST_ASSERT_EQUAL_STRING("abc", small);
+}
+
+void test_history_is_browsed(void)
+{
+    EditorHooks hooks = {history_count, history_get, NULL, NULL, NULL};
+    editor_set_hooks(&hooks);
+    char line[64];
+    edit("\033[A\033[A\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("ls -l", line);
+    edit("\033[A\033[A\033[A\033[B\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("pwd", line);
+    // Going past the newest entry brings back the line being typed
+    edit("cd /\033[A\033[B\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("cd /", line);
+}
+
+void test_only_changes_are_redrawn(void)
+{
+    char line[64];
+    // Each key appends, Left is one backspace, the insertion rewrites the tail and comes back
+    edit("abc\033[DX\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("abXc", line);
+    TEST_ASSERT_EQUAL_STRING("$ abc\bXc\b\033[1C\r\n", screen);
+
+    // A shorter line erases what is left after it
+    edit("ab\177\r", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("$ ab\b\033[J\r\n", screen);
+}
+
+void test_end_of_input_on_empty_line(void)
+{
+    char line[64];
+    TEST_ASSERT_EQUAL_INT(-1, edit("\004", line, sizeof(line)));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_typed_line_is_returned);
+    RUN_TEST(test_edits_move_the_gap);
+    RUN_TEST(test_long_lines_grow_the_buffer_and_are_cut);
+    RUN_TEST(test_history_is_browsed);
+    RUN_TEST(test_only_changes_are_redrawn);
+    RUN_TEST(test_end_of_input_on_empty_line);
+    return UNITY_END();
+}
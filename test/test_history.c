@@ -0,0 +1,108 @@
+#include "../include/history.h"
+#include "unity.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char history_path[] = "/tmp/test_history_XXXXXX";
+
+void setUp(void)
+{
+    // Every test starts with an empty history file
+    int fd = mkstemp(history_path);
+    close(fd);
+    setenv("SURVSHELL_HISTFILE", history_path, 1);
+    history_init();
+}
+
+void tearDown(void)
+{
+    history_close();
+    unlink(history_path);
+    strcpy(history_path, "/tmp/test_history_XXXXXX");
+}
+
+void test_history_add_and_get(void)
+{
+    char command[HISTORY_MAX_LINE];
+
+    history_add("ls -l\n");
+    history_add("   ");
+    history_add("echo hello");
+
+    TEST_ASSERT_EQUAL_INT(2, history_count());
+    TEST_ASSERT_EQUAL_INT(5, history_get(1, command, sizeof(command)));
+    TEST_ASSERT_EQUAL_STRING("ls -l", command);
+    TEST_ASSERT_EQUAL_STRING("echo hello", (history_get(2, command, sizeof(command)), command));
+    TEST_ASSERT_EQUAL_INT(-1, history_get(3, command, sizeof(command)));
+}
+
+void test_history_search_finds_most_recent(void)
+{
+    history_add("make test");
+    history_add("git status");
+    history_add("make install");
+    history_add("ls");
+
+    TEST_ASSERT_EQUAL_INT(3, history_search("make", 0));
+    TEST_ASSERT_EQUAL_INT(1, history_search("make", 3));
+    TEST_ASSERT_EQUAL_INT(0, history_search("make", 1));
+    TEST_ASSERT_EQUAL_INT(2, history_search("st", 3));
+    TEST_ASSERT_EQUAL_INT(0, history_search("cargo", 0));
+}
+
+void test_history_sees_records_of_other_shells(void)
+{
+    history_add("first");
+
+    // Another shell appends a complete record and starts a second one
+    int fd = open(history_path, O_WRONLY | O_APPEND);
+    TEST_ASSERT_TRUE(write(fd, "second\nthi", 10) == 10);
+
+    TEST_ASSERT_EQUAL_INT(2, history_count());
+    TEST_ASSERT_EQUAL_INT(0, history_search("thi", 0));
+
+    TEST_ASSERT_TRUE(write(fd, "rd\n", 3) == 3);
+    close(fd);
+    TEST_ASSERT_EQUAL_INT(3, history_search("thi", 0));
+}
+
+void test_history_expand(void)
+{
+    char line[HISTORY_MAX_LINE];
+    history_add("echo one");
+    history_add("ls /tmp");
+
+    strcpy(line, "!!");
+    TEST_ASSERT_EQUAL_INT(1, history_expand(line, sizeof(line)));
+    TEST_ASSERT_EQUAL_STRING("ls /tmp", line);
+
+    strcpy(line, "!1 two");
+    TEST_ASSERT_EQUAL_INT(1, history_expand(line, sizeof(line)));
+    TEST_ASSERT_EQUAL_STRING("echo one two", line);
+
+    strcpy(line, "!-2");
+    TEST_ASSERT_EQUAL_INT(1, history_expand(line, sizeof(line)));
+    TEST_ASSERT_EQUAL_STRING("echo one", line);
+
+    strcpy(line, "!ec");
+    TEST_ASSERT_EQUAL_INT(1, history_expand(line, sizeof(line)));
+    TEST_ASSERT_EQUAL_STRING("echo one", line);
+
+    strcpy(line, "!9");
+    TEST_ASSERT_EQUAL_INT(-1, history_expand(line, sizeof(line)));
+
+    strcpy(line, "ls");
+    TEST_ASSERT_EQUAL_INT(0, history_expand(line, sizeof(line)));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_history_add_and_get);
+    RUN_TEST(test_history_search_finds_most_recent);
+    RUN_TEST(test_history_sees_records_of_other_shells);
+    RUN_TEST(test_history_expand);
+    return UNITY_END();
+}
@@ -0,0 +1,95 @@
+#include "../include/hash.h"
+#include "../include/incremental.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char directory[64];
+static char input[96];
+static char output[96];
+static char state_file[96];
+static char annotation[256];
+
+static void write_file(const char* path, const char* content)
+{
+    FILE* file = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    fputs(content, file);
+    fclose(file);
+}
+
+void setUp(void)
+{
+    snprintf(directory, sizeof(directory), "/tmp/test_incremental_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(directory));
+    snprintf(input, sizeof(input), "%s/input", directory);
+    snprintf(output, sizeof(output), "%s/output", directory);
+    snprintf(state_file, sizeof(state_file), "%s/state", directory);
+    snprintf(annotation, sizeof(annotation), " in=%s out=%s\n", input, output);
+    write_file(input, "first");
+    write_file(output, "built");
+    TEST_ASSERT_EQUAL_INT(0, incremental_open(state_file));
+}
+
+void tearDown(void)
+{
+    incremental_close();
+    unlink(input);
+    unlink(output);
+    unlink(state_file);
+    rmdir(directory);
+}
+
+void test_hash64_matches_reference_values(void)
+{
+    TEST_ASSERT_TRUE(hash64("", 0, 0) == 0xEF46DB3751D8E999ULL);
+    TEST_ASSERT_TRUE(hash64("a", 1, 0) == 0xD24EC4F1A98C6E5BULL);
+    TEST_ASSERT_TRUE(hash64("abc", 3, 0) == 0x44BC2CF5AD770999ULL);
+
+    const char* text = "Nobody inspects the spammish repetition";
+    TEST_ASSERT_TRUE(hash64(text, strlen(text), 0) == 0xFBCEA83C8A378BF1ULL);
+}
+
+void test_unchanged_files_skip_the_command(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, incremental_is_current(annotation, "cp in out\n"));
+    TEST_ASSERT_EQUAL_INT(0, incremental_record(annotation, "cp in out\n", 0));
+    TEST_ASSERT_EQUAL_INT(1, incremental_is_current(annotation, "cp in out\n"));
+    TEST_ASSERT_EQUAL_INT(0, incremental_is_current(annotation, "cp -v in out\n"));
+
+    // The state is kept across runs
+    incremental_close();
+    TEST_ASSERT_EQUAL_INT(0, incremental_open(state_file));
+    TEST_ASSERT_EQUAL_INT(1, incremental_is_current(annotation, "cp in out"));
+}
+
+void test_changed_or_missing_files_run_the_command(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, incremental_record(annotation, "cp in out", 0));
+    write_file(input, "second");
+    TEST_ASSERT_EQUAL_INT(0, incremental_is_current(annotation, "cp in out"));
+
+    TEST_ASSERT_EQUAL_INT(0, incremental_record(annotation, "cp in out", 0));
+    TEST_ASSERT_EQUAL_INT(1, incremental_is_current(annotation, "cp in out"));
+    unlink(output);
+    TEST_ASSERT_EQUAL_INT(0, incremental_is_current(annotation, "cp in out"));
+}
+
+void test_failed_command_is_forgotten(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, incremental_record(annotation, "cp in out", 0));
+    TEST_ASSERT_EQUAL_INT(0, incremental_record(annotation, "cp in out", 1));
+    TEST_ASSERT_EQUAL_INT(0, incremental_is_current(annotation, "cp in out"));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hash64_matches_reference_values);
+    RUN_TEST(test_unchanged_files_skip_the_command);
+    RUN_TEST(test_changed_or_missing_files_run_the_command);
+    RUN_TEST(test_failed_command_is_forgotten);
+    return UNITY_END();
+}
@@ -0,0 +1,76 @@
+#include "../include/jobs.h"
+#include "unity.h"
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_parse_signal(void)
+{
+    TEST_ASSERT_EQUAL_INT(SIGKILL, job_parse_signal("9"));
+    TEST_ASSERT_EQUAL_INT(SIGTERM, job_parse_signal("TERM"));
+    TEST_ASSERT_EQUAL_INT(SIGHUP, job_parse_signal("SIGHUP"));
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_signal("0"));
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_signal("BOGUS"));
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_signal("9x"));
+}
+
+void test_parse_pid(void)
+{
+    pid_t pid = 0;
+    TEST_ASSERT_EQUAL_INT(0, job_parse_pid("1234", &pid));
+    TEST_ASSERT_EQUAL_INT(1234, pid);
+    TEST_ASSERT_EQUAL_INT(0, job_parse_pid("-1234", &pid));
+    TEST_ASSERT_EQUAL_INT(-1234, pid);
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_pid("foo", &pid));
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_pid("12ab", &pid));
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_pid("", &pid));
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_pid("0", &pid));
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_pid("-1", &pid));
+    TEST_ASSERT_EQUAL_INT(-1, job_parse_pid("99999999999", &pid));
+}
+
+void test_kill_refuses_invalid_targets(void)
+{
+    // kill(0, SIGTERM) would end this test with the whole process group
+    char words[] = "foo";
+    command_kill(words);
+    char signal_words[] = "-TERM 0 -1 12ab";
+    command_kill(signal_words);
+    TEST_PASS();
+}
+
+void test_kill_signals_a_pid(void)
+{
+    pid_t child = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, child);
+    if (child == 0)
+    {
+        pause();
+        _exit(0);
+    }
+    char words[32];
+    snprintf(words, sizeof(words), "-s KILL %d", (int)child);
+    command_kill(words);
+    int status;
+    TEST_ASSERT_EQUAL_INT(child, waitpid(child, &status, 0));
+    TEST_ASSERT_TRUE(WIFSIGNALED(status));
+    TEST_ASSERT_EQUAL_INT(SIGKILL, WTERMSIG(status));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_signal);
+    RUN_TEST(test_parse_pid);
+    RUN_TEST(test_kill_refuses_invalid_targets);
+    RUN_TEST(test_kill_signals_a_pid);
+    return UNITY_END();
+}
@@ -0,0 +1,147 @@
+#include "../include/jsonw.h"
+#include "../include/sampler.h"
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static JsonWriter writer;
+
+/**
+ * @brief Returns the document written so far as a string.
+ */
+static const char* document(void)
+{
+    static char text[1024];
+    TEST_ASSERT_FALSE(writer.failed);
+    TEST_ASSERT_TRUE(writer.length < sizeof(text));
+    memcpy(text, writer.buffer, writer.length);
+    text[writer.length] = '\0';
+    return text;
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, jsonw_init(&writer, 16));
+}
+
+void tearDown(void)
+{
+    jsonw_free(&writer);
+}
+
+void test_writer_separates_nested_values(void)
+{
+    jsonw_begin_object(&writer);
+    jsonw_key(&writer, "name");
+    jsonw_string(&writer, "a \"quoted\"\tline\n\x01");
+    jsonw_key(&writer, "list");
+    jsonw_begin_array(&writer);
+    jsonw_int(&writer, -12);
+    jsonw_begin_object(&writer);
+    jsonw_end_object(&writer);
+    jsonw_bool(&writer, 1);
+    jsonw_null(&writer);
+    jsonw_end_array(&writer);
+    jsonw_key(&writer, "min");
+    jsonw_int(&writer, INT64_MIN);
+    jsonw_end_object(&writer);
+    jsonw_newline(&writer);
+
+    TEST_ASSERT_EQUAL_STRING("{\"name\":\"a \\\"quoted\\\"\\tline\\n\\u0001\",\"list\":[-12,{},true,null],"
+                             "\"min\":-9223372036854775808}\n",
+                             document());
+}
+
+void test_reset_reuses_the_buffer(void)
+{
+    jsonw_begin_array(&writer);
+    for (int i = 0; i < 100; i++)
+    {
+        jsonw_int(&writer, i);
+    }
+    jsonw_end_array(&writer);
+    char* buffer = writer.buffer;
+
+    jsonw_reset(&writer);
+    jsonw_begin_array(&writer);
+    jsonw_int(&writer, 7);
+    jsonw_end_array(&writer);
+    TEST_ASSERT_EQUAL_PTR(buffer, writer.buffer);
+    TEST_ASSERT_EQUAL_STRING("[7]", document());
+}
+
+void test_doubles_match_printf(void)
+{
+    const double values[] = {0, 0.5, 1, -1, 3.14159, -0.001, 99.999, 12345.678, 0.07, 1e12, 123.4567};
+    for (int decimals = 0; decimals <= 4; decimals++)
+    {
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+        {
+            char expected[64];
+            snprintf(expected, sizeof(expected), "%.*f", decimals, values[i]);
+            if (expected[0] == '-' && strspn(expected + 1, "0.") == strlen(expected + 1))
+            {
+                // printf keeps the sign of a value rounded to zero, JSON readers do not need it
+                memmove(expected, expected + 1, strlen(expected));
+            }
+            jsonw_reset(&writer);
+            jsonw_double(&writer, values[i], decimals);
+            TEST_ASSERT_EQUAL_STRING(expected, document());
+        }
+    }
+
+    jsonw_reset(&writer);
+    jsonw_begin_array(&writer);
+    jsonw_double(&writer, NAN, 2);
+    jsonw_double(&writer, 1e300, 2);
+    jsonw_end_array(&writer);
+    TEST_ASSERT_EQUAL_STRING("[null,1.0000000000000001e+300]", document());
+}
+
+void test_sampler_appends_json_lines(void)
+{
+    char path[] = "/tmp/test_jsonw_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd != -1);
+    close(fd);
+
+    SamplerOptions options;
+    sampler_options_init(&options);
+    options.jsonl_path = path;
+    options.interval_ms = 10;
+    TEST_ASSERT_EQUAL_INT(0, sampler_start(&options));
+    usleep(100000);
+    sampler_stop();
+    TEST_ASSERT_FALSE(sampler_running());
+
+    MetricSample sample;
+    TEST_ASSERT_EQUAL_INT(1, sampler_latest(&sample));
+
+    FILE* file = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(file);
+    char line[512];
+    int lines = 0;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        TEST_ASSERT_EQUAL_INT(0, strncmp(line, "{\"timestamp_ms\":", 16));
+        TEST_ASSERT_EQUAL_STRING("}\n", line + strlen(line) - 2);
+        TEST_ASSERT_NOT_NULL(strstr(line, "\"cpu\":"));
+        lines++;
+    }
+    fclose(file);
+    unlink(path);
+    TEST_ASSERT_TRUE(lines >= 2);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_writer_separates_nested_values);
+    RUN_TEST(test_reset_reuses_the_buffer);
+    RUN_TEST(test_doubles_match_printf);
+    RUN_TEST(test_sampler_appends_json_lines);
+    return UNITY_END();
+}
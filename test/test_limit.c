@@ -0,0 +1,92 @@
+#include "../include/commands.h"
+#include "../include/limit.h"
+#include "unity.h"
+
+static JobLimits limits;
+
+/**
+ * @brief Parses options into cleared limits.
+ */
+static int parse(const char* text)
+{
+    static char options[256];
+    snprintf(options, sizeof(options), "%s", text);
+    memset(&limits, 0, sizeof(limits));
+    limits.cgroup_fd = -1;
+    return limits_parse(options, &limits);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_options_are_split_from_the_command_line(void)
+{
+    char arg[] = "nofile=64 cpu=50% echo hi";
+    char* options;
+    TEST_ASSERT_EQUAL_STRING("echo hi", split_prefix_options(arg, &options));
+    TEST_ASSERT_EQUAL_STRING("nofile=64 cpu=50%", options);
+
+    // Without -- the first word of the command, which has a '=', would be taken for an option
+    char separated[] = "mem=1G -- A=1 env";
+    TEST_ASSERT_EQUAL_STRING("A=1 env", split_prefix_options(separated, &options));
+    TEST_ASSERT_EQUAL_INT(0, strncmp(options, "mem=1G", 6));
+
+    char plain[] = "ls -l";
+    TEST_ASSERT_EQUAL_STRING("ls -l", split_prefix_options(plain, &options));
+    TEST_ASSERT_EQUAL_STRING("", options);
+
+    char without_command[] = "mem=1G --";
+    TEST_ASSERT_NULL(split_prefix_options(without_command, &options));
+}
+
+void test_rlimits_are_parsed(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, parse("cputime=10 as=1G nofile=64 nofile=128 stack=max"));
+    TEST_ASSERT_EQUAL_INT(4, limits.rlimit_count);
+    TEST_ASSERT_EQUAL_INT(RLIMIT_CPU, limits.resources[0]);
+    TEST_ASSERT_EQUAL_UINT64(10, limits.values[0].rlim_cur);
+    TEST_ASSERT_EQUAL_UINT64(1ULL << 30, limits.values[1].rlim_max);
+    // The later nofile replaced the first one
+    TEST_ASSERT_EQUAL_INT(RLIMIT_NOFILE, limits.resources[2]);
+    TEST_ASSERT_EQUAL_UINT64(128, limits.values[2].rlim_cur);
+    TEST_ASSERT_TRUE(limits.values[3].rlim_cur == RLIM_INFINITY);
+}
+
+void test_cgroup_settings_are_formatted(void)
+{
+    TEST_ASSERT_EQUAL_INT(1, parse("cpu=50% mem=512M io=8:0,rbps=1M,wiops=100"));
+    TEST_ASSERT_EQUAL_STRING("50000 100000", limits.cpu_max);
+    TEST_ASSERT_EQUAL_STRING("536870912", limits.memory_max);
+    TEST_ASSERT_EQUAL_STRING("8:0 rbps=1048576 wiops=100", limits.io_max);
+    TEST_ASSERT_EQUAL_INT(0, limits.rlimit_count);
+
+    TEST_ASSERT_EQUAL_INT(1, parse("cpu=max mem=unlimited"));
+    TEST_ASSERT_EQUAL_STRING("max 100000", limits.cpu_max);
+    TEST_ASSERT_EQUAL_STRING("max", limits.memory_max);
+}
+
+void test_invalid_options_are_refused(void)
+{
+    TEST_ASSERT_EQUAL_INT(-1, parse("cpu=0"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("mem=12X"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("nofile=-1"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("nofile=64k"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("io=8:0"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("io=8:0,speed=1"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("bogus=1"));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_options_are_split_from_the_command_line);
+    RUN_TEST(test_rlimits_are_parsed);
+    RUN_TEST(test_cgroup_settings_are_formatted);
+    RUN_TEST(test_invalid_options_are_refused);
+    return UNITY_END();
+}
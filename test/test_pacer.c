@@ -0,0 +1,104 @@
+#include "../include/pacer.h"
+#include "unity.h"
+
+static MetricSample sample_of(double cpu, double memory, int processes)
+{
+    MetricSample sample = {0, cpu, memory, -1, 20000, processes, 5000, {1, 0, -1}};
+    return sample;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_steady_system_backs_off_to_the_slowest(void)
+{
+    Pacer pacer;
+    pacer_init(&pacer, PACER_FASTEST_MS, PACER_SLOWEST_MS);
+    TEST_ASSERT_EQUAL_INT(PACER_FASTEST_MS, pacer.interval_ms);
+    MetricSample sample = sample_of(12, 40, 300);
+    int previous = 0;
+    int samples = 0;
+    int interval = pacer_update(&pacer, &sample, NULL, 0);
+    while (interval != previous)
+    {
+        TEST_ASSERT_TRUE(interval > previous);
+        previous = interval;
+        interval = pacer_update(&pacer, &sample, NULL, 0);
+        samples++;
+    }
+    TEST_ASSERT_EQUAL_INT(PACER_SLOWEST_MS, interval);
+    TEST_ASSERT_INT_WITHIN(3, 15, samples);
+}
+
+void test_changes_speed_sampling_up(void)
+{
+    Pacer pacer;
+    pacer_init(&pacer, 100, 30000);
+    MetricSample sample = sample_of(12, 40, 300);
+    for (int index = 0; index < 20; index++)
+    {
+        pacer_update(&pacer, &sample, NULL, 0);
+    }
+    // A drift of a few points halves the interval, a jump drops it to the shortest
+    sample.cpu_usage = 15;
+    TEST_ASSERT_EQUAL_INT(PACE_BUSY, pacer_level(&pacer, &sample, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(15000, pacer_update(&pacer, &sample, NULL, 0));
+    sample.process_count = 360;
+    TEST_ASSERT_EQUAL_INT(100, pacer_update(&pacer, &sample, NULL, 0));
+    // Metrics that could not be read are ignored
+    MetricSample unread = sample;
+    unread.memory_usage = -1;
+    TEST_ASSERT_EQUAL_INT(PACE_CALM, pacer_level(&pacer, &unread, NULL, 0));
+}
+
+void test_alert_thresholds_are_hot(void)
+{
+    MonitorConfig config;
+    memset(&config, 0, sizeof(config));
+    TEST_ASSERT_EQUAL_INT(0, config_compile_rule("cpu > 90% clear 60%", &config.rules[0]));
+    config.rule_count = 1;
+    Pacer pacer;
+    pacer_init(&pacer, 100, 30000);
+
+    MetricSample sample = sample_of(70, 40, 300);
+    TEST_ASSERT_EQUAL_INT(PACE_CALM, pacer_level(&pacer, &sample, &config, 0));
+    sample.cpu_usage = 85;
+    TEST_ASSERT_EQUAL_INT(PACE_HOT, pacer_level(&pacer, &sample, &config, 0));
+    // While the rule fires, the clear value is the boundary to watch
+    TEST_ASSERT_EQUAL_INT(PACE_CALM, pacer_level(&pacer, &sample, &config, 1));
+    sample.cpu_usage = 62;
+    TEST_ASSERT_EQUAL_INT(PACE_HOT, pacer_level(&pacer, &sample, &config, 1));
+}
+
+void test_wake_and_bounds(void)
+{
+    Pacer pacer;
+    pacer_init(&pacer, 1, 5);
+    TEST_ASSERT_EQUAL_INT(SAMPLER_MIN_INTERVAL_MS, pacer.fastest_ms);
+    TEST_ASSERT_EQUAL_INT(SAMPLER_MIN_INTERVAL_MS, pacer.slowest_ms);
+
+    pacer_init(&pacer, 100, 30000);
+    MetricSample sample = sample_of(12, 40, 300);
+    for (int index = 0; index < 20; index++)
+    {
+        pacer_update(&pacer, &sample, NULL, 0);
+    }
+    pacer_wake(&pacer);
+    TEST_ASSERT_EQUAL_INT(100, pacer.interval_ms);
+    TEST_ASSERT_EQUAL_INT(150, pacer_update(&pacer, &sample, NULL, 0));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_system_backs_off_to_the_slowest);
+    RUN_TEST(test_changes_speed_sampling_up);
+    RUN_TEST(test_alert_thresholds_are_hot);
+    RUN_TEST(test_wake_and_bounds);
+    return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include "../include/parallel.h"
+#include "unity.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+static const char* directory = "/tmp/test_parallel";
+
+// Each job prints how many other jobs were running when it started
+static const char* job_script = "n=$(ls /tmp/test_parallel/running | wc -l)\n"
+                                "touch /tmp/test_parallel/running/$1\n"
+                                "sleep 0.05\n"
+                                "rm /tmp/test_parallel/running/$1\n"
+                                "echo $n\n";
+
+static char output[4096];
+
+/**
+ * @brief Runs a parallel command line with its standard output and error in files.
+ */
+static void run(const char* command_line, char* errors, size_t size)
+{
+    char line[512];
+    snprintf(line, sizeof(line), "%s", command_line);
+    int output_fd = open("/tmp/test_parallel/output", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int errors_fd = open("/tmp/test_parallel/errors", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    TEST_ASSERT_NOT_EQUAL(-1, output_fd);
+    TEST_ASSERT_NOT_EQUAL(-1, errors_fd);
+    fflush(stdout);
+    fflush(stderr);
+    int original_stdout = dup(STDOUT_FILENO);
+    int original_stderr = dup(STDERR_FILENO);
+    dup2(output_fd, STDOUT_FILENO);
+    dup2(errors_fd, STDERR_FILENO);
+
+    command_parallel(line);
+
+    fflush(stdout);
+    fflush(stderr);
+    dup2(original_stdout, STDOUT_FILENO);
+    dup2(original_stderr, STDERR_FILENO);
+    close(original_stdout);
+    close(original_stderr);
+
+    ssize_t length = pread(output_fd, output, sizeof(output) - 1, 0);
+    output[length > 0 ? length : 0] = '\0';
+    length = pread(errors_fd, errors, size - 1, 0);
+    errors[length > 0 ? length : 0] = '\0';
+    close(output_fd);
+    close(errors_fd);
+}
+
+/**
+ * @brief Returns the number of jobs that printed and the most jobs any of them saw running.
+ */
+static int jobs_printed(int* most_running)
+{
+    int jobs = 0;
+    *most_running = 0;
+    char* saveptr = NULL;
+    for (char* line = strtok_r(output, "\n", &saveptr); line != NULL; line = strtok_r(NULL, "\n", &saveptr))
+    {
+        int running = atoi(line);
+        *most_running = running > *most_running ? running : *most_running;
+        jobs++;
+    }
+    return jobs;
+}
+
+void setUp(void)
+{
+    mkdir(directory, 0755);
+    mkdir("/tmp/test_parallel/running", 0755);
+    FILE* script = fopen("/tmp/test_parallel/job.sh", "w");
+    TEST_ASSERT_NOT_NULL(script);
+    fputs(job_script, script);
+    fclose(script);
+}
+
+void tearDown(void)
+{
+    unlink("/tmp/test_parallel/job.sh");
+    unlink("/tmp/test_parallel/output");
+    unlink("/tmp/test_parallel/errors");
+    rmdir("/tmp/test_parallel/running");
+    rmdir(directory);
+}
+
+void test_pool_never_runs_more_than_its_slots(void)
+{
+    char errors[256];
+    int most_running;
+    run("-j 2 sh /tmp/test_parallel/job.sh {} ::: a b c d e f", errors, sizeof(errors));
+    // Every job ran, so the slots of the finished ones were given back
+    TEST_ASSERT_EQUAL_INT(6, jobs_printed(&most_running));
+    TEST_ASSERT_TRUE(most_running <= 1);
+    TEST_ASSERT_EQUAL_STRING("", errors);
+
+    run("-j1 sh /tmp/test_parallel/job.sh ::: a b c", errors, sizeof(errors));
+    TEST_ASSERT_EQUAL_INT(3, jobs_printed(&most_running));
+    TEST_ASSERT_EQUAL_INT(0, most_running);
+}
+
+void test_failed_jobs_are_counted(void)
+{
+    char errors[256];
+    run("-j 2 sh -c {} ::: true false false", errors, sizeof(errors));
+    TEST_ASSERT_NOT_NULL(strstr(errors, "2 of 3 jobs failed"));
+}
+
+void test_invalid_job_count_is_refused(void)
+{
+    char errors[256];
+    run("-j two echo ::: a", errors, sizeof(errors));
+    TEST_ASSERT_NOT_NULL(strstr(errors, "invalid number of jobs"));
+    TEST_ASSERT_EQUAL_STRING("", output);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pool_never_runs_more_than_its_slots);
+    RUN_TEST(test_failed_jobs_are_counted);
+    RUN_TEST(test_invalid_job_count_is_refused);
+    return UNITY_END();
+}
@@ -0,0 +1,115 @@
+#define _GNU_SOURCE
+#include "../include/placement.h"
+#include "unity.h"
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/wait.h>
+
+static CpuPlacement placement;
+
+/**
+ * @brief Parses a specification into a placement without CPUs or memory policy.
+ */
+static int parse(const char* text)
+{
+    static char spec[256];
+    snprintf(spec, sizeof(spec), "%s", text);
+    memset(&placement, 0, sizeof(placement));
+    placement.memory_mode = -1;
+    return placement_parse(spec, &placement);
+}
+
+static int has_cpu(int cpu)
+{
+    for (int i = 0; i < placement.cpu_count; i++)
+    {
+        if (placement.cpus[i] == cpu)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_cpu_lists_are_parsed(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, parse("cpus=0"));
+    TEST_ASSERT_EQUAL_INT(1, placement.cpu_count);
+    TEST_ASSERT_EQUAL_INT(0, placement.cpus[0]);
+    TEST_ASSERT_EQUAL_INT(-1, placement.memory_mode);
+    TEST_ASSERT_EQUAL_INT(0, placement.per_stage);
+
+    // A CPU listed twice is kept once
+    TEST_ASSERT_EQUAL_INT(0, parse("cpus=0-3,2,8 layout=siblings"));
+    TEST_ASSERT_EQUAL_INT(5, placement.cpu_count);
+    TEST_ASSERT_TRUE(has_cpu(0) && has_cpu(3) && has_cpu(8));
+    TEST_ASSERT_FALSE(has_cpu(4));
+    TEST_ASSERT_EQUAL_INT(1, placement.per_stage);
+}
+
+void test_nodes_give_their_cpus_and_memory_policy(void)
+{
+    if (access("/sys/devices/system/node/node0/cpulist", R_OK) != 0)
+    {
+        TEST_IGNORE_MESSAGE("no NUMA node in sysfs");
+    }
+    TEST_ASSERT_EQUAL_INT(0, parse("node=0"));
+    TEST_ASSERT_EQUAL_INT(MPOL_BIND, placement.memory_mode);
+    TEST_ASSERT_EQUAL_UINT64(1, placement.nodes[0]);
+    TEST_ASSERT_TRUE(placement.cpu_count > 0);
+
+    TEST_ASSERT_EQUAL_INT(0, parse("node=0 mem=interleave cpus=0"));
+    TEST_ASSERT_EQUAL_INT(MPOL_INTERLEAVE, placement.memory_mode);
+    TEST_ASSERT_EQUAL_INT(1, placement.cpu_count);
+}
+
+void test_invalid_specifications_are_refused(void)
+{
+    TEST_ASSERT_EQUAL_INT(-1, parse("cpus="));
+    TEST_ASSERT_EQUAL_INT(-1, parse("cpus=3-1"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("cpus=1024"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("cpus=a"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("cpus=1;2"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("cpus"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("mem=bind"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("node=0 mem=spread"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("layout=grid"));
+    TEST_ASSERT_EQUAL_INT(-1, parse("speed=1"));
+}
+
+void test_child_runs_on_the_cpu_of_its_stage(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, parse("cpus=0 layout=siblings"));
+    pid_t pid = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    if (pid == 0)
+    {
+        cpu_set_t set;
+        int applied = placement_apply_in_child(&placement, 3) == 0;
+        _exit(applied && sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set)
+                  ? 0
+                  : 1);
+    }
+    int status;
+    TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cpu_lists_are_parsed);
+    RUN_TEST(test_nodes_give_their_cpus_and_memory_policy);
+    RUN_TEST(test_invalid_specifications_are_refused);
+    RUN_TEST(test_child_runs_on_the_cpu_of_its_stage);
+    return UNITY_END();
+}
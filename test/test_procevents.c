@@ -0,0 +1,86 @@
+#include "../include/procevents.h"
+#include "unity.h"
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+    procevents_close();
+}
+
+/**
+ * Applies the events until none came for 200 ms.
+ */
+static void drain_until_quiet(int fd)
+{
+    struct pollfd events = {.fd = fd, .events = POLLIN};
+    while (poll(&events, 1, 200) > 0)
+    {
+        TEST_ASSERT_TRUE(procevents_drain() >= 0);
+    }
+}
+
+void test_closed_listener_is_inactive(void)
+{
+    ProcEventStats stats;
+    procevents_stats(&stats);
+    TEST_ASSERT_EQUAL_INT(0, stats.listening);
+    TEST_ASSERT_EQUAL_INT(0, procevents_active());
+    TEST_ASSERT_EQUAL_INT(-1, procevents_drain());
+}
+
+void test_children_are_counted_and_removed(void)
+{
+    int fd = procevents_open();
+    if (fd == -1)
+    {
+        ProcEventStats stats;
+        procevents_stats(&stats);
+        TEST_ASSERT_NOT_EQUAL(0, stats.error);
+        TEST_IGNORE_MESSAGE("The proc connector is not available");
+    }
+    TEST_ASSERT_EQUAL_INT(1, procevents_active());
+    drain_until_quiet(fd);
+    int before = procevents_count();
+    TEST_ASSERT_TRUE(before > 0);
+
+    int pipes[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(pipes));
+    pid_t children[5];
+    for (int i = 0; i < 5; i++)
+    {
+        children[i] = fork();
+        if (children[i] == 0)
+        {
+            char byte;
+            close(pipes[1]);
+            (void)!read(pipes[0], &byte, 1);
+            _exit(0);
+        }
+    }
+    drain_until_quiet(fd);
+    // Other processes of the system may start or end meanwhile
+    TEST_ASSERT_INT_WITHIN(3, before + 5, procevents_count());
+
+    close(pipes[0]);
+    close(pipes[1]);
+    for (int i = 0; i < 5; i++)
+    {
+        waitpid(children[i], NULL, 0);
+    }
+    drain_until_quiet(fd);
+    TEST_ASSERT_INT_WITHIN(3, before, procevents_count());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_closed_listener_is_inactive);
+    RUN_TEST(test_children_are_counted_and_removed);
+    return UNITY_END();
+}
@@ -0,0 +1,81 @@
+#include "../include/proctop.h"
+#include "unity.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static pid_t spinner = -1;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+    if (spinner > 0)
+    {
+        kill(spinner, SIGKILL);
+        waitpid(spinner, NULL, 0);
+        spinner = -1;
+    }
+    proctop_close();
+}
+
+void test_scan_finds_this_process(void)
+{
+    TEST_ASSERT_TRUE(proctop_scan() > 0);
+    ProcessUsage usage;
+    TEST_ASSERT_EQUAL_INT(1, proctop_lookup(getpid(), &usage));
+    TEST_ASSERT_TRUE(usage.rss_bytes > 0);
+    TEST_ASSERT_EQUAL_STRING("test_proctop", usage.command);
+    TEST_ASSERT_TRUE(proctop_open_descriptors() > 0);
+}
+
+void test_busy_process_ranks_first(void)
+{
+    spinner = fork();
+    if (spinner == 0)
+    {
+        while (1)
+        {
+        }
+    }
+    TEST_ASSERT_TRUE(proctop_scan() > 0);
+    struct timespec pause = {0, 300000000};
+    nanosleep(&pause, NULL);
+    TEST_ASSERT_TRUE(proctop_scan() > 0);
+
+    ProcessUsage top[3];
+    TEST_ASSERT_TRUE(proctop_top(top, 3, PROCTOP_BY_CPU) >= 1);
+    TEST_ASSERT_EQUAL_INT(spinner, top[0].pid);
+    TEST_ASSERT_TRUE(top[0].cpu_percent > 50);
+}
+
+void test_ended_process_is_dropped(void)
+{
+    pid_t child = fork();
+    if (child == 0)
+    {
+        pause();
+        _exit(0);
+    }
+    TEST_ASSERT_TRUE(proctop_scan() > 0);
+    ProcessUsage usage;
+    TEST_ASSERT_EQUAL_INT(1, proctop_lookup(child, &usage));
+
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    TEST_ASSERT_TRUE(proctop_scan() > 0);
+    TEST_ASSERT_EQUAL_INT(0, proctop_lookup(child, &usage));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_scan_finds_this_process);
+    RUN_TEST(test_busy_process_ranks_first);
+    RUN_TEST(test_ended_process_is_dropped);
+    return UNITY_END();
+}
@@ -0,0 +1,60 @@
+#include "../include/psi.h"
+#include "unity.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_parse_reads_some_and_full(void)
+{
+    PsiStats stats;
+    TEST_ASSERT_EQUAL_INT(0, psi_parse("some avg10=2.30 avg60=1.27 avg300=1.33 total=52743474\n"
+                                       "full avg10=0.50 avg60=0.25 avg300=0.10 total=1234\n",
+                                       &stats));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.30f, (float)stats.some.avg10);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.33f, (float)stats.some.avg300);
+    TEST_ASSERT_EQUAL_UINT64(52743474, stats.some.total_us);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.50f, (float)stats.full.avg10);
+    TEST_ASSERT_EQUAL_UINT64(1234, stats.full.total_us);
+
+    // cpu has no full line before Linux 5.13
+    TEST_ASSERT_EQUAL_INT(0, psi_parse("some avg10=1.00 avg60=0.00 avg300=0.00 total=10\n", &stats));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.0f, (float)stats.full.avg10);
+    TEST_ASSERT_EQUAL_INT(-1, psi_parse("", &stats));
+}
+
+void test_parse_trigger_options(void)
+{
+    PsiTrigger trigger;
+    TEST_ASSERT_EQUAL_INT(PSI_MEMORY, psi_parse_trigger("memory:150ms/2s", &trigger));
+    TEST_ASSERT_EQUAL_INT(0, trigger.full);
+    TEST_ASSERT_EQUAL_UINT32(150000, trigger.stall_us);
+    TEST_ASSERT_EQUAL_UINT32(2000000, trigger.window_us);
+    TEST_ASSERT_EQUAL_INT(PSI_IO, psi_parse_trigger("io:full:500ms/4s", &trigger));
+    TEST_ASSERT_EQUAL_INT(1, trigger.full);
+    TEST_ASSERT_EQUAL_INT(-1, psi_parse_trigger("disk:1s/2s", &trigger));
+    TEST_ASSERT_EQUAL_INT(-1, psi_parse_trigger("cpu:3s/2s", &trigger));
+    TEST_ASSERT_EQUAL_INT(-1, psi_parse_trigger("cpu:1s", &trigger));
+}
+
+void test_fired_trigger_warns_once(void)
+{
+    uint64_t before = psi_trigger_count(PSI_IO);
+    psi_trigger_fired(PSI_IO);
+    TEST_ASSERT_EQUAL_UINT64(before + 1, psi_trigger_count(PSI_IO));
+    TEST_ASSERT_EQUAL_INT(1, psi_warn_pending());
+    TEST_ASSERT_EQUAL_INT(0, psi_warn_pending());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_reads_some_and_full);
+    RUN_TEST(test_parse_trigger_options);
+    RUN_TEST(test_fired_trigger_warns_once);
+    return UNITY_END();
+}
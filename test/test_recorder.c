@@ -0,0 +1,155 @@
+#include "../include/recorder.h"
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SAMPLES 1000
+
+static char path[64];
+static MetricRecorder recorder;
+static MetricSample written[SAMPLES];
+static int read_count;
+
+static void check_sample(const MetricSample* sample, void* data)
+{
+    (void)data;
+    TEST_ASSERT_TRUE(read_count < SAMPLES);
+    const MetricSample* expected = &written[read_count++];
+    TEST_ASSERT_EQUAL_INT64(expected->timestamp_ms, sample->timestamp_ms);
+    TEST_ASSERT_EQUAL_MEMORY(&expected->cpu_usage, &sample->cpu_usage, sizeof(double));
+    TEST_ASSERT_EQUAL_MEMORY(&expected->memory_usage, &sample->memory_usage, sizeof(double));
+    TEST_ASSERT_EQUAL_MEMORY(&expected->disk_usage, &sample->disk_usage, sizeof(double));
+    TEST_ASSERT_EQUAL_MEMORY(&expected->network_rate, &sample->network_rate, sizeof(double));
+    TEST_ASSERT_EQUAL_INT(expected->process_count, sample->process_count);
+    TEST_ASSERT_EQUAL_INT(expected->context_switches, sample->context_switches);
+}
+
+static MetricSample last;
+
+static void count_sample(const MetricSample* sample, void* data)
+{
+    (void)data;
+    TEST_ASSERT_TRUE(read_count == 0 || sample->timestamp_ms > last.timestamp_ms);
+    last = *sample;
+    read_count++;
+}
+
+/**
+ * @brief Fills the samples with jittered timestamps, steady and noisy metrics and failed readings.
+ */
+static void make_samples(void)
+{
+    int64_t timestamp = 1700000000000;
+    srand(7);
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        timestamp += i % 100 == 99 ? 60000 : 100 + rand() % 5 - 2;
+        written[i].timestamp_ms = timestamp;
+        written[i].cpu_usage = (rand() % 10000) / 100.0;
+        written[i].memory_usage = 42.5;
+        written[i].disk_usage = i % 50 == 0 ? -1 : sin(i / 10.0) * 50 + 50;
+        written[i].network_rate = i * 1024.0;
+        written[i].process_count = 300 + i % 7;
+        written[i].context_switches = 1000000 + i * 37;
+    }
+}
+
+void setUp(void)
+{
+    snprintf(path, sizeof(path), "/tmp/test_recorder_%d.rec", (int)getpid());
+    read_count = 0;
+    make_samples();
+}
+
+void tearDown(void)
+{
+    char rotated[80];
+    for (int index = 1; index <= 8; index++)
+    {
+        snprintf(rotated, sizeof(rotated), "%s.%d", path, index);
+        unlink(rotated);
+    }
+    unlink(path);
+}
+
+void test_recorder_round_trips_samples(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, recorder_open(&recorder, path, 0, 0));
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(0, recorder_append(&recorder, &written[i]));
+    }
+    recorder_close(&recorder);
+
+    TEST_ASSERT_EQUAL_INT(SAMPLES, recorder_read(path, check_sample, NULL));
+    TEST_ASSERT_EQUAL_INT(SAMPLES, read_count);
+
+    // Far smaller than the 56 bytes of a raw sample
+    struct stat info;
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &info));
+    TEST_ASSERT_TRUE(info.st_size < SAMPLES * 56 / 2);
+}
+
+void test_recorder_appends_to_an_existing_record(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, recorder_open(&recorder, path, 0, 0));
+    for (int i = 0; i < SAMPLES / 2; i++)
+    {
+        recorder_append(&recorder, &written[i]);
+    }
+    recorder_close(&recorder);
+    TEST_ASSERT_EQUAL_INT(0, recorder_open(&recorder, path, 0, 0));
+    for (int i = SAMPLES / 2; i < SAMPLES; i++)
+    {
+        recorder_append(&recorder, &written[i]);
+    }
+    recorder_close(&recorder);
+
+    TEST_ASSERT_EQUAL_INT(SAMPLES, recorder_read(path, check_sample, NULL));
+}
+
+void test_recorder_rotates_files(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, recorder_open(&recorder, path, 4096, 2));
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        recorder_append(&recorder, &written[i]);
+    }
+    recorder_close(&recorder);
+
+    char rotated[80];
+    snprintf(rotated, sizeof(rotated), "%s.2", path);
+    TEST_ASSERT_EQUAL_INT(0, access(rotated, F_OK));
+    snprintf(rotated, sizeof(rotated), "%s.3", path);
+    TEST_ASSERT_EQUAL_INT(-1, access(rotated, F_OK));
+
+    // The files left hold the newest samples, in order, oldest first
+    long kept = 0;
+    for (int index = 2; index >= 0; index--)
+    {
+        if (index > 0)
+        {
+            snprintf(rotated, sizeof(rotated), "%s.%d", path, index);
+        }
+        // The current file may only hold its header right after a rotation
+        long count = recorder_read(index > 0 ? rotated : path, count_sample, NULL);
+        TEST_ASSERT_TRUE(count > 0 || (index == 0 && count == 0));
+        kept += count;
+    }
+    TEST_ASSERT_TRUE(kept < SAMPLES);
+    TEST_ASSERT_EQUAL_INT(kept, read_count);
+    TEST_ASSERT_EQUAL_INT64(written[SAMPLES - 1].timestamp_ms, last.timestamp_ms);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_recorder_round_trips_samples);
+    RUN_TEST(test_recorder_appends_to_an_existing_record);
+    RUN_TEST(test_recorder_rotates_files);
+    return UNITY_END();
+}
@@ -0,0 +1,73 @@
+#include "../include/selfstats.h"
+#include "unity.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// Kept so the compiler does not remove the allocations
+void* volatile kept;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+    selfstats_close();
+}
+
+void test_sources_are_charged_their_reads(void)
+{
+    int counted = selfstats_open() == 0;
+    selfstats_begin();
+    char buffer[4096];
+    int fd = open("/proc/self/status", O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    close(fd);
+    selfstats_mark(SELF_STAT);
+    kept = malloc(4096);
+    selfstats_mark(SELF_OUTPUTS);
+    free(kept);
+    selfstats_mark(SELF_PRESSURE);
+    selfstats_end();
+
+    SelfStats stats;
+    TEST_ASSERT_EQUAL_UINT64(1, selfstats_read(&stats));
+    TEST_ASSERT_TRUE(stats.last[SELF_STAT].time_ns > 0);
+    TEST_ASSERT_EQUAL_INT64(0, stats.last[SELF_STAT].heap_bytes);
+    TEST_ASSERT_TRUE(stats.last[SELF_OUTPUTS].heap_bytes >= 4096);
+    TEST_ASSERT_TRUE(stats.last[SELF_PRESSURE].heap_bytes <= -4096);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.last[SELF_MEMINFO].time_ns);
+    if (counted)
+    {
+        // The reads of /proc/thread-self/io by the marks are not charged
+        TEST_ASSERT_EQUAL_UINT64(1, stats.last[SELF_STAT].syscalls);
+        TEST_ASSERT_EQUAL_UINT64((uint64_t)length, stats.last[SELF_STAT].bytes_read);
+        TEST_ASSERT_EQUAL_UINT64(0, stats.last[SELF_OUTPUTS].syscalls);
+        TEST_ASSERT_EQUAL_UINT64(0, stats.last[SELF_OUTPUTS].bytes_read);
+    }
+    SelfCost sum = selfstats_sum(stats.total);
+    TEST_ASSERT_EQUAL_UINT64(stats.total[SELF_STAT].time_ns + stats.total[SELF_OUTPUTS].time_ns +
+                                 stats.total[SELF_PRESSURE].time_ns,
+                             sum.time_ns);
+    TEST_ASSERT_EQUAL_INT64(stats.total[SELF_OUTPUTS].heap_bytes + stats.total[SELF_PRESSURE].heap_bytes,
+                            sum.heap_bytes);
+}
+
+void test_unmeasured_thread_changes_nothing(void)
+{
+    SelfStats stats;
+    uint64_t samples = selfstats_read(&stats);
+    selfstats_begin();
+    selfstats_mark(SELF_STAT);
+    selfstats_end();
+    TEST_ASSERT_EQUAL_UINT64(samples, selfstats_read(&stats));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sources_are_charged_their_reads);
+    RUN_TEST(test_unmeasured_thread_changes_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+#include "../include/server.h"
+#include "unity.h"
+#include <arpa/inet.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static char path[64];
+static pid_t server_pid;
+
+/**
+ * @brief Connects to the test server, waiting until it listens.
+ */
+static int connect_server(void)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strcpy(address.sun_path, path);
+    for (int attempt = 0; attempt < 200; attempt++)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0)
+        {
+            return fd;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    return -1;
+}
+
+static void send_request(int fd, const char* command)
+{
+    uint32_t length = htonl((uint32_t)strlen(command));
+    TEST_ASSERT_EQUAL_INT(4, write(fd, &length, 4));
+    TEST_ASSERT_EQUAL_INT((int)strlen(command), write(fd, command, strlen(command)));
+}
+
+static void read_exactly(int fd, void* buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t length = read(fd, (char*)buffer + done, size - done);
+        TEST_ASSERT_TRUE(length > 0);
+        done += length;
+    }
+}
+
+/**
+ * @brief Reads the answer of one request.
+ *
+ * @return The exit status, with the standard output stored in output.
+ */
+static int read_answer(int fd, char* output, size_t size)
+{
+    size_t used = 0;
+    output[0] = '\0';
+    while (1)
+    {
+        char type;
+        uint32_t length;
+        read_exactly(fd, &type, 1);
+        read_exactly(fd, &length, 4);
+        length = ntohl(length);
+        char payload[4096];
+        TEST_ASSERT_TRUE(length < sizeof(payload));
+        read_exactly(fd, payload, length);
+        if (type == SERVER_FRAME_EXIT)
+        {
+            uint32_t status;
+            memcpy(&status, payload, 4);
+            return (int)ntohl(status);
+        }
+        if (type == SERVER_FRAME_STDOUT && used + length < size)
+        {
+            memcpy(output + used, payload, length);
+            used += length;
+            output[used] = '\0';
+        }
+    }
+}
+
+void setUp(void)
+{
+    snprintf(path, sizeof(path), "/tmp/test_server_%d.sock", (int)getpid());
+    server_pid = fork();
+    if (server_pid == 0)
+    {
+        _exit(server_run(path) == 0 ? 0 : 1);
+    }
+}
+
+void tearDown(void)
+{
+    kill(server_pid, SIGTERM);
+    int status;
+    waitpid(server_pid, &status, 0);
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+    TEST_ASSERT_EQUAL_INT(-1, access(path, F_OK));
+}
+
+void test_server_returns_output_and_status(void)
+{
+    int fd = connect_server();
+    TEST_ASSERT_TRUE(fd != -1);
+    char output[256];
+
+    send_request(fd, "echo served");
+    TEST_ASSERT_EQUAL_INT(0, read_answer(fd, output, sizeof(output)));
+    TEST_ASSERT_EQUAL_STRING("served\n", output);
+
+    send_request(fd, "false");
+    TEST_ASSERT_EQUAL_INT(1, read_answer(fd, output, sizeof(output)));
+    close(fd);
+}
+
+void test_server_runs_pipelined_requests_in_order(void)
+{
+    int fd = connect_server();
+    TEST_ASSERT_TRUE(fd != -1);
+    char output[256];
+
+    send_request(fd, "echo first");
+    send_request(fd, "echo second");
+    TEST_ASSERT_EQUAL_INT(0, read_answer(fd, output, sizeof(output)));
+    TEST_ASSERT_EQUAL_STRING("first\n", output);
+    TEST_ASSERT_EQUAL_INT(0, read_answer(fd, output, sizeof(output)));
+    TEST_ASSERT_EQUAL_STRING("second\n", output);
+    close(fd);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_server_returns_output_and_status);
+    RUN_TEST(test_server_runs_pipelined_requests_in_order);
+    return UNITY_END();
+}
@@ -0,0 +1,84 @@
+#include "../include/statusquery.h"
+#include "unity.h"
+
+static MetricSample sample = {1700000000123, 12.5, 40.25, -1, 2048, 180, 5000, {-1, -1, -1}};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_parse_metrics_and_options(void)
+{
+    char arg[] = "cpu,memory --format json --watch 500ms --count 3";
+    StatusQuery query;
+    TEST_ASSERT_EQUAL_INT(0, statusquery_parse(arg, &query));
+    TEST_ASSERT_EQUAL_INT(2, query.metric_count);
+    TEST_ASSERT_EQUAL_INT(0, query.metrics[0]);
+    TEST_ASSERT_EQUAL_INT(1, query.metrics[1]);
+    TEST_ASSERT_EQUAL_INT(QUERY_JSON, query.format);
+    TEST_ASSERT_EQUAL_INT(500, query.watch_ms);
+    TEST_ASSERT_EQUAL_INT(3, query.count);
+
+    char all[] = "--watch 2s";
+    TEST_ASSERT_EQUAL_INT(0, statusquery_parse(all, &query));
+    TEST_ASSERT_EQUAL_INT(SAMPLER_METRICS, query.metric_count);
+    TEST_ASSERT_EQUAL_INT(QUERY_PLAIN, query.format);
+    TEST_ASSERT_EQUAL_INT(2000, query.watch_ms);
+}
+
+void test_parse_rejects_invalid_arguments(void)
+{
+    StatusQuery query;
+    char unknown[] = "cpu,temperature";
+    TEST_ASSERT_EQUAL_INT(-1, statusquery_parse(unknown, &query));
+    char format[] = "cpu --format xml";
+    TEST_ASSERT_EQUAL_INT(-1, statusquery_parse(format, &query));
+    char interval[] = "cpu --watch 1ms";
+    TEST_ASSERT_EQUAL_INT(-1, statusquery_parse(interval, &query));
+    char missing[] = "cpu --watch";
+    TEST_ASSERT_EQUAL_INT(-1, statusquery_parse(missing, &query));
+}
+
+void test_render_formats(void)
+{
+    char arg[] = "cpu,disk,processes";
+    StatusQuery query;
+    TEST_ASSERT_EQUAL_INT(0, statusquery_parse(arg, &query));
+    char buffer[256];
+
+    statusquery_render(&query, &sample, 1, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("12.50 - 180\n", buffer);
+    query.format = QUERY_CSV;
+    statusquery_render(&query, &sample, 1, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("timestamp_ms,cpu,disk,processes\n1700000000123,12.50,,180\n", buffer);
+    statusquery_render(&query, &sample, 0, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("1700000000123,12.50,,180\n", buffer);
+    query.format = QUERY_JSON;
+    size_t length = statusquery_render(&query, &sample, 1, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("{\"timestamp_ms\":1700000000123,\"cpu\":12.50,\"disk\":null,\"processes\":180}\n", buffer);
+    TEST_ASSERT_EQUAL_UINT(strlen(buffer), length);
+}
+
+void test_render_cuts_at_the_buffer(void)
+{
+    char arg[] = "--format json";
+    StatusQuery query;
+    TEST_ASSERT_EQUAL_INT(0, statusquery_parse(arg, &query));
+    char buffer[16];
+    TEST_ASSERT_EQUAL_UINT(15, statusquery_render(&query, &sample, 0, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("{\"timestamp_ms\"", buffer);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_metrics_and_options);
+    RUN_TEST(test_parse_rejects_invalid_arguments);
+    RUN_TEST(test_render_formats);
+    RUN_TEST(test_render_cuts_at_the_buffer);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include "../include/supervisor.h"
+#include "unity.h"
+#include <signal.h>
+#include <sys/wait.h>
+
+static int ended;
+static int last_status;
+
+static void child_ended(pid_t pid, int status, void* data)
+{
+    (void)pid;
+    ended++;
+    last_status = status;
+    if (data != NULL)
+    {
+        *(pid_t*)data = 0;
+    }
+}
+
+/**
+ * @brief Forks a child that exits with a code after a delay.
+ */
+static pid_t spawn(int code, int delay_ms)
+{
+    pid_t pid = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    if (pid == 0)
+    {
+        usleep(delay_ms * 1000);
+        _exit(code);
+    }
+    return pid;
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, supervisor_init());
+    ended = 0;
+    last_status = -1;
+}
+
+void tearDown(void)
+{
+}
+
+void test_handlers_run_when_children_end(void)
+{
+    pid_t first = spawn(3, 0);
+    pid_t second = spawn(4, 50);
+    TEST_ASSERT_EQUAL_INT(0, supervisor_watch(first, child_ended, &first));
+    TEST_ASSERT_EQUAL_INT(0, supervisor_watch(second, child_ended, &second));
+    TEST_ASSERT_EQUAL_INT(2, supervisor_pending());
+
+    while (ended < 2)
+    {
+        TEST_ASSERT_NOT_EQUAL(-1, supervisor_dispatch(1000));
+    }
+    TEST_ASSERT_EQUAL_INT(0, first);
+    TEST_ASSERT_EQUAL_INT(0, second);
+    TEST_ASSERT_EQUAL_INT(0, supervisor_pending());
+    // The slower child ended last
+    TEST_ASSERT_EQUAL_INT(4, WEXITSTATUS(last_status));
+}
+
+void test_wait_dispatches_the_other_children(void)
+{
+    pid_t background = spawn(0, 0);
+    TEST_ASSERT_EQUAL_INT(0, supervisor_watch(background, child_ended, NULL));
+    pid_t foreground = spawn(7, 100);
+    int status = 0;
+    TEST_ASSERT_EQUAL_INT(0, supervisor_wait(foreground, &status));
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(7, WEXITSTATUS(status));
+    // The background child ended first, its handler ran during the wait
+    TEST_ASSERT_EQUAL_INT(1, ended);
+    TEST_ASSERT_EQUAL_INT(0, supervisor_pending());
+}
+
+void test_stops_only_reach_the_watchers_that_ask(void)
+{
+    pid_t quiet = spawn(0, 10000);
+    pid_t job = spawn(0, 10000);
+    TEST_ASSERT_EQUAL_INT(0, supervisor_watch(quiet, child_ended, NULL));
+    TEST_ASSERT_EQUAL_INT(0, supervisor_watch_stops(job, child_ended, NULL));
+    kill(quiet, SIGSTOP);
+    kill(job, SIGSTOP);
+    while (ended < 1)
+    {
+        TEST_ASSERT_NOT_EQUAL(-1, supervisor_dispatch(1000));
+    }
+    supervisor_dispatch(50);
+    TEST_ASSERT_EQUAL_INT(1, ended);
+    TEST_ASSERT_TRUE(WIFSTOPPED(last_status));
+    TEST_ASSERT_EQUAL_INT(2, supervisor_pending());
+
+    kill(quiet, SIGKILL);
+    kill(job, SIGKILL);
+    while (supervisor_pending() > 0)
+    {
+        TEST_ASSERT_NOT_EQUAL(-1, supervisor_dispatch(1000));
+    }
+    TEST_ASSERT_TRUE(WIFSIGNALED(last_status));
+}
+
+void test_readable_descriptor_is_reported(void)
+{
+    int pipe_fds[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(pipe_fds));
+    TEST_ASSERT_EQUAL_INT(1, (int)write(pipe_fds[1], "x", 1));
+    TEST_ASSERT_EQUAL_INT(1, supervisor_wait_readable(pipe_fds[0]));
+
+    // A child ending before any input arrives is reported first
+    char byte;
+    TEST_ASSERT_EQUAL_INT(1, (int)read(pipe_fds[0], &byte, 1));
+    TEST_ASSERT_EQUAL_INT(0, supervisor_watch(spawn(0, 0), child_ended, NULL));
+    TEST_ASSERT_EQUAL_INT(0, supervisor_wait_readable(pipe_fds[0]));
+    TEST_ASSERT_EQUAL_INT(1, ended);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_handlers_run_when_children_end);
+    RUN_TEST(test_wait_dispatches_the_other_children);
+    RUN_TEST(test_stops_only_reach_the_watchers_that_ask);
+    RUN_TEST(test_readable_descriptor_is_reported);
+    return UNITY_END();
+}
@@ -0,0 +1,100 @@
+#include "../include/timeseries.h"
+#include "unity.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define START_MS 1700000000000LL
+
+static MetricSample sample_at(int64_t timestamp_ms, double cpu)
+{
+    MetricSample sample = {timestamp_ms, cpu, 50.0, -1, 1000.0, 200, 10, {-1, -1, -1}};
+    return sample;
+}
+
+void setUp(void)
+{
+    timeseries_reset();
+}
+
+void tearDown(void)
+{
+}
+
+void test_window_rollups_follow_the_samples(void)
+{
+    // One sample per second, cpu going 1..100
+    for (int i = 0; i < 100; i++)
+    {
+        MetricSample sample = sample_at(START_MS + i * 1000LL, i + 1);
+        timeseries_add(&sample);
+    }
+
+    SeriesSummary summary;
+    int64_t end = START_MS / 1000 + 99;
+    TEST_ASSERT_EQUAL_INT(0, timeseries_query(0, end, 100, &summary));
+    TEST_ASSERT_EQUAL_INT(1, summary.resolution_s);
+    TEST_ASSERT_EQUAL_INT(100, summary.points);
+    TEST_ASSERT_EQUAL_INT(100, summary.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, (float)summary.min);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 100.0f, (float)summary.max);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 50.5f, (float)summary.average);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 95.0f, (float)summary.p95);
+
+    // The last ten seconds only
+    TEST_ASSERT_EQUAL_INT(0, timeseries_query(0, end, 10, &summary));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 91.0f, (float)summary.min);
+    TEST_ASSERT_EQUAL_INT(10, summary.count);
+
+    // Metrics that could not be read are not stored
+    TEST_ASSERT_EQUAL_INT(-1, timeseries_query(2, end, 100, &summary));
+}
+
+void test_long_windows_use_coarser_buckets(void)
+{
+    // Ten samples per second for an hour, in 10 s and 1 min buckets
+    srand(3);
+    for (int i = 0; i < 36000; i++)
+    {
+        MetricSample sample = sample_at(START_MS + i * 100LL, rand() % 1000 / 10.0);
+        timeseries_add(&sample);
+    }
+
+    SeriesSummary summary;
+    int64_t end = START_MS / 1000 + 3599;
+    TEST_ASSERT_EQUAL_INT(0, timeseries_query(0, end, 3600, &summary));
+    TEST_ASSERT_EQUAL_INT(10, summary.resolution_s);
+    TEST_ASSERT_EQUAL_INT(360, summary.points);
+    TEST_ASSERT_EQUAL_INT(36000, summary.count);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 49.95f, (float)summary.average);
+
+    TEST_ASSERT_EQUAL_INT(0, timeseries_query(0, end, 6 * 3600, &summary));
+    TEST_ASSERT_EQUAL_INT(60, summary.resolution_s);
+    // The hour starts 20 s into a minute, so it spans 61 minute buckets
+    TEST_ASSERT_EQUAL_INT(61, summary.points);
+
+    TEST_ASSERT_EQUAL_INT(-1, timeseries_query(0, end, 2 * 86400, &summary));
+}
+
+void test_old_buckets_are_replaced(void)
+{
+    MetricSample sample = sample_at(START_MS, 10);
+    timeseries_add(&sample);
+    // Same slot of the 1 s ring, 900 seconds later
+    sample = sample_at(START_MS + 900000, 20);
+    timeseries_add(&sample);
+
+    SeriesSummary summary;
+    TEST_ASSERT_EQUAL_INT(0, timeseries_query(0, START_MS / 1000 + 900, 1, &summary));
+    TEST_ASSERT_EQUAL_INT(1, summary.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.0f, (float)summary.max);
+    TEST_ASSERT_EQUAL_INT(-1, timeseries_query(0, START_MS / 1000, 1, &summary));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_window_rollups_follow_the_samples);
+    RUN_TEST(test_long_windows_use_coarser_buckets);
+    RUN_TEST(test_old_buckets_are_replaced);
+    return UNITY_END();
+}
@@ -0,0 +1,91 @@
+#include "../include/zygote.h"
+#include "unity.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief Launches a program through the zygote with its output in a pipe.
+ *
+ * @return The exit status of the program, with its output stored in output.
+ */
+static int run(char* const argv[], char* output, size_t size)
+{
+    int fds[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+    LaunchOptions options;
+    launch_options_init(&options);
+    options.stdout_fd = fds[1];
+    pid_t pid = zygote_launch(argv, &options);
+    close(fds[1]);
+    TEST_ASSERT_TRUE(pid > 0);
+
+    size_t used = 0;
+    ssize_t length;
+    while ((length = read(fds[0], output + used, size - used - 1)) > 0)
+    {
+        used += length;
+    }
+    output[used] = '\0';
+    close(fds[0]);
+
+    // The child of the zygote is a child of this process
+    int status;
+    TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, zygote_start());
+}
+
+void tearDown(void)
+{
+    zygote_stop();
+}
+
+void test_zygote_launches_with_descriptors(void)
+{
+    char output[256];
+    char* argv[] = {"echo", "from", "zygote", NULL};
+    TEST_ASSERT_EQUAL_INT(0, run(argv, output, sizeof(output)));
+    TEST_ASSERT_EQUAL_STRING("from zygote\n", output);
+}
+
+void test_zygote_uses_current_directory_and_environment(void)
+{
+    char output[256];
+    char previous[1024];
+    TEST_ASSERT_NOT_NULL(getcwd(previous, sizeof(previous)));
+    TEST_ASSERT_EQUAL_INT(0, chdir("/tmp"));
+    setenv("ZYGOTE_TEST", "value", 1);
+
+    char* pwd[] = {"pwd", NULL};
+    TEST_ASSERT_EQUAL_INT(0, run(pwd, output, sizeof(output)));
+    TEST_ASSERT_EQUAL_STRING("/tmp\n", output);
+
+    char* printenv[] = {"printenv", "ZYGOTE_TEST", NULL};
+    TEST_ASSERT_EQUAL_INT(0, run(printenv, output, sizeof(output)));
+    TEST_ASSERT_EQUAL_STRING("value\n", output);
+    TEST_ASSERT_EQUAL_INT(0, chdir(previous));
+}
+
+void test_zygote_reports_exec_errors(void)
+{
+    char* argv[] = {"survshell-no-such-program", NULL};
+    errno = 0;
+    TEST_ASSERT_EQUAL_INT(-1, zygote_launch(argv, NULL));
+    TEST_ASSERT_EQUAL_INT(ENOENT, errno);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_zygote_launches_with_descriptors);
+    RUN_TEST(test_zygote_uses_current_directory_and_environment);
+    RUN_TEST(test_zygote_reports_exec_errors);
+    return UNITY_END();
+}